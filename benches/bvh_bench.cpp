@@ -0,0 +1,196 @@
+#include <math/batch.hpp>
+#include <systems/bvh.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static double ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// Boxes scattered through a cube, in SoA for the brute force cull and as items for the tree
+struct Data
+{
+    std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+    std::vector<niqqa::math::vec3> velocity;
+    std::vector<uint32_t> items;
+    std::vector<uint32_t> visible;
+};
+
+static Data make_data(niqqa::systems::Bvh &bvh, uint32_t count)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    std::uniform_real_distribution<float> speed(-0.5f, 0.5f);
+
+    Data data;
+
+    for (auto *pool : {&data.min_x, &data.min_y, &data.min_z, &data.max_x, &data.max_y, &data.max_z})
+    {
+        pool->resize(count);
+    }
+
+    data.velocity.resize(count);
+    data.items.resize(count);
+    data.visible.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        niqqa::math::vec3 center{position(rng), position(rng), position(rng)};
+        niqqa::math::vec3 extent{size(rng), size(rng), size(rng)};
+
+        data.min_x[i] = center.x - extent.x;
+        data.min_y[i] = center.y - extent.y;
+        data.min_z[i] = center.z - extent.z;
+        data.max_x[i] = center.x + extent.x;
+        data.max_y[i] = center.y + extent.y;
+        data.max_z[i] = center.z + extent.z;
+        data.velocity[i] = {speed(rng), speed(rng), speed(rng)};
+        data.items[i] = bvh.insert({center - extent, center + extent}, i);
+    }
+
+    return data;
+}
+
+// Every tenth box moves each frame, a different tenth each time
+static void bench_update(niqqa::systems::Bvh &bvh, Data &data, uint32_t frames)
+{
+    uint32_t count = static_cast<uint32_t>(data.items.size());
+    double worst = 0.0;
+
+    auto start = clock_type::now();
+
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        for (uint32_t i = frame % 10; i < count; i += 10)
+        {
+            const niqqa::math::vec3 &v = data.velocity[i];
+
+            data.min_x[i] += v.x;
+            data.min_y[i] += v.y;
+            data.min_z[i] += v.z;
+            data.max_x[i] += v.x;
+            data.max_y[i] += v.y;
+            data.max_z[i] += v.z;
+
+            bvh.move(data.items[i], {{data.min_x[i], data.min_y[i], data.min_z[i]}, {data.max_x[i], data.max_y[i], data.max_z[i]}});
+        }
+
+        auto update_start = clock_type::now();
+        bvh.update();
+        double update_ms = ms_since(update_start);
+
+        worst = update_ms > worst ? update_ms : worst;
+    }
+
+    std::printf("move a tenth + update  %7.3f ms per frame, worst update %7.3f ms, %u nodes\n",
+                ms_since(start) / frames, worst, bvh.node_count());
+}
+
+static void bench_cull(niqqa::systems::Bvh &bvh, niqqa::systems::JobSystem &jobs, Data &data, uint32_t iterations)
+{
+    using namespace niqqa::math;
+
+    // Sees a few percent of the cube, like a camera inside a large level
+    mat4 projection = perspective(1.2f, 16.0f / 9.0f, 0.1f, 100.0f);
+    mat4 view = look_at({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f});
+    Frustum frustum = extract_frustum(projection * view);
+
+    SoaAabbs boxes{{data.min_x.data(), data.min_y.data(), data.min_z.data()}, {data.max_x.data(), data.max_y.data(), data.max_z.data()}};
+    uint32_t count = static_cast<uint32_t>(data.items.size());
+    uint32_t brute_visible = 0;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        brute_visible = cull_aabbs(frustum, boxes, count, data.visible.data());
+    }
+
+    double brute_ms = ms_since(start) / iterations;
+
+    std::vector<uint32_t> visible;
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        bvh.query(frustum, visible);
+    }
+
+    double query_ms = ms_since(start) / iterations;
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        bvh.query(frustum, jobs, visible);
+    }
+
+    double parallel_ms = ms_since(start) / iterations;
+
+    std::printf("cull  brute force %7.3f ms  bvh %7.3f ms  bvh on %u threads %7.3f ms  (%u / %zu visible)\n",
+                brute_ms, query_ms, jobs.thread_count(), parallel_ms, brute_visible, visible.size());
+}
+
+static void bench_rays(niqqa::systems::Bvh &bvh, uint32_t ray_count)
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    uint32_t hits = 0;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < ray_count; ++i)
+    {
+        niqqa::math::Ray ray;
+        ray.origin = {0.0f, 0.0f, 0.0f};
+        ray.direction = niqqa::math::normalize(niqqa::math::vec3{unit(rng), unit(rng), unit(rng)});
+
+        niqqa::systems::BvhHit hit;
+        hits += bvh.raycast(ray, hit) ? 1 : 0;
+    }
+
+    std::printf("rays  %7.3f us per ray (%u of %u hit)\n", ms_since(start) * 1000.0 / ray_count, hits, ray_count);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 100000;
+
+    niqqa::systems::JobSystem jobs;
+    niqqa::systems::Bvh bvh;
+
+    if (!jobs.init() || !bvh.init(count))
+    {
+        return EXIT_FAILURE;
+    }
+
+    Data data = make_data(bvh, count);
+
+    auto start = clock_type::now();
+    bvh.rebuild();
+
+    std::printf("%u boxes, full build %.3f ms, %u nodes\n", count, ms_since(start), bvh.node_count());
+
+    for (int i = 0; i < 3; ++i)
+    {
+        bench_cull(bvh, jobs, data, 50);
+        bench_update(bvh, data, 100);
+        bench_rays(bvh, 10000);
+    }
+
+    bvh.cleanup();
+    jobs.cleanup();
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
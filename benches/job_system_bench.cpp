@@ -0,0 +1,130 @@
+#include <systems/job_system.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+using clock_type = std::chrono::steady_clock;
+
+static double ns_per_job(clock_type::time_point start, uint32_t job_count)
+{
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / job_count;
+}
+
+// Empty jobs submitted from the main thread, which then helps until they finish
+static void bench_flat(niqqa::systems::JobSystem &jobs, uint32_t job_count)
+{
+    std::atomic<uint32_t> sink{0};
+    niqqa::systems::JobCounter counter;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < job_count; ++i)
+    {
+        jobs.run([&sink]() {
+            sink.fetch_add(1, std::memory_order_relaxed);
+        }, &counter);
+    }
+
+    jobs.wait(counter);
+
+    std::printf("flat          %8u jobs  %8.1f ns/job\n", job_count, ns_per_job(start, job_count));
+}
+
+// Each job spawns its children from whatever worker runs it, so most work is stolen
+static void bench_fan_out(niqqa::systems::JobSystem &jobs, uint32_t parent_count, uint32_t child_count)
+{
+    std::atomic<uint32_t> sink{0};
+    niqqa::systems::JobCounter counter;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < parent_count; ++i)
+    {
+        jobs.run([&jobs, &sink, &counter, child_count]() {
+            for (uint32_t j = 0; j < child_count; ++j)
+            {
+                jobs.run([&sink]() {
+                    sink.fetch_add(1, std::memory_order_relaxed);
+                }, &counter);
+            }
+        }, &counter);
+    }
+
+    jobs.wait(counter);
+
+    uint32_t job_count = parent_count * (child_count + 1);
+
+    std::printf("fan-out       %8u jobs  %8.1f ns/job\n", job_count, ns_per_job(start, job_count));
+}
+
+// Second batch depends on the first through its counter
+static void bench_dependency(niqqa::systems::JobSystem &jobs, uint32_t job_count)
+{
+    std::atomic<uint32_t> sink{0};
+    niqqa::systems::JobCounter first;
+    niqqa::systems::JobCounter second;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < job_count / 2; ++i)
+    {
+        jobs.run([&sink]() {
+            sink.fetch_add(1, std::memory_order_relaxed);
+        }, &first);
+    }
+
+    for (uint32_t i = 0; i < job_count / 2; ++i)
+    {
+        jobs.run([&sink]() {
+            sink.fetch_add(1, std::memory_order_relaxed);
+        }, &second, &first);
+    }
+
+    jobs.wait(second);
+
+    std::printf("dependency    %8u jobs  %8.1f ns/job\n", job_count, ns_per_job(start, job_count));
+}
+
+static void bench_parallel_for(niqqa::systems::JobSystem &jobs, uint32_t count, uint32_t chunk_size)
+{
+    std::atomic<uint64_t> sink{0};
+
+    auto start = clock_type::now();
+
+    jobs.parallel_for(count, chunk_size, [&sink](uint32_t begin, uint32_t end) {
+        sink.fetch_add(end - begin, std::memory_order_relaxed);
+    });
+
+    uint32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    std::printf("parallel_for  %8u chunks %7.1f ns/chunk\n", chunk_count, ns_per_job(start, chunk_count));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t worker_count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 0;
+
+    niqqa::systems::JobSystem jobs;
+
+    if (!jobs.init(worker_count))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%u threads\n", jobs.thread_count());
+
+    for (int i = 0; i < 3; ++i)
+    {
+        bench_flat(jobs, 4000);
+        bench_fan_out(jobs, 16, 200);
+        bench_dependency(jobs, 4000);
+        bench_parallel_for(jobs, 1u << 20, 256);
+    }
+
+    jobs.cleanup();
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <log.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+// The old backend, a locked iostream write per call
+static std::mutex s_stream_mutex;
+
+static void stream_log(const std::string &module, const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(s_stream_mutex);
+    std::cout << "[INFO][" << module << "]" << message << std::endl;
+}
+
+struct Timing
+{
+    double ns_per_call;
+    uint64_t dropped;
+};
+
+// Until the last message is written out, with what got dropped on the way
+template <typename Call>
+static Timing measure(uint32_t thread_count, uint32_t calls, Call call)
+{
+    std::vector<std::thread> threads;
+
+    uint64_t dropped = niqqa::log::dropped();
+
+    auto start = clock_type::now();
+
+    for (uint32_t t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([t, calls, &call]()
+        {
+            for (uint32_t i = 0; i < calls; ++i)
+            {
+                call(t, i);
+            }
+        });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    niqqa::log::flush();
+
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+
+    return {ns / (static_cast<double>(thread_count) * calls), niqqa::log::dropped() - dropped};
+}
+
+static void print(const char *name, const Timing &timing)
+{
+    std::fprintf(stderr, "%-22s %8.1f ns per call, %llu dropped\n", name, timing.ns_per_call,
+                 static_cast<unsigned long long>(timing.dropped));
+}
+
+// Run with stdout redirected, the results go to stderr. Fails when a message was dropped, the
+// timings would leave out the work of writing it.
+int main(int argc, char **argv)
+{
+    uint32_t thread_count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 4;
+    uint32_t calls = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 20000;
+
+    Timing stream = measure(thread_count, calls, [](uint32_t t, uint32_t i)
+    {
+        stream_log("Bench", "thread " + std::to_string(t) + " frame " + std::to_string(i) + " took " + std::to_string(i * 0.25) + " ms");
+    });
+
+    Timing concat = measure(thread_count, calls, [](uint32_t t, uint32_t i)
+    {
+        LOG_INFO("Bench", "thread " + std::to_string(t) + " frame " + std::to_string(i) + " took " + std::to_string(i * 0.25) + " ms");
+    });
+
+    Timing deferred = measure(thread_count, calls, [](uint32_t t, uint32_t i)
+    {
+        LOG_INFO("Bench", "thread {} frame {} took {} ms", t, i, i * 0.25);
+    });
+
+    std::fprintf(stderr, "%u threads x %u calls\n", thread_count, calls);
+    print("iostream", stream);
+    print("ring, message built", concat);
+    print("ring, deferred format", deferred);
+
+    return concat.dropped + deferred.dropped == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
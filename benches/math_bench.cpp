@@ -0,0 +1,185 @@
+#include <math/batch.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static double ns_per_entry(clock_type::time_point start, uint32_t count, uint32_t iterations)
+{
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / (static_cast<double>(count) * iterations);
+}
+
+// SoA inputs for every kernel, random but the same for each lane type
+struct Data
+{
+    uint32_t count{0};
+
+    std::vector<float> x, y, z, radius;
+    std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+    std::vector<float> a_x, a_y, a_z, a_w, b_x, b_y, b_z, b_w;
+    std::vector<float> out_x, out_y, out_z, out_w, out_max_x, out_max_y, out_max_z;
+    std::vector<uint32_t> visible;
+
+    niqqa::math::mat4 matrix;
+    niqqa::math::Frustum frustum;
+};
+
+static Data make_data(uint32_t count)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+    Data data;
+    data.count = count;
+
+    for (auto *pool : {&data.x, &data.y, &data.z, &data.radius, &data.min_x, &data.min_y, &data.min_z,
+                       &data.max_x, &data.max_y, &data.max_z, &data.a_x, &data.a_y, &data.a_z, &data.a_w,
+                       &data.b_x, &data.b_y, &data.b_z, &data.b_w, &data.out_x, &data.out_y, &data.out_z,
+                       &data.out_w, &data.out_max_x, &data.out_max_y, &data.out_max_z})
+    {
+        pool->resize(count);
+    }
+
+    data.visible.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        data.x[i] = position(rng);
+        data.y[i] = position(rng);
+        data.z[i] = position(rng);
+        data.radius[i] = size(rng);
+
+        data.min_x[i] = data.x[i] - size(rng);
+        data.min_y[i] = data.y[i] - size(rng);
+        data.min_z[i] = data.z[i] - size(rng);
+        data.max_x[i] = data.x[i] + size(rng);
+        data.max_y[i] = data.y[i] + size(rng);
+        data.max_z[i] = data.z[i] + size(rng);
+
+        niqqa::math::quat a = niqqa::math::normalize(niqqa::math::quat{unit(rng), unit(rng), unit(rng), unit(rng)});
+        niqqa::math::quat b = niqqa::math::normalize(niqqa::math::quat{unit(rng), unit(rng), unit(rng), unit(rng)});
+
+        data.a_x[i] = a.x;
+        data.a_y[i] = a.y;
+        data.a_z[i] = a.z;
+        data.a_w[i] = a.w;
+        data.b_x[i] = b.x;
+        data.b_y[i] = b.y;
+        data.b_z[i] = b.z;
+        data.b_w[i] = b.w;
+    }
+
+    niqqa::math::quat rotation = niqqa::math::from_axis_angle({0.0f, 1.0f, 0.0f}, 0.7f);
+    data.matrix = niqqa::math::compose({1.0f, 2.0f, 3.0f}, rotation, {1.5f, 1.5f, 1.5f});
+
+    // Sees roughly a quarter of the cube the data sits in
+    niqqa::math::mat4 projection = niqqa::math::perspective(1.2f, 16.0f / 9.0f, 0.1f, 150.0f);
+    niqqa::math::mat4 view = niqqa::math::look_at({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f});
+    data.frustum = niqqa::math::extract_frustum(projection * view);
+
+    return data;
+}
+
+template <typename Lanes>
+static void bench(const char *name, Data &data, uint32_t iterations)
+{
+    using namespace niqqa::math;
+
+    SoaVec3 points{data.x.data(), data.y.data(), data.z.data()};
+    SoaVec3Out out{data.out_x.data(), data.out_y.data(), data.out_z.data()};
+    SoaAabbs boxes{{data.min_x.data(), data.min_y.data(), data.min_z.data()}, {data.max_x.data(), data.max_y.data(), data.max_z.data()}};
+    SoaAabbsOut out_boxes{out, {data.out_max_x.data(), data.out_max_y.data(), data.out_max_z.data()}};
+    SoaQuat a{data.a_x.data(), data.a_y.data(), data.a_z.data(), data.a_w.data()};
+    SoaQuat b{data.b_x.data(), data.b_y.data(), data.b_z.data(), data.b_w.data()};
+    SoaQuatOut out_quats{data.out_x.data(), data.out_y.data(), data.out_z.data(), data.out_w.data()};
+    SoaSpheres spheres{data.x.data(), data.y.data(), data.z.data(), data.radius.data()};
+
+    uint32_t visible = 0;
+
+    auto start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        transform_points<Lanes>(data.matrix, points, out, data.count);
+    }
+
+    double points_ns = ns_per_entry(start, data.count, iterations);
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        transform_aabbs<Lanes>(data.matrix, boxes, out_boxes, data.count);
+    }
+
+    double aabbs_ns = ns_per_entry(start, data.count, iterations);
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        rotate_vectors<Lanes>(a, points, out, data.count);
+    }
+
+    double rotate_ns = ns_per_entry(start, data.count, iterations);
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        nlerp<Lanes>(a, b, 0.25f, out_quats, data.count);
+    }
+
+    double nlerp_ns = ns_per_entry(start, data.count, iterations);
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        visible = cull_spheres<Lanes>(data.frustum, spheres, data.count, data.visible.data());
+    }
+
+    double spheres_ns = ns_per_entry(start, data.count, iterations);
+
+    start = clock_type::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        visible = cull_aabbs<Lanes>(data.frustum, boxes, data.count, data.visible.data());
+    }
+
+    double cull_aabbs_ns = ns_per_entry(start, data.count, iterations);
+
+    std::printf("%-7s points %6.2f  aabbs %6.2f  rotate %6.2f  nlerp %6.2f  cull spheres %6.2f  cull aabbs %6.2f ns  (%u visible)\n",
+                name, points_ns, aabbs_ns, rotate_ns, nlerp_ns, spheres_ns, cull_aabbs_ns, visible);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 16384;
+    uint32_t iterations = 1000;
+
+    Data data = make_data(count);
+
+    std::printf("%u entries per call, ns per entry\n", count);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        bench<niqqa::math::ScalarLanes>("scalar", data, iterations);
+#ifdef NIQQA_MATH_SSE2
+        bench<niqqa::math::SseLanes>("sse", data, iterations);
+#endif
+#ifdef NIQQA_MATH_AVX2
+        bench<niqqa::math::Avx2Lanes>("avx2", data, iterations);
+#endif
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
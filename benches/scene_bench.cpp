@@ -0,0 +1,152 @@
+#include <systems/scene.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static double ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// Roots with a few levels of children under each, built depth first like a loader would
+static std::vector<niqqa::systems::Entity> build(niqqa::systems::Scene &scene, uint32_t root_count, uint32_t fan_out, uint32_t depth)
+{
+    std::vector<niqqa::systems::Entity> roots;
+
+    niqqa::systems::Transform local;
+    local.position = {1.0f, 0.5f, -0.25f};
+    local.rotation = {0.0f, 0.38268343f, 0.0f, 0.92387953f};
+
+    struct Pending
+    {
+        niqqa::systems::Entity entity;
+        uint32_t depth;
+    };
+
+    std::vector<Pending> stack;
+
+    for (uint32_t i = 0; i < root_count; ++i)
+    {
+        niqqa::systems::Entity root = scene.create(local);
+        scene.set_bounds(root, {0.0f, 0.0f, 0.0f, 1.0f});
+        roots.push_back(root);
+
+        stack.push_back({root, 0});
+
+        while (!stack.empty())
+        {
+            Pending pending = stack.back();
+            stack.pop_back();
+
+            if (pending.depth == depth)
+            {
+                continue;
+            }
+
+            for (uint32_t j = 0; j < fan_out; ++j)
+            {
+                niqqa::systems::Entity child = scene.create(local, pending.entity);
+                scene.set_bounds(child, {0.0f, 0.0f, 0.0f, 1.0f});
+                stack.push_back({child, pending.depth + 1});
+            }
+        }
+    }
+
+    return roots;
+}
+
+// Every root moves, so every entity is recomputed
+static void bench_full(niqqa::systems::Scene &scene, const std::vector<niqqa::systems::Entity> &roots, uint32_t iterations)
+{
+    double total = 0.0;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (auto root : roots)
+        {
+            scene.set_position(root, {static_cast<float>(i), 0.0f, 0.0f});
+        }
+
+        auto start = clock_type::now();
+        scene.update();
+        total += ms_since(start);
+    }
+
+    std::printf("full          %8u entities  %8.3f ms/update\n", scene.entity_count(), total / iterations);
+}
+
+// One root in moving_every moves, the static rest is skipped
+static void bench_partial(niqqa::systems::Scene &scene,
+                          const std::vector<niqqa::systems::Entity> &roots,
+                          uint32_t moving_every,
+                          uint32_t iterations)
+{
+    double total = 0.0;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (size_t j = 0; j < roots.size(); j += moving_every)
+        {
+            scene.set_position(roots[j], {static_cast<float>(i), 0.0f, 0.0f});
+        }
+
+        auto start = clock_type::now();
+        scene.update();
+        total += ms_since(start);
+    }
+
+    std::printf("1 in %-4u     %8u entities  %8.3f ms/update\n", moving_every, scene.entity_count(), total / iterations);
+}
+
+// Reparenting breaks the order, the next update restores it
+static void bench_reorder(niqqa::systems::Scene &scene, const std::vector<niqqa::systems::Entity> &roots, uint32_t iterations)
+{
+    double total = 0.0;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        scene.set_parent(roots[(i + 1) % roots.size()], roots[i % roots.size()]);
+
+        auto start = clock_type::now();
+        scene.update();
+        total += ms_since(start);
+
+        scene.set_parent(roots[(i + 1) % roots.size()], niqqa::systems::Scene::INVALID_ENTITY);
+        scene.update();
+    }
+
+    std::printf("reorder       %8u entities  %8.3f ms/update\n", scene.entity_count(), total / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t root_count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1000;
+
+    niqqa::systems::Scene scene;
+
+    // 1 + 4 + 16 + 64 = 85 entities per root
+    if (!scene.init(root_count * 85))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<niqqa::systems::Entity> roots = build(scene, root_count, 4, 3);
+    scene.update();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        bench_full(scene, roots, 100);
+        bench_partial(scene, roots, 10, 100);
+        bench_partial(scene, roots, 100, 100);
+        bench_reorder(scene, roots, 10);
+    }
+
+    scene.cleanup();
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
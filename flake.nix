@@ -20,7 +20,8 @@
       # vulkan-loader
       # vulkan-validation-layers
       # vulkan-tools
-      # shaderc
+      shaderc
+      liburing
     ];};
   };
 }
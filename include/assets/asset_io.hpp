@@ -0,0 +1,188 @@
+#pragma once
+
+#include <graphics/upload_queue.hpp>
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace niqqa
+{
+namespace assets
+{
+using IoRequestId = uint64_t;
+
+// Queued requests are issued highest priority first, in submission order within one
+enum class IoPriority : uint32_t
+{
+    Critical,
+    High,
+    Normal,
+    Low,
+    Count
+};
+
+enum class IoStatus : uint32_t
+{
+    Complete,
+    Cancelled,
+    Failed
+};
+
+struct IoResult
+{
+    IoRequestId id{0};
+    IoStatus status{IoStatus::Failed};
+    uint64_t size{0};
+
+    // Only for reads into host memory
+    std::vector<uint8_t> data;
+};
+
+// Called from AssetIo::update() on the thread that calls it
+using IoCallback = std::function<void(IoResult &result)>;
+
+struct IoRequest
+{
+    std::string path;
+    uint64_t offset{0};
+
+    // 0 reads to the end of the file
+    uint64_t size{0};
+
+    IoPriority priority{IoPriority::Normal};
+
+    // With a buffer the file is read straight into upload staging memory and copied to
+    // buffer_offset from there, nothing goes through host memory of our own. The copies
+    // are recorded by the time the callback runs, they land with the upload queue's next
+    // flush(). Keep the buffer alive until then, also for a cancelled request.
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkDeviceSize buffer_offset{0};
+
+    IoCallback callback;
+};
+
+// Reads asset files off the render thread. Requests are split into chunks that are
+// issued a queue depth at a time, through io_uring where liburing is available and by a
+// few threads doing blocking reads otherwise. Reads into a buffer hold staging space
+// only while their chunks are in flight, a full staging ring just holds them back.
+class AssetIo
+{
+public:
+    static constexpr IoRequestId INVALID_REQUEST{0};
+    static constexpr uint64_t CHUNK_SIZE{1024 * 1024};
+    static constexpr uint32_t QUEUE_DEPTH{32};
+
+    // Without an upload queue only reads into host memory are possible
+    bool init(graphics::UploadQueue *uploads, uint32_t fallback_threads = 2) noexcept;
+    void cleanup() noexcept;
+
+    IoRequestId read(IoRequest request) noexcept;
+
+    // Chunks not yet issued are dropped, the callback still runs, with Cancelled, once the
+    // ones in flight are back
+    void cancel(IoRequestId id) noexcept;
+
+    // Only affects chunks not yet issued
+    void set_priority(IoRequestId id, IoPriority priority) noexcept;
+
+    // Runs the callbacks of finished requests, call once a frame
+    void update() noexcept;
+
+    uint32_t pending() const noexcept;
+    bool uses_io_uring() const noexcept;
+
+private:
+    static constexpr uint32_t WAIT_MS{2};
+
+    struct Request
+    {
+        IoRequestId id{INVALID_REQUEST};
+        IoRequest desc;
+
+        // A file descriptor, or a FILE * where there is no pread
+        intptr_t file{-1};
+        bool opened{false};
+        bool queued{false};
+        bool cancelled{false};
+        bool failed{false};
+
+        uint64_t size{0};
+        uint64_t issued{0};
+        uint64_t completed{0};
+        uint32_t in_flight{0};
+
+        std::vector<uint8_t> data;
+    };
+
+    struct Chunk
+    {
+        Request *request{nullptr};
+
+        // Within the read, not the file
+        uint64_t offset{0};
+        uint64_t size{0};
+        uint64_t done{0};
+
+        uint8_t *destination{nullptr};
+        graphics::StagingLease lease;
+
+        // Bytes read by the last attempt, or a negative errno
+        int64_t result{0};
+    };
+
+    // io_uring state, only defined with liburing
+    struct Ring;
+
+    graphics::UploadQueue *m_uploads{nullptr};
+    Ring *m_ring{nullptr};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_running{false};
+
+    std::unordered_map<IoRequestId, std::unique_ptr<Request>> m_requests;
+    std::array<std::deque<Request *>, static_cast<size_t>(IoPriority::Count)> m_queues;
+    std::vector<Request *> m_cancelled;
+    std::vector<std::pair<IoCallback, IoResult>> m_finished;
+    IoRequestId m_next_id{1};
+
+    // Owned by the dispatcher
+    std::array<Chunk, QUEUE_DEPTH> m_chunks;
+    std::vector<Chunk *> m_free_chunks;
+    uint32_t m_in_flight{0};
+
+    // Blocking reads, when there is no ring
+    std::vector<std::thread> m_workers;
+    std::deque<Chunk *> m_work;
+    std::condition_variable m_work_ready;
+
+    // Only once the dispatcher is gone, it may still hand out retries while shutting down
+    bool m_stop_workers{false};
+    std::vector<Chunk *> m_completed;
+
+    std::thread m_dispatcher;
+
+    void dispatch_loop() noexcept;
+    bool open_request(Request &request) noexcept;
+    Chunk *prepare_chunk(Request &request) noexcept;
+    void issue(const std::vector<Chunk *> &chunks) noexcept;
+    void reap(std::vector<Chunk *> &completed, bool wait) noexcept;
+    void complete(Chunk &chunk, std::vector<Chunk *> &retries) noexcept;
+    void finish(Request &request, IoStatus status) noexcept;
+    void unqueue(Request &request) noexcept;
+
+    void worker_loop() noexcept;
+};
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <assets/mesh_file.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace assets
+{
+struct MeshSourceLod
+{
+    uint32_t first_index{0};
+    uint32_t index_count{0};
+    float max_distance{0.0f};
+};
+
+// Triangle lists with full precision attributes, as an importer produces them
+struct MeshSource
+{
+    std::vector<std::array<float, 3>> positions;
+
+    // Both optional, a missing normal is +Z, a missing uv is 0
+    std::vector<std::array<float, 3>> normals;
+    std::vector<std::array<float, 2>> uvs;
+
+    std::vector<uint32_t> indices;
+
+    // Ranges of indices, finest first. Empty is a single level over every index.
+    std::vector<MeshSourceLod> lods;
+};
+
+// Quantizes the vertices, reorders every lod's triangles for the post transform cache,
+// then the vertices in the order the triangles first use them, and writes the result in
+// the layout MeshFile maps. This is the offline half, nothing here runs at load time.
+bool cook_mesh(const MeshSource &source, const std::string &path) noexcept;
+
+// Tom Forsyth's linear speed vertex cache optimization, in place
+void optimize_vertex_cache(uint32_t *indices, size_t index_count, uint32_t vertex_count) noexcept;
+
+// Renumbers vertices in first use order, remap[old] is the new index or UINT32_MAX when unused.
+// Returns the used vertex count.
+uint32_t optimize_vertex_fetch(uint32_t *indices, size_t index_count, uint32_t vertex_count, std::vector<uint32_t> &remap) noexcept;
+
+std::array<int16_t, 2> encode_octahedral(const std::array<float, 3> &normal) noexcept;
+uint16_t float_to_half(float value) noexcept;
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace assets
+{
+// "NMSH" read as a little endian uint32
+static constexpr uint32_t MESH_FILE_MAGIC{0x48534D4E};
+static constexpr uint32_t MESH_FILE_VERSION{1};
+
+// Every stream starts on this, so a mapped stream is as aligned as any GPU copy wants
+static constexpr uint64_t MESH_FILE_ALIGNMENT{64};
+static constexpr uint32_t MESH_FILE_MAX_LODS{8};
+
+enum class MeshStream : uint32_t
+{
+    Positions,
+    Attributes,
+    Indices,
+    Count
+};
+
+struct MeshFileRange
+{
+    uint64_t offset{0};
+    uint64_t size{0};
+};
+
+// The file is, in order: this header, lod_count MeshFileLods, then the streams, each on a
+// MESH_FILE_ALIGNMENT boundary. Everything from data_offset to the end of the file is
+// GPU data, laid out so it can be copied into one buffer as is.
+struct MeshFileHeader
+{
+    uint32_t magic{MESH_FILE_MAGIC};
+    uint32_t version{MESH_FILE_VERSION};
+    uint32_t vertex_count{0};
+    uint32_t index_count{0};
+
+    // 2 or 4
+    uint32_t index_size{4};
+    uint32_t lod_count{0};
+    uint64_t data_offset{0};
+
+    // Positions are unorm16 within this box, position = quantize_min + unorm * quantize_scale
+    std::array<float, 3> quantize_min{};
+    float padding0{0.0f};
+    std::array<float, 3> quantize_scale{};
+    float padding1{0.0f};
+
+    // Bounding sphere in object space, center and radius
+    std::array<float, 4> bounds{};
+
+    std::array<MeshFileRange, static_cast<size_t>(MeshStream::Count)> streams{};
+};
+
+// A range of the index stream, finest first
+struct MeshFileLod
+{
+    uint32_t first_index{0};
+    uint32_t index_count{0};
+
+    // Furthest camera distance this level is used at
+    float max_distance{0.0f};
+    uint32_t padding{0};
+};
+
+// Vertex stream elements, 8 bytes each instead of 32 for float positions, normals and uvs
+struct MeshPosition
+{
+    // R16G16B16A16_UNORM, w unused
+    std::array<uint16_t, 4> position;
+};
+
+struct MeshAttributes
+{
+    // R16G16_SNORM octahedral unit vector
+    std::array<int16_t, 2> normal;
+
+    // R16G16_SFLOAT
+    std::array<uint16_t, 2> uv;
+};
+
+static_assert(sizeof(MeshFileHeader) == 128);
+static_assert(sizeof(MeshFileLod) == 16);
+static_assert(sizeof(MeshPosition) == 8);
+static_assert(sizeof(MeshAttributes) == 8);
+
+// A read-only view of a mesh file. The file is mapped, not read, so opening it only
+// touches the header and the pages the GPU copy later reads. Nothing is decoded, open()
+// checks that the header describes ranges inside the file and that is it.
+class MeshFile
+{
+public:
+    bool open(const std::string &path) noexcept;
+    void close() noexcept;
+
+    bool is_open() const noexcept;
+
+    const MeshFileHeader &header() const noexcept;
+    const MeshFileLod *lods() const noexcept;
+
+    const void *stream(MeshStream stream) const noexcept;
+    uint64_t stream_size(MeshStream stream) const noexcept;
+
+    // Every stream, back to back as they are in the file. Stream offsets within it are
+    // header().streams[i].offset - header().data_offset.
+    const void *data() const noexcept;
+    uint64_t data_size() const noexcept;
+
+    // Tells the OS the data is about to be read, so the pages come in ahead of the copy
+    void prefetch() const noexcept;
+
+private:
+    const uint8_t *m_bytes{nullptr};
+    uint64_t m_size{0};
+
+    // Only used where files cannot be mapped
+    std::vector<uint8_t> m_fallback;
+
+    std::string m_path;
+
+    bool validate() const noexcept;
+};
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
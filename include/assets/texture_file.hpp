@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace assets
+{
+// "NTEX" read as a little endian uint32
+static constexpr uint32_t TEXTURE_FILE_MAGIC{0x5845544E};
+static constexpr uint32_t TEXTURE_FILE_VERSION{1};
+
+// Every mip starts on this, which covers the copy alignment of any texel block
+static constexpr uint64_t TEXTURE_FILE_ALIGNMENT{64};
+static constexpr uint32_t TEXTURE_FILE_MAX_MIPS{16};
+
+struct TextureFileMip
+{
+    uint64_t offset{0};
+    uint64_t size{0};
+    uint32_t width{0};
+    uint32_t height{0};
+};
+
+// The file is this header then the mips, finest first, each on a TEXTURE_FILE_ALIGNMENT
+// boundary. Mip data is in the layout vkCmdCopyBufferToImage takes, tightly packed rows
+// or blocks. Any run of consecutive mips is one contiguous range of the file, so a
+// streamer reads the coarse tail or the next few finer mips with a single read.
+struct TextureFileHeader
+{
+    uint32_t magic{TEXTURE_FILE_MAGIC};
+    uint32_t version{TEXTURE_FILE_VERSION};
+
+    // A VkFormat
+    uint32_t format{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t mip_count{0};
+    uint32_t padding[2]{};
+
+    std::array<TextureFileMip, TEXTURE_FILE_MAX_MIPS> mips{};
+};
+
+// Full precision mips as an importer or an offline compressor produces them
+struct TextureSource
+{
+    // A VkFormat, mips are generated for the 8 bit RGBA and BGRA formats only
+    uint32_t format{0};
+    uint32_t width{0};
+    uint32_t height{0};
+
+    // Finest first. A single mip of a format mips can be generated for gets the whole chain.
+    std::vector<std::vector<uint8_t>> mips;
+};
+
+// Offsets, sizes and extents consistent and within file_size, when it is known
+bool validate_texture_header(const TextureFileHeader &header, uint64_t file_size = UINT64_MAX) noexcept;
+
+// Box filters missing mips where it can and writes the file. Offline, like cook_mesh.
+bool cook_texture(const TextureSource &source, const std::string &path) noexcept;
+
+// Bytes from the first byte of mip first to the last byte of mip last - 1
+uint64_t texture_mip_range_size(const TextureFileHeader &header, uint32_t first, uint32_t last) noexcept;
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace niqqa
+{
+namespace core
+{
+static constexpr size_t CACHE_LINE_SIZE{64};
+
+// Hands out storage on an Alignment boundary, so pools start on a cache line and
+// SIMD loops over them never split one
+template <typename T, size_t Alignment = CACHE_LINE_SIZE>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T *pointer, size_t) noexcept
+    {
+        ::operator delete(pointer, std::align_val_t{Alignment});
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept
+    {
+        return true;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+} // namespace core
+} // namespace niqqa
\ No newline at end of file
@@ -10,13 +10,15 @@ namespace core
 class Instance
 {
 public:
-    bool init() noexcept;
+    bool init(bool headless = false) noexcept;
     void cleanup() noexcept;
 
+    VkInstance instance() const noexcept;
+
 private:
     VkInstance m_instance{VK_NULL_HANDLE};
 
-    std::vector<const char *> get_required_extensions();
+    std::vector<const char *> get_required_extensions(bool headless);
 }; 
 } // namespace core
 } // namespace niqqa
\ No newline at end of file
@@ -15,6 +15,7 @@ namespace core
 class Window
 {
 public:
+    Window() = default;
     Window(const Window &) = delete;
     Window &operator=(const Window &) = delete;
 
@@ -23,17 +24,26 @@ public:
     bool create_surface(VkInstance instance, VkSurfaceKHR &surface) noexcept;
 
     void poll_events() noexcept;
+
+    // Blocks until at least one event arrived
+    void wait_events() noexcept;
     void cleanup() noexcept;
 
+    // True once after the framebuffer changed size
+    bool consume_resize() noexcept;
+    VkExtent2D framebuffer_extent() const noexcept;
+
 private:
     GLFWwindow *m_window{nullptr};
 
-    VkExtent2D m_extent;
-    const std::string m_title;
+    static void framebuffer_size_callback(GLFWwindow *window, int width, int height) noexcept;
+
+    VkExtent2D m_extent{};
+    std::string m_title;
 
     bool m_resized{false};
-    bool m_resizable;
-    bool m_fullscreen;
+    bool m_resizable{true};
+    bool m_fullscreen{false};
 };
 } // namespace core
 } // namspace niqqa
\ No newline at end of file
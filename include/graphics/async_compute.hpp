@@ -0,0 +1,78 @@
+#pragma once
+
+#include <graphics/command_pool.hpp>
+#include <graphics/device.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+struct ComputeFrame
+{
+    CommandPool command_pool;
+    VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+
+    // Compute timeline value of the frame's submit, waited on by the graphics submit of the same frame
+    SyncPoint sync;
+};
+
+// Per frame compute work on the compute queue, submitted ahead of the graphics work
+// so the two overlap. Without a compute-only family it goes to the graphics queue
+// and the same code path runs, just serialized.
+//
+// Resources the compute work writes are handed to graphics with release_*: across
+// families that is a queue family ownership transfer, whose acquire half acquire()
+// records on the graphics side. Handed over resources should be per frame and fully
+// rewritten by the compute work, they are never transferred back.
+class AsyncCompute
+{
+public:
+    bool init(Device &device, uint32_t frame_count) noexcept;
+    void cleanup() noexcept;
+
+    // Waits for the frame's previous compute submit and starts recording
+    VkCommandBuffer begin(uint32_t frame_index) noexcept;
+
+    // dst_access and dst_stage describe the first graphics use of the resource
+    void release_buffer(VkBuffer buffer, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage) noexcept;
+    void release_image(VkImage image,
+                       const VkImageSubresourceRange &range,
+                       VkImageLayout old_layout,
+                       VkImageLayout new_layout,
+                       VkAccessFlags dst_access,
+                       VkPipelineStageFlags dst_stage) noexcept;
+
+    // Returns the point the graphics submit has to wait on at wait_stage().
+    // wait_for makes the compute work start after something else, e.g. an earlier graphics submit.
+    SyncPoint submit(const SyncPoint &wait_for = {},
+                     VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) noexcept;
+
+    void acquire(VkCommandBuffer graphics_command_buffer) noexcept;
+    VkPipelineStageFlags wait_stage() const noexcept;
+
+    bool is_dedicated() const noexcept;
+
+private:
+    VkDevice m_device{VK_NULL_HANDLE};
+    Timeline *m_timeline{nullptr};
+    uint32_t m_compute_family{UINT32_MAX};
+    uint32_t m_graphics_family{UINT32_MAX};
+
+    std::vector<ComputeFrame> m_frames;
+    uint32_t m_frame_index{0};
+
+    std::vector<VkBufferMemoryBarrier> m_buffer_releases;
+    std::vector<VkImageMemoryBarrier> m_image_releases;
+    VkPipelineStageFlags m_release_stages{0};
+
+    std::vector<VkBufferMemoryBarrier> m_buffer_acquires;
+    std::vector<VkImageMemoryBarrier> m_image_acquires;
+    VkPipelineStageFlags m_wait_stage{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
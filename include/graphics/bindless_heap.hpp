@@ -0,0 +1,106 @@
+#pragma once
+
+#include <graphics/device.hpp>
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+enum class BindlessType : uint32_t
+{
+    Texture = 0,
+    Sampler,
+    Buffer,
+    Count
+};
+
+// Binding index inside the heap's set, also what shaders declare
+static constexpr std::array<VkDescriptorType, static_cast<uint32_t>(BindlessType::Count)> BINDLESS_DESCRIPTOR_TYPES = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+};
+
+// One update-after-bind descriptor set holding every texture, sampler and storage
+// buffer, bound once per command buffer. Materials refer to resources by index and
+// pass those through push constants instead of binding sets per draw.
+//
+// Removed slots are only reused once the frames that might still read them are done,
+// begin_frame() keeps track of that.
+class BindlessHeap
+{
+public:
+    static constexpr uint32_t INVALID_INDEX{UINT32_MAX};
+    static constexpr uint32_t PUSH_CONSTANT_SIZE{128};
+
+    bool init(Device &device, uint32_t frames_in_flight) noexcept;
+    void cleanup() noexcept;
+
+    void begin_frame() noexcept;
+
+    uint32_t add_texture(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) noexcept;
+    uint32_t add_sampler(VkSampler sampler) noexcept;
+    uint32_t add_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) noexcept;
+
+    void update_texture(uint32_t index, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) noexcept;
+    void update_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) noexcept;
+
+    void remove(BindlessType type, uint32_t index) noexcept;
+
+    void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point) const noexcept;
+
+    bool is_enabled() const noexcept;
+    uint32_t capacity(BindlessType type) const noexcept;
+
+    VkDescriptorSetLayout set_layout() const noexcept;
+    VkPipelineLayout pipeline_layout() const noexcept;
+    VkDescriptorSet descriptor_set() const noexcept;
+
+private:
+    static constexpr uint32_t TYPE_COUNT{static_cast<uint32_t>(BindlessType::Count)};
+    static constexpr std::array<uint32_t, TYPE_COUNT> DESIRED_CAPACITY = {65536, 1024, 65536};
+
+    struct Slots
+    {
+        uint32_t capacity{0};
+        uint32_t next{0};
+        std::vector<uint32_t> free;
+
+        // Per slot below next, set from allocation until remove()
+        std::vector<uint8_t> live;
+    };
+
+    struct RetiredSlot
+    {
+        BindlessType type;
+        uint32_t index;
+        uint64_t frame;
+    };
+
+    VkDevice m_device{VK_NULL_HANDLE};
+
+    VkDescriptorPool m_pool{VK_NULL_HANDLE};
+    VkDescriptorSetLayout m_set_layout{VK_NULL_HANDLE};
+    VkPipelineLayout m_pipeline_layout{VK_NULL_HANDLE};
+    VkDescriptorSet m_set{VK_NULL_HANDLE};
+
+    std::array<Slots, TYPE_COUNT> m_slots;
+    std::vector<RetiredSlot> m_retired;
+
+    uint32_t m_frames_in_flight{0};
+    uint64_t m_frame{0};
+
+    std::mutex m_mutex;
+
+    uint32_t allocate(BindlessType type) noexcept;
+    bool is_live(BindlessType type, uint32_t index) const noexcept;
+    void write(BindlessType type, uint32_t index, const VkDescriptorImageInfo *image_info, const VkDescriptorBufferInfo *buffer_info) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
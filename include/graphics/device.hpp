@@ -1,5 +1,9 @@
 #pragma once
 
+#include <graphics/memory_allocator.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <graphics/timeline.hpp>
+
 #include <vulkan/vulkan.h>
 
 #include <cstdint>
@@ -17,24 +21,92 @@ struct QueueFamilyIndices
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
 
+    // Only set when the device has a family other than graphics that can copy
+    std::optional<uint32_t> transfer_family;
+
+    // Only set when the device has a compute family without graphics. It may be the
+    // transfer family too, uploads and async compute then share its queue.
+    std::optional<uint32_t> compute_family;
+
     bool is_complete() const noexcept;
 };
 
+// Pipeline state that can be set while recording instead of being baked into pipelines
+struct DynamicStateSupport
+{
+    // Cull mode, front face, topology within its class, depth test, write and compare op
+    bool extended{false};
+
+    // Depth bias enable, primitive restart enable
+    bool extended2{false};
+
+    bool polygon_mode{false};
+    bool depth_clamp{false};
+};
+
+// Per memory heap, from VK_EXT_memory_budget. Usage counts this process only, budget is
+// what the driver thinks it can have before other processes and the system push back.
+struct MemoryBudget
+{
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> budget{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> usage{};
+    uint32_t heap_count{0};
+};
+
 QueueFamilyIndices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface) noexcept;
 
 class Device
 {
 public:
-    bool init(VkInstance instance, VkSurfaceKHR surface) noexcept;
+    bool init(VkInstance instance, VkSurfaceKHR surface, const std::string &pipeline_cache_path = "pipeline_cache.bin") noexcept;
     void cleanup() noexcept;
 
     VkPhysicalDevice gpu() const noexcept;
     VkDevice device() const noexcept;
+
+    VkQueue graphics_queue() const noexcept;
+    VkQueue present_queue() const noexcept;
+    VkQueue transfer_queue() const noexcept;
+    VkQueue compute_queue() const noexcept;
     
     uint32_t graphics_queue_family() const noexcept;
     uint32_t present_queue_family() const noexcept;
+    uint32_t transfer_queue_family() const noexcept;
+    uint32_t compute_queue_family() const noexcept;
+
+    bool has_dedicated_transfer_queue() const noexcept;
+    bool has_dedicated_compute_queue() const noexcept;
 
     VkPhysicalDeviceProperties properties() const noexcept;
+    VkPhysicalDeviceFeatures features() const noexcept;
+
+    // What was enabled, not what the device supports
+    const VkPhysicalDeviceVulkan12Features &vulkan12_features() const noexcept;
+    const VkPhysicalDeviceVulkan13Features &vulkan13_features() const noexcept;
+
+    bool supports_bindless() const noexcept;
+    bool supports_dynamic_rendering() const noexcept;
+    bool supports_present_wait() const noexcept;
+    bool supports_memory_budget() const noexcept;
+
+    // vkCmdDrawIndexedIndirectCount with multi draw and a first instance per draw
+    bool supports_draw_indirect_count() const noexcept;
+    const DynamicStateSupport &dynamic_state() const noexcept;
+
+    // vkWaitForPresentKHR, presents have to carry a VkPresentIdKHR for this to return
+    VkResult wait_for_present(VkSwapchainKHR swapchain, uint64_t present_id, uint64_t timeout) const noexcept;
+
+    // Current values, they change as this and other processes allocate. False without the extension.
+    bool memory_budget(MemoryBudget &budget) const noexcept;
+
+    // One per distinct queue, so a queue shared between roles also shares its timeline
+    Timeline &graphics_timeline() noexcept;
+    Timeline &compute_timeline() noexcept;
+    Timeline &transfer_timeline() noexcept;
+    Timeline &present_timeline() noexcept;
+
+    MemoryAllocator &allocator() noexcept;
+    PipelineCache &pipeline_cache() noexcept;
 
 private:
     VkInstance m_instance{VK_NULL_HANDLE};
@@ -42,12 +114,34 @@ private:
     VkPhysicalDevice m_gpu{VK_NULL_HANDLE};
     VkQueue m_graphics_queue{VK_NULL_HANDLE};
     VkQueue m_present_queue{VK_NULL_HANDLE};
+    VkQueue m_transfer_queue{VK_NULL_HANDLE};
+    VkQueue m_compute_queue{VK_NULL_HANDLE};
 
     VkPhysicalDeviceProperties m_properties;
     VkPhysicalDeviceFeatures m_features;
+    VkPhysicalDeviceVulkan12Features m_vulkan12_features{};
+    VkPhysicalDeviceVulkan13Features m_vulkan13_features{};
+    bool m_bindless{false};
+    bool m_dynamic_rendering{false};
+    bool m_present_wait{false};
+    bool m_memory_budget{false};
+    bool m_draw_indirect_count{false};
+    DynamicStateSupport m_dynamic_state;
+
+    PFN_vkWaitForPresentKHR m_wait_for_present{nullptr};
+
+    MemoryAllocator m_allocator;
+    PipelineCache m_pipeline_cache;
+
+    Timeline m_graphics_timeline;
+    Timeline m_compute_timeline;
+    Timeline m_transfer_timeline;
+    Timeline m_present_timeline;
 
     uint32_t m_graphics_family{UINT32_MAX};
     uint32_t m_present_family{UINT32_MAX};
+    uint32_t m_transfer_family{UINT32_MAX};
+    uint32_t m_compute_family{UINT32_MAX};
 
     const std::vector<const char *> m_validation_layers = {
         "VK_LAYER_KHRONOS_validation"
@@ -1,30 +1,59 @@
 #pragma once
 
 #include <graphics/command_pool.hpp>
+#include <graphics/gpu_profiler.hpp>
+#include <graphics/timeline.hpp>
 
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <cstdint>
+#include <vector>
 
 namespace niqqa
 {
 namespace graphics
 {
+// Command pools are externally synchronized, so every recording thread gets its
+// own pool per frame and reuses the secondary buffers it allocated last time around
+struct ThreadCommands
+{
+    CommandPool command_pool;
+    std::vector<VkCommandBuffer> secondary_buffers;
+    uint32_t used_secondary_buffers{0};
+};
+
 struct Frame 
 {
     CommandPool command_pool;
     VkCommandBuffer command_buffer{VK_NULL_HANDLE};
 
+    std::vector<ThreadCommands> thread_commands;
+
+    // The swapchain only takes binary semaphores. Present semaphores belong to the
+    // swapchain's images, see Swapchain::present_semaphore.
     VkSemaphore acquire_semaphore{VK_NULL_HANDLE};
-    VkSemaphore present_semaphore{VK_NULL_HANDLE};
-    VkFence frame_fence{VK_NULL_HANDLE};
 
-    bool init(VkDevice device, uint32_t queue_family_index) noexcept;
+    // Graphics timeline value of the frame's last submit
+    SyncPoint sync;
+
+    FrameQueries queries;
+
+    // When the frame's input was sampled, and the VkPresentIdKHR it was presented with (0 if none)
+    std::chrono::steady_clock::time_point input_time;
+    uint64_t present_id{0};
+
+    bool init(VkDevice device, uint32_t queue_family_index, uint32_t thread_count = 0) noexcept;
     void destroy(VkDevice device) noexcept;
 
-    void wait_and_reset(VkDevice device) noexcept;
+    // Split so a frame can bail out after waiting, e.g. on an out of date swapchain,
+    // before anything it owns was reset
+    void wait() const noexcept;
+    void reset() noexcept;
 
     void begin_commands() noexcept;
     void end_commands() noexcept;
+
+    VkCommandBuffer acquire_secondary(uint32_t thread_index) noexcept;
 };
 } // namespace graphics
 } // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <graphics/device.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+static constexpr uint32_t PIPELINE_STATISTIC_COUNT{7};
+
+static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// Same order as the bits above, which is the order Vulkan writes them in
+static constexpr std::array<const char *, PIPELINE_STATISTIC_COUNT> PIPELINE_STATISTIC_NAMES = {
+    "ia_vertices",
+    "ia_primitives",
+    "vs_invocations",
+    "clipping_invocations",
+    "clipping_primitives",
+    "fs_invocations",
+    "cs_invocations"
+};
+
+struct PassTiming
+{
+    std::string name;
+    uint32_t depth{0};
+
+    double begin_ms{0.0};
+    double gpu_ms{0.0};
+
+    bool has_statistics{false};
+    std::array<uint64_t, PIPELINE_STATISTIC_COUNT> statistics{};
+};
+
+struct FrameTimings
+{
+    uint64_t frame_number{0};
+
+    // Device clock of the first pass, passes are relative to it
+    double gpu_begin_ms{0.0};
+    std::vector<PassTiming> passes;
+};
+
+// Query pools owned by one Frame. Results are collected the next time the frame
+// comes around, after its timeline value has been waited on, so reading them never stalls.
+class FrameQueries
+{
+public:
+    bool init(Device &device, uint32_t max_passes) noexcept;
+    void destroy(VkDevice device) noexcept;
+
+    void reset(VkCommandBuffer command_buffer, uint64_t frame_number) noexcept;
+
+    uint32_t begin_pass(VkCommandBuffer command_buffer, const char *name) noexcept;
+    void end_pass(VkCommandBuffer command_buffer, uint32_t pass_index) noexcept;
+
+    bool collect(VkDevice device, FrameTimings &timings) noexcept;
+
+    // Statistics a secondary command buffer has to inherit right now
+    VkQueryPipelineStatisticFlags active_statistics() const noexcept;
+
+private:
+    static constexpr uint32_t INVALID_PASS{UINT32_MAX};
+
+    VkQueryPool m_timestamp_pool{VK_NULL_HANDLE};
+    VkQueryPool m_statistics_pool{VK_NULL_HANDLE};
+
+    double m_timestamp_period{1.0};
+    uint64_t m_timestamp_mask{UINT64_MAX};
+
+    uint32_t m_max_passes{0};
+    uint32_t m_pass_count{0};
+    uint32_t m_depth{0};
+    uint32_t m_statistics_pass{INVALID_PASS};
+    uint64_t m_frame_number{0};
+    bool m_pending{false};
+
+    // Names must outlive the frame, string literals are the intended use
+    std::vector<const char *> m_pass_names;
+    std::vector<uint32_t> m_pass_depths;
+    std::vector<bool> m_pass_statistics;
+
+    std::vector<uint64_t> m_timestamp_results;
+    std::vector<uint64_t> m_statistics_results;
+};
+
+class GpuScope
+{
+public:
+    GpuScope(FrameQueries &queries, VkCommandBuffer command_buffer, const char *name) noexcept;
+    ~GpuScope() noexcept;
+
+    GpuScope(const GpuScope &) = delete;
+    GpuScope &operator=(const GpuScope &) = delete;
+
+private:
+    FrameQueries &m_queries;
+    VkCommandBuffer m_command_buffer;
+    uint32_t m_pass_index;
+};
+
+class GpuProfiler
+{
+public:
+    void submit(FrameTimings &&timings) noexcept;
+
+    const FrameTimings &latest() const noexcept;
+    double average_pass_ms(const std::string &name) const noexcept;
+
+    void set_capture(bool capture) noexcept;
+    bool write_chrome_trace(const std::string &path) const noexcept;
+
+private:
+    static constexpr size_t HISTORY_SIZE{120};
+    static constexpr size_t MAX_CAPTURED_FRAMES{10000};
+
+    FrameTimings m_latest;
+    std::deque<FrameTimings> m_history;
+
+    bool m_capture{false};
+    std::vector<FrameTimings> m_captured;
+};
+} // namespace graphics
+} // namespace niqqa
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <graphics/bindless_heap.hpp>
+#include <graphics/device.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/pipeline_builder.hpp>
+#include <graphics/render_graph.hpp>
+#include <graphics/shader_manager.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+static constexpr uint32_t MAX_MESH_LODS{4};
+
+// The structs below are read by shaders as is, shaders/gpu_driven/scene.glsl has their
+// std430 counterparts. Keep the two in sync.
+
+// Indices into the scene's shared index and vertex buffers
+struct GpuMeshLod
+{
+    uint32_t first_index{0};
+    uint32_t index_count{0};
+    int32_t vertex_offset{0};
+
+    // Furthest camera distance, scaled by the view's lod scale, this level is used at
+    float max_distance{0.0f};
+};
+
+struct GpuMesh
+{
+    std::array<GpuMeshLod, MAX_MESH_LODS> lods{};
+    uint32_t lod_count{0};
+    uint32_t padding[3]{};
+};
+
+struct GpuObject
+{
+    // Object to world, the upper three rows of a row-major 4x4
+    std::array<float, 12> transform{1.0f, 0.0f, 0.0f, 0.0f,
+                                    0.0f, 1.0f, 0.0f, 0.0f,
+                                    0.0f, 0.0f, 1.0f, 0.0f};
+
+    // Bounding sphere in object space, center and radius
+    std::array<float, 4> bounds{0.0f, 0.0f, 0.0f, 0.0f};
+
+    // An object with an INVALID_INDEX mesh is skipped
+    uint32_t mesh{UINT32_MAX};
+    uint32_t batch{0};
+    uint32_t material{0};
+    uint32_t padding{0};
+};
+
+struct GpuSceneLimits
+{
+    uint32_t max_objects{131072};
+    uint32_t max_meshes{4096};
+    uint32_t max_batches{256};
+
+    // Object and mesh writes copied per frame, the rest waits for the next frame
+    uint32_t max_updates_per_frame{32768};
+};
+
+// Objects live in GPU buffers and are culled there. A compute pass tests every object
+// against the view frustum, picks a mesh LOD by distance and appends a
+// VkDrawIndexedIndirectCommand to its batch, then draw() issues one
+// vkCmdDrawIndexedIndirectCount per batch. A batch is one pipeline, so CPU cost no
+// longer grows with the object count.
+//
+// All meshes share one index buffer and optionally one vertex buffer, set_geometry().
+// Draw shaders find their object through gl_InstanceIndex and the object buffer's
+// bindless index, pushed at offset 0, see scene.glsl. Needs the bindless heap and
+// drawIndirectCount, init() fails without them.
+class GpuScene
+{
+public:
+    static constexpr uint32_t INVALID_INDEX{UINT32_MAX};
+    static constexpr uint32_t CULL_GROUP_SIZE{64};
+
+    bool init(Device &device,
+              BindlessHeap &bindless,
+              ShaderManager &shaders,
+              uint32_t frame_count,
+              const GpuSceneLimits &limits = {}) noexcept;
+    void cleanup() noexcept;
+
+    // INVALID_INDEX once the limit is reached
+    uint32_t add_mesh(const GpuMesh &mesh) noexcept;
+    uint32_t add_batch(const GraphicsPipeline &pipeline) noexcept;
+    uint32_t add_object(const GpuObject &object) noexcept;
+
+    void update_mesh(uint32_t index, const GpuMesh &mesh) noexcept;
+    void update_object(uint32_t index, const GpuObject &object) noexcept;
+
+    // For pipelines rebuilt after a shader reload
+    void update_batch(uint32_t index, const GraphicsPipeline &pipeline) noexcept;
+
+    void set_geometry(VkBuffer index_buffer, VkIndexType index_type, VkBuffer vertex_buffer = VK_NULL_HANDLE) noexcept;
+
+    // view_projection is column-major with Vulkan's 0 to 1 depth range
+    void set_view(const std::array<float, 16> &view_projection,
+                  const std::array<float, 3> &camera_position,
+                  float lod_scale = 1.0f) noexcept;
+
+    // Adds the update and cull passes, declare the draws' reads with read_draws()
+    void add_passes(RenderGraph &graph, uint32_t frame_index) noexcept;
+    void read_draws(RenderGraphPass &pass) const noexcept;
+
+    // Update, cull and the barriers between them, for command buffers without a graph
+    void record_cull(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept;
+
+    // Inside the rendering scope, with the bindless heap bound
+    void draw(VkCommandBuffer command_buffer, const PipelineBuilder &pipelines) const noexcept;
+
+    uint32_t object_count() const noexcept;
+    uint32_t object_buffer_index() const noexcept;
+
+private:
+    // Matches scene.glsl, one per batch
+    struct GpuBatch
+    {
+        uint32_t first_command;
+        uint32_t capacity;
+    };
+
+    struct GpuView
+    {
+        std::array<float, 24> planes;
+
+        // xyz camera position, w lod scale
+        std::array<float, 4> camera;
+    };
+
+    struct SceneBuffer
+    {
+        VkBuffer buffer{VK_NULL_HANDLE};
+        Allocation allocation;
+        VkDeviceSize size{0};
+        uint32_t bindless_index{BindlessHeap::INVALID_INDEX};
+        RenderGraphBuffer graph{INVALID_GRAPH_RESOURCE};
+    };
+
+    struct Batch
+    {
+        GraphicsPipeline pipeline;
+        uint32_t object_count{0};
+
+        // As last uploaded, what this frame's cull and draws use
+        uint32_t first_command{0};
+        uint32_t capacity{0};
+    };
+
+    struct RetiredPipeline
+    {
+        VkPipeline pipeline;
+        SyncPoint in_use;
+    };
+
+    Device *m_device{nullptr};
+    BindlessHeap *m_bindless{nullptr};
+    ShaderManager *m_shaders{nullptr};
+    GpuSceneLimits m_limits;
+
+    SceneBuffer m_objects;
+    SceneBuffer m_meshes;
+    SceneBuffer m_batches_buffer;
+    SceneBuffer m_view_buffer;
+    SceneBuffer m_commands;
+    SceneBuffer m_counts;
+
+    // Host visible, one max_updates_per_frame slice per frame in flight
+    SceneBuffer m_staging;
+    VkDeviceSize m_staging_slice{0};
+
+    ShaderHandle m_cull_shader{ShaderManager::INVALID_HANDLE};
+    ShaderReloadCallbackId m_cull_reload{ShaderManager::INVALID_CALLBACK};
+    VkPipeline m_cull_pipeline{VK_NULL_HANDLE};
+    std::vector<RetiredPipeline> m_retired;
+
+    std::vector<GpuObject> m_object_data;
+    std::vector<GpuMesh> m_mesh_data;
+    std::vector<Batch> m_batches;
+
+    std::vector<uint32_t> m_dirty_objects;
+    std::vector<uint32_t> m_dirty_meshes;
+    std::vector<bool> m_object_dirty;
+    std::vector<bool> m_mesh_dirty;
+    bool m_batches_dirty{false};
+
+    // Objects and meshes below these were uploaded at least once, the cull skips the rest
+    uint32_t m_resident_objects{0};
+    uint32_t m_resident_meshes{0};
+    uint32_t m_uploaded_batches{0};
+
+    GpuView m_view{};
+
+    VkBuffer m_index_buffer{VK_NULL_HANDLE};
+    VkIndexType m_index_type{VK_INDEX_TYPE_UINT32};
+    VkBuffer m_vertex_buffer{VK_NULL_HANDLE};
+
+    bool create_buffer(SceneBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) noexcept;
+    void destroy_buffer(SceneBuffer &buffer) noexcept;
+    bool create_cull_pipeline(VkShaderModule module) noexcept;
+    void collect_retired() noexcept;
+
+    void record_update(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept;
+    void record_dispatch(VkCommandBuffer command_buffer) const noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 namespace niqqa
 {
 namespace graphics
@@ -11,5 +13,12 @@ struct Image
     VkImage image{VK_NULL_HANDLE};
     VkImageView image_view{VK_NULL_HANDLE};
 };
+
+VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags) noexcept;
+
+VkFormat find_supported_format(VkPhysicalDevice gpu, const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags feature_flag) noexcept;
+VkFormat find_depth_format(VkPhysicalDevice gpu) noexcept;
+VkImageAspectFlags depth_aspect_flags(VkFormat depth_format) noexcept;
+bool is_depth_format(VkFormat format) noexcept;
 } // namespace graphics
 } // namespace niqqa
\ No newline at end of file
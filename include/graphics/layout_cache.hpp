@@ -0,0 +1,53 @@
+#pragma once
+
+#include <graphics/shader_reflection.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+// Creates descriptor set layouts and pipeline layouts from shader reflection and hands
+// out the same handle for the same description, so pipelines that agree on their sets
+// share layouts instead of each creating their own.
+//
+// Every binding is visible to all stages and every pipeline layout carries the same
+// push constant range as the bindless heap. Layouts that only differ in which stage
+// reads what are then identical, and sets stay bound across pipeline switches.
+class LayoutCache
+{
+public:
+    static constexpr uint32_t PUSH_CONSTANT_SIZE{128};
+
+    bool init(VkDevice device) noexcept;
+    void cleanup() noexcept;
+
+    // Bindings of a single set, runtime arrays can not be created from reflection alone
+    VkDescriptorSetLayout set_layout(const std::vector<ReflectedBinding> &bindings) noexcept;
+
+    // A non null entry in set_overrides is used for that set instead of the reflected one,
+    // which is how the bindless heap's set or a set with runtime arrays gets in
+    VkPipelineLayout pipeline_layout(const ShaderReflection &reflection,
+                                     const std::vector<VkDescriptorSetLayout> &set_overrides = {}) noexcept;
+    VkPipelineLayout pipeline_layout(const std::vector<VkDescriptorSetLayout> &set_layouts) noexcept;
+
+    size_t set_layout_count() const noexcept;
+    size_t pipeline_layout_count() const noexcept;
+
+private:
+    VkDevice m_device{VK_NULL_HANDLE};
+
+    // Keyed by the raw bytes of the description, equal keys are equal layouts
+    std::unordered_map<std::string, VkDescriptorSetLayout> m_set_layouts;
+    std::unordered_map<std::string, VkPipelineLayout> m_pipeline_layouts;
+
+    mutable std::mutex m_mutex;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+// One vkAllocateMemory'd block, carved up with a buddy scheme. Free lists are
+// indexed by order, order 0 being the allocator's minimum allocation size.
+struct MemoryBlock
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    VkDeviceSize used{0};
+    uint32_t memory_type{UINT32_MAX};
+    uint32_t allocation_count{0};
+    void *mapped{nullptr};
+
+    std::vector<std::set<VkDeviceSize>> free_lists;
+};
+
+struct Allocation
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    void *mapped{nullptr};
+
+    uint32_t memory_type{UINT32_MAX};
+    uint32_t order{0};
+
+    // Null for dedicated allocations
+    MemoryBlock *block{nullptr};
+
+    bool is_valid() const noexcept;
+};
+
+struct HeapStats
+{
+    VkDeviceSize heap_size{0};
+    VkMemoryHeapFlags flags{0};
+
+    uint32_t block_count{0};
+    VkDeviceSize block_bytes{0};
+    VkDeviceSize used_bytes{0};
+    uint32_t allocation_count{0};
+
+    uint32_t dedicated_count{0};
+    VkDeviceSize dedicated_bytes{0};
+};
+
+class MemoryAllocator
+{
+public:
+    bool init(VkPhysicalDevice gpu, VkDevice device, const VkPhysicalDeviceProperties &properties) noexcept;
+    void cleanup() noexcept;
+
+    bool allocate(const VkMemoryRequirements &requirements,
+                  VkMemoryPropertyFlags property_flags,
+                  bool dedicated,
+                  Allocation &allocation) noexcept;
+
+    bool allocate_image(VkImage image, VkMemoryPropertyFlags property_flags, Allocation &allocation, bool dedicated = false) noexcept;
+    bool allocate_buffer(VkBuffer buffer, VkMemoryPropertyFlags property_flags, Allocation &allocation, bool dedicated = false) noexcept;
+
+    void free(Allocation &allocation) noexcept;
+
+    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const noexcept;
+
+    const VkPhysicalDeviceMemoryProperties &memory_properties() const noexcept;
+    std::vector<HeapStats> heap_stats() const noexcept;
+    void log_stats() const noexcept;
+
+private:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE{64ull * 1024 * 1024};
+    static constexpr VkDeviceSize MIN_BLOCK_SIZE{4ull * 1024 * 1024};
+    static constexpr VkDeviceSize MIN_ALLOCATION_SIZE{256};
+
+    VkDevice m_device{VK_NULL_HANDLE};
+    VkPhysicalDeviceMemoryProperties m_memory_properties{};
+
+    VkDeviceSize m_min_allocation{MIN_ALLOCATION_SIZE};
+    uint32_t m_max_allocation_count{0};
+    uint32_t m_device_allocation_count{0};
+
+    std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> m_block_sizes{};
+    std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES> m_blocks;
+    std::array<HeapStats, VK_MAX_MEMORY_HEAPS> m_heap_stats{};
+
+    mutable std::mutex m_mutex;
+
+    bool allocate_device_memory(VkDeviceSize size,
+                                uint32_t memory_type,
+                                const void *p_next,
+                                VkDeviceMemory &memory,
+                                void *&mapped) noexcept;
+    void free_device_memory(VkDeviceMemory memory) noexcept;
+
+    bool allocate_dedicated(VkDeviceSize size,
+                            uint32_t memory_type,
+                            const VkMemoryDedicatedAllocateInfo *dedicated_info,
+                            Allocation &allocation) noexcept;
+    bool allocate_from_blocks(const VkMemoryRequirements &requirements, uint32_t memory_type, Allocation &allocation) noexcept;
+
+    MemoryBlock *create_block(uint32_t memory_type) noexcept;
+    void destroy_block(uint32_t memory_type, MemoryBlock *block) noexcept;
+
+    uint32_t order_for_size(VkDeviceSize size) const noexcept;
+    bool block_allocate(MemoryBlock &block, uint32_t order, VkDeviceSize &offset) noexcept;
+    void block_free(MemoryBlock &block, uint32_t order, VkDeviceSize offset) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <assets/mesh_file.hpp>
+#include <graphics/device.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/upload_queue.hpp>
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+// A cooked mesh in one device local buffer. The file's data region is copied into it byte
+// for byte, so loading is a map and a copy through the staging ring, no decoding. Vertex
+// shaders decode positions with quantize_min and quantize_scale, usually folded into the
+// object transform, and normals with an octahedral decode.
+class MeshBuffer
+{
+public:
+    static constexpr VkFormat POSITION_FORMAT{VK_FORMAT_R16G16B16A16_UNORM};
+    static constexpr VkFormat NORMAL_FORMAT{VK_FORMAT_R16G16_SNORM};
+    static constexpr VkFormat UV_FORMAT{VK_FORMAT_R16G16_SFLOAT};
+
+    // Binding 0 is positions at location 0, binding 1 normals at 1 and uvs at 2
+    static void vertex_input(std::vector<VkVertexInputBindingDescription> &bindings,
+                             std::vector<VkVertexInputAttributeDescription> &attributes) noexcept;
+
+    // The copies are only recorded, they land with the upload queue's next flush(). The
+    // data is in the staging ring by the time this returns, the file can be closed.
+    bool init(Device &device, UploadQueue &uploads, const assets::MeshFile &file) noexcept;
+    void cleanup() noexcept;
+
+    // Inside the rendering scope, before drawing any lod
+    void bind(VkCommandBuffer command_buffer) const noexcept;
+    void draw(VkCommandBuffer command_buffer, uint32_t lod, uint32_t instance_count = 1, uint32_t first_instance = 0) const noexcept;
+
+    // The finest lod whose max distance is at least distance, the coarsest past all of them
+    uint32_t select_lod(float distance) const noexcept;
+
+    VkBuffer buffer() const noexcept;
+    VkDeviceSize stream_offset(assets::MeshStream stream) const noexcept;
+    VkIndexType index_type() const noexcept;
+
+    uint32_t vertex_count() const noexcept;
+    uint32_t index_count() const noexcept;
+    const std::vector<assets::MeshFileLod> &lods() const noexcept;
+
+    const std::array<float, 3> &quantize_min() const noexcept;
+    const std::array<float, 3> &quantize_scale() const noexcept;
+    const std::array<float, 4> &bounds() const noexcept;
+
+private:
+    // Keeps single copies well below the default staging ring
+    static constexpr VkDeviceSize UPLOAD_CHUNK_SIZE{16ull * 1024 * 1024};
+
+    Device *m_device{nullptr};
+
+    VkBuffer m_buffer{VK_NULL_HANDLE};
+    Allocation m_allocation;
+
+    std::array<VkDeviceSize, static_cast<size_t>(assets::MeshStream::Count)> m_stream_offsets{};
+    VkIndexType m_index_type{VK_INDEX_TYPE_UINT32};
+    uint32_t m_vertex_count{0};
+    uint32_t m_index_count{0};
+    std::vector<assets::MeshFileLod> m_lods;
+
+    std::array<float, 3> m_quantize_min{};
+    std::array<float, 3> m_quantize_scale{};
+    std::array<float, 4> m_bounds{};
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <graphics/device.hpp>
+#include <graphics/image.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+struct OffscreenImage
+{
+    Image color;
+    Allocation color_allocation;
+
+    VkFramebuffer framebuffer{VK_NULL_HANDLE};
+
+    VkBuffer readback_buffer{VK_NULL_HANDLE};
+    Allocation readback_allocation;
+
+    // Submit of the last frame rendered into the image, its readback is written once this completes
+    SyncPoint rendered;
+};
+
+// Stand-in for a swapchain when there is no window: a ring of color targets
+// sharing one depth buffer, optionally copied to host memory after each frame
+class OffscreenTarget
+{
+public:
+    bool init(Device &device,
+              VkExtent2D extent,
+              uint32_t image_count,
+              VkFormat color_format,
+              bool readback) noexcept;
+    bool create_framebuffers(VkRenderPass render_pass) noexcept;
+    void cleanup() noexcept;
+
+    uint32_t acquire_next_image() noexcept;
+    void record_readback(VkCommandBuffer command_buffer, uint32_t image_index) noexcept;
+    void set_rendered(uint32_t image_index, const SyncPoint &sync) noexcept;
+
+    // Waits for the last frame rendered into image_index, the data stays valid until the
+    // image comes round again
+    const void *readback_data(uint32_t image_index) const noexcept;
+
+    VkExtent2D extent() const noexcept;
+    VkFormat color_format() const noexcept;
+    VkFormat depth_format() const noexcept;
+    VkImageLayout color_final_layout() const noexcept;
+    uint32_t image_count() const noexcept;
+    bool readback_enabled() const noexcept;
+
+    VkFramebuffer framebuffer(uint32_t image_index) const noexcept;
+    const Image &color_image(uint32_t image_index) const noexcept;
+    const Image &depth_image() const noexcept;
+
+private:
+    VkDevice m_device{VK_NULL_HANDLE};
+    MemoryAllocator *m_allocator{nullptr};
+
+    VkExtent2D m_extent{};
+    VkFormat m_color_format{VK_FORMAT_UNDEFINED};
+    VkFormat m_depth_format{VK_FORMAT_UNDEFINED};
+    bool m_readback{false};
+
+    uint32_t m_next_image{0};
+    std::vector<OffscreenImage> m_images;
+
+    Image m_depth;
+    Allocation m_depth_allocation;
+
+    bool create_image(VkFormat format, VkImageUsageFlags usage_flags, VkImageAspectFlags aspect_flags, Image &image, Allocation &allocation) noexcept;
+    bool create_readback_buffer(OffscreenImage &image) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <graphics/device.hpp>
+#include <graphics/shader_reflection.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+// State that is set while recording when the device allows it, and baked into the
+// pipeline otherwise. Pipelines that only differ in here are one pipeline on devices
+// with extended dynamic state.
+struct RasterState
+{
+    VkCullModeFlags cull_mode{VK_CULL_MODE_BACK_BIT};
+    VkFrontFace front_face{VK_FRONT_FACE_COUNTER_CLOCKWISE};
+
+    // Only the topology class (points, lines, triangles, patches) stays static
+    VkPrimitiveTopology topology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+    bool primitive_restart{false};
+
+    VkPolygonMode polygon_mode{VK_POLYGON_MODE_FILL};
+    bool depth_clamp{false};
+
+    bool depth_test{true};
+    bool depth_write{true};
+    VkCompareOp depth_compare{VK_COMPARE_OP_LESS_OR_EQUAL};
+
+    // The bias values themselves are always dynamic
+    bool depth_bias{false};
+    float depth_bias_constant{0.0f};
+    float depth_bias_slope{0.0f};
+
+    float line_width{1.0f};
+};
+
+// Everything a graphics pipeline is made of. Setters chain, so a description can
+// be built in one expression.
+struct GraphicsPipelineDesc
+{
+    struct Stage
+    {
+        VkShaderStageFlagBits stage;
+        VkShaderModule module;
+        std::string entry_point;
+    };
+
+    std::vector<Stage> stages;
+
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+
+    VkPipelineLayout layout{VK_NULL_HANDLE};
+
+    // Null for dynamic rendering, the formats below are used then
+    VkRenderPass render_pass{VK_NULL_HANDLE};
+    uint32_t subpass{0};
+
+    std::vector<VkFormat> color_formats;
+    VkFormat depth_format{VK_FORMAT_UNDEFINED};
+    VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+
+    // One per color attachment, blending off when empty
+    std::vector<VkPipelineColorBlendAttachmentState> blend;
+
+    RasterState raster;
+
+    GraphicsPipelineDesc &shader(VkShaderStageFlagBits stage, VkShaderModule module, const std::string &entry_point = "main") noexcept;
+
+    // Packs the reflected vertex inputs into binding 0
+    GraphicsPipelineDesc &vertex_input(const ShaderReflection &reflection) noexcept;
+
+    GraphicsPipelineDesc &pipeline_layout(VkPipelineLayout pipeline_layout) noexcept;
+    GraphicsPipelineDesc &target(VkRenderPass pass, uint32_t subpass_index = 0) noexcept;
+    GraphicsPipelineDesc &target(const std::vector<VkFormat> &color, VkFormat depth) noexcept;
+    GraphicsPipelineDesc &alpha_blend() noexcept;
+    GraphicsPipelineDesc &raster_state(const RasterState &state) noexcept;
+};
+
+// What draws bind: the pipeline plus the raster state it was asked for, which bind()
+// sets dynamically where the pipeline left it out
+struct GraphicsPipeline
+{
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout layout{VK_NULL_HANDLE};
+    RasterState raster;
+};
+
+struct PipelineBuilderStats
+{
+    uint32_t requests{0};
+    uint32_t pipelines{0};
+};
+
+// Builds graphics pipelines from descriptions and keeps them, keyed by the state that
+// is actually static on this device. Everything RasterState holds that the device can
+// set dynamically is left out of the key and set by bind() instead, so variations of
+// cull mode, depth state, polygon mode and so on share a pipeline.
+//
+// Ask for pipelines up front (material creation, not per draw) and keep the
+// GraphicsPipeline, binding one is cheap and takes no lock.
+class PipelineBuilder
+{
+public:
+    bool init(Device &device) noexcept;
+    void cleanup() noexcept;
+
+    // Thread safe, VK_NULL_HANDLE pipeline on failure
+    GraphicsPipeline get(const GraphicsPipelineDesc &desc) noexcept;
+
+    void bind(VkCommandBuffer command_buffer, const GraphicsPipeline &pipeline) const noexcept;
+
+    // Sets only the part of the state that is dynamic on this device
+    void set_raster_state(VkCommandBuffer command_buffer, const RasterState &raster) const noexcept;
+
+    // Drops every pipeline made from module once the GPU is done with it. Call with the old
+    // module from a ShaderManager reload callback, before it is destroyed and its handle
+    // value can be reused by a new module.
+    void evict(VkShaderModule module) noexcept;
+
+    PipelineBuilderStats stats() const noexcept;
+
+private:
+    struct RetiredPipeline
+    {
+        VkPipeline pipeline;
+        SyncPoint in_use;
+    };
+
+    struct CachedPipeline
+    {
+        VkPipeline pipeline{VK_NULL_HANDLE};
+        std::vector<VkShaderModule> modules;
+    };
+
+    Device *m_device{nullptr};
+    DynamicStateSupport m_dynamic;
+
+    PFN_vkCmdSetCullMode m_set_cull_mode{nullptr};
+    PFN_vkCmdSetFrontFace m_set_front_face{nullptr};
+    PFN_vkCmdSetPrimitiveTopology m_set_primitive_topology{nullptr};
+    PFN_vkCmdSetDepthTestEnable m_set_depth_test_enable{nullptr};
+    PFN_vkCmdSetDepthWriteEnable m_set_depth_write_enable{nullptr};
+    PFN_vkCmdSetDepthCompareOp m_set_depth_compare_op{nullptr};
+    PFN_vkCmdSetDepthBiasEnable m_set_depth_bias_enable{nullptr};
+    PFN_vkCmdSetPrimitiveRestartEnable m_set_primitive_restart_enable{nullptr};
+    PFN_vkCmdSetPolygonModeEXT m_set_polygon_mode{nullptr};
+    PFN_vkCmdSetDepthClampEnableEXT m_set_depth_clamp_enable{nullptr};
+
+    std::unordered_map<std::string, CachedPipeline> m_pipelines;
+    std::vector<RetiredPipeline> m_retired;
+    uint32_t m_requests{0};
+
+    mutable std::mutex m_mutex;
+
+    std::string static_key(const GraphicsPipelineDesc &desc) const noexcept;
+    VkPipeline create(const GraphicsPipelineDesc &desc) noexcept;
+    std::vector<VkDynamicState> dynamic_states() const noexcept;
+    void collect_retired() noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
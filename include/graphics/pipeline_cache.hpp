@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+struct PipelineCacheStats
+{
+    uint32_t hits{0};
+    uint32_t misses{0};
+
+    // Pipelines created without creation feedback, so nobody knows
+    uint32_t unknown{0};
+
+    double creation_ms{0.0};
+
+    bool loaded_from_disk{false};
+    size_t loaded_bytes{0};
+};
+
+class PipelineCache
+{
+public:
+    bool init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path) noexcept;
+    void cleanup() noexcept;
+
+    bool save() noexcept;
+
+    VkResult create_graphics_pipeline(const VkGraphicsPipelineCreateInfo &create_info, VkPipeline &pipeline) noexcept;
+    VkResult create_compute_pipeline(const VkComputePipelineCreateInfo &create_info, VkPipeline &pipeline) noexcept;
+
+    VkPipelineCache cache() const noexcept;
+    PipelineCacheStats stats() const noexcept;
+    void log_stats() const noexcept;
+
+private:
+    static constexpr uint32_t FILE_MAGIC{0x4e504343}; // "NPCC"
+    static constexpr uint32_t FILE_VERSION{1};
+
+    // Our own header in front of the driver blob, the blob is only handed to the
+    // driver when every field matches the device we are running on
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+        uint64_t checksum;
+    };
+
+    VkDevice m_device{VK_NULL_HANDLE};
+    VkPipelineCache m_cache{VK_NULL_HANDLE};
+    VkPhysicalDeviceProperties m_properties{};
+    std::string m_path;
+
+    bool m_creation_feedback{false};
+    bool m_loaded_from_disk{false};
+    size_t m_loaded_bytes{0};
+
+    std::atomic<uint32_t> m_hits{0};
+    std::atomic<uint32_t> m_misses{0};
+    std::atomic<uint32_t> m_unknown{0};
+    std::atomic<uint64_t> m_creation_ns{0};
+
+    bool load(std::string &data) noexcept;
+    bool validate(const FileHeader &header, const std::string &data) const noexcept;
+    void record_feedback(const VkPipelineCreationFeedback &feedback, uint64_t elapsed_ns) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
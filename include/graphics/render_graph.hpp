@@ -0,0 +1,321 @@
+#pragma once
+
+#include <graphics/device.hpp>
+#include <graphics/gpu_profiler.hpp>
+#include <graphics/image.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+using RenderGraphImage = uint32_t;
+using RenderGraphBuffer = uint32_t;
+
+static constexpr uint32_t INVALID_GRAPH_RESOURCE{UINT32_MAX};
+
+class RenderGraph;
+
+using RenderGraphCallback = std::function<void(VkCommandBuffer command_buffer, const RenderGraph &graph)>;
+
+// Decides the default stages of shader reads and writes, every pass records into the
+// graphics queue's command buffer
+enum class RenderGraphPassType
+{
+    Graphics,
+    Compute,
+    Transfer
+};
+
+enum class BufferUse
+{
+    Vertex,
+    Index,
+    Indirect,
+    Uniform,
+    Storage,
+    TransferSrc,
+    TransferDst
+};
+
+// Images the graph owns for the length of a frame, memory is shared between the ones
+// whose lifetimes do not overlap
+struct TransientImageDesc
+{
+    VkFormat format{VK_FORMAT_UNDEFINED};
+    VkExtent2D extent{0, 0};
+    VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+};
+
+// State an imported resource is in when the graph starts and has to be left in. A final
+// layout of UNDEFINED leaves the image in whatever layout its last use needed.
+struct ImportedState
+{
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags2 stages{VK_PIPELINE_STAGE_2_NONE};
+    VkAccessFlags2 access{VK_ACCESS_2_NONE};
+
+    // Only read as a final state, contents nobody needs after the graph skip their stores
+    bool preserve{true};
+};
+
+// One pass's declaration, the graph turns what it reads and writes into barriers
+class RenderGraphPass
+{
+public:
+    // Loading keeps what earlier passes wrote, which also counts as reading it
+    RenderGraphPass &color(RenderGraphImage image,
+                           VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                           VkClearColorValue clear = {{0.0f, 0.0f, 0.0f, 1.0f}}) noexcept;
+    RenderGraphPass &depth(RenderGraphImage image,
+                           VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                           float clear = 1.0f) noexcept;
+
+    // Depth testing against an earlier pass's depth without writing it
+    RenderGraphPass &depth_read(RenderGraphImage image) noexcept;
+
+    // Stages 0 picks the pass type's default, fragment shader for graphics passes
+    RenderGraphPass &sample(RenderGraphImage image, VkPipelineStageFlags2 stages = 0) noexcept;
+    RenderGraphPass &storage(RenderGraphImage image, bool write = true, VkPipelineStageFlags2 stages = 0) noexcept;
+    RenderGraphPass &copy_from(RenderGraphImage image) noexcept;
+    RenderGraphPass &copy_to(RenderGraphImage image) noexcept;
+
+    RenderGraphPass &read(RenderGraphBuffer buffer, BufferUse use, VkPipelineStageFlags2 stages = 0) noexcept;
+    RenderGraphPass &write(RenderGraphBuffer buffer, BufferUse use, VkPipelineStageFlags2 stages = 0) noexcept;
+
+    // Kept even when nothing reads what it writes, e.g. it writes to the host
+    RenderGraphPass &side_effect() noexcept;
+
+    // The callback only executes secondary command buffers inside the rendering scope
+    RenderGraphPass &secondary_contents() noexcept;
+
+    RenderGraphPass &execute(RenderGraphCallback callback) noexcept;
+
+private:
+    friend class RenderGraph;
+
+    struct ImageAccess
+    {
+        RenderGraphImage image;
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        VkImageUsageFlags usage;
+        bool read;
+        bool write;
+    };
+
+    struct BufferAccess
+    {
+        RenderGraphBuffer buffer;
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        bool read;
+        bool write;
+    };
+
+    struct Attachment
+    {
+        RenderGraphImage image{INVALID_GRAPH_RESOURCE};
+        VkAttachmentLoadOp load_op{VK_ATTACHMENT_LOAD_OP_DONT_CARE};
+        VkAttachmentStoreOp store_op{VK_ATTACHMENT_STORE_OP_STORE};
+        VkClearValue clear{};
+        bool read_only{false};
+    };
+
+    RenderGraph *m_graph{nullptr};
+    std::string m_name;
+    RenderGraphPassType m_type{RenderGraphPassType::Graphics};
+
+    std::vector<ImageAccess> m_images;
+    std::vector<BufferAccess> m_buffers;
+    std::vector<Attachment> m_colors;
+    Attachment m_depth;
+
+    bool m_side_effect{false};
+    bool m_secondary_contents{false};
+    RenderGraphCallback m_callback;
+
+    // Filled by compile
+    bool m_culled{false};
+    std::vector<VkImageMemoryBarrier2> m_image_barriers;
+    std::vector<VkBufferMemoryBarrier2> m_buffer_barriers;
+
+    void add_image(RenderGraphImage image, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, VkImageUsageFlags usage, bool read, bool write) noexcept;
+    void add_buffer(RenderGraphBuffer buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access, bool read, bool write) noexcept;
+    VkPipelineStageFlags2 shader_stages(VkPipelineStageFlags2 stages) const noexcept;
+};
+
+// Passes are declared every frame in execution order together with the resources they
+// touch. compile() drops passes whose results nobody uses, places transient images in
+// shared memory by lifetime and works out one batched barrier per pass; execute()
+// records it all. Rendering scopes are begun and ended by the graph, so passes with
+// attachments need dynamic rendering.
+//
+// Transient images stay alive between frames as long as the set of them and their
+// lifetimes do not change, so a graph that is the same every frame allocates nothing.
+class RenderGraph
+{
+public:
+
+    bool init(Device &device) noexcept;
+    void cleanup() noexcept;
+
+    // Forgets the last frame's passes and resources, transient memory is kept
+    void reset() noexcept;
+
+    RenderGraphImage import_image(const std::string &name,
+                                  const Image &image,
+                                  VkFormat format,
+                                  VkExtent2D extent,
+                                  const ImportedState &initial,
+                                  const ImportedState &final = {}) noexcept;
+    RenderGraphImage create_image(const std::string &name, const TransientImageDesc &desc) noexcept;
+
+    RenderGraphBuffer import_buffer(const std::string &name,
+                                    VkBuffer buffer,
+                                    VkDeviceSize offset = 0,
+                                    VkDeviceSize size = VK_WHOLE_SIZE,
+                                    const ImportedState &initial = {},
+                                    const ImportedState &final = {}) noexcept;
+
+    // The reference stays valid until the next add_pass
+    RenderGraphPass &add_pass(const std::string &name, RenderGraphPassType type = RenderGraphPassType::Graphics) noexcept;
+
+    bool compile() noexcept;
+
+    // Pass names go to queries when given, one GPU timing per pass
+    void execute(VkCommandBuffer command_buffer, FrameQueries *queries = nullptr) noexcept;
+
+    // Valid inside pass callbacks, transient images only exist once compiled
+    const Image &image(RenderGraphImage handle) const noexcept;
+    VkExtent2D extent(RenderGraphImage handle) const noexcept;
+    VkFormat format(RenderGraphImage handle) const noexcept;
+    VkBuffer buffer(RenderGraphBuffer handle) const noexcept;
+
+    uint32_t culled_pass_count() const noexcept;
+
+    // Memory all transient images take together, and what they would take without aliasing
+    VkDeviceSize transient_bytes() const noexcept;
+    VkDeviceSize unaliased_bytes() const noexcept;
+
+private:
+    friend class RenderGraphPass;
+
+    // Where a resource is after its latest use while barriers are worked out
+    struct ResourceState
+    {
+        VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkPipelineStageFlags2 write_stages{VK_PIPELINE_STAGE_2_NONE};
+        VkAccessFlags2 write_access{VK_ACCESS_2_NONE};
+        VkPipelineStageFlags2 read_stages{VK_PIPELINE_STAGE_2_NONE};
+        VkPipelineStageFlags2 visible_stages{VK_PIPELINE_STAGE_2_NONE};
+        VkAccessFlags2 visible_access{VK_ACCESS_2_NONE};
+    };
+
+    struct ImageResource
+    {
+        std::string name;
+        Image image;
+        VkFormat format{VK_FORMAT_UNDEFINED};
+        VkExtent2D extent{0, 0};
+        VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+
+        bool imported{false};
+        ImportedState initial;
+        ImportedState final;
+
+        TransientImageDesc desc;
+        VkImageUsageFlags usage{0};
+
+        // First and last pass using it, in declaration order
+        uint32_t first_use{UINT32_MAX};
+        uint32_t last_use{0};
+
+        // Index into m_physical for transient images
+        uint32_t physical{UINT32_MAX};
+
+        uint32_t readers{0};
+        std::vector<uint32_t> writers;
+    };
+
+    struct BufferResource
+    {
+        std::string name;
+        VkBuffer buffer{VK_NULL_HANDLE};
+        VkDeviceSize offset{0};
+        VkDeviceSize size{VK_WHOLE_SIZE};
+
+        ImportedState initial;
+        ImportedState final;
+
+        uint32_t readers{0};
+        std::vector<uint32_t> writers;
+    };
+
+    // A transient image's VkImage and where it sits in its heap
+    struct PhysicalImage
+    {
+        Image image;
+        VkMemoryRequirements requirements{};
+        uint32_t heap{UINT32_MAX};
+        VkDeviceSize offset{0};
+
+        // Only for images that have to have their own allocation
+        Allocation allocation;
+    };
+
+    struct Heap
+    {
+        uint32_t memory_type_bits{0};
+        VkDeviceSize alignment{1};
+        VkDeviceSize size{0};
+        Allocation allocation;
+    };
+
+    struct RetiredTransients
+    {
+        std::vector<PhysicalImage> images;
+        std::vector<Heap> heaps;
+        SyncPoint in_use;
+    };
+
+    Device *m_device{nullptr};
+
+    std::vector<RenderGraphPass> m_passes;
+    std::vector<ImageResource> m_images;
+    std::vector<BufferResource> m_buffers;
+
+    std::vector<PhysicalImage> m_physical;
+    std::vector<Heap> m_heaps;
+    std::string m_transient_signature;
+    std::vector<RetiredTransients> m_retired;
+
+    std::vector<VkImageMemoryBarrier2> m_final_image_barriers;
+    std::vector<VkBufferMemoryBarrier2> m_final_buffer_barriers;
+
+    uint32_t m_culled_passes{0};
+    VkDeviceSize m_unaliased_bytes{0};
+
+    void cull_passes() noexcept;
+    void compute_lifetimes() noexcept;
+    bool allocate_transients() noexcept;
+    void place_in_heaps() noexcept;
+    void build_barriers() noexcept;
+    void choose_store_ops() noexcept;
+
+    void destroy_transients(std::vector<PhysicalImage> &images, std::vector<Heap> &heaps) noexcept;
+    void collect_retired() noexcept;
+
+    bool images_alias(const ImageResource &a, const ImageResource &b) const noexcept;
+    void begin_rendering(VkCommandBuffer command_buffer, const RenderGraphPass &pass) const noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -9,7 +9,10 @@ namespace graphics
 class RenderPass 
 {
 public:
-    bool init(VkDevice device, VkFormat color_format, VkFormat depth_format) noexcept;
+    bool init(VkDevice device,
+              VkFormat color_format,
+              VkFormat depth_format,
+              VkImageLayout color_final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) noexcept;
     void cleanup(VkDevice device) noexcept;
 
     VkRenderPass render_pass() const noexcept;
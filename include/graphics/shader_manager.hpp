@@ -0,0 +1,142 @@
+#pragma once
+
+#include <graphics/device.hpp>
+#include <graphics/shader_reflection.hpp>
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+using ShaderHandle = uint32_t;
+using ShaderReloadCallbackId = uint32_t;
+
+struct ShaderDesc
+{
+    // Relative to the shader root. A .spv path is loaded as is, anything else is GLSL.
+    std::string path;
+    VkShaderStageFlagBits stage{VK_SHADER_STAGE_VERTEX_BIT};
+    std::vector<std::pair<std::string, std::string>> defines;
+    std::string entry_point{"main"};
+};
+
+// Called from ShaderManager::update() on the thread that calls it, with the new module and
+// the one it replaces. Rebuild whatever pipelines use the shader and drop anything keyed on
+// the old module, it is destroyed right after and its handle value may come back.
+using ShaderReloadCallback = std::function<void(ShaderHandle handle, VkShaderModule module, VkShaderModule old_module)>;
+
+// Compiles GLSL to SPIR-V at runtime with shaderc and caches the result on disk, keyed
+// by a hash of the source, everything it includes, the defines and the stage. An
+// unchanged shader is never compiled twice, also not across runs.
+//
+// With watching on, a background thread follows the shader root with inotify and
+// recompiles whatever a changed file affects. The results are only turned into modules
+// by update(), so a reload happens between frames. Without shaderc only .spv shaders
+// and cache hits can be loaded.
+class ShaderManager
+{
+public:
+    static constexpr ShaderHandle INVALID_HANDLE{UINT32_MAX};
+    static constexpr ShaderReloadCallbackId INVALID_CALLBACK{0};
+
+    bool init(Device &device,
+              const std::string &root = "shaders",
+              const std::string &cache_dir = ".shader_cache",
+              bool watch = true) noexcept;
+    void cleanup() noexcept;
+
+    // Compiles or loads from the cache right away, the first load never waits on the watcher
+    ShaderHandle load(const ShaderDesc &desc) noexcept;
+
+    VkShaderModule module(ShaderHandle handle) const noexcept;
+
+    // Valid until cleanup(), later loads do not move them
+    const ShaderDesc &desc(ShaderHandle handle) const noexcept;
+
+    // Up to date with module(), also after a reload
+    const ShaderReflection &reflection(ShaderHandle handle) const noexcept;
+
+    // Whoever registers a callback removes it again before going away, with the returned id
+    ShaderReloadCallbackId on_reload(ShaderHandle handle, ShaderReloadCallback callback) noexcept;
+    void remove_reload_callback(ShaderHandle handle, ShaderReloadCallbackId id) noexcept;
+
+    // Queues a recompile as if the source had changed
+    void reload(ShaderHandle handle) noexcept;
+
+    // Swaps in finished recompiles, call once per frame
+    void update() noexcept;
+
+    bool can_compile() const noexcept;
+
+private:
+    static constexpr uint32_t CACHE_VERSION{1};
+    static constexpr int WATCH_POLL_MS{100};
+
+    struct ShaderEntry
+    {
+        ShaderDesc desc;
+        VkShaderModule module{VK_NULL_HANDLE};
+        uint64_t hash{0};
+        ShaderReflection reflection;
+
+        // The source and every file it includes, what the watcher matches changes against
+        std::vector<std::string> dependencies;
+        std::vector<std::pair<ShaderReloadCallbackId, ShaderReloadCallback>> callbacks;
+    };
+
+    struct CompiledShader
+    {
+        ShaderHandle handle{INVALID_HANDLE};
+        uint64_t hash{0};
+        std::vector<uint32_t> spirv;
+        ShaderReflection reflection;
+        std::vector<std::string> dependencies;
+    };
+
+    VkDevice m_device{VK_NULL_HANDLE};
+    std::string m_root;
+    std::string m_cache_dir;
+
+    // shaderc_compiler_t, opaque here so users of the header do not need shaderc
+    void *m_compiler{nullptr};
+
+    // A deque so load() never moves entries, desc() and reflection() hand out references into them
+    std::deque<ShaderEntry> m_shaders;
+    std::vector<CompiledShader> m_completed;
+    std::vector<ShaderHandle> m_requests;
+    ShaderReloadCallbackId m_next_callback{INVALID_CALLBACK + 1};
+    mutable std::mutex m_mutex;
+
+    std::thread m_watcher;
+    std::atomic<bool> m_running{false};
+    int m_inotify{-1};
+    std::unordered_map<int, std::string> m_watch_dirs;
+
+    bool compile(const ShaderDesc &desc, CompiledShader &compiled) noexcept;
+    bool compile_spirv(const ShaderDesc &desc, CompiledShader &compiled) noexcept;
+    bool compile_glsl(const ShaderDesc &desc, const std::string &source, std::vector<uint32_t> &spirv) noexcept;
+    bool load_cached(uint64_t hash, std::vector<uint32_t> &spirv) const noexcept;
+    void store_cached(uint64_t hash, const std::vector<uint32_t> &spirv) const noexcept;
+    VkShaderModule create_module(const std::vector<uint32_t> &spirv) const noexcept;
+
+    std::string resolve_include(const std::string &name, const std::string &includer) const noexcept;
+    void collect_dependencies(const std::string &path, std::vector<std::string> &dependencies, std::string &contents) const noexcept;
+
+    bool start_watching() noexcept;
+    void watch_directory(const std::string &path) noexcept;
+    void watch_loop() noexcept;
+    void file_changed(const std::string &path) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
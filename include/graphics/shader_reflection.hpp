@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+struct ReflectedBinding
+{
+    uint32_t set{0};
+    uint32_t binding{0};
+    VkDescriptorType type{VK_DESCRIPTOR_TYPE_MAX_ENUM};
+
+    // 0 for a runtime array, the layout then has to come from somewhere that knows its size
+    uint32_t count{1};
+    VkShaderStageFlags stages{0};
+};
+
+struct ReflectedVertexInput
+{
+    uint32_t location{0};
+    VkFormat format{VK_FORMAT_UNDEFINED};
+};
+
+// What a pipeline layout and vertex input state need to know about a set of shaders.
+// Read straight from the SPIR-V, no compiler or SPIRV-Cross involved.
+struct ShaderReflection
+{
+    VkShaderStageFlags stages{0};
+
+    // Sorted by set, then binding
+    std::vector<ReflectedBinding> bindings;
+
+    // Size 0 when no stage uses push constants
+    VkPushConstantRange push_constants{0, 0, 0};
+
+    // Vertex stage only, sorted by location
+    std::vector<ReflectedVertexInput> vertex_inputs;
+
+    // Compute stage only
+    uint32_t local_size[3]{1, 1, 1};
+
+    // Combines another stage into this one, fails when both use a binding differently
+    bool merge(const ShaderReflection &other) noexcept;
+
+    uint32_t set_count() const noexcept;
+
+    // Attributes packed one after another in location order into a single binding, returns the stride
+    uint32_t packed_vertex_attributes(uint32_t binding, std::vector<VkVertexInputAttributeDescription> &attributes) const noexcept;
+};
+
+bool reflect_spirv(const uint32_t *code,
+                   size_t word_count,
+                   ShaderReflection &reflection,
+                   const std::string &entry_point = "main") noexcept;
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
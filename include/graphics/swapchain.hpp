@@ -2,6 +2,7 @@
 
 #include <graphics/image.hpp>
 #include <graphics/device.hpp>
+#include <graphics/memory_allocator.hpp>
 
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -19,56 +20,100 @@ struct SwapchainSupportDetails
 
 SwapchainSupportDetails query_swapchain_support(VkPhysicalDevice device, VkSurfaceKHR surface) noexcept;
 
+// Everything that belonged to a replaced swapchain, kept until the frames that used it are done
+struct RetiredSwapchain
+{
+    VkSwapchainKHR swapchain{VK_NULL_HANDLE};
+    std::vector<Image> present_images;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> present_semaphores;
+
+    // Only set when the extent changed
+    VkImage depth_image{VK_NULL_HANDLE};
+    VkImageView depth_image_view{VK_NULL_HANDLE};
+    Allocation depth_allocation;
+
+    // Frames numbered below this may still reference it
+    uint64_t frame_number{0};
+};
+
 class Swapchain
 {
 public:
+    // Framebuffers are only created for a render pass, the dynamic rendering path passes VK_NULL_HANDLE
     bool create(Device &device,
                 VkSurfaceKHR surface, 
                 VkExtent2D actual_extent,
                 VkFormat user_defined_format,
                 VkPresentModeKHR user_defined_present_mode,
-                VkRenderPass render_pass) noexcept;
+                VkRenderPass render_pass = VK_NULL_HANDLE) noexcept;
+    bool create_framebuffers(VkRenderPass render_pass) noexcept;
+
+    // Never waits for the device: the old swapchain is handed to the new one and destroyed
+    // by collect_retired once completed_frames reaches frame_number
+    bool recreate(VkExtent2D actual_extent, uint64_t frame_number) noexcept;
+    void collect_retired(uint64_t completed_frames) noexcept;
     
     void cleanup() noexcept;
 
     VkSwapchainKHR swapchain() const noexcept;
     VkExtent2D extent() const noexcept;
     VkFormat present_format() const noexcept;
+    VkPresentModeKHR present_mode() const noexcept;
     VkFormat depth_format() const noexcept;
 
+    uint32_t image_count() const noexcept;
+    const Image &present_image(uint32_t image_index) const noexcept;
+    Image depth_image() const noexcept;
+    VkFramebuffer framebuffer(uint32_t image_index) const noexcept;
+
+    // Signaled by the frame rendering into image_index and waited on by its present. One per
+    // image, not per frame: an image is only acquired again once its last present is done
+    // with the semaphore, a frame slot can come round while the present still holds it.
+    VkSemaphore present_semaphore(uint32_t image_index) const noexcept;
+
 private:
     VkSwapchainKHR m_swapchain{VK_NULL_HANDLE};
     VkDevice m_device{VK_NULL_HANDLE};
+    VkPhysicalDevice m_gpu{VK_NULL_HANDLE};
+    MemoryAllocator *m_allocator{nullptr};
     VkSurfaceKHR m_surface{VK_NULL_HANDLE};
+    VkRenderPass m_render_pass{VK_NULL_HANDLE};
+    VkFormat m_desired_format{VK_FORMAT_UNDEFINED};
+    VkPresentModeKHR m_desired_present_mode{VK_PRESENT_MODE_FIFO_KHR};
     VkPresentModeKHR m_present_mode;
     VkFormat m_present_format{VK_FORMAT_UNDEFINED};
     VkFormat m_depth_format{VK_FORMAT_UNDEFINED};
     VkExtent2D m_extent;
+    VkImage m_depth_image{VK_NULL_HANDLE};
     VkImageView m_depth_image_view{VK_NULL_HANDLE};
-    VkDeviceMemory m_depth_memory{VK_NULL_HANDLE};
+    Allocation m_depth_allocation;
 
     std::vector<Image> m_present_images;
     std::vector<VkFramebuffer> m_framebuffers;
-
-    VkFormat find_supported_format(VkPhysicalDevice gpu, const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags feature_flag) noexcept;
-    VkFormat find_depth_format(VkPhysicalDevice gpu) noexcept;
+    std::vector<VkSemaphore> m_present_semaphores;
+    std::vector<RetiredSwapchain> m_retired;
 
     VkSurfaceFormatKHR choose_swapchain_surface_format(const std::vector<VkSurfaceFormatKHR> &available_formats, VkFormat desired_format) noexcept;
     VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKHR> &available_modes, VkPresentModeKHR desired_mode) noexcept;
     VkExtent2D choose_swapchain_extent(VkSurfaceCapabilitiesKHR capabilities, VkExtent2D actual_extent) noexcept;
 
+    bool create_swapchain(VkExtent2D actual_extent, VkSwapchainKHR old_swapchain) noexcept;
     bool create_image_views() noexcept;
-    bool create_framebuffers(VkRenderPass render_pass) noexcept;
-    bool create_image(VkPhysicalDevice gpu,
-                      uint32_t width,
+    bool create_present_semaphores() noexcept;
+    void destroy_present_semaphores(std::vector<VkSemaphore> &semaphores) noexcept;
+    void destroy_framebuffers() noexcept;
+    void destroy_retired(RetiredSwapchain &retired) noexcept;
+    bool create_image(uint32_t width,
                       uint32_t height,
                       VkFormat format,
                       VkImageTiling tiling,
                       VkImageUsageFlags usage_flags,
                       VkMemoryPropertyFlags property_flags,
+                      bool dedicated,
                       VkImage &image,
-                      VkDeviceMemory &image_memory) noexcept;
-    bool create_depth_resources(VkPhysicalDevice gpu) noexcept;
+                      Allocation &allocation) noexcept;
+    bool create_depth_resources() noexcept;
 };
 } // namespace graphics
 } // namespace niqqa
\ No newline at end of file
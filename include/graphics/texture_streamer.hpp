@@ -0,0 +1,221 @@
+#pragma once
+
+#include <assets/asset_io.hpp>
+#include <assets/texture_file.hpp>
+#include <graphics/bindless_heap.hpp>
+#include <graphics/device.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/upload_queue.hpp>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+using TextureHandle = uint32_t;
+
+struct TextureStreamerConfig
+{
+    // Mips no larger than this on either side load with the texture and are never evicted
+    uint32_t tail_size{128};
+
+    // Share of the device local budget left over by everything else that textures may fill
+    float budget_fraction{0.9f};
+
+    // Without VK_EXT_memory_budget, share of the device local heaps instead
+    float heap_fraction{0.5f};
+
+    // A cap on top of the budget, 0 for none
+    VkDeviceSize max_bytes{0};
+
+    // Grows in flight at once, each is one read and one new image
+    uint32_t max_streams{8};
+
+    // Frames without any feedback after which a texture only wants its tail
+    uint32_t idle_frames{240};
+
+    // Added to the wanted mip, above 0 streams coarser
+    float mip_bias{0.0f};
+};
+
+// Keeps only the mips of cooked textures (assets/texture_file.hpp) that are on screen
+// resident, within a share of the VRAM budget. A texture starts as its coarse tail, finer
+// mips are read through AssetIo as screen space feedback asks for them and dropped again,
+// least recently used first, once the budget is exceeded.
+//
+// Images are not sparse, so a texture's image is re-created with each change of its mip
+// range. The mips it keeps are copied over on the GPU, only new ones are read and go
+// through the upload queue. Bindless indices therefore change, look them up every frame.
+class TextureStreamer
+{
+public:
+    static constexpr TextureHandle INVALID_HANDLE{UINT32_MAX};
+
+    // What feedback entries are reset to, not a valid footprint
+    static constexpr uint32_t NO_FEEDBACK{UINT32_MAX};
+
+    bool init(Device &device,
+              BindlessHeap &bindless,
+              UploadQueue &uploads,
+              assets::AssetIo &io,
+              uint32_t frames_in_flight,
+              const TextureStreamerConfig &config = {}) noexcept;
+    void cleanup() noexcept;
+
+    TextureHandle load(const std::string &path) noexcept;
+    void unload(TextureHandle handle) noexcept;
+
+    // Always safe to sample, a grey placeholder until the tail is resident
+    uint32_t bindless_index(TextureHandle handle) const noexcept;
+
+    // Finest resident mip of the file, the mip count while nothing is
+    uint32_t resident_mip(TextureHandle handle) const noexcept;
+
+    // CPU side feedback, e.g. from bounds, the texture spans about this many pixels on screen
+    void request_size(TextureHandle handle, float screen_size) noexcept;
+
+    // Bindless storage buffer this frame's shaders write feedback to, see
+    // shaders/common/texture_streaming.glsl. Changes with every record().
+    uint32_t feedback_index() const noexcept;
+
+    // Starts reads and uploads within the budget, call once a frame after AssetIo::update()
+    // and before the frame is drawn
+    void update() noexcept;
+
+    // Reads feedback and swaps in re-created images. Once a frame, after its slot was waited
+    // for and its uploads consumed, before anything samples the textures.
+    void record(VkCommandBuffer command_buffer) noexcept;
+
+    VkDeviceSize resident_bytes() const noexcept;
+    VkDeviceSize budget() const noexcept;
+
+private:
+    // A grow that failed is not tried again for this many frames
+    static constexpr uint64_t RETRY_FRAMES{60};
+
+    enum class TextureState : uint32_t
+    {
+        Free,
+        LoadingHeader,
+        LoadingTail,
+        Resident,
+        Failed
+    };
+
+    struct TextureImage
+    {
+        VkImage image{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+        Allocation allocation;
+
+        // Mip of the file that is the image's mip 0
+        uint32_t first_mip{0};
+    };
+
+    struct Texture
+    {
+        std::string path;
+        assets::TextureFileHeader header;
+        TextureState state{TextureState::Free};
+
+        TextureImage image;
+        uint32_t bindless_index{BindlessHeap::INVALID_INDEX};
+
+        uint32_t tail_mip{0};
+        uint32_t wanted_mip{0};
+
+        // Finest mip asked for since the last record()
+        uint32_t requested_mip{UINT32_MAX};
+        uint64_t last_used{0};
+        uint64_t retry_frame{0};
+
+        assets::IoRequestId request{assets::AssetIo::INVALID_REQUEST};
+        VkDeviceSize reserved{0};
+        bool pending{false};
+        bool unloading{false};
+    };
+
+    // A re-created image waiting for record() to copy the kept mips and swap it in
+    struct PendingImage
+    {
+        TextureHandle handle{INVALID_HANDLE};
+        TextureImage image;
+
+        // Mips of the file from here on are copied from the current image
+        uint32_t copy_mip{0};
+    };
+
+    struct RetiredImage
+    {
+        TextureImage image;
+        uint64_t frame{0};
+    };
+
+    struct FeedbackBuffer
+    {
+        VkBuffer buffer{VK_NULL_HANDLE};
+        Allocation allocation;
+        uint32_t bindless_index{BindlessHeap::INVALID_INDEX};
+    };
+
+    Device *m_device{nullptr};
+    BindlessHeap *m_bindless{nullptr};
+    UploadQueue *m_uploads{nullptr};
+    assets::AssetIo *m_io{nullptr};
+    TextureStreamerConfig m_config;
+    uint32_t m_frames_in_flight{0};
+
+    std::vector<Texture> m_textures;
+    std::vector<TextureHandle> m_free;
+    std::vector<TextureHandle> m_unloading;
+    std::vector<PendingImage> m_pending;
+    std::vector<RetiredImage> m_retired;
+
+    TextureImage m_placeholder;
+    uint32_t m_placeholder_index{BindlessHeap::INVALID_INDEX};
+
+    // One more than frames in flight, a buffer is read once the frame after the one that
+    // wrote it is done too, that frame's barrier makes the writes visible to the host
+    std::vector<FeedbackBuffer> m_feedback;
+
+    // Latest image of every texture, pending ones instead of those they replace
+    VkDeviceSize m_resident_bytes{0};
+
+    // Growth of the images reads in flight will create
+    VkDeviceSize m_reserved_bytes{0};
+    VkDeviceSize m_budget{0};
+    uint32_t m_streams{0};
+
+    uint64_t m_frame{0};
+
+    bool create_image(const assets::TextureFileHeader &header, uint32_t first_mip, TextureImage &image) noexcept;
+    bool create_placeholder() noexcept;
+    void destroy_image(TextureImage &image) noexcept;
+
+    // Destroyed once the frame that last used it is done
+    void retire(TextureImage &image, uint64_t frame) noexcept;
+
+    void read_mips(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, assets::IoPriority priority) noexcept;
+    void on_header(TextureHandle handle, assets::IoResult &result) noexcept;
+    void on_mips(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, assets::IoResult &result) noexcept;
+
+    // New image with mips [first_mip, last_mip) from data, the coarser ones copied later
+    bool stage(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, const uint8_t *data) noexcept;
+
+    void refresh_budget() noexcept;
+    void evict() noexcept;
+    void stream() noexcept;
+
+    void read_feedback() noexcept;
+    void swap_pending(VkCommandBuffer command_buffer) noexcept;
+    void finish_unloads() noexcept;
+
+    bool is_busy(const Texture &texture) const noexcept;
+    void set_feedback_slot(uint32_t bindless_index) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
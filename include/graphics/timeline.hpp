@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+class Timeline;
+
+// A value on a queue's timeline. Everything submitted to that queue up to and
+// including it is done once the timeline reaches it, which makes this the answer
+// to "is the GPU still using X" for anything recorded into those submits.
+// A default constructed point is always complete.
+struct SyncPoint
+{
+    const Timeline *timeline{nullptr};
+    uint64_t value{0};
+
+    bool is_complete() const noexcept;
+    void wait() const noexcept;
+};
+
+// What a submit waits on and signals besides its own timeline value. Binary
+// semaphores are only still needed for the swapchain.
+struct SubmitBatch
+{
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<uint64_t> wait_values;
+    std::vector<VkPipelineStageFlags> wait_stages;
+
+    std::vector<VkSemaphore> signal_semaphores;
+    std::vector<uint64_t> signal_values;
+
+    // Points that already completed are skipped
+    void wait(const SyncPoint &point, VkPipelineStageFlags stage) noexcept;
+    void wait_binary(VkSemaphore semaphore, VkPipelineStageFlags stage) noexcept;
+    void signal_binary(VkSemaphore semaphore) noexcept;
+};
+
+// One timeline semaphore per queue, every submit to the queue signals the next
+// value. Queues never share a timeline: signals from different queues complete in
+// any order, and a timeline value must only ever increase.
+//
+// Submits are serialized by the timeline so values reach the queue in order, which
+// also makes it safe for several threads to submit to the same queue. Presents on the
+// queue have to go through present() to take the same lock.
+class Timeline
+{
+public:
+    bool init(VkDevice device, VkQueue queue) noexcept;
+    void cleanup() noexcept;
+
+    SyncPoint submit(const VkCommandBuffer *command_buffers, uint32_t command_buffer_count, SubmitBatch batch = {}) noexcept;
+    VkResult present(const VkPresentInfoKHR &present_info) noexcept;
+
+    SyncPoint last_submitted() const noexcept;
+    uint64_t completed_value() const noexcept;
+
+    bool is_complete(uint64_t value) const noexcept;
+    void wait(uint64_t value) const noexcept;
+
+    VkSemaphore semaphore() const noexcept;
+    VkQueue queue() const noexcept;
+
+private:
+    VkDevice m_device{VK_NULL_HANDLE};
+    VkQueue m_queue{VK_NULL_HANDLE};
+    VkSemaphore m_semaphore{VK_NULL_HANDLE};
+
+    std::atomic<uint64_t> m_submitted{0};
+
+    // Last value seen completed, spares most is_complete calls the driver round trip
+    mutable std::atomic<uint64_t> m_completed{0};
+
+    std::mutex m_submit_mutex;
+
+    void advance_completed(uint64_t value) const noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
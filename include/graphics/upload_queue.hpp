@@ -0,0 +1,142 @@
+#pragma once
+
+#include <graphics/command_pool.hpp>
+#include <graphics/device.hpp>
+#include <graphics/memory_allocator.hpp>
+#include <graphics/timeline.hpp>
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace niqqa
+{
+namespace graphics
+{
+struct UploadBatch
+{
+    VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+    SyncPoint sync;
+
+    // Ring head once this batch was submitted, the tail moves here when sync completes
+    uint64_t ring_end{0};
+    bool recording{false};
+};
+
+// Staging space the caller fills itself, e.g. file reads landing straight in it
+struct StagingLease
+{
+    uint8_t *data{nullptr};
+    VkDeviceSize size{0};
+
+    // Monotonic ring position, like the head
+    uint64_t position{0};
+};
+
+// Barriers that either release resources to the graphics family or, when the
+// transfer queue is the graphics family, just finish their layout transitions
+struct UploadBarriers
+{
+    std::vector<VkBufferMemoryBarrier> buffers;
+    std::vector<VkImageMemoryBarrier> images;
+
+    bool empty() const noexcept;
+    void clear() noexcept;
+};
+
+// Streams data to device local resources on the transfer queue. Copies go through a
+// persistently mapped staging ring and are batched until flush(), which submits them
+// and returns the transfer timeline value consume() hands to the graphics submit.
+//
+// Every call may come from any thread. Without a dedicated transfer family the copies
+// are submitted to the graphics queue, whose timeline serializes them with the
+// renderer's submits and presents.
+class UploadQueue
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_STAGING_SIZE{64ull * 1024 * 1024};
+
+    bool init(Device &device, VkDeviceSize staging_size = DEFAULT_STAGING_SIZE) noexcept;
+    void cleanup() noexcept;
+
+    bool upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size) noexcept;
+
+    // One whole mip of layer 0, extent is that mip's. It ends up in final_layout, owned by the
+    // graphics family, the other mips are left alone.
+    bool upload_image(VkImage image,
+                      VkImageAspectFlags aspect,
+                      VkExtent3D extent,
+                      const void *data,
+                      VkDeviceSize size,
+                      VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      uint32_t mip_level = 0) noexcept;
+
+    // Reserves staging space without copying into it. Never waits, false while the ring is
+    // full. Leased space is not reused until the lease is committed or released, and the
+    // ring cannot wrap past it, so a lease should live as long as a read does.
+    bool acquire_staging(VkDeviceSize size, StagingLease &lease) noexcept;
+
+    // Records the copy of a filled lease into buffer, ending the lease
+    void commit_staging(StagingLease &lease, VkBuffer buffer, VkDeviceSize offset) noexcept;
+    void release_staging(StagingLease &lease) noexcept;
+
+    // Submits the copies recorded so far without waiting for them
+    void flush() noexcept;
+    void flush_and_wait() noexcept;
+
+    // Records the graphics side of every submitted upload and returns the point the
+    // graphics submit has to wait on, a completed one when nothing was submitted since
+    SyncPoint consume(VkCommandBuffer command_buffer) noexcept;
+
+    // Retires finished batches, freeing their staging space
+    void collect() noexcept;
+
+private:
+    static constexpr uint32_t BATCH_COUNT{8};
+    static constexpr VkDeviceSize STAGING_ALIGNMENT{16};
+
+    VkDevice m_device{VK_NULL_HANDLE};
+    MemoryAllocator *m_allocator{nullptr};
+
+    Timeline *m_timeline{nullptr};
+    uint32_t m_transfer_family{UINT32_MAX};
+    uint32_t m_graphics_family{UINT32_MAX};
+
+    VkBuffer m_staging_buffer{VK_NULL_HANDLE};
+    Allocation m_staging_allocation;
+    uint8_t *m_staging_data{nullptr};
+    VkDeviceSize m_capacity{0};
+
+    // Monotonic byte positions, the ring offset is position % capacity
+    uint64_t m_head{0};
+    uint64_t m_tail{0};
+
+    CommandPool m_command_pool;
+    std::array<UploadBatch, BATCH_COUNT> m_batches;
+    uint64_t m_submitted{0};
+    uint64_t m_retired{0};
+
+    // Positions of outstanding leases, a submitted batch frees the ring up to the oldest
+    std::set<uint64_t> m_leases;
+
+    UploadBarriers m_batch_barriers;
+    UploadBarriers m_acquire_barriers;
+
+    // Latest submit not yet handed to consume()
+    SyncPoint m_pending;
+
+    std::mutex m_mutex;
+
+    bool ownership_transfer() const noexcept;
+
+    bool reserve(VkDeviceSize size, VkDeviceSize &offset, bool wait = true) noexcept;
+    void record_buffer_copy(VkDeviceSize staging_offset, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) noexcept;
+    VkCommandBuffer begin_batch() noexcept;
+    void submit() noexcept;
+    bool retire(bool wait) noexcept;
+};
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
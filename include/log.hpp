@@ -1,12 +1,190 @@
 #pragma once
 
-#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
-#define LOG_INFO(module, msg) \
-    std::cout << "[INFO][" << module << "]" << msg << "\n"
+// Lowest severity compiled in: 0 info, 1 warn, 2 error, 3 none. Calls below it are still
+// type checked but never run, their arguments are not even evaluated. CMake sets it from
+// NIQQA_LOG_LEVEL.
+#ifndef NIQQA_LOG_LEVEL
+#define NIQQA_LOG_LEVEL 0
+#endif
 
-#define LOG_WARN(module, msg) \
-    std::cout << "[WARN][" << module << "]" << msg << "\n"
+namespace niqqa
+{
+namespace log
+{
+enum class Level : uint8_t
+{
+    Info,
+    Warn,
+    Error
+};
 
-#define LOG_ERROR(module, msg) \
-    std::cerr << "[ERROR][" << module << "]" << msg << "\n"
\ No newline at end of file
+// Waits until everything logged before the call is written out. Errors do this themselves.
+void flush() noexcept;
+
+// Messages lost so far because a thread's ring stayed full while the background thread got
+// nowhere. Errors wait for room instead.
+uint64_t dropped() noexcept;
+
+namespace detail
+{
+enum class ArgType : uint8_t
+{
+    Int,
+    Uint,
+    Double,
+    Bool,
+    String
+};
+
+// Longer strings are cut, a record has to fit in its thread's ring
+inline constexpr uint32_t MAX_STRING_SIZE{8192};
+
+// Space for arguments_size bytes of arguments in the calling thread's ring, after a header
+// with the rest. nullptr when the ring is full and the message is dropped.
+uint8_t *begin_record(Level level, const char *module, const char *format, uint32_t argument_count, uint32_t arguments_size) noexcept;
+
+// Hands the record begin_record returned to the background thread
+void end_record(Level level) noexcept;
+
+template <typename T>
+std::string_view as_string(const T &value) noexcept
+{
+    if constexpr (std::is_array_v<T>)
+    {
+        return std::string_view(value).substr(0, MAX_STRING_SIZE);
+    }
+    else if constexpr (std::is_pointer_v<T>)
+    {
+        std::string_view text = value != nullptr ? std::string_view(value) : std::string_view("(null)");
+
+        return text.substr(0, MAX_STRING_SIZE);
+    }
+    else
+    {
+        static_assert(std::is_convertible_v<const T &, std::string_view>,
+                      "Log arguments are numbers, bools or strings");
+
+        return std::string_view(value).substr(0, MAX_STRING_SIZE);
+    }
+}
+
+template <typename T>
+uint32_t encoded_size(const T &value) noexcept
+{
+    if constexpr (std::is_arithmetic_v<T>)
+    {
+        return 1 + sizeof(uint64_t);
+    }
+    else
+    {
+        return 1 + sizeof(uint32_t) + static_cast<uint32_t>(as_string(value).size());
+    }
+}
+
+// A type tag, then 8 bytes for numbers or a length and the bytes for strings
+template <typename T>
+void encode(uint8_t *&out, const T &value) noexcept
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        uint64_t bits = value ? 1 : 0;
+
+        *out++ = static_cast<uint8_t>(ArgType::Bool);
+        std::memcpy(out, &bits, sizeof(bits));
+        out += sizeof(bits);
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        int64_t bits = value;
+
+        *out++ = static_cast<uint8_t>(ArgType::Int);
+        std::memcpy(out, &bits, sizeof(bits));
+        out += sizeof(bits);
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        uint64_t bits = value;
+
+        *out++ = static_cast<uint8_t>(ArgType::Uint);
+        std::memcpy(out, &bits, sizeof(bits));
+        out += sizeof(bits);
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        double bits = value;
+
+        *out++ = static_cast<uint8_t>(ArgType::Double);
+        std::memcpy(out, &bits, sizeof(bits));
+        out += sizeof(bits);
+    }
+    else
+    {
+        std::string_view text = as_string(value);
+        uint32_t length = static_cast<uint32_t>(text.size());
+
+        *out++ = static_cast<uint8_t>(ArgType::String);
+        std::memcpy(out, &length, sizeof(length));
+        out += sizeof(length);
+        std::memcpy(out, text.data(), length);
+        out += length;
+    }
+}
+
+template <typename... Args>
+void write_record(Level level, const char *module, const char *format, const Args &...args) noexcept
+{
+    uint8_t *out = begin_record(level, module, format, sizeof...(Args), (0 + ... + encoded_size(args)));
+
+    if (out == nullptr)
+    {
+        return;
+    }
+
+    (encode(out, args), ...);
+
+    end_record(level);
+}
+} // namespace detail
+
+// The message is copied as it is, the line is put together on the background thread.
+// module has to outlive the program, like the string literals every call site passes.
+template <typename Message>
+void write(Level level, const char *module, const Message &message) noexcept
+{
+    detail::write_record(level, module, nullptr, message);
+}
+
+// Each {} in format is replaced by the next argument on the background thread, the calling
+// thread only copies the arguments. Only format's address is kept, it has to be a literal.
+template <size_t N, typename First, typename... Rest>
+void write(Level level, const char *module, const char (&format)[N], const First &first, const Rest &...rest) noexcept
+{
+    detail::write_record(level, module, format, first, rest...);
+}
+} // namespace log
+} // namespace niqqa
+
+#if NIQQA_LOG_LEVEL <= 0
+#define LOG_INFO(module, ...) ::niqqa::log::write(::niqqa::log::Level::Info, (module), __VA_ARGS__)
+#else
+#define LOG_INFO(module, ...) (false ? ::niqqa::log::write(::niqqa::log::Level::Info, (module), __VA_ARGS__) : (void)0)
+#endif
+
+#if NIQQA_LOG_LEVEL <= 1
+#define LOG_WARN(module, ...) ::niqqa::log::write(::niqqa::log::Level::Warn, (module), __VA_ARGS__)
+#else
+#define LOG_WARN(module, ...) (false ? ::niqqa::log::write(::niqqa::log::Level::Warn, (module), __VA_ARGS__) : (void)0)
+#endif
+
+#if NIQQA_LOG_LEVEL <= 2
+#define LOG_ERROR(module, ...) ::niqqa::log::write(::niqqa::log::Level::Error, (module), __VA_ARGS__)
+#else
+#define LOG_ERROR(module, ...) (false ? ::niqqa::log::write(::niqqa::log::Level::Error, (module), __VA_ARGS__) : (void)0)
+#endif
\ No newline at end of file
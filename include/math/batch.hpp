@@ -0,0 +1,338 @@
+#pragma once
+
+#include <math/bounds.hpp>
+#include <math/mat4.hpp>
+#include <math/simd.hpp>
+
+#include <bit>
+#include <cstdint>
+
+namespace niqqa
+{
+namespace math
+{
+// Struct-of-arrays views, count floats behind each pointer. Kernels take Lanes::WIDTH
+// entries per step with unaligned loads and finish the rest one at a time, so any count and
+// any offset into a pool works. Outputs may alias the matching inputs.
+struct SoaVec3
+{
+    const float *x{nullptr};
+    const float *y{nullptr};
+    const float *z{nullptr};
+};
+
+struct SoaVec3Out
+{
+    float *x{nullptr};
+    float *y{nullptr};
+    float *z{nullptr};
+};
+
+struct SoaQuat
+{
+    const float *x{nullptr};
+    const float *y{nullptr};
+    const float *z{nullptr};
+    const float *w{nullptr};
+};
+
+struct SoaQuatOut
+{
+    float *x{nullptr};
+    float *y{nullptr};
+    float *z{nullptr};
+    float *w{nullptr};
+};
+
+struct SoaSpheres
+{
+    const float *x{nullptr};
+    const float *y{nullptr};
+    const float *z{nullptr};
+    const float *radius{nullptr};
+};
+
+struct SoaAabbs
+{
+    SoaVec3 min;
+    SoaVec3 max;
+};
+
+struct SoaAabbsOut
+{
+    SoaVec3Out min;
+    SoaVec3Out max;
+};
+
+namespace detail
+{
+// Full groups of Lanes from begin, returns where they stopped
+template <typename Lanes, typename Kernel>
+inline uint32_t run(Kernel &kernel, uint32_t begin, uint32_t end) noexcept
+{
+    uint32_t i = begin;
+
+    for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH)
+    {
+        kernel(Lanes{}, i);
+    }
+
+    return i;
+}
+
+// Same for kernels returning a lane mask, the set lanes' indices are appended to visible
+template <typename Lanes, typename Kernel>
+inline uint32_t run_compact(Kernel &kernel, uint32_t begin, uint32_t end, uint32_t *visible, uint32_t &visible_count) noexcept
+{
+    uint32_t i = begin;
+
+    for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH)
+    {
+        uint32_t bits = kernel(Lanes{}, i);
+
+        while (bits != 0)
+        {
+            visible[visible_count++] = i + static_cast<uint32_t>(std::countr_zero(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    return i;
+}
+
+// Dot product of the plane normal and the lanes' points plus the plane distance
+template <typename Lanes>
+inline typename Lanes::value plane_distance(const Plane &plane,
+                                            typename Lanes::value x,
+                                            typename Lanes::value y,
+                                            typename Lanes::value z) noexcept
+{
+    return Lanes::fmadd(Lanes::set1(plane.normal.x), x,
+                        Lanes::fmadd(Lanes::set1(plane.normal.y), y,
+                                     Lanes::fmadd(Lanes::set1(plane.normal.z), z, Lanes::set1(plane.distance))));
+}
+} // namespace detail
+
+// out = m * (in, 1)
+template <typename Lanes = NativeLanes>
+inline void transform_points(const mat4 &m, const SoaVec3 &in, const SoaVec3Out &out, uint32_t count) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+
+        typename L::value x = L::load(in.x + i);
+        typename L::value y = L::load(in.y + i);
+        typename L::value z = L::load(in.z + i);
+
+        const float *c = m.data();
+
+        L::store(out.x + i, L::fmadd(L::set1(c[0]), x, L::fmadd(L::set1(c[4]), y, L::fmadd(L::set1(c[8]), z, L::set1(c[12])))));
+        L::store(out.y + i, L::fmadd(L::set1(c[1]), x, L::fmadd(L::set1(c[5]), y, L::fmadd(L::set1(c[9]), z, L::set1(c[13])))));
+        L::store(out.z + i, L::fmadd(L::set1(c[2]), x, L::fmadd(L::set1(c[6]), y, L::fmadd(L::set1(c[10]), z, L::set1(c[14])))));
+    };
+
+    uint32_t i = detail::run<Lanes>(kernel, 0, count);
+    detail::run<ScalarLanes>(kernel, i, count);
+}
+
+// transform_aabb for every box
+template <typename Lanes = NativeLanes>
+inline void transform_aabbs(const mat4 &m, const SoaAabbs &in, const SoaAabbsOut &out, uint32_t count) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+        using V = typename L::value;
+
+        const V half = L::set1(0.5f);
+        const float *c = m.data();
+
+        V min_x = L::load(in.min.x + i);
+        V min_y = L::load(in.min.y + i);
+        V min_z = L::load(in.min.z + i);
+        V max_x = L::load(in.max.x + i);
+        V max_y = L::load(in.max.y + i);
+        V max_z = L::load(in.max.z + i);
+
+        V center_x = L::mul(L::add(min_x, max_x), half);
+        V center_y = L::mul(L::add(min_y, max_y), half);
+        V center_z = L::mul(L::add(min_z, max_z), half);
+        V extent_x = L::mul(L::sub(max_x, min_x), half);
+        V extent_y = L::mul(L::sub(max_y, min_y), half);
+        V extent_z = L::mul(L::sub(max_z, min_z), half);
+
+        auto axis = [&](uint32_t row, float *min_out, float *max_out) {
+            V new_center = L::fmadd(L::set1(c[row]), center_x,
+                                    L::fmadd(L::set1(c[4 + row]), center_y,
+                                             L::fmadd(L::set1(c[8 + row]), center_z, L::set1(c[12 + row]))));
+            V new_extent = L::fmadd(L::set1(std::fabs(c[row])), extent_x,
+                                    L::fmadd(L::set1(std::fabs(c[4 + row])), extent_y,
+                                             L::mul(L::set1(std::fabs(c[8 + row])), extent_z)));
+
+            L::store(min_out + i, L::sub(new_center, new_extent));
+            L::store(max_out + i, L::add(new_center, new_extent));
+        };
+
+        axis(0, out.min.x, out.max.x);
+        axis(1, out.min.y, out.max.y);
+        axis(2, out.min.z, out.max.z);
+    };
+
+    uint32_t i = detail::run<Lanes>(kernel, 0, count);
+    detail::run<ScalarLanes>(kernel, i, count);
+}
+
+// out = q * in * conjugate(q), one rotation per entry
+template <typename Lanes = NativeLanes>
+inline void rotate_vectors(const SoaQuat &q, const SoaVec3 &in, const SoaVec3Out &out, uint32_t count) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+        using V = typename L::value;
+
+        V qx = L::load(q.x + i);
+        V qy = L::load(q.y + i);
+        V qz = L::load(q.z + i);
+        V qw = L::load(q.w + i);
+        V vx = L::load(in.x + i);
+        V vy = L::load(in.y + i);
+        V vz = L::load(in.z + i);
+
+        // t = 2 * cross(q.xyz, v), then v + w * t + cross(q.xyz, t)
+        const V two = L::set1(2.0f);
+
+        V tx = L::mul(two, L::sub(L::mul(qy, vz), L::mul(qz, vy)));
+        V ty = L::mul(two, L::sub(L::mul(qz, vx), L::mul(qx, vz)));
+        V tz = L::mul(two, L::sub(L::mul(qx, vy), L::mul(qy, vx)));
+
+        L::store(out.x + i, L::add(L::fmadd(qw, tx, vx), L::sub(L::mul(qy, tz), L::mul(qz, ty))));
+        L::store(out.y + i, L::add(L::fmadd(qw, ty, vy), L::sub(L::mul(qz, tx), L::mul(qx, tz))));
+        L::store(out.z + i, L::add(L::fmadd(qw, tz, vz), L::sub(L::mul(qx, ty), L::mul(qy, tx))));
+    };
+
+    uint32_t i = detail::run<Lanes>(kernel, 0, count);
+    detail::run<ScalarLanes>(kernel, i, count);
+}
+
+// nlerp of every pair by the same t, for blending two animation poses
+template <typename Lanes = NativeLanes>
+inline void nlerp(const SoaQuat &a, const SoaQuat &b, float t, const SoaQuatOut &out, uint32_t count) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+        using V = typename L::value;
+
+        V ax = L::load(a.x + i);
+        V ay = L::load(a.y + i);
+        V az = L::load(a.z + i);
+        V aw = L::load(a.w + i);
+        V bx = L::load(b.x + i);
+        V by = L::load(b.y + i);
+        V bz = L::load(b.z + i);
+        V bw = L::load(b.w + i);
+
+        // Shorter arc, b flips where the dot product is negative
+        V cosine = L::fmadd(ax, bx, L::fmadd(ay, by, L::fmadd(az, bz, L::mul(aw, bw))));
+        V u = L::set1(1.0f - t);
+        V v = L::select(L::greater_equal(cosine, L::set1(0.0f)), L::set1(t), L::set1(-t));
+
+        V x = L::fmadd(ax, u, L::mul(bx, v));
+        V y = L::fmadd(ay, u, L::mul(by, v));
+        V z = L::fmadd(az, u, L::mul(bz, v));
+        V w = L::fmadd(aw, u, L::mul(bw, v));
+
+        V scale = L::rsqrt(L::fmadd(x, x, L::fmadd(y, y, L::fmadd(z, z, L::mul(w, w)))));
+
+        L::store(out.x + i, L::mul(x, scale));
+        L::store(out.y + i, L::mul(y, scale));
+        L::store(out.z + i, L::mul(z, scale));
+        L::store(out.w + i, L::mul(w, scale));
+    };
+
+    uint32_t i = detail::run<Lanes>(kernel, 0, count);
+    detail::run<ScalarLanes>(kernel, i, count);
+}
+
+// Writes the indices of spheres touching the frustum to visible, in order, and returns how
+// many. visible needs room for count.
+template <typename Lanes = NativeLanes>
+inline uint32_t cull_spheres(const Frustum &frustum, const SoaSpheres &spheres, uint32_t count, uint32_t *visible) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+        using V = typename L::value;
+
+        V x = L::load(spheres.x + i);
+        V y = L::load(spheres.y + i);
+        V z = L::load(spheres.z + i);
+        V negative_radius = L::sub(L::set1(0.0f), L::load(spheres.radius + i));
+
+        typename L::mask inside = L::greater_equal(detail::plane_distance<L>(frustum.planes[0], x, y, z), negative_radius);
+
+        for (uint32_t p = 1; p < frustum.planes.size(); ++p)
+        {
+            inside = L::mask_and(inside, L::greater_equal(detail::plane_distance<L>(frustum.planes[p], x, y, z), negative_radius));
+        }
+
+        return L::bits(inside);
+    };
+
+    uint32_t visible_count = 0;
+
+    uint32_t i = detail::run_compact<Lanes>(kernel, 0, count, visible, visible_count);
+    detail::run_compact<ScalarLanes>(kernel, i, count, visible, visible_count);
+
+    return visible_count;
+}
+
+// cull_spheres for boxes, testing the corner furthest along each plane normal
+template <typename Lanes = NativeLanes>
+inline uint32_t cull_aabbs(const Frustum &frustum, const SoaAabbs &boxes, uint32_t count, uint32_t *visible) noexcept
+{
+    auto kernel = [&](auto lanes, uint32_t i) {
+        using L = decltype(lanes);
+        using V = typename L::value;
+
+        const V half = L::set1(0.5f);
+        const V zero = L::set1(0.0f);
+
+        V min_x = L::load(boxes.min.x + i);
+        V min_y = L::load(boxes.min.y + i);
+        V min_z = L::load(boxes.min.z + i);
+        V max_x = L::load(boxes.max.x + i);
+        V max_y = L::load(boxes.max.y + i);
+        V max_z = L::load(boxes.max.z + i);
+
+        V center_x = L::mul(L::add(min_x, max_x), half);
+        V center_y = L::mul(L::add(min_y, max_y), half);
+        V center_z = L::mul(L::add(min_z, max_z), half);
+        V extent_x = L::mul(L::sub(max_x, min_x), half);
+        V extent_y = L::mul(L::sub(max_y, min_y), half);
+        V extent_z = L::mul(L::sub(max_z, min_z), half);
+
+        auto outside_distance = [&](const Plane &plane) {
+            V reach = L::fmadd(L::set1(std::fabs(plane.normal.x)), extent_x,
+                               L::fmadd(L::set1(std::fabs(plane.normal.y)), extent_y,
+                                        L::mul(L::set1(std::fabs(plane.normal.z)), extent_z)));
+
+            return L::add(detail::plane_distance<L>(plane, center_x, center_y, center_z), reach);
+        };
+
+        typename L::mask inside = L::greater_equal(outside_distance(frustum.planes[0]), zero);
+
+        for (uint32_t p = 1; p < frustum.planes.size(); ++p)
+        {
+            inside = L::mask_and(inside, L::greater_equal(outside_distance(frustum.planes[p]), zero));
+        }
+
+        return L::bits(inside);
+    };
+
+    uint32_t visible_count = 0;
+
+    uint32_t i = detail::run_compact<Lanes>(kernel, 0, count, visible, visible_count);
+    detail::run_compact<ScalarLanes>(kernel, i, count, visible, visible_count);
+
+    return visible_count;
+}
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
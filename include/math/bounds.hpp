@@ -0,0 +1,200 @@
+#pragma once
+
+#include <math/mat4.hpp>
+#include <math/vec.hpp>
+
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+namespace niqqa
+{
+namespace math
+{
+struct Aabb
+{
+    vec3 min{FLT_MAX, FLT_MAX, FLT_MAX};
+    vec3 max{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+};
+
+struct Sphere
+{
+    vec3 center;
+    float radius{0.0f};
+};
+
+// Points origin + direction * t for t in [0, max_distance]
+struct Ray
+{
+    vec3 origin;
+    vec3 direction{0.0f, 0.0f, -1.0f};
+    float max_distance{FLT_MAX};
+};
+
+// Points with dot(normal, p) + distance >= 0 are inside, the convention cull.comp uses
+struct Plane
+{
+    vec3 normal;
+    float distance{0.0f};
+};
+
+// Left, right, bottom, top, near, far, all facing inwards with unit normals
+struct Frustum
+{
+    std::array<Plane, 6> planes;
+};
+
+inline vec3 center(const Aabb &box) noexcept
+{
+    return (box.min + box.max) * 0.5f;
+}
+
+// Half the size
+inline vec3 extent(const Aabb &box) noexcept
+{
+    return (box.max - box.min) * 0.5f;
+}
+
+inline Aabb merge(const Aabb &a, const Aabb &b) noexcept
+{
+    return {min(a.min, b.min), max(a.max, b.max)};
+}
+
+inline Aabb merge(const Aabb &box, const vec3 &point) noexcept
+{
+    return {min(box.min, point), max(box.max, point)};
+}
+
+inline bool overlaps(const Aabb &a, const Aabb &b) noexcept
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Tight box around the transformed box: the center moves with m, the extent grows by the
+// absolute value of its linear part
+inline Aabb transform_aabb(const mat4 &m, const Aabb &box) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    __m128 box_min = _mm_setr_ps(box.min.x, box.min.y, box.min.z, 1.0f);
+    __m128 box_max = _mm_setr_ps(box.max.x, box.max.y, box.max.z, 1.0f);
+    __m128 c = _mm_mul_ps(_mm_add_ps(box_min, box_max), half);
+    __m128 e = _mm_mul_ps(_mm_sub_ps(box_max, box_min), half);
+
+    __m128 column0 = load(m.columns[0]);
+    __m128 column1 = load(m.columns[1]);
+    __m128 column2 = load(m.columns[2]);
+
+    __m128 new_center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0))),
+                                              _mm_mul_ps(column1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)))),
+                                   _mm_add_ps(_mm_mul_ps(column2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))),
+                                              load(m.columns[3])));
+
+    __m128 new_extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, column0), _mm_shuffle_ps(e, e, _MM_SHUFFLE(0, 0, 0, 0))),
+                                              _mm_mul_ps(_mm_andnot_ps(sign, column1), _mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1)))),
+                                   _mm_mul_ps(_mm_andnot_ps(sign, column2), _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 2, 2, 2))));
+
+    vec4 result_min = store(_mm_sub_ps(new_center, new_extent));
+    vec4 result_max = store(_mm_add_ps(new_center, new_extent));
+
+    return {xyz(result_min), xyz(result_max)};
+#else
+    vec3 c = center(box);
+    vec3 e = extent(box);
+
+    vec3 new_center = transform_point(m, c);
+    vec3 new_extent = abs(xyz(m.columns[0])) * e.x + abs(xyz(m.columns[1])) * e.y + abs(xyz(m.columns[2])) * e.z;
+
+    return {new_center - new_extent, new_center + new_extent};
+#endif
+}
+
+// Slab test, distance is where the ray enters the box, 0 when it starts inside
+inline bool intersect(const Ray &ray, const Aabb &box, float &distance) noexcept
+{
+    vec3 inverse{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    vec3 t1 = (box.min - ray.origin) * inverse;
+    vec3 t2 = (box.max - ray.origin) * inverse;
+    vec3 t_near = min(t1, t2);
+    vec3 t_far = max(t1, t2);
+
+    float enter = std::fmax(std::fmax(t_near.x, t_near.y), std::fmax(t_near.z, 0.0f));
+    float exit = std::fmin(std::fmin(t_far.x, t_far.y), std::fmin(t_far.z, ray.max_distance));
+
+    if (enter > exit)
+    {
+        return false;
+    }
+
+    distance = enter;
+
+    return true;
+}
+
+inline float distance(const Plane &plane, const vec3 &point) noexcept
+{
+    return dot(plane.normal, point) + plane.distance;
+}
+
+// From a column-major view projection with Vulkan's 0 to 1 depth range, planes are sums
+// and differences of its rows
+inline Frustum extract_frustum(const mat4 &view_projection) noexcept
+{
+    mat4 rows = transpose(view_projection);
+
+    const vec4 &x = rows.columns[0];
+    const vec4 &y = rows.columns[1];
+    const vec4 &z = rows.columns[2];
+    const vec4 &w = rows.columns[3];
+
+    std::array<vec4, 6> coefficients{w + x, w - x, w + y, w - y, z, w - z};
+
+    Frustum frustum;
+
+    for (uint32_t p = 0; p < coefficients.size(); ++p)
+    {
+        float normal_length = length(xyz(coefficients[p]));
+        float scale = normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+
+        frustum.planes[p] = {xyz(coefficients[p]) * scale, coefficients[p].w * scale};
+    }
+
+    return frustum;
+}
+
+// Conservative, spheres near a frustum corner can pass without touching it
+inline bool intersects(const Frustum &frustum, const Sphere &sphere) noexcept
+{
+    for (const Plane &plane : frustum.planes)
+    {
+        if (distance(plane, sphere.center) < -sphere.radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Tests the corner furthest along each normal, conservative in the same way
+inline bool intersects(const Frustum &frustum, const Aabb &box) noexcept
+{
+    vec3 c = center(box);
+    vec3 e = extent(box);
+
+    for (const Plane &plane : frustum.planes)
+    {
+        if (distance(plane, c) + dot(abs(plane.normal), e) < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <math/quat.hpp>
+#include <math/vec.hpp>
+
+#include <array>
+#include <cmath>
+
+namespace niqqa
+{
+namespace math
+{
+// Column-major like GLSL, so data() goes to shaders and GpuScene::set_view unchanged
+struct alignas(16) mat4
+{
+    std::array<vec4, 4> columns{vec4{1.0f, 0.0f, 0.0f, 0.0f},
+                                vec4{0.0f, 1.0f, 0.0f, 0.0f},
+                                vec4{0.0f, 0.0f, 1.0f, 0.0f},
+                                vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+
+    const float *data() const noexcept
+    {
+        return &columns[0].x;
+    }
+};
+
+inline vec4 operator*(const mat4 &m, const vec4 &v) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    __m128 p = load(v);
+
+    __m128 sum01 = _mm_add_ps(_mm_mul_ps(load(m.columns[0]), _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))),
+                              _mm_mul_ps(load(m.columns[1]), _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1))));
+    __m128 sum23 = _mm_add_ps(_mm_mul_ps(load(m.columns[2]), _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))),
+                              _mm_mul_ps(load(m.columns[3]), _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3))));
+
+    return store(_mm_add_ps(sum01, sum23));
+#else
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+#endif
+}
+
+// a * b applies b first
+inline mat4 operator*(const mat4 &a, const mat4 &b) noexcept
+{
+    mat4 result;
+
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        result.columns[c] = a * b.columns[c];
+    }
+
+    return result;
+}
+
+inline vec3 transform_point(const mat4 &m, const vec3 &p) noexcept
+{
+    return xyz(m * make_vec4(p, 1.0f));
+}
+
+inline vec3 transform_vector(const mat4 &m, const vec3 &v) noexcept
+{
+    return xyz(m * make_vec4(v, 0.0f));
+}
+
+inline mat4 transpose(const mat4 &m) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    __m128 c0 = load(m.columns[0]);
+    __m128 c1 = load(m.columns[1]);
+    __m128 c2 = load(m.columns[2]);
+    __m128 c3 = load(m.columns[3]);
+
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    return {store(c0), store(c1), store(c2), store(c3)};
+#else
+    const vec4 *c = m.columns.data();
+
+    return {vec4{c[0].x, c[1].x, c[2].x, c[3].x},
+            vec4{c[0].y, c[1].y, c[2].y, c[3].y},
+            vec4{c[0].z, c[1].z, c[2].z, c[3].z},
+            vec4{c[0].w, c[1].w, c[2].w, c[3].w}};
+#endif
+}
+
+// General inverse by cofactors, m has to be invertible
+inline mat4 inverse(const mat4 &m) noexcept
+{
+    const float *a = m.data();
+    std::array<float, 16> r;
+
+    r[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    r[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    r[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    r[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    r[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    r[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    r[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    r[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    r[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    r[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    r[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    r[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    r[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    r[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    r[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    r[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+    float inverse_determinant = 1.0f / (a[0] * r[0] + a[1] * r[4] + a[2] * r[8] + a[3] * r[12]);
+
+    mat4 result;
+
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        result.columns[c] = vec4{r[c * 4], r[c * 4 + 1], r[c * 4 + 2], r[c * 4 + 3]} * inverse_determinant;
+    }
+
+    return result;
+}
+
+inline mat4 translation(const vec3 &offset) noexcept
+{
+    mat4 result;
+    result.columns[3] = make_vec4(offset, 1.0f);
+
+    return result;
+}
+
+inline mat4 scaling(const vec3 &scale) noexcept
+{
+    mat4 result;
+    result.columns[0].x = scale.x;
+    result.columns[1].y = scale.y;
+    result.columns[2].z = scale.z;
+
+    return result;
+}
+
+inline mat4 rotation(const quat &q) noexcept
+{
+    float xx = q.x * q.x;
+    float yy = q.y * q.y;
+    float zz = q.z * q.z;
+    float xy = q.x * q.y;
+    float xz = q.x * q.z;
+    float yz = q.y * q.z;
+    float wx = q.w * q.x;
+    float wy = q.w * q.y;
+    float wz = q.w * q.z;
+
+    mat4 result;
+    result.columns[0] = {1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f};
+    result.columns[1] = {2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f};
+    result.columns[2] = {2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f};
+
+    return result;
+}
+
+// Scale, then rotate, then translate, the order Scene composes local transforms in
+inline mat4 compose(const vec3 &position, const quat &q, const vec3 &scale) noexcept
+{
+    mat4 result = rotation(q);
+    result.columns[0] = result.columns[0] * scale.x;
+    result.columns[1] = result.columns[1] * scale.y;
+    result.columns[2] = result.columns[2] * scale.z;
+    result.columns[3] = make_vec4(position, 1.0f);
+
+    return result;
+}
+
+// Right handed view space looking down -z, into Vulkan clip space: y down, depth 0 to 1
+inline mat4 perspective(float fov_y, float aspect, float z_near, float z_far) noexcept
+{
+    float focal = 1.0f / std::tan(fov_y * 0.5f);
+
+    mat4 result;
+    result.columns[0] = {focal / aspect, 0.0f, 0.0f, 0.0f};
+    result.columns[1] = {0.0f, -focal, 0.0f, 0.0f};
+    result.columns[2] = {0.0f, 0.0f, z_far / (z_near - z_far), -1.0f};
+    result.columns[3] = {0.0f, 0.0f, z_near * z_far / (z_near - z_far), 0.0f};
+
+    return result;
+}
+
+// World to right handed view space
+inline mat4 look_at(const vec3 &eye, const vec3 &target, const vec3 &up) noexcept
+{
+    vec3 forward = normalize(target - eye);
+    vec3 right = normalize(cross(forward, up));
+    vec3 camera_up = cross(right, forward);
+
+    mat4 result;
+    result.columns[0] = {right.x, camera_up.x, -forward.x, 0.0f};
+    result.columns[1] = {right.y, camera_up.y, -forward.y, 0.0f};
+    result.columns[2] = {right.z, camera_up.z, -forward.z, 0.0f};
+    result.columns[3] = {-dot(right, eye), -dot(camera_up, eye), dot(forward, eye), 1.0f};
+
+    return result;
+}
+
+// The upper three rows, row-major, as GpuObject::transform and Scene's world matrices are
+inline std::array<float, 12> to_affine_rows(const mat4 &m) noexcept
+{
+    mat4 rows = transpose(m);
+
+    return {rows.columns[0].x, rows.columns[0].y, rows.columns[0].z, rows.columns[0].w,
+            rows.columns[1].x, rows.columns[1].y, rows.columns[1].z, rows.columns[1].w,
+            rows.columns[2].x, rows.columns[2].y, rows.columns[2].z, rows.columns[2].w};
+}
+
+inline mat4 from_affine_rows(const std::array<float, 12> &rows) noexcept
+{
+    mat4 transposed;
+    transposed.columns[0] = {rows[0], rows[1], rows[2], rows[3]};
+    transposed.columns[1] = {rows[4], rows[5], rows[6], rows[7]};
+    transposed.columns[2] = {rows[8], rows[9], rows[10], rows[11]};
+
+    return transpose(transposed);
+}
+
+inline std::array<float, 16> to_array(const mat4 &m) noexcept
+{
+    const float *data = m.data();
+
+    return {data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7],
+            data[8], data[9], data[10], data[11], data[12], data[13], data[14], data[15]};
+}
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <math/vec.hpp>
+
+#include <cmath>
+
+namespace niqqa
+{
+namespace math
+{
+// Rotation as a unit quaternion, x y z w like Transform::rotation
+struct alignas(16) quat
+{
+    float x{0.0f};
+    float y{0.0f};
+    float z{0.0f};
+    float w{1.0f};
+};
+
+// axis has to be unit length
+inline quat from_axis_angle(const vec3 &axis, float radians) noexcept
+{
+    float s = std::sin(radians * 0.5f);
+
+    return {axis.x * s, axis.y * s, axis.z * s, std::cos(radians * 0.5f)};
+}
+
+// a * b rotates by b first, then by a
+inline quat operator*(const quat &a, const quat &b) noexcept
+{
+    return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+// The inverse, for unit quaternions
+inline quat conjugate(const quat &q) noexcept
+{
+    return {-q.x, -q.y, -q.z, q.w};
+}
+
+inline float dot(const quat &a, const quat &b) noexcept
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+inline quat normalize(const quat &q) noexcept
+{
+    float length_squared = dot(q, q);
+
+    if (length_squared <= 0.0f)
+    {
+        return {};
+    }
+
+    float scale = 1.0f / std::sqrt(length_squared);
+
+    return {q.x * scale, q.y * scale, q.z * scale, q.w * scale};
+}
+
+inline vec3 rotate(const quat &q, const vec3 &v) noexcept
+{
+    vec3 axis{q.x, q.y, q.z};
+    vec3 t = cross(axis, v) * 2.0f;
+
+    return v + t * q.w + cross(axis, t);
+}
+
+// Along the shorter arc. Not constant speed, which blending animation poses does not need.
+inline quat nlerp(const quat &a, const quat &b, float t) noexcept
+{
+    float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    float u = 1.0f - t;
+    float v = t * sign;
+
+    return normalize(quat{a.x * u + b.x * v, a.y * u + b.y * v, a.z * u + b.z * v, a.w * u + b.w * v});
+}
+
+// Constant angular speed, nlerp for nearly equal rotations where the angle is unstable
+inline quat slerp(const quat &a, const quat &b, float t) noexcept
+{
+    float cosine = dot(a, b);
+    float sign = 1.0f;
+
+    if (cosine < 0.0f)
+    {
+        cosine = -cosine;
+        sign = -1.0f;
+    }
+
+    if (cosine > 0.9995f)
+    {
+        return nlerp(a, b, t);
+    }
+
+    float angle = std::acos(cosine);
+    float inverse_sine = 1.0f / std::sin(angle);
+    float u = std::sin((1.0f - t) * angle) * inverse_sine;
+    float v = std::sin(t * angle) * inverse_sine * sign;
+
+    return {a.x * u + b.x * v, a.y * u + b.y * v, a.z * u + b.z * v, a.w * u + b.w * v};
+}
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// What the compiler was allowed to target, NIQQA_SIMD in CMake picks it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NIQQA_MATH_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define NIQQA_MATH_SSE4
+#include <smmintrin.h>
+#endif
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define NIQQA_MATH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace niqqa
+{
+namespace math
+{
+// Batched kernels are written once against a lane type and instantiated per width. Every
+// lane type has the same static interface, ScalarLanes is the reference and the tail path.
+struct ScalarLanes
+{
+    using value = float;
+    using mask = bool;
+
+    static constexpr uint32_t WIDTH{1};
+
+    static value load(const float *source) noexcept
+    {
+        return *source;
+    }
+
+    static void store(float *destination, value v) noexcept
+    {
+        *destination = v;
+    }
+
+    static value set1(float v) noexcept
+    {
+        return v;
+    }
+
+    static value add(value a, value b) noexcept
+    {
+        return a + b;
+    }
+
+    static value sub(value a, value b) noexcept
+    {
+        return a - b;
+    }
+
+    static value mul(value a, value b) noexcept
+    {
+        return a * b;
+    }
+
+    // a * b + c
+    static value fmadd(value a, value b, value c) noexcept
+    {
+        return a * b + c;
+    }
+
+    static value min(value a, value b) noexcept
+    {
+        return a < b ? a : b;
+    }
+
+    static value max(value a, value b) noexcept
+    {
+        return a > b ? a : b;
+    }
+
+    static value abs(value v) noexcept
+    {
+        return std::fabs(v);
+    }
+
+    static value sqrt(value v) noexcept
+    {
+        return std::sqrt(v);
+    }
+
+    static value rsqrt(value v) noexcept
+    {
+        return 1.0f / std::sqrt(v);
+    }
+
+    static mask greater_equal(value a, value b) noexcept
+    {
+        return a >= b;
+    }
+
+    static mask mask_and(mask a, mask b) noexcept
+    {
+        return a && b;
+    }
+
+    // Lane i in bit i
+    static uint32_t bits(mask m) noexcept
+    {
+        return m ? 1u : 0u;
+    }
+
+    // Lanes of a where m is set, b elsewhere
+    static value select(mask m, value a, value b) noexcept
+    {
+        return m ? a : b;
+    }
+};
+
+#ifdef NIQQA_MATH_SSE2
+struct SseLanes
+{
+    using value = __m128;
+    using mask = __m128;
+
+    static constexpr uint32_t WIDTH{4};
+
+    static value load(const float *source) noexcept
+    {
+        return _mm_loadu_ps(source);
+    }
+
+    static void store(float *destination, value v) noexcept
+    {
+        _mm_storeu_ps(destination, v);
+    }
+
+    static value set1(float v) noexcept
+    {
+        return _mm_set1_ps(v);
+    }
+
+    static value add(value a, value b) noexcept
+    {
+        return _mm_add_ps(a, b);
+    }
+
+    static value sub(value a, value b) noexcept
+    {
+        return _mm_sub_ps(a, b);
+    }
+
+    static value mul(value a, value b) noexcept
+    {
+        return _mm_mul_ps(a, b);
+    }
+
+    static value fmadd(value a, value b, value c) noexcept
+    {
+#ifdef NIQQA_MATH_AVX2
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+
+    static value min(value a, value b) noexcept
+    {
+        return _mm_min_ps(a, b);
+    }
+
+    static value max(value a, value b) noexcept
+    {
+        return _mm_max_ps(a, b);
+    }
+
+    static value abs(value v) noexcept
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    }
+
+    static value sqrt(value v) noexcept
+    {
+        return _mm_sqrt_ps(v);
+    }
+
+    // Full precision, the estimate alone is off by up to 1.5 * 2^-12
+    static value rsqrt(value v) noexcept
+    {
+        return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v));
+    }
+
+    static mask greater_equal(value a, value b) noexcept
+    {
+        return _mm_cmpge_ps(a, b);
+    }
+
+    static mask mask_and(mask a, mask b) noexcept
+    {
+        return _mm_and_ps(a, b);
+    }
+
+    static uint32_t bits(mask m) noexcept
+    {
+        return static_cast<uint32_t>(_mm_movemask_ps(m));
+    }
+
+    static value select(mask m, value a, value b) noexcept
+    {
+#ifdef NIQQA_MATH_SSE4
+        return _mm_blendv_ps(b, a, m);
+#else
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+#endif
+    }
+};
+#endif
+
+#ifdef NIQQA_MATH_AVX2
+struct Avx2Lanes
+{
+    using value = __m256;
+    using mask = __m256;
+
+    static constexpr uint32_t WIDTH{8};
+
+    static value load(const float *source) noexcept
+    {
+        return _mm256_loadu_ps(source);
+    }
+
+    static void store(float *destination, value v) noexcept
+    {
+        _mm256_storeu_ps(destination, v);
+    }
+
+    static value set1(float v) noexcept
+    {
+        return _mm256_set1_ps(v);
+    }
+
+    static value add(value a, value b) noexcept
+    {
+        return _mm256_add_ps(a, b);
+    }
+
+    static value sub(value a, value b) noexcept
+    {
+        return _mm256_sub_ps(a, b);
+    }
+
+    static value mul(value a, value b) noexcept
+    {
+        return _mm256_mul_ps(a, b);
+    }
+
+    static value fmadd(value a, value b, value c) noexcept
+    {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+
+    static value min(value a, value b) noexcept
+    {
+        return _mm256_min_ps(a, b);
+    }
+
+    static value max(value a, value b) noexcept
+    {
+        return _mm256_max_ps(a, b);
+    }
+
+    static value abs(value v) noexcept
+    {
+        return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+    }
+
+    static value sqrt(value v) noexcept
+    {
+        return _mm256_sqrt_ps(v);
+    }
+
+    static value rsqrt(value v) noexcept
+    {
+        return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(v));
+    }
+
+    static mask greater_equal(value a, value b) noexcept
+    {
+        return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+    }
+
+    static mask mask_and(mask a, mask b) noexcept
+    {
+        return _mm256_and_ps(a, b);
+    }
+
+    static uint32_t bits(mask m) noexcept
+    {
+        return static_cast<uint32_t>(_mm256_movemask_ps(m));
+    }
+
+    static value select(mask m, value a, value b) noexcept
+    {
+        return _mm256_blendv_ps(b, a, m);
+    }
+};
+#endif
+
+// The widest the build allows
+#if defined(NIQQA_MATH_AVX2)
+using NativeLanes = Avx2Lanes;
+#elif defined(NIQQA_MATH_SSE2)
+using NativeLanes = SseLanes;
+#else
+using NativeLanes = ScalarLanes;
+#endif
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
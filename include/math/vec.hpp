@@ -0,0 +1,189 @@
+#pragma once
+
+#include <math/simd.hpp>
+
+#include <cmath>
+
+namespace niqqa
+{
+namespace math
+{
+// Plain three floats, for storage and one-off math. Anything done to many of them at once
+// belongs in the batched SoA kernels instead.
+struct vec3
+{
+    float x{0.0f};
+    float y{0.0f};
+    float z{0.0f};
+};
+
+// Points and directions in homogeneous form, rows and columns of mat4
+struct alignas(16) vec4
+{
+    float x{0.0f};
+    float y{0.0f};
+    float z{0.0f};
+    float w{0.0f};
+};
+
+inline vec3 operator+(const vec3 &a, const vec3 &b) noexcept
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+inline vec3 operator-(const vec3 &a, const vec3 &b) noexcept
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline vec3 operator-(const vec3 &v) noexcept
+{
+    return {-v.x, -v.y, -v.z};
+}
+
+inline vec3 operator*(const vec3 &a, const vec3 &b) noexcept
+{
+    return {a.x * b.x, a.y * b.y, a.z * b.z};
+}
+
+inline vec3 operator*(const vec3 &v, float s) noexcept
+{
+    return {v.x * s, v.y * s, v.z * s};
+}
+
+inline vec3 operator*(float s, const vec3 &v) noexcept
+{
+    return v * s;
+}
+
+inline vec3 operator/(const vec3 &v, float s) noexcept
+{
+    return v * (1.0f / s);
+}
+
+inline float dot(const vec3 &a, const vec3 &b) noexcept
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline vec3 cross(const vec3 &a, const vec3 &b) noexcept
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline float length(const vec3 &v) noexcept
+{
+    return std::sqrt(dot(v, v));
+}
+
+// Zero stays zero
+inline vec3 normalize(const vec3 &v) noexcept
+{
+    float length_squared = dot(v, v);
+
+    return length_squared > 0.0f ? v * (1.0f / std::sqrt(length_squared)) : v;
+}
+
+inline vec3 min(const vec3 &a, const vec3 &b) noexcept
+{
+    return {std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z)};
+}
+
+inline vec3 max(const vec3 &a, const vec3 &b) noexcept
+{
+    return {std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z)};
+}
+
+inline vec3 abs(const vec3 &v) noexcept
+{
+    return {std::fabs(v.x), std::fabs(v.y), std::fabs(v.z)};
+}
+
+inline vec4 make_vec4(const vec3 &v, float w) noexcept
+{
+    return {v.x, v.y, v.z, w};
+}
+
+inline vec3 xyz(const vec4 &v) noexcept
+{
+    return {v.x, v.y, v.z};
+}
+
+#ifdef NIQQA_MATH_SSE2
+inline __m128 load(const vec4 &v) noexcept
+{
+    return _mm_load_ps(&v.x);
+}
+
+inline vec4 store(__m128 v) noexcept
+{
+    vec4 result;
+    _mm_store_ps(&result.x, v);
+
+    return result;
+}
+#endif
+
+inline vec4 operator+(const vec4 &a, const vec4 &b) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    return store(_mm_add_ps(load(a), load(b)));
+#else
+    return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+#endif
+}
+
+inline vec4 operator-(const vec4 &a, const vec4 &b) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    return store(_mm_sub_ps(load(a), load(b)));
+#else
+    return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+#endif
+}
+
+inline vec4 operator*(const vec4 &a, const vec4 &b) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    return store(_mm_mul_ps(load(a), load(b)));
+#else
+    return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+#endif
+}
+
+inline vec4 operator*(const vec4 &v, float s) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    return store(_mm_mul_ps(load(v), _mm_set1_ps(s)));
+#else
+    return {v.x * s, v.y * s, v.z * s, v.w * s};
+#endif
+}
+
+inline vec4 operator*(float s, const vec4 &v) noexcept
+{
+    return v * s;
+}
+
+inline float dot(const vec4 &a, const vec4 &b) noexcept
+{
+#ifdef NIQQA_MATH_SSE4
+    return _mm_cvtss_f32(_mm_dp_ps(load(a), load(b), 0xF1));
+#else
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+#endif
+}
+
+inline float length(const vec4 &v) noexcept
+{
+    return std::sqrt(dot(v, v));
+}
+
+inline vec4 normalize(const vec4 &v) noexcept
+{
+    float length_squared = dot(v, v);
+
+    return length_squared > 0.0f ? v * (1.0f / std::sqrt(length_squared)) : v;
+}
+} // namespace math
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <core/aligned_vector.hpp>
+#include <math/bounds.hpp>
+#include <systems/job_system.hpp>
+#include <systems/scene.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace systems
+{
+struct BvhHit
+{
+    uint32_t item{UINT32_MAX};
+    uint32_t value{0};
+
+    // Where the ray enters the item's box
+    float distance{0.0f};
+};
+
+// Four child slots with their boxes side by side, so one 4-wide test covers the node.
+// A slot holds a node index, an item index with Bvh::ITEM_BIT, or Bvh::EMPTY_SLOT with an
+// inverted box that no test passes.
+struct alignas(64) BvhNode
+{
+    std::array<float, 4> min_x;
+    std::array<float, 4> min_y;
+    std::array<float, 4> min_z;
+    std::array<float, 4> max_x;
+    std::array<float, 4> max_y;
+    std::array<float, 4> max_z;
+    std::array<uint32_t, 4> children;
+
+    uint32_t parent;
+    uint32_t parent_slot;
+
+    // Surface area of the subtree's boxes over its own when it was built, 0 if it never was
+    float build_cost;
+};
+
+// Dynamic bounding volume hierarchy over item boxes, each item carrying a value such as a
+// render handle. Moving items only refits the boxes above them and inserts go straight into
+// the tree. update() looks at one subtree near the root per call and rebuilds it once moves
+// made it noticeably worse, so the tree stays good without a full rebuild every frame.
+//
+// Queries see changes once update() ran.
+class Bvh
+{
+public:
+    static constexpr uint32_t INVALID_ITEM{UINT32_MAX};
+    static constexpr uint32_t ITEM_BIT{0x80000000u};
+    static constexpr uint32_t EMPTY_SLOT{UINT32_MAX};
+
+    bool init(uint32_t capacity = 0) noexcept;
+    void cleanup() noexcept;
+
+    uint32_t insert(const math::Aabb &bounds, uint32_t value) noexcept;
+    void move(uint32_t item, const math::Aabb &bounds) noexcept;
+    void set_value(uint32_t item, uint32_t value) noexcept;
+    void remove(uint32_t item) noexcept;
+
+    // Entities with a render handle become items with it as their value, boxed around their
+    // world bounding sphere. Call after Scene::update(), then update().
+    void sync(const Scene &scene) noexcept;
+
+    // Refits moved items, then does one of rebuilding the subtree whose turn it is if it got
+    // worse, at most MAX_REBUILD_ITEMS items, rebuilding the levels above those subtrees, or
+    // compacting away the nodes earlier rebuilds left behind. The refit costs what moved, the
+    // rest a few milliseconds at most with 100k items.
+    //
+    // Once inserts and removes since the last full build pass a quarter of the items, update()
+    // gives up on patching and rebuilds everything instead, which costs a full build (over
+    // 100 ms for 100k items). Call rebuild() after loading to pick when that happens.
+    void update() noexcept;
+
+    // Everything from scratch
+    void rebuild() noexcept;
+
+    // Values of the items touching the frustum, replacing what visible held
+    void query(const math::Frustum &frustum, std::vector<uint32_t> &visible) const noexcept;
+
+    // Same, with the subtrees spread over the job system's threads. The order is the same
+    // for the same tree, whatever thread ran which part.
+    void query(const math::Frustum &frustum, JobSystem &jobs, std::vector<uint32_t> &visible) noexcept;
+
+    // Nearest item box along the ray, for picking
+    bool raycast(const math::Ray &ray, BvhHit &hit) const noexcept;
+
+    uint32_t value(uint32_t item) const noexcept;
+    uint32_t item_count() const noexcept;
+    uint32_t node_count() const noexcept;
+
+private:
+    static constexpr uint32_t NO_NODE{UINT32_MAX};
+
+    // A subtree is rebuilt once its cost grows past this much of what it was built at
+    static constexpr float REBUILD_COST_RATIO{1.3f};
+
+    // Subtrees this deep are what update() rebuilds, a 64th of a balanced tree each
+    static constexpr uint32_t REBUILD_DEPTH{3};
+    static constexpr uint32_t MAX_REBUILD_CANDIDATES{64};
+
+    // Most items one update() rebuilds, a couple of milliseconds. Larger subtrees are rebuilt a
+    // part at a time.
+    static constexpr uint32_t MAX_REBUILD_ITEMS{2048};
+
+    // Builds bin centroids for the SAH, fewer items than SMALL_SPLIT_COUNT split at the median
+    static constexpr uint32_t BUILD_BINS{12};
+    static constexpr uint32_t SMALL_SPLIT_COUNT{16};
+
+    // Subtrees handed to each job system thread by the parallel query
+    static constexpr uint32_t TASKS_PER_THREAD{4};
+
+    struct Item
+    {
+        math::Aabb bounds;
+        uint32_t value{0};
+
+        // NO_NODE while the item is free
+        uint32_t node{NO_NODE};
+        uint32_t slot{0};
+    };
+
+    // What a build puts in a slot, an item or a subtree kept as it is, with its box and
+    // centroid next to it so builds partition these in place
+    struct BuildRef
+    {
+        math::Aabb bounds;
+        math::vec3 centroid;
+        uint32_t child{0};
+    };
+
+    // A subtree left to a job, all_visible when its box is inside the frustum, or an item
+    // with ITEM_BIT the query met on the way down
+    struct Task
+    {
+        uint32_t node{NO_NODE};
+        bool all_visible{false};
+    };
+
+    // Children come after their parents, update() refits in a backward sweep. The levels a
+    // rebuilt top puts after the subtrees below them are the exception. Nodes replaced by
+    // rebuilds stay behind as garbage until update() compacts them.
+    core::AlignedVector<BvhNode> m_nodes;
+    std::vector<uint8_t> m_dirty;
+    bool m_refit{false};
+    uint32_t m_root{NO_NODE};
+    uint32_t m_garbage_nodes{0};
+
+    std::vector<Item> m_items;
+    std::vector<uint32_t> m_free_items;
+    uint32_t m_item_count{0};
+
+    // Inserts and removes since the last full rebuild
+    uint32_t m_changes{0};
+    uint32_t m_rebuild_cursor{0};
+
+    // Scene entity to item
+    std::vector<uint32_t> m_entity_items;
+    uint64_t m_scene_layout{UINT64_MAX};
+
+    // Scratch
+    std::vector<BuildRef> m_build_refs;
+    std::vector<uint32_t> m_node_order;
+    std::vector<uint32_t> m_node_remap;
+    std::vector<Task> m_tasks;
+    std::vector<Task> m_expanded;
+    std::vector<std::vector<uint32_t>> m_task_visible;
+
+    uint32_t allocate_node(uint32_t parent, uint32_t parent_slot) noexcept;
+    void set_slot(uint32_t node, uint32_t slot, uint32_t child, const math::Aabb &bounds) noexcept;
+    math::Aabb slot_bounds(uint32_t node, uint32_t slot) const noexcept;
+    math::Aabb node_bounds(uint32_t node) const noexcept;
+    void mark_dirty(uint32_t node) noexcept;
+    void refit() noexcept;
+
+    // Builds a subtree over refs below parent's slot, returns its root
+    uint32_t build(BuildRef *refs, uint32_t count, uint32_t parent, uint32_t parent_slot, float &area_sum) noexcept;
+    static uint32_t split(BuildRef *refs, uint32_t count) noexcept;
+    void rebuild_subtree(uint32_t node) noexcept;
+
+    // The levels above the subtrees rebuild_subtree() takes care of
+    void rebuild_top() noexcept;
+    void compact() noexcept;
+
+    // Appends the subtree's items to m_build_refs and leaves its nodes behind as garbage
+    void discard_subtree(uint32_t node) noexcept;
+    float subtree_cost(uint32_t node, uint32_t &item_count) const noexcept;
+
+    // Same for the levels rebuild_top() redoes, the root's turn in update() stays that small
+    float top_cost() const noexcept;
+    float top_area(uint32_t node, uint32_t depth) const noexcept;
+
+    // What to rebuild instead of node's subtree, the descendant that got worst once the
+    // subtree holds more than MAX_REBUILD_ITEMS
+    uint32_t rebuild_target(uint32_t node, uint32_t item_count) const noexcept;
+
+    void traverse(const math::Frustum &frustum, uint32_t node, bool all_visible, std::vector<uint32_t> &visible) const noexcept;
+};
+} // namespace systems
+} // namespace niqqa
\ No newline at end of file
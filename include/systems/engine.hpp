@@ -1,14 +1,39 @@
 #pragma once
 
-#include <graphics/device.hpp>
+#include <assets/asset_io.hpp>
+#include <core/vulkan/instance.hpp>
 #include <core/windows/window.hpp>
+#include <graphics/device.hpp>
+#include <graphics/layout_cache.hpp>
+#include <graphics/offscreen_target.hpp>
+#include <graphics/shader_manager.hpp>
+#include <graphics/swapchain.hpp>
+#include <graphics/texture_streamer.hpp>
+#include <graphics/upload_queue.hpp>
+#include <systems/bvh.hpp>
+#include <systems/job_system.hpp>
+#include <systems/scene.hpp>
+#include <systems/renderers/forward.hpp>
 #include <vulkan/vulkan.h>
 #include <array>
+#include <string>
 
 namespace niqqa
 {
 namespace systems
 {
+struct HeadlessConfig
+{
+    uint32_t width{1920};
+    uint32_t height{1080};
+    uint32_t image_count{3};
+    VkFormat color_format{VK_FORMAT_R8G8B8A8_UNORM};
+    bool readback{false};
+
+    // Chrome trace of per-pass GPU timings, written after run_headless when set
+    std::string trace_path;
+};
+
 class Engine
 {
 public:
@@ -28,10 +53,43 @@ public:
               bool resizable = true, 
               bool fullscreen = false
               ) noexcept;
+    void run() noexcept;
+
+    // No window, no surface, no swapchain: the renderer draws into an offscreen ring
+    bool init_headless(const HeadlessConfig &config) noexcept;
+    void run_headless(uint32_t frame_count) noexcept;
+
+    void cleanup() noexcept;
+
+    JobSystem &jobs() noexcept;
+    graphics::UploadQueue &uploads() noexcept;
+    assets::AssetIo &io() noexcept;
+    graphics::TextureStreamer &textures() noexcept;
+    Scene &scene() noexcept;
+    Bvh &bvh() noexcept;
+    ForwardRenderer &renderer() noexcept;
+    graphics::ShaderManager &shaders() noexcept;
+    graphics::LayoutCache &layouts() noexcept;
 
 private:
+    JobSystem m_jobs;
+    core::Instance m_instance;
     core::Window m_window;
+    VkSurfaceKHR m_surface{VK_NULL_HANDLE};
     graphics::Device m_device;
+    graphics::Swapchain m_swapchain;
+    graphics::OffscreenTarget m_offscreen;
+    graphics::UploadQueue m_uploads;
+    assets::AssetIo m_io;
+    graphics::TextureStreamer m_textures;
+    Scene m_scene;
+    Bvh m_bvh;
+    graphics::ShaderManager m_shaders;
+    graphics::LayoutCache m_layouts;
+    ForwardRenderer m_renderer;
+
+    bool m_headless{false};
+    std::string m_trace_path;
 };
 } // namespace systems
 } // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace niqqa
+{
+namespace systems
+{
+// Counts unfinished jobs. A job can depend on a counter and will not start
+// until it reaches zero; wait() helps run jobs until it does.
+struct JobCounter
+{
+    std::atomic<uint32_t> value{0};
+
+    bool done() const noexcept
+    {
+        return value.load(std::memory_order_acquire) == 0;
+    }
+};
+
+struct alignas(64) Job
+{
+    static constexpr size_t PAYLOAD_SIZE{104};
+
+    void (*function)(void *payload){nullptr};
+    JobCounter *counter{nullptr};
+    const JobCounter *dependency{nullptr};
+
+    // Set from allocation until the job has run, the slot is not handed out again before
+    std::atomic<bool> busy{false};
+
+    alignas(16) unsigned char payload[PAYLOAD_SIZE];
+};
+
+// Chase-Lev deque: the owning thread pushes and pops at the bottom, thieves take from the top
+class WorkStealingQueue
+{
+public:
+    static constexpr int64_t CAPACITY{4096};
+
+    bool push(Job *job) noexcept;
+    Job *pop() noexcept;
+    Job *steal() noexcept;
+
+    int64_t size() const noexcept;
+
+private:
+    static constexpr int64_t MASK{CAPACITY - 1};
+
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    alignas(64) std::atomic<Job *> m_jobs[CAPACITY]{};
+};
+
+class JobSystem
+{
+public:
+    static constexpr uint32_t INVALID_THREAD{UINT32_MAX};
+    static constexpr uint32_t MAX_JOBS_PER_THREAD{4096};
+    static constexpr uint32_t PARALLEL_FOR_JOBS_PER_THREAD{4};
+
+    // The calling thread becomes thread 0 and takes part in the work whenever it waits.
+    // Jobs may only be submitted from that thread or from inside other jobs.
+    bool init(uint32_t worker_count = 0) noexcept;
+    void cleanup() noexcept;
+
+    template <typename F>
+    void run(F &&function, JobCounter *counter = nullptr, const JobCounter *dependency = nullptr) noexcept;
+
+    // function(begin, end) over [0, count) in chunks of chunk_size, returns when all are done.
+    // Consecutive chunks are grouped into a few jobs per thread rather than one job each.
+    // A chunk_size of 0 is taken as 1.
+    template <typename F>
+    void parallel_for(uint32_t count, uint32_t chunk_size, F &&function) noexcept;
+
+    void wait(const JobCounter &counter) noexcept;
+
+    uint32_t thread_count() const noexcept;
+    static uint32_t thread_index() noexcept;
+
+private:
+    struct ThreadState
+    {
+        WorkStealingQueue queue;
+        std::unique_ptr<Job[]> jobs;
+        uint32_t next_job{0};
+    };
+
+    std::vector<std::unique_ptr<ThreadState>> m_threads;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<bool> m_running{false};
+
+    // Queued jobs not yet taken, only used to let idle workers sleep
+    alignas(64) std::atomic<int32_t> m_pending{0};
+
+    Job *allocate_job() noexcept;
+    void push(Job *job) noexcept;
+    Job *find_job(uint32_t thread, bool oldest_first) noexcept;
+    bool execute(Job *job) noexcept;
+
+    void worker_main(uint32_t thread) noexcept;
+};
+
+template <typename F>
+void JobSystem::run(F &&function, JobCounter *counter, const JobCounter *dependency) noexcept
+{
+    using Function = std::decay_t<F>;
+
+    static_assert(sizeof(Function) <= Job::PAYLOAD_SIZE, "Job closure too large, capture by reference");
+    static_assert(alignof(Function) <= 16, "Job closure over-aligned");
+
+    Job *job = allocate_job();
+
+    new (job->payload) Function(std::forward<F>(function));
+
+    job->function = [](void *payload) {
+        Function *closure = std::launder(reinterpret_cast<Function *>(payload));
+        (*closure)();
+        closure->~Function();
+    };
+    job->counter = counter;
+    job->dependency = dependency;
+
+    if (counter != nullptr)
+    {
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    push(job);
+}
+
+template <typename F>
+void JobSystem::parallel_for(uint32_t count, uint32_t chunk_size, F &&function) noexcept
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    chunk_size = chunk_size > 0 ? chunk_size : 1;
+
+    uint32_t chunk_count = count / chunk_size + (count % chunk_size != 0 ? 1 : 0);
+    uint32_t max_jobs = thread_count() * PARALLEL_FOR_JOBS_PER_THREAD;
+    uint32_t job_count = chunk_count < max_jobs ? chunk_count : max_jobs;
+
+    JobCounter counter;
+
+    for (uint32_t i = 0; i < job_count; ++i)
+    {
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(chunk_count) * i / job_count);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(chunk_count) * (i + 1) / job_count);
+
+        run([&function, first, last, chunk_size, count]() {
+            for (uint32_t chunk = first; chunk < last; ++chunk)
+            {
+                uint32_t begin = chunk * chunk_size;
+                uint32_t end = count - begin > chunk_size ? begin + chunk_size : count;
+
+                function(begin, end);
+            }
+        }, &counter);
+    }
+
+    wait(counter);
+}
+} // namespace systems
+} // namespace niqqa
@@ -1,38 +1,218 @@
 #pragma once
 
+#include <graphics/async_compute.hpp>
+#include <graphics/bindless_heap.hpp>
 #include <graphics/frame.hpp>
+#include <graphics/gpu_profiler.hpp>
+#include <graphics/gpu_scene.hpp>
 #include <graphics/device.hpp>
+#include <graphics/offscreen_target.hpp>
+#include <graphics/pipeline_builder.hpp>
+#include <graphics/render_graph.hpp>
 #include <graphics/render_pass.hpp>
 #include <graphics/swapchain.hpp>
+#include <graphics/texture_streamer.hpp>
+#include <graphics/upload_queue.hpp>
+#include <systems/job_system.hpp>
 
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace niqqa
 {
 namespace systems
 {
+// Records draws [first, first + count) into command_buffer. Called from several
+// threads at once with disjoint ranges when recording is split into chunks.
+using DrawRecorder = std::function<void(VkCommandBuffer command_buffer, uint32_t first, uint32_t count)>;
+
+// Same for a list of items, e.g. the render handles a Bvh query found visible
+using ItemRecorder = std::function<void(VkCommandBuffer command_buffer, const uint32_t *items, uint32_t count)>;
+
+// Records this frame's async compute work, handing its outputs to graphics with compute.release_*
+using ComputeRecorder = std::function<void(VkCommandBuffer command_buffer, graphics::AsyncCompute &compute, uint32_t frame_index)>;
+
+// What the forward pass renders to, for passes added around it. scene_color is the
+// backbuffer itself unless post passes are set, which then have to write the backbuffer.
+struct ForwardGraph
+{
+    graphics::RenderGraphImage backbuffer{graphics::INVALID_GRAPH_RESOURCE};
+    graphics::RenderGraphImage scene_color{graphics::INVALID_GRAPH_RESOURCE};
+    graphics::RenderGraphImage depth{graphics::INVALID_GRAPH_RESOURCE};
+    VkExtent2D extent{0, 0};
+};
+
+// Adds passes to the frame's graph, called every frame while it is built
+using GraphSetup = std::function<void(graphics::RenderGraph &graph, const ForwardGraph &targets)>;
+
+// Dynamic rendering needs no render pass or framebuffers at all, render passes are
+// the fallback for devices without dynamic rendering and synchronization2
+enum class RenderPath
+{
+    RenderPass,
+    Dynamic
+};
+
+struct FramePacing
+{
+    // How many frames the CPU may record ahead of the GPU, 1 to ForwardRenderer::MAX_FRAMES_IN_FLIGHT
+    uint32_t frames_in_flight{2};
+
+    // Holds the CPU back until the previous frame is presented (VK_KHR_present_wait),
+    // or finished on the GPU without it. Lower latency for slightly lower throughput.
+    bool low_latency{false};
+};
+
+// From the end of pace_frame, where input should be sampled, to the frame reaching the
+// display. Only measured in low latency mode, to_present is false when only GPU completion
+// could be observed.
+struct LatencyStats
+{
+    double last_ms{0.0};
+    double average_ms{0.0};
+    double max_ms{0.0};
+    uint64_t samples{0};
+    bool to_present{false};
+};
+
 class ForwardRenderer final
 {
 public:
-    bool init(graphics::Device *device, graphics::Swapchain *swapchain) noexcept;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT{3};
+
+    bool init(graphics::Device *device, 
+              graphics::Swapchain *swapchain, 
+              JobSystem *jobs = nullptr, 
+              RenderPath render_path = RenderPath::Dynamic) noexcept;
+    bool init(graphics::Device *device, 
+              graphics::OffscreenTarget *offscreen, 
+              JobSystem *jobs = nullptr, 
+              RenderPath render_path = RenderPath::Dynamic) noexcept;
+
+    // Blocks until the next frame should start, sample input right after it.
+    // draw_frame calls it itself when the application did not.
+    void pace_frame() noexcept;
     void draw_frame() noexcept;
-    void resize() noexcept;
+
+    // Only records the new size, the swapchain is recreated at the start of the next frame
+    void resize(VkExtent2D extent) noexcept;
     void cleanup() noexcept;
 
+    void set_draws(uint32_t draw_count, DrawRecorder recorder) noexcept;
+
+    // One draw per item, split into chunks like the above. items has to stay as it is until
+    // draw_frame, so set it again after each query.
+    void set_draws(const std::vector<uint32_t> &items, ItemRecorder recorder) noexcept;
+
+    // Can be changed between frames, a new frames_in_flight waits for the frames still in flight
+    void set_frame_pacing(const FramePacing &pacing) noexcept;
+    FramePacing frame_pacing() const noexcept;
+    const LatencyStats &latency() const noexcept;
+
+    // Each frame flushes the queue and waits for the uploads it submitted
+    void set_upload_queue(graphics::UploadQueue *uploads) noexcept;
+
+    // Swaps in streamed mips each frame, right after the uploads are consumed
+    void set_texture_streamer(graphics::TextureStreamer *textures) noexcept;
+
+    // Passes before and after the forward pass, e.g. shadows or a depth pre-pass and post
+    // processing. Only the dynamic rendering path builds a graph.
+    void set_pre_passes(GraphSetup setup) noexcept;
+    void set_post_passes(GraphSetup setup) noexcept;
+
+    // Submitted before the frame's graphics work, which waits for it where its outputs are first used
+    void set_compute_work(ComputeRecorder recorder) noexcept;
+
+    // Objects culled and drawn on the GPU, drawn ahead of set_draws' draws. Fails when the
+    // device lacks what it needs, rendering then stays with CPU draws only.
+    bool enable_gpu_scene(graphics::ShaderManager &shaders, const graphics::GpuSceneLimits &limits = {}) noexcept;
+    bool gpu_scene_enabled() const noexcept;
+
+    graphics::GpuProfiler &profiler() noexcept;
+    graphics::BindlessHeap &bindless() noexcept;
+    graphics::PipelineBuilder &pipelines() noexcept;
+    graphics::GpuScene &gpu_scene() noexcept;
+
+    // Layout, render pass or attachment formats of the forward pass filled in, add shaders and state
+    graphics::GraphicsPipelineDesc pipeline_desc() const noexcept;
+    RenderPath render_path() const noexcept;
+
 private:
-    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT{2};
+    static constexpr uint32_t MAX_PROFILED_PASSES{32};
+    static constexpr uint32_t MAX_RECORD_CHUNKS{16};
+    static constexpr uint32_t MIN_DRAWS_PER_CHUNK{256};
+
+    JobSystem *m_jobs{nullptr};
+    graphics::UploadQueue *m_uploads{nullptr};
+    graphics::TextureStreamer *m_textures{nullptr};
+
+    uint32_t m_record_thread_count{1};
+    uint32_t m_draw_count{0};
+    DrawRecorder m_draw_recorder;
+
+    graphics::AsyncCompute m_compute;
+    ComputeRecorder m_compute_recorder;
+
+    RenderPath m_render_path{RenderPath::Dynamic};
 
     uint32_t m_frame_index{0};
+    uint64_t m_frame_count{0};
+    uint32_t m_frames_in_flight{2};
     std::vector<graphics::Frame> m_frames;
 
+    static constexpr uint64_t PRESENT_WAIT_TIMEOUT{100'000'000};
+
+    bool m_low_latency{false};
+    bool m_paced{false};
+    std::chrono::steady_clock::time_point m_input_time;
+    uint64_t m_present_id{0};
+    uint64_t m_measured_present_id{0};
+    LatencyStats m_latency;
+
+    // Also set when acquire or present report the swapchain out of date or suboptimal
+    bool m_swapchain_dirty{false};
+    VkExtent2D m_pending_extent{0, 0};
+
     graphics::Device *m_device{nullptr};
     graphics::Swapchain *m_swapchain{nullptr};
+    graphics::OffscreenTarget *m_offscreen{nullptr};
 
     graphics::RenderPass m_render_pass;
+    graphics::BindlessHeap m_bindless;
+    graphics::PipelineBuilder m_pipelines;
+    graphics::GpuScene m_scene;
+    bool m_scene_enabled{false};
+    graphics::RenderGraph m_graph;
+    GraphSetup m_pre_passes;
+    GraphSetup m_post_passes;
+    graphics::GpuProfiler m_profiler;
+
+    bool init_frames() noexcept;
+    void choose_render_path(RenderPath render_path) noexcept;
+    bool recreate_swapchain() noexcept;
+    void record_latency(const graphics::Frame &frame, bool to_present) noexcept;
+
+    VkExtent2D target_extent() const noexcept;
+    VkFramebuffer target_framebuffer(uint32_t image_index) const noexcept;
+    graphics::Image target_color_image(uint32_t image_index) const noexcept;
+    graphics::Image target_depth_image() const noexcept;
+    VkFormat target_color_format() const noexcept;
+    VkFormat target_depth_format() const noexcept;
+    VkImageLayout target_final_layout() const noexcept;
+
+    uint32_t draw_chunk_count(const graphics::Frame &frame) const noexcept;
+    void record_draw_chunks(graphics::Frame &frame,
+                            VkFramebuffer framebuffer,
+                            VkExtent2D extent,
+                            uint32_t chunk_count,
+                            std::vector<VkCommandBuffer> &secondary_buffers) noexcept;
 
-    void record_commands(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept;
+    void begin_render_pass(VkCommandBuffer command_buffer, uint32_t image_index, bool secondary_contents) noexcept;
+    void build_graph(uint32_t image_index, bool secondary_contents, std::vector<VkCommandBuffer> &secondary_buffers) noexcept;
+    void record_commands(VkCommandBuffer command_buffer, uint32_t image_index) noexcept;
 };
 } // namespace systems
 } // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <core/aligned_vector.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace niqqa
+{
+namespace systems
+{
+using Entity = uint32_t;
+
+// Object to world, the upper three rows of a row-major 4x4, as GpuObject::transform takes it
+using WorldMatrix = std::array<float, 12>;
+
+// Relative to the parent
+struct Transform
+{
+    std::array<float, 3> position{0.0f, 0.0f, 0.0f};
+
+    // Unit quaternion, x y z w
+    std::array<float, 4> rotation{0.0f, 0.0f, 0.0f, 1.0f};
+    std::array<float, 3> scale{1.0f, 1.0f, 1.0f};
+};
+
+// Dense indices [begin, end) whose world data update() rewrote
+struct SceneRange
+{
+    uint32_t begin{0};
+    uint32_t end{0};
+};
+
+// Every per entity array, index i of each is the same entity. Parents come before their
+// children and every subtree is one contiguous range, which is what lets update() get away
+// with linear sweeps. Each array is its own cache line aligned pool, loops only touch the
+// fields they need.
+struct ScenePools
+{
+    static constexpr uint32_t NO_PARENT{UINT32_MAX};
+
+    core::AlignedVector<Entity> entity;
+
+    // Dense index of the parent, and one past the last dense index of the subtree
+    core::AlignedVector<uint32_t> parent;
+    core::AlignedVector<uint32_t> subtree_end;
+
+    core::AlignedVector<float> position_x;
+    core::AlignedVector<float> position_y;
+    core::AlignedVector<float> position_z;
+    core::AlignedVector<float> rotation_x;
+    core::AlignedVector<float> rotation_y;
+    core::AlignedVector<float> rotation_z;
+    core::AlignedVector<float> rotation_w;
+    core::AlignedVector<float> scale_x;
+    core::AlignedVector<float> scale_y;
+    core::AlignedVector<float> scale_z;
+
+    // Bounding spheres in object space
+    core::AlignedVector<float> bounds_x;
+    core::AlignedVector<float> bounds_y;
+    core::AlignedVector<float> bounds_z;
+    core::AlignedVector<float> bounds_radius;
+
+    core::AlignedVector<WorldMatrix> world;
+
+    // Whatever the renderer draws the entity with, e.g. a GpuScene object
+    core::AlignedVector<uint32_t> render_handle;
+
+    core::AlignedVector<uint8_t> dirty;
+    core::AlignedVector<uint8_t> alive;
+
+    // Bounding sphere after the world transform. Worked out on request rather than in
+    // update(), only whoever needs bounds pays for them.
+    std::array<float, 4> world_bounds(uint32_t index) const noexcept;
+};
+
+// Entity transforms, bounds and render handles in struct-of-arrays pools. Setting a
+// transform only marks the entity dirty, update() then recomputes the world matrices of
+// dirty subtrees in one pass over their contiguous ranges and never visits the rest, so
+// static parts of the scene cost nothing per frame.
+//
+// Entities are stable handles, their dense index changes whenever the hierarchy does.
+class Scene
+{
+public:
+    static constexpr Entity INVALID_ENTITY{UINT32_MAX};
+    static constexpr uint32_t NO_RENDER_HANDLE{UINT32_MAX};
+
+    bool init(uint32_t capacity = 0) noexcept;
+    void cleanup() noexcept;
+
+    Entity create(const Transform &local = {}, Entity parent = INVALID_ENTITY) noexcept;
+
+    // Its children go with it
+    void destroy(Entity entity) noexcept;
+
+    // Keeps the local transform, so the entity moves with its new parent. False for a cycle.
+    bool set_parent(Entity entity, Entity parent) noexcept;
+    Entity parent(Entity entity) const noexcept;
+
+    void set_transform(Entity entity, const Transform &local) noexcept;
+    void set_position(Entity entity, const std::array<float, 3> &position) noexcept;
+    void set_rotation(Entity entity, const std::array<float, 4> &rotation) noexcept;
+    void set_scale(Entity entity, const std::array<float, 3> &scale) noexcept;
+    Transform transform(Entity entity) const noexcept;
+
+    // Center and radius in object space
+    void set_bounds(Entity entity, const std::array<float, 4> &bounds) noexcept;
+    // Shows up in changed() after the next update(), like a moved entity
+    void set_render_handle(Entity entity, uint32_t handle) noexcept;
+    uint32_t render_handle(Entity entity) const noexcept;
+
+    // Restores the hierarchy order if it changed, then propagates transforms
+    void update() noexcept;
+
+    // As of the last update()
+    const WorldMatrix &world_matrix(Entity entity) const noexcept;
+    std::array<float, 4> world_bounds(Entity entity) const noexcept;
+
+    bool is_alive(Entity entity) const noexcept;
+    uint32_t entity_count() const noexcept;
+    uint32_t dense_index(Entity entity) const noexcept;
+
+    // Dense data in hierarchy order, valid until the next structural change
+    const ScenePools &pools() const noexcept;
+
+    // Rewritten by the last update(). After a reorder it is everything, with a new layout_version().
+    const std::vector<SceneRange> &changed() const noexcept;
+    uint64_t layout_version() const noexcept;
+
+private:
+    ScenePools m_pools;
+
+    // Last layout's pools, reorder() gathers into them
+    ScenePools m_reordered;
+
+    // Entity to dense index, INVALID_ENTITY for free ones
+    std::vector<uint32_t> m_dense;
+    std::vector<Entity> m_free;
+
+    // Parents no longer all come before their children, update() restores the order
+    bool m_reorder{false};
+    uint64_t m_layout_version{0};
+
+    std::vector<Entity> m_dirty;
+    std::vector<uint32_t> m_dirty_indices;
+    std::vector<SceneRange> m_changed;
+
+    // Scratch for reordering
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_remap;
+    std::vector<uint32_t> m_child_offsets;
+    std::vector<uint32_t> m_children;
+    std::vector<uint32_t> m_stack;
+
+    void mark_dirty(uint32_t index) noexcept;
+    void reorder() noexcept;
+    void propagate(uint32_t begin, uint32_t end) noexcept;
+    bool is_valid(Entity entity) const noexcept;
+};
+} // namespace systems
+} // namespace niqqa
\ No newline at end of file
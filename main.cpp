@@ -1,9 +1,63 @@
 #include "tests/test1.hpp"
 
+#include <systems/engine.hpp>
+
+#include <charconv>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+static int run_headless(uint32_t frame_count, const char *trace_path)
+{
+    niqqa::systems::Engine engine;
+    niqqa::systems::HeadlessConfig config;
+
+    if (trace_path != nullptr)
+    {
+        config.trace_path = trace_path;
+    }
+
+    if (!engine.init_headless(config))
+    {
+        engine.cleanup();
+        return EXIT_FAILURE;
+    }
+
+    engine.run_headless(frame_count);
+    engine.cleanup();
 
-int main()
+    return EXIT_SUCCESS;
+}
+
+static void print_usage(const char *program)
+{
+    std::fprintf(stderr, "usage: %s [--headless [frames] [trace.json]]\n", program);
+}
+
+int main(int argc, char **argv)
 {
+    // --headless [frames] [trace.json]: render offscreen without a window, e.g. on lavapipe in CI
+    if (argc > 1 && std::strcmp(argv[1], "--headless") == 0)
+    {
+        uint32_t frame_count = 1000;
+
+        if (argc > 2)
+        {
+            const char *end = argv[2] + std::strlen(argv[2]);
+            auto [last, error] = std::from_chars(argv[2], end, frame_count);
+
+            if (error != std::errc() || last != end)
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        const char *trace_path = argc > 3 ? argv[3] : nullptr;
+
+        return run_headless(frame_count, trace_path);
+    }
+
     niqqa::app::Test1 test;
 
     if (!test.init(800, 600, "Test 1"))
@@ -0,0 +1,25 @@
+#ifndef NIQQA_MESH_GLSL
+#define NIQQA_MESH_GLSL
+
+// Decoding for the vertex streams of cooked meshes, see assets/mesh_file.hpp.
+// Positions come in as unorm within the mesh's quantization box, normals as an
+// octahedral snorm pair and uvs as half floats the vertex fetch already expands.
+
+vec3 decode_position(vec3 unorm, vec3 quantize_min, vec3 quantize_scale)
+{
+    return quantize_min + unorm * (quantize_scale * 65535.0);
+}
+
+vec3 decode_octahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+    // Unfold the lower hemisphere
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+
+    return normalize(normal);
+}
+
+#endif
\ No newline at end of file
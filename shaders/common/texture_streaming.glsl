@@ -0,0 +1,25 @@
+#ifndef NIQQA_TEXTURE_STREAMING_GLSL
+#define NIQQA_TEXTURE_STREAMING_GLSL
+
+// Screen space size feedback for graphics::TextureStreamer. Pass the frame's
+// TextureStreamer::feedback_index() in with the other bindless indices and call this
+// next to the sample, with the texture's bindless index. The streamer turns the smallest
+// uv footprint of a frame into the mip it wants resident. Footprints are positive floats,
+// so their bits order like the floats and atomicMin keeps the finest.
+
+// The bindless heap's storage buffer binding
+layout(set = 0, binding = 2, std430) buffer StreamFeedback
+{
+    uint footprints[];
+} stream_feedback_buffers[];
+
+void stream_feedback(uint feedback_buffer, uint texture_index, vec2 uv)
+{
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    float footprint = max(sqrt(max(dot(dx, dx), dot(dy, dy))), 1.0e-8);
+
+    atomicMin(stream_feedback_buffers[feedback_buffer].footprints[texture_index], floatBitsToUint(footprint));
+}
+
+#endif
\ No newline at end of file
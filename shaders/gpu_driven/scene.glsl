@@ -0,0 +1,77 @@
+// GPU driven scene data, mirrors the structs in graphics/gpu_scene.hpp
+
+#define MAX_MESH_LODS 4
+#define INVALID_INDEX 0xFFFFFFFFu
+
+struct MeshLod
+{
+    uint first_index;
+    uint index_count;
+    int vertex_offset;
+    float max_distance;
+};
+
+struct Mesh
+{
+    MeshLod lods[MAX_MESH_LODS];
+    uint lod_count;
+    uint padding[3];
+};
+
+struct Object
+{
+    // Upper three rows of a row-major object to world matrix
+    vec4 transform[3];
+
+    // Object space bounding sphere, center and radius
+    vec4 bounds;
+    uint mesh;
+    uint batch;
+    uint material;
+    uint padding;
+};
+
+struct Batch
+{
+    uint first_command;
+    uint capacity;
+};
+
+struct View
+{
+    vec4 planes[6];
+
+    // xyz camera position, w lod scale
+    vec4 camera;
+};
+
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+// The bindless heap's storage buffer binding
+layout(set = 0, binding = 2, std430) readonly buffer Objects
+{
+    Object objects[];
+} object_buffers[];
+
+vec3 object_to_world(Object object, vec3 position)
+{
+    vec4 p = vec4(position, 1.0);
+    return vec3(dot(object.transform[0], p), dot(object.transform[1], p), dot(object.transform[2], p));
+}
+
+// For vertex shaders of scene draws. The scene pushes its object buffer's bindless index
+// at offset 0, declare it as the first member of the push constant block and pass it in.
+// Draws use the object index as their first instance.
+#ifdef SCENE_DRAW
+Object scene_object(uint object_buffer)
+{
+    return object_buffers[object_buffer].objects[gl_InstanceIndex];
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,759 @@
+#include <assets/asset_io.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef NIQQA_HAS_LIBURING
+#include <liburing.h>
+#endif
+
+namespace niqqa
+{
+namespace assets
+{
+#ifdef NIQQA_HAS_LIBURING
+struct AssetIo::Ring
+{
+    io_uring ring;
+};
+#else
+struct AssetIo::Ring
+{
+};
+#endif
+
+#ifdef __linux__
+static intptr_t open_file(const std::string &path, uint64_t &size) noexcept
+{
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (file < 0)
+    {
+        return -1;
+    }
+
+    struct stat info{};
+
+    if (fstat(file, &info) != 0)
+    {
+        close(file);
+        return -1;
+    }
+
+    // Reads are mostly whole files front to back
+    posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size = static_cast<uint64_t>(info.st_size);
+
+    return file;
+}
+
+static int64_t read_file(intptr_t file, void *destination, uint64_t size, uint64_t offset) noexcept
+{
+    ssize_t result = pread(static_cast<int>(file), destination, static_cast<size_t>(size), static_cast<off_t>(offset));
+
+    return result < 0 ? -errno : static_cast<int64_t>(result);
+}
+
+static void close_file(intptr_t file) noexcept
+{
+    close(static_cast<int>(file));
+}
+#else
+// Seeking and reading a FILE is not atomic, so without pread the reads take turns
+static std::mutex s_file_mutex;
+
+static intptr_t open_file(const std::string &path, uint64_t &size) noexcept
+{
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+
+    if (file == nullptr)
+    {
+        return -1;
+    }
+
+    if (std::fseek(file, 0, SEEK_END) != 0)
+    {
+        std::fclose(file);
+        return -1;
+    }
+
+    size = static_cast<uint64_t>(std::ftell(file));
+
+    return reinterpret_cast<intptr_t>(file);
+}
+
+static int64_t read_file(intptr_t file, void *destination, uint64_t size, uint64_t offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(s_file_mutex);
+
+    std::FILE *stream = reinterpret_cast<std::FILE *>(file);
+
+    if (std::fseek(stream, static_cast<long>(offset), SEEK_SET) != 0)
+    {
+        return -EIO;
+    }
+
+    size_t result = std::fread(destination, 1, static_cast<size_t>(size), stream);
+
+    return std::ferror(stream) ? -EIO : static_cast<int64_t>(result);
+}
+
+static void close_file(intptr_t file) noexcept
+{
+    std::fclose(reinterpret_cast<std::FILE *>(file));
+}
+#endif
+
+bool AssetIo::init(graphics::UploadQueue *uploads, uint32_t fallback_threads) noexcept
+{
+    m_uploads = uploads;
+
+    m_free_chunks.clear();
+
+    for (auto &chunk : m_chunks)
+    {
+        m_free_chunks.push_back(&chunk);
+    }
+
+#ifdef NIQQA_HAS_LIBURING
+    m_ring = new Ring;
+
+    int result = io_uring_queue_init(QUEUE_DEPTH, &m_ring->ring, 0);
+
+    if (result < 0)
+    {
+        // Kernels without io_uring, or with it disabled, still get the thread pool
+        LOG_WARN("Asset IO", std::string("io_uring unavailable (") + std::strerror(-result) + "), falling back to threads");
+
+        delete m_ring;
+        m_ring = nullptr;
+    }
+#endif
+
+    m_running = true;
+    m_stop_workers = false;
+
+    if (m_ring == nullptr)
+    {
+        for (uint32_t i = 0; i < std::max(fallback_threads, 1u); ++i)
+        {
+            m_workers.emplace_back(&AssetIo::worker_loop, this);
+        }
+    }
+
+    m_dispatcher = std::thread(&AssetIo::dispatch_loop, this);
+
+    LOG_INFO("Asset IO", m_ring != nullptr
+                         ? "Reading through io_uring, queue depth " + std::to_string(QUEUE_DEPTH)
+                         : "Reading with " + std::to_string(m_workers.size()) + " threads");
+
+    return true;
+}
+
+void AssetIo::cleanup() noexcept
+{
+    if (!m_dispatcher.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+
+    // The dispatcher cancels what is queued and returns once nothing is in flight
+    m_wake.notify_all();
+    m_dispatcher.join();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop_workers = true;
+    }
+
+    m_work_ready.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        worker.join();
+    }
+
+    m_workers.clear();
+
+#ifdef NIQQA_HAS_LIBURING
+    if (m_ring != nullptr)
+    {
+        io_uring_queue_exit(&m_ring->ring);
+    }
+#endif
+
+    delete m_ring;
+    m_ring = nullptr;
+
+    m_requests.clear();
+    m_cancelled.clear();
+    m_finished.clear();
+    m_free_chunks.clear();
+    m_uploads = nullptr;
+}
+
+IoRequestId AssetIo::read(IoRequest request) noexcept
+{
+    if (request.buffer != VK_NULL_HANDLE && m_uploads == nullptr)
+    {
+        LOG_ERROR("Asset IO", "Reads into buffers need an upload queue");
+        return INVALID_REQUEST;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_running)
+    {
+        return INVALID_REQUEST;
+    }
+
+    auto pending = std::make_unique<Request>();
+    pending->id = m_next_id++;
+    pending->desc = std::move(request);
+    pending->queued = true;
+
+    Request *queued = pending.get();
+    m_queues[static_cast<size_t>(queued->desc.priority)].push_back(queued);
+    m_requests.emplace(queued->id, std::move(pending));
+
+    m_wake.notify_all();
+
+    return queued->id;
+}
+
+void AssetIo::cancel(IoRequestId id) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_requests.find(id);
+
+    if (it == m_requests.end() || it->second->cancelled)
+    {
+        return;
+    }
+
+    Request &request = *it->second;
+    request.cancelled = true;
+    unqueue(request);
+
+    // With chunks in flight the last one to come back finishes the request
+    if (request.in_flight == 0)
+    {
+        m_cancelled.push_back(&request);
+        m_wake.notify_all();
+    }
+}
+
+void AssetIo::set_priority(IoRequestId id, IoPriority priority) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_requests.find(id);
+
+    if (it == m_requests.end() || it->second->desc.priority == priority)
+    {
+        return;
+    }
+
+    Request &request = *it->second;
+
+    if (request.queued)
+    {
+        unqueue(request);
+
+        request.queued = true;
+        m_queues[static_cast<size_t>(priority)].push_back(&request);
+    }
+
+    request.desc.priority = priority;
+}
+
+void AssetIo::update() noexcept
+{
+    std::vector<std::pair<IoCallback, IoResult>> finished;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+
+    for (auto &[callback, result] : finished)
+    {
+        callback(result);
+    }
+}
+
+uint32_t AssetIo::pending() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return static_cast<uint32_t>(m_requests.size());
+}
+
+bool AssetIo::uses_io_uring() const noexcept
+{
+    return m_ring != nullptr;
+}
+
+void AssetIo::dispatch_loop() noexcept
+{
+    std::vector<Chunk *> issued;
+    std::vector<Chunk *> retries;
+    std::vector<Chunk *> completed;
+
+    while (true)
+    {
+        // Short reads continue before anything new is started
+        issued.swap(retries);
+        retries.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            if (!m_running)
+            {
+                for (auto &queue : m_queues)
+                {
+                    for (Request *request : queue)
+                    {
+                        request->cancelled = true;
+                        request->queued = false;
+
+                        if (request->in_flight == 0)
+                        {
+                            m_cancelled.push_back(request);
+                        }
+                    }
+
+                    queue.clear();
+                }
+            }
+
+            for (Request *request : m_cancelled)
+            {
+                finish(*request, IoStatus::Cancelled);
+            }
+
+            m_cancelled.clear();
+
+            if (!m_running && m_in_flight == 0 && issued.empty())
+            {
+                break;
+            }
+
+            bool staging_full = false;
+
+            while (m_running && !m_free_chunks.empty())
+            {
+                auto queue = std::find_if(m_queues.begin(), m_queues.end(), [](const auto &requests) {
+                    return !requests.empty();
+                });
+
+                if (queue == m_queues.end())
+                {
+                    break;
+                }
+
+                Request &request = *queue->front();
+
+                if (!request.opened)
+                {
+                    // Opening can block on the disk, requests keep coming in meanwhile
+                    lock.unlock();
+                    bool opened = open_request(request);
+                    lock.lock();
+
+                    // Cancelled meanwhile, m_cancelled finishes it
+                    if (request.cancelled)
+                    {
+                        continue;
+                    }
+
+                    if (!opened)
+                    {
+                        finish(request, IoStatus::Failed);
+                    }
+                    else if (request.size == 0)
+                    {
+                        finish(request, IoStatus::Complete);
+                    }
+
+                    // Priorities may have changed meanwhile
+                    continue;
+                }
+
+                Chunk *chunk = prepare_chunk(request);
+
+                if (chunk == nullptr)
+                {
+                    staging_full = true;
+                    break;
+                }
+
+                issued.push_back(chunk);
+
+                if (request.issued == request.size)
+                {
+                    unqueue(request);
+                }
+            }
+
+            if (issued.empty() && m_in_flight == 0)
+            {
+                bool queued = std::any_of(m_queues.begin(), m_queues.end(), [](const auto &requests) {
+                    return !requests.empty();
+                });
+
+                // A full staging ring frees up without telling anyone, so that wait is bounded
+                if (staging_full && queued)
+                {
+                    m_wake.wait_for(lock, std::chrono::milliseconds(WAIT_MS));
+                }
+                else
+                {
+                    m_wake.wait(lock, [this]() {
+                        return !m_running || !m_cancelled.empty() || std::any_of(m_queues.begin(), m_queues.end(), [](const auto &requests) {
+                            return !requests.empty();
+                        });
+                    });
+                }
+
+                continue;
+            }
+        }
+
+        issue(issued);
+        issued.clear();
+
+        reap(completed, true);
+
+        for (Chunk *chunk : completed)
+        {
+            complete(*chunk, retries);
+        }
+
+        completed.clear();
+    }
+}
+
+bool AssetIo::open_request(Request &request) noexcept
+{
+    uint64_t file_size = 0;
+    intptr_t file = open_file(request.desc.path, file_size);
+
+    if (file == -1)
+    {
+        LOG_ERROR("Asset IO", "Failed to open " + request.desc.path);
+        return false;
+    }
+
+    uint64_t size = request.desc.size != 0 ? request.desc.size : file_size - std::min(request.desc.offset, file_size);
+
+    if (request.desc.offset > file_size || size > file_size - request.desc.offset)
+    {
+        LOG_ERROR("Asset IO", "Read past the end of " + request.desc.path);
+
+        close_file(file);
+        return false;
+    }
+
+    // Only the dispatcher touches these, and it is the one asking
+    request.file = file;
+    request.size = size;
+    request.opened = true;
+
+    if (request.desc.buffer == VK_NULL_HANDLE)
+    {
+        request.data.resize(size);
+    }
+
+    return true;
+}
+
+AssetIo::Chunk *AssetIo::prepare_chunk(Request &request) noexcept
+{
+    uint64_t size = std::min(CHUNK_SIZE, request.size - request.issued);
+    Chunk &chunk = *m_free_chunks.back();
+
+    if (request.desc.buffer != VK_NULL_HANDLE)
+    {
+        if (!m_uploads->acquire_staging(size, chunk.lease))
+        {
+            return nullptr;
+        }
+
+        chunk.destination = chunk.lease.data;
+    }
+    else
+    {
+        chunk.destination = request.data.data() + request.issued;
+    }
+
+    m_free_chunks.pop_back();
+
+    chunk.request = &request;
+    chunk.offset = request.issued;
+    chunk.size = size;
+    chunk.done = 0;
+    chunk.result = 0;
+
+    request.issued += size;
+    ++request.in_flight;
+
+    return &chunk;
+}
+
+void AssetIo::issue(const std::vector<Chunk *> &chunks) noexcept
+{
+    if (chunks.empty())
+    {
+        return;
+    }
+
+    m_in_flight += static_cast<uint32_t>(chunks.size());
+
+#ifdef NIQQA_HAS_LIBURING
+    if (m_ring != nullptr)
+    {
+        for (Chunk *chunk : chunks)
+        {
+            // Never more chunks than queue entries, so there always is one
+            io_uring_sqe *entry = io_uring_get_sqe(&m_ring->ring);
+
+            io_uring_prep_read(entry,
+                               static_cast<int>(chunk->request->file),
+                               chunk->destination + chunk->done,
+                               static_cast<unsigned>(chunk->size - chunk->done),
+                               chunk->request->desc.offset + chunk->offset + chunk->done);
+            io_uring_sqe_set_data(entry, chunk);
+        }
+
+        io_uring_submit(&m_ring->ring);
+
+        return;
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_work.insert(m_work.end(), chunks.begin(), chunks.end());
+    }
+
+    m_work_ready.notify_all();
+}
+
+void AssetIo::reap(std::vector<Chunk *> &completed, bool wait) noexcept
+{
+#ifdef NIQQA_HAS_LIBURING
+    if (m_ring != nullptr)
+    {
+        io_uring_cqe *entry = nullptr;
+
+        if (wait)
+        {
+            __kernel_timespec timeout{};
+            timeout.tv_nsec = WAIT_MS * 1000000;
+
+            io_uring_wait_cqe_timeout(&m_ring->ring, &entry, &timeout);
+        }
+
+        while (io_uring_peek_cqe(&m_ring->ring, &entry) == 0)
+        {
+            Chunk *chunk = static_cast<Chunk *>(io_uring_cqe_get_data(entry));
+            chunk->result = entry->res;
+            completed.push_back(chunk);
+
+            io_uring_cqe_seen(&m_ring->ring, entry);
+        }
+
+        m_in_flight -= static_cast<uint32_t>(completed.size());
+
+        return;
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // New requests wake this too, they get issued alongside the reads still running
+    if (wait && m_completed.empty())
+    {
+        m_wake.wait_for(lock, std::chrono::milliseconds(WAIT_MS));
+    }
+
+    completed.swap(m_completed);
+    m_in_flight -= static_cast<uint32_t>(completed.size());
+}
+
+void AssetIo::complete(Chunk &chunk, std::vector<Chunk *> &retries) noexcept
+{
+    Request &request = *chunk.request;
+
+    bool failed = chunk.result < 0 || (chunk.result == 0 && chunk.done < chunk.size);
+
+    if (chunk.result < 0)
+    {
+        LOG_ERROR("Asset IO", "Failed to read " + request.desc.path + ": " + std::strerror(static_cast<int>(-chunk.result)));
+    }
+    else if (failed)
+    {
+        LOG_ERROR("Asset IO", request.desc.path + " ended early");
+    }
+    else
+    {
+        chunk.done += static_cast<uint64_t>(chunk.result);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    bool dropped = request.cancelled || !m_running;
+
+    if (failed)
+    {
+        request.failed = true;
+        unqueue(request);
+    }
+
+    // Short reads happen, the rest is read where the last attempt stopped
+    if (!failed && !dropped && chunk.done < chunk.size)
+    {
+        retries.push_back(&chunk);
+        return;
+    }
+
+    bool keep = !dropped && !request.failed;
+
+    lock.unlock();
+
+    if (chunk.lease.data != nullptr)
+    {
+        if (keep)
+        {
+            m_uploads->commit_staging(chunk.lease, request.desc.buffer, request.desc.buffer_offset + chunk.offset);
+        }
+        else
+        {
+            m_uploads->release_staging(chunk.lease);
+        }
+    }
+
+    lock.lock();
+
+    request.completed += chunk.size;
+    --request.in_flight;
+
+    chunk = Chunk{};
+    m_free_chunks.push_back(&chunk);
+
+    if (request.in_flight != 0)
+    {
+        return;
+    }
+
+    if (request.cancelled || !m_running)
+    {
+        finish(request, IoStatus::Cancelled);
+    }
+    else if (request.failed)
+    {
+        finish(request, IoStatus::Failed);
+    }
+    else if (request.completed == request.size)
+    {
+        finish(request, IoStatus::Complete);
+    }
+}
+
+void AssetIo::finish(Request &request, IoStatus status) noexcept
+{
+    if (request.opened)
+    {
+        close_file(request.file);
+    }
+
+    unqueue(request);
+
+    IoResult result;
+    result.id = request.id;
+    result.status = status;
+    result.size = request.size;
+
+    if (status == IoStatus::Complete)
+    {
+        result.data = std::move(request.data);
+    }
+
+    if (request.desc.callback)
+    {
+        m_finished.emplace_back(std::move(request.desc.callback), std::move(result));
+    }
+
+    m_requests.erase(request.id);
+}
+
+void AssetIo::unqueue(Request &request) noexcept
+{
+    if (!request.queued)
+    {
+        return;
+    }
+
+    auto &queue = m_queues[static_cast<size_t>(request.desc.priority)];
+    queue.erase(std::find(queue.begin(), queue.end(), &request));
+
+    request.queued = false;
+}
+
+void AssetIo::worker_loop() noexcept
+{
+    while (true)
+    {
+        Chunk *chunk = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_work_ready.wait(lock, [this]() {
+                return !m_work.empty() || m_stop_workers;
+            });
+
+            if (m_work.empty())
+            {
+                return;
+            }
+
+            chunk = m_work.front();
+            m_work.pop_front();
+        }
+
+        chunk->result = read_file(chunk->request->file,
+                                  chunk->destination + chunk->done,
+                                  chunk->size - chunk->done,
+                                  chunk->request->desc.offset + chunk->offset + chunk->done);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.push_back(chunk);
+        }
+
+        m_wake.notify_all();
+    }
+}
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
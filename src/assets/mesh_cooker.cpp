@@ -0,0 +1,541 @@
+#include <assets/mesh_cooker.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace niqqa
+{
+namespace assets
+{
+// Larger than any real post transform cache, the scores only need the order to be right
+static constexpr uint32_t VERTEX_CACHE_SIZE{32};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static float vertex_score(int32_t cache_position, uint32_t remaining) noexcept
+{
+    if (remaining == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+
+    if (cache_position >= 0)
+    {
+        // The last triangle's vertices get a fixed score so the next one does not just reuse two of them
+        if (cache_position < 3)
+        {
+            score = 0.75f;
+        }
+        else
+        {
+            float scale = 1.0f / static_cast<float>(VERTEX_CACHE_SIZE - 3);
+            score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scale, 1.5f);
+        }
+    }
+
+    // Vertices with few triangles left are finished first, so they leave the cache for good
+    return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+void optimize_vertex_cache(uint32_t *indices, size_t index_count, uint32_t vertex_count) noexcept
+{
+    size_t triangle_count = index_count / 3;
+
+    if (triangle_count < 2)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> remaining(vertex_count, 0);
+
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+    {
+        ++remaining[indices[i]];
+    }
+
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+
+    for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + remaining[vertex];
+    }
+
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+
+    for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+    {
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            adjacency[fill[indices[triangle * 3 + corner]]++] = static_cast<uint32_t>(triangle);
+        }
+    }
+
+    std::vector<int32_t> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+
+    for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        vertex_scores[vertex] = vertex_score(-1, remaining[vertex]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+
+    uint32_t best = 0;
+
+    for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+    {
+        const uint32_t *corners = indices + triangle * 3;
+        triangle_scores[triangle] = vertex_scores[corners[0]] + vertex_scores[corners[1]] + vertex_scores[corners[2]];
+
+        if (triangle_scores[triangle] > triangle_scores[best])
+        {
+            best = static_cast<uint32_t>(triangle);
+        }
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count * 3);
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> next_cache;
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    next_cache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    size_t next_unemitted = 0;
+
+    while (output.size() < triangle_count * 3)
+    {
+        // Nothing in the cache has triangles left, start over at the next triangle in input order
+        if (best == UINT32_MAX)
+        {
+            while (emitted[next_unemitted])
+            {
+                ++next_unemitted;
+            }
+
+            best = static_cast<uint32_t>(next_unemitted);
+        }
+
+        emitted[best] = true;
+
+        const uint32_t *corners = indices + static_cast<size_t>(best) * 3;
+        next_cache.clear();
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            uint32_t vertex = corners[corner];
+            output.push_back(vertex);
+
+            if (std::find(next_cache.begin(), next_cache.end(), vertex) == next_cache.end())
+            {
+                next_cache.push_back(vertex);
+            }
+
+            uint32_t *begin = adjacency.data() + adjacency_offsets[vertex];
+            uint32_t *end = begin + remaining[vertex];
+            uint32_t *found = std::find(begin, end, best);
+
+            if (found != end)
+            {
+                std::swap(*found, *(end - 1));
+                --remaining[vertex];
+            }
+        }
+
+        size_t emitted_count = next_cache.size();
+
+        for (uint32_t vertex : cache)
+        {
+            if (std::find(next_cache.begin(), next_cache.begin() + emitted_count, vertex) == next_cache.begin() + emitted_count)
+            {
+                next_cache.push_back(vertex);
+            }
+        }
+
+        // Vertices pushed past the end were evicted, they lose their cache score
+        for (size_t i = 0; i < next_cache.size(); ++i)
+        {
+            uint32_t vertex = next_cache[i];
+            cache_positions[vertex] = i < VERTEX_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+            vertex_scores[vertex] = vertex_score(cache_positions[vertex], remaining[vertex]);
+        }
+
+        best = UINT32_MAX;
+        float best_score = -1.0f;
+
+        for (uint32_t vertex : next_cache)
+        {
+            const uint32_t *begin = adjacency.data() + adjacency_offsets[vertex];
+
+            for (const uint32_t *triangle = begin; triangle < begin + remaining[vertex]; ++triangle)
+            {
+                const uint32_t *triangle_corners = indices + static_cast<size_t>(*triangle) * 3;
+                float score = vertex_scores[triangle_corners[0]] + vertex_scores[triangle_corners[1]] + vertex_scores[triangle_corners[2]];
+                triangle_scores[*triangle] = score;
+
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = *triangle;
+                }
+            }
+        }
+
+        if (next_cache.size() > VERTEX_CACHE_SIZE)
+        {
+            next_cache.resize(VERTEX_CACHE_SIZE);
+        }
+
+        cache.swap(next_cache);
+    }
+
+    std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+uint32_t optimize_vertex_fetch(uint32_t *indices, size_t index_count, uint32_t vertex_count, std::vector<uint32_t> &remap) noexcept
+{
+    remap.assign(vertex_count, UINT32_MAX);
+
+    uint32_t next = 0;
+
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        uint32_t &mapped = remap[indices[i]];
+
+        if (mapped == UINT32_MAX)
+        {
+            mapped = next++;
+        }
+
+        indices[i] = mapped;
+    }
+
+    return next;
+}
+
+std::array<int16_t, 2> encode_octahedral(const std::array<float, 3> &normal) noexcept
+{
+    float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+
+    if (length == 0.0f)
+    {
+        return {0, 0};
+    }
+
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+
+    // The lower hemisphere is folded over the diagonals
+    if (normal[2] < 0.0f)
+    {
+        float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    return {static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f)),
+            static_cast<int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f))};
+}
+
+uint16_t float_to_half(float value) noexcept
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+
+    if (half_exponent >= 0x1f)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    if (half_exponent <= 0)
+    {
+        if (half_exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        // Subnormal, round to nearest even on the bits shifted out
+        mantissa |= 0x800000;
+
+        uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1) != 0))
+        {
+            ++half_mantissa;
+        }
+
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+
+    // A carry out of the mantissa bumps the exponent, which is the right result
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))
+    {
+        ++half;
+    }
+
+    return static_cast<uint16_t>(half);
+}
+
+static bool validate_source(const MeshSource &source, const std::vector<MeshSourceLod> &lods) noexcept
+{
+    size_t vertex_count = source.positions.size();
+
+    if (vertex_count == 0 || vertex_count > UINT32_MAX || source.indices.empty() || source.indices.size() % 3 != 0)
+    {
+        LOG_ERROR("Mesh Cooker", "A mesh needs vertices and a triangle list");
+        return false;
+    }
+
+    if ((!source.normals.empty() && source.normals.size() != vertex_count) ||
+        (!source.uvs.empty() && source.uvs.size() != vertex_count))
+    {
+        LOG_ERROR("Mesh Cooker", "Normals and uvs need one entry per position");
+        return false;
+    }
+
+    for (uint32_t index : source.indices)
+    {
+        if (index >= vertex_count)
+        {
+            LOG_ERROR("Mesh Cooker", "Index " + std::to_string(index) + " is out of range");
+            return false;
+        }
+    }
+
+    if (lods.size() > MESH_FILE_MAX_LODS)
+    {
+        LOG_ERROR("Mesh Cooker", "At most " + std::to_string(MESH_FILE_MAX_LODS) + " lods are supported");
+        return false;
+    }
+
+    // Every lod is optimized on its own, so they must not share triangles
+    std::vector<MeshSourceLod> sorted = lods;
+    std::sort(sorted.begin(), sorted.end(), [](const MeshSourceLod &a, const MeshSourceLod &b) {
+        return a.first_index < b.first_index;
+    });
+
+    uint64_t previous_end = 0;
+
+    for (const auto &lod : sorted)
+    {
+        uint64_t end = uint64_t{lod.first_index} + lod.index_count;
+
+        if (lod.first_index % 3 != 0 || lod.index_count % 3 != 0 || lod.first_index < previous_end || end > source.indices.size())
+        {
+            LOG_ERROR("Mesh Cooker", "Lods have to be disjoint whole triangle ranges of the index list");
+            return false;
+        }
+
+        previous_end = end;
+    }
+
+    return true;
+}
+
+bool cook_mesh(const MeshSource &source, const std::string &path) noexcept
+{
+    std::vector<MeshSourceLod> lods = source.lods;
+
+    if (lods.empty())
+    {
+        lods.push_back({0, static_cast<uint32_t>(source.indices.size()), 0.0f});
+    }
+
+    if (!validate_source(source, lods))
+    {
+        return false;
+    }
+
+    uint32_t source_vertex_count = static_cast<uint32_t>(source.positions.size());
+    std::vector<uint32_t> indices = source.indices;
+
+    for (const auto &lod : lods)
+    {
+        optimize_vertex_cache(indices.data() + lod.first_index, lod.index_count, source_vertex_count);
+    }
+
+    // After the cache pass, so vertices are fetched in the order triangles are drawn
+    std::vector<uint32_t> remap;
+    uint32_t vertex_count = optimize_vertex_fetch(indices.data(), indices.size(), source_vertex_count, remap);
+
+    std::vector<uint32_t> source_vertices(vertex_count);
+
+    for (uint32_t vertex = 0; vertex < source_vertex_count; ++vertex)
+    {
+        if (remap[vertex] != UINT32_MAX)
+        {
+            source_vertices[remap[vertex]] = vertex;
+        }
+    }
+
+    MeshFileHeader header;
+    header.vertex_count = vertex_count;
+    header.index_count = static_cast<uint32_t>(indices.size());
+    header.lod_count = static_cast<uint32_t>(lods.size());
+
+    // 0xffff is left free for primitive restart
+    header.index_size = vertex_count < UINT16_MAX ? 2 : 4;
+
+    std::array<float, 3> minimum = source.positions[source_vertices[0]];
+    std::array<float, 3> maximum = minimum;
+
+    for (uint32_t vertex : source_vertices)
+    {
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            minimum[axis] = std::min(minimum[axis], source.positions[vertex][axis]);
+            maximum[axis] = std::max(maximum[axis], source.positions[vertex][axis]);
+        }
+    }
+
+    std::array<float, 3> center{};
+    float radius_squared = 0.0f;
+
+    for (size_t axis = 0; axis < 3; ++axis)
+    {
+        header.quantize_min[axis] = minimum[axis];
+        header.quantize_scale[axis] = (maximum[axis] - minimum[axis]) / 65535.0f;
+        center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+    }
+
+    for (uint32_t vertex : source_vertices)
+    {
+        float distance_squared = 0.0f;
+
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            float delta = source.positions[vertex][axis] - center[axis];
+            distance_squared += delta * delta;
+        }
+
+        radius_squared = std::max(radius_squared, distance_squared);
+    }
+
+    header.bounds = {center[0], center[1], center[2], std::sqrt(radius_squared)};
+
+    uint64_t lods_end = sizeof(MeshFileHeader) + sizeof(MeshFileLod) * lods.size();
+    header.data_offset = align_up(lods_end, MESH_FILE_ALIGNMENT);
+
+    MeshFileRange &positions = header.streams[static_cast<size_t>(MeshStream::Positions)];
+    MeshFileRange &attributes = header.streams[static_cast<size_t>(MeshStream::Attributes)];
+    MeshFileRange &index_stream = header.streams[static_cast<size_t>(MeshStream::Indices)];
+
+    positions = {header.data_offset, uint64_t{vertex_count} * sizeof(MeshPosition)};
+    attributes = {align_up(positions.offset + positions.size, MESH_FILE_ALIGNMENT), uint64_t{vertex_count} * sizeof(MeshAttributes)};
+    index_stream = {align_up(attributes.offset + attributes.size, MESH_FILE_ALIGNMENT), uint64_t{header.index_count} * header.index_size};
+
+    std::vector<uint8_t> bytes(align_up(index_stream.offset + index_stream.size, MESH_FILE_ALIGNMENT), 0);
+
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    for (size_t i = 0; i < lods.size(); ++i)
+    {
+        MeshFileLod lod;
+        lod.first_index = lods[i].first_index;
+        lod.index_count = lods[i].index_count;
+        lod.max_distance = lods[i].max_distance;
+
+        std::memcpy(bytes.data() + sizeof(MeshFileHeader) + sizeof(MeshFileLod) * i, &lod, sizeof(lod));
+    }
+
+    MeshPosition *position_data = reinterpret_cast<MeshPosition *>(bytes.data() + positions.offset);
+    MeshAttributes *attribute_data = reinterpret_cast<MeshAttributes *>(bytes.data() + attributes.offset);
+
+    for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        uint32_t source_vertex = source_vertices[vertex];
+        MeshPosition position{};
+
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            float extent = maximum[axis] - minimum[axis];
+            float unorm = extent > 0.0f ? (source.positions[source_vertex][axis] - minimum[axis]) / extent : 0.0f;
+            position.position[axis] = static_cast<uint16_t>(std::lround(std::clamp(unorm, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        MeshAttributes attribute{};
+        attribute.normal = encode_octahedral(source.normals.empty() ? std::array<float, 3>{0.0f, 0.0f, 1.0f} : source.normals[source_vertex]);
+
+        if (!source.uvs.empty())
+        {
+            attribute.uv = {float_to_half(source.uvs[source_vertex][0]), float_to_half(source.uvs[source_vertex][1])};
+        }
+
+        position_data[vertex] = position;
+        attribute_data[vertex] = attribute;
+    }
+
+    uint8_t *index_data = bytes.data() + index_stream.offset;
+
+    if (header.index_size == 2)
+    {
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            uint16_t index = static_cast<uint16_t>(indices[i]);
+            std::memcpy(index_data + i * sizeof(index), &index, sizeof(index));
+        }
+    }
+    else
+    {
+        std::memcpy(index_data, indices.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    // Written next to the target and renamed over it, a mapped old version stays valid
+    std::string temporary = path + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        if (!file || !file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+        {
+            LOG_ERROR("Mesh Cooker", "Failed to write " + temporary);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+
+    if (error)
+    {
+        LOG_ERROR("Mesh Cooker", "Failed to replace " + path + ": " + error.message());
+        return false;
+    }
+
+    LOG_INFO("Mesh Cooker", "Cooked " + path + " (" + std::to_string(vertex_count) + " vertices, " +
+                            std::to_string(header.index_count / 3) + " triangles, " + std::to_string(bytes.size() / 1024) + " KiB)");
+
+    return true;
+}
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
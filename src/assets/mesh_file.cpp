@@ -0,0 +1,218 @@
+#include <assets/mesh_file.hpp>
+
+#include <log.hpp>
+
+#include <fstream>
+#include <iterator>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace niqqa
+{
+namespace assets
+{
+static bool range_inside(const MeshFileRange &range, uint64_t begin, uint64_t end) noexcept
+{
+    return range.offset >= begin && range.offset <= end && range.size <= end - range.offset;
+}
+
+bool MeshFile::open(const std::string &path) noexcept
+{
+    close();
+
+    m_path = path;
+
+#ifdef __linux__
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (file < 0)
+    {
+        LOG_ERROR("Mesh File", "Failed to open " + path);
+        return false;
+    }
+
+    struct stat info{};
+
+    if (fstat(file, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(file);
+
+        LOG_ERROR("Mesh File", "Failed to stat " + path);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping keeps the file alive on its own
+    ::close(file);
+
+    if (mapping == MAP_FAILED)
+    {
+        LOG_ERROR("Mesh File", "Failed to map " + path);
+        return false;
+    }
+
+    m_bytes = static_cast<const uint8_t *>(mapping);
+    m_size = static_cast<uint64_t>(info.st_size);
+#else
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        LOG_ERROR("Mesh File", "Failed to open " + path);
+        return false;
+    }
+
+    m_fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    m_bytes = m_fallback.data();
+    m_size = m_fallback.size();
+#endif
+
+    if (!validate())
+    {
+        LOG_ERROR("Mesh File", path + " is not a valid mesh file");
+
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MeshFile::close() noexcept
+{
+#ifdef __linux__
+    if (m_bytes != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(m_bytes), static_cast<size_t>(m_size));
+    }
+#endif
+
+    m_bytes = nullptr;
+    m_size = 0;
+    m_fallback.clear();
+    m_fallback.shrink_to_fit();
+    m_path.clear();
+}
+
+bool MeshFile::is_open() const noexcept
+{
+    return m_bytes != nullptr;
+}
+
+const MeshFileHeader &MeshFile::header() const noexcept
+{
+    return *reinterpret_cast<const MeshFileHeader *>(m_bytes);
+}
+
+const MeshFileLod *MeshFile::lods() const noexcept
+{
+    return reinterpret_cast<const MeshFileLod *>(m_bytes + sizeof(MeshFileHeader));
+}
+
+const void *MeshFile::stream(MeshStream stream) const noexcept
+{
+    return m_bytes + header().streams[static_cast<size_t>(stream)].offset;
+}
+
+uint64_t MeshFile::stream_size(MeshStream stream) const noexcept
+{
+    return header().streams[static_cast<size_t>(stream)].size;
+}
+
+const void *MeshFile::data() const noexcept
+{
+    return m_bytes + header().data_offset;
+}
+
+uint64_t MeshFile::data_size() const noexcept
+{
+    return m_size - header().data_offset;
+}
+
+void MeshFile::prefetch() const noexcept
+{
+#ifdef __linux__
+    if (m_bytes != nullptr)
+    {
+        madvise(const_cast<uint8_t *>(m_bytes), static_cast<size_t>(m_size), MADV_WILLNEED | MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+bool MeshFile::validate() const noexcept
+{
+    if (m_size < sizeof(MeshFileHeader))
+    {
+        return false;
+    }
+
+    const MeshFileHeader &file_header = header();
+
+    if (file_header.magic != MESH_FILE_MAGIC)
+    {
+        return false;
+    }
+
+    if (file_header.version != MESH_FILE_VERSION)
+    {
+        LOG_WARN("Mesh File", m_path + " has version " + std::to_string(file_header.version) +
+                              ", expected " + std::to_string(MESH_FILE_VERSION) + ", recook it");
+        return false;
+    }
+
+    if ((file_header.index_size != 2 && file_header.index_size != 4) ||
+        file_header.lod_count == 0 ||
+        file_header.lod_count > MESH_FILE_MAX_LODS)
+    {
+        return false;
+    }
+
+    uint64_t lods_end = sizeof(MeshFileHeader) + sizeof(MeshFileLod) * file_header.lod_count;
+
+    if (file_header.data_offset < lods_end ||
+        file_header.data_offset > m_size ||
+        file_header.data_offset % MESH_FILE_ALIGNMENT != 0)
+    {
+        return false;
+    }
+
+    const uint64_t expected_sizes[] = {
+        uint64_t{file_header.vertex_count} * sizeof(MeshPosition),
+        uint64_t{file_header.vertex_count} * sizeof(MeshAttributes),
+        uint64_t{file_header.index_count} * file_header.index_size
+    };
+
+    for (size_t i = 0; i < file_header.streams.size(); ++i)
+    {
+        const MeshFileRange &range = file_header.streams[i];
+
+        if (range.size != expected_sizes[i] ||
+            range.offset % MESH_FILE_ALIGNMENT != 0 ||
+            !range_inside(range, file_header.data_offset, m_size))
+        {
+            return false;
+        }
+    }
+
+    const MeshFileLod *file_lods = lods();
+
+    for (uint32_t i = 0; i < file_header.lod_count; ++i)
+    {
+        if (file_lods[i].first_index > file_header.index_count ||
+            file_lods[i].index_count > file_header.index_count - file_lods[i].first_index)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <assets/texture_file.hpp>
+
+#include <log.hpp>
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace niqqa
+{
+namespace assets
+{
+static uint64_t align_up(uint64_t value, uint64_t alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t mip_extent(uint32_t extent, uint32_t mip) noexcept
+{
+    return std::max(extent >> mip, 1u);
+}
+
+static uint32_t full_mip_count(uint32_t width, uint32_t height) noexcept
+{
+    uint32_t count = 1;
+
+    while ((std::max(width, height) >> count) != 0)
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+static bool is_rgba8(uint32_t format) noexcept
+{
+    return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB ||
+           format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+static bool is_srgb(uint32_t format) noexcept
+{
+    return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+static float srgb_to_linear(float value) noexcept
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value) noexcept
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// Averages 2x2 texels, colour in linear space for sRGB formats, alpha always as stored
+static std::vector<uint8_t> downsample_rgba8(const std::vector<uint8_t> &source,
+                                             uint32_t width,
+                                             uint32_t height,
+                                             bool srgb) noexcept
+{
+    uint32_t target_width = std::max(width / 2, 1u);
+    uint32_t target_height = std::max(height / 2, 1u);
+
+    std::array<float, 256> to_linear{};
+
+    for (uint32_t i = 0; i < to_linear.size(); ++i)
+    {
+        float value = static_cast<float>(i) / 255.0f;
+        to_linear[i] = srgb ? srgb_to_linear(value) : value;
+    }
+
+    std::vector<uint8_t> target(size_t{target_width} * target_height * 4);
+
+    for (uint32_t y = 0; y < target_height; ++y)
+    {
+        for (uint32_t x = 0; x < target_width; ++x)
+        {
+            std::array<float, 4> sum{};
+
+            for (uint32_t dy = 0; dy < 2; ++dy)
+            {
+                for (uint32_t dx = 0; dx < 2; ++dx)
+                {
+                    uint32_t source_x = std::min(x * 2 + dx, width - 1);
+                    uint32_t source_y = std::min(y * 2 + dy, height - 1);
+                    const uint8_t *texel = source.data() + (size_t{source_y} * width + source_x) * 4;
+
+                    for (uint32_t channel = 0; channel < 3; ++channel)
+                    {
+                        sum[channel] += to_linear[texel[channel]];
+                    }
+
+                    sum[3] += static_cast<float>(texel[3]) / 255.0f;
+                }
+            }
+
+            uint8_t *texel = target.data() + (size_t{y} * target_width + x) * 4;
+
+            for (uint32_t channel = 0; channel < 4; ++channel)
+            {
+                float value = sum[channel] * 0.25f;
+
+                if (channel < 3 && srgb)
+                {
+                    value = linear_to_srgb(value);
+                }
+
+                texel[channel] = static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+            }
+        }
+    }
+
+    return target;
+}
+
+bool validate_texture_header(const TextureFileHeader &header, uint64_t file_size) noexcept
+{
+    if (header.magic != TEXTURE_FILE_MAGIC || header.version != TEXTURE_FILE_VERSION)
+    {
+        return false;
+    }
+
+    if (header.width == 0 || header.height == 0 ||
+        header.mip_count == 0 ||
+        header.mip_count > TEXTURE_FILE_MAX_MIPS ||
+        header.mip_count > full_mip_count(header.width, header.height))
+    {
+        return false;
+    }
+
+    uint64_t next_offset = align_up(sizeof(TextureFileHeader), TEXTURE_FILE_ALIGNMENT);
+
+    for (uint32_t i = 0; i < header.mip_count; ++i)
+    {
+        const TextureFileMip &mip = header.mips[i];
+
+        if (mip.width != mip_extent(header.width, i) ||
+            mip.height != mip_extent(header.height, i) ||
+            mip.size == 0 ||
+            mip.offset % TEXTURE_FILE_ALIGNMENT != 0 ||
+            mip.offset < next_offset ||
+            mip.size > file_size ||
+            mip.offset > file_size - mip.size)
+        {
+            return false;
+        }
+
+        next_offset = mip.offset + mip.size;
+    }
+
+    return true;
+}
+
+uint64_t texture_mip_range_size(const TextureFileHeader &header, uint32_t first, uint32_t last) noexcept
+{
+    if (first >= last || last > header.mip_count)
+    {
+        return 0;
+    }
+
+    return header.mips[last - 1].offset + header.mips[last - 1].size - header.mips[first].offset;
+}
+
+bool cook_texture(const TextureSource &source, const std::string &path) noexcept
+{
+    if (source.width == 0 || source.height == 0 || source.mips.empty())
+    {
+        LOG_ERROR("Texture Cooker", "A texture needs an extent and at least one mip");
+        return false;
+    }
+
+    uint32_t chain_length = std::min(full_mip_count(source.width, source.height), TEXTURE_FILE_MAX_MIPS);
+
+    if (source.mips.size() > chain_length)
+    {
+        LOG_ERROR("Texture Cooker", "More mips than the extent has, at most " + std::to_string(chain_length));
+        return false;
+    }
+
+    std::vector<std::vector<uint8_t>> mips = source.mips;
+
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+        uint64_t expected = uint64_t{mip_extent(source.width, i)} * mip_extent(source.height, i) * 4;
+
+        if (mips[i].empty() || (is_rgba8(source.format) && mips[i].size() != expected))
+        {
+            LOG_ERROR("Texture Cooker", "Mip " + std::to_string(i) + " has the wrong size");
+            return false;
+        }
+    }
+
+    if (mips.size() == 1 && is_rgba8(source.format))
+    {
+        for (uint32_t i = 1; i < chain_length; ++i)
+        {
+            mips.push_back(downsample_rgba8(mips.back(),
+                                            mip_extent(source.width, i - 1),
+                                            mip_extent(source.height, i - 1),
+                                            is_srgb(source.format)));
+        }
+    }
+
+    TextureFileHeader header{};
+    header.format = source.format;
+    header.width = source.width;
+    header.height = source.height;
+    header.mip_count = static_cast<uint32_t>(mips.size());
+
+    uint64_t offset = align_up(sizeof(TextureFileHeader), TEXTURE_FILE_ALIGNMENT);
+
+    for (uint32_t i = 0; i < header.mip_count; ++i)
+    {
+        header.mips[i].offset = offset;
+        header.mips[i].size = mips[i].size();
+        header.mips[i].width = mip_extent(source.width, i);
+        header.mips[i].height = mip_extent(source.height, i);
+
+        offset = align_up(offset + mips[i].size(), TEXTURE_FILE_ALIGNMENT);
+    }
+
+    std::vector<uint8_t> bytes(offset, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    for (uint32_t i = 0; i < header.mip_count; ++i)
+    {
+        std::memcpy(bytes.data() + header.mips[i].offset, mips[i].data(), mips[i].size());
+    }
+
+    // Written next to the target and renamed over it, like cooked meshes
+    std::string temporary = path + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        if (!file || !file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+        {
+            LOG_ERROR("Texture Cooker", "Failed to write " + temporary);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+
+    if (error)
+    {
+        LOG_ERROR("Texture Cooker", "Failed to replace " + path + ": " + error.message());
+        return false;
+    }
+
+    LOG_INFO("Texture Cooker", "Cooked " + path + " (" + std::to_string(header.width) + "x" + std::to_string(header.height) + ", " +
+                               std::to_string(header.mip_count) + " mips, " + std::to_string(bytes.size() / 1024) + " KiB)");
+
+    return true;
+}
+} // namespace assets
+} // namespace niqqa
\ No newline at end of file
@@ -12,7 +12,7 @@ namespace niqqa
 {
 namespace core
 {
-bool Instance::init() noexcept
+bool Instance::init(bool headless) noexcept
 {
     VkApplicationInfo app_info{};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -26,7 +26,7 @@ bool Instance::init() noexcept
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     create_info.pApplicationInfo = &app_info;
 
-    std::vector<const char *> extensions = get_required_extensions();
+    std::vector<const char *> extensions = get_required_extensions(headless);
 
     create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     create_info.ppEnabledExtensionNames = extensions.data();
@@ -62,8 +62,19 @@ void Instance::cleanup() noexcept
     }
 }
 
-std::vector<const char *> Instance::get_required_extensions()
+VkInstance Instance::instance() const noexcept
 {
+    return m_instance;
+}
+
+std::vector<const char *> Instance::get_required_extensions(bool headless)
+{
+    // No window, no surface extensions: lets the instance come up without a display
+    if (headless)
+    {
+        return {};
+    }
+
     uint32_t extension_count = 0;
     const char **glfw_extensions = glfwGetRequiredInstanceExtensions(&extension_count);
 
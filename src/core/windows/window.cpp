@@ -15,7 +15,7 @@ bool Window::create_surface(VkInstance instance, VkSurfaceKHR &surface) noexcept
 {
     LOG_INFO("Surface", "Creating surface");
 
-    if (!glfwCreateWindowSurface(instance, m_window, nullptr, &surface))
+    if (glfwCreateWindowSurface(instance, m_window, nullptr, &surface) != VK_SUCCESS)
     {
         LOG_ERROR("Surface", "Failed to create surface");
         return false;
@@ -31,6 +31,33 @@ void Window::poll_events() noexcept
     glfwPollEvents();
 }
 
+void Window::wait_events() noexcept
+{
+    glfwWaitEvents();
+}
+
+bool Window::consume_resize() noexcept
+{
+    bool resized = m_resized;
+    m_resized = false;
+
+    return resized;
+}
+
+VkExtent2D Window::framebuffer_extent() const noexcept
+{
+    return m_extent;
+}
+
+void Window::framebuffer_size_callback(GLFWwindow *window, int width, int height) noexcept
+{
+    Window *self = static_cast<Window *>(glfwGetWindowUserPointer(window));
+
+    // Only recorded here, the renderer recreates its swapchain at the start of the next frame
+    self->m_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+    self->m_resized = true;
+}
+
 void Window::cleanup() noexcept
 {
     if (m_window)
@@ -41,6 +68,11 @@ void Window::cleanup() noexcept
 
 bool Window::init(uint32_t width, uint32_t height, const std::string &title, bool resizable, bool fullscreen) noexcept
 {
+    m_extent = {width, height};
+    m_title = title;
+    m_resizable = resizable;
+    m_fullscreen = fullscreen;
+
     LOG_INFO("GLFW", "Initializing GLFW");
 
     if (!glfwInit())
@@ -70,6 +102,16 @@ bool Window::init(uint32_t width, uint32_t height, const std::string &title, boo
 
     LOG_INFO("Window", "Window created");
 
+    // The window size is in screen coordinates, the swapchain wants pixels
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+    glfwGetFramebufferSize(m_window, &framebuffer_width, &framebuffer_height);
+
+    m_extent = {static_cast<uint32_t>(framebuffer_width), static_cast<uint32_t>(framebuffer_height)};
+
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetFramebufferSizeCallback(m_window, framebuffer_size_callback);
+
     return true;
 }
 } // namespace core
@@ -0,0 +1,180 @@
+#include <graphics/async_compute.hpp>
+
+#include <utility>
+
+namespace niqqa
+{
+namespace graphics
+{
+bool AsyncCompute::init(Device &device, uint32_t frame_count) noexcept
+{
+    m_device = device.device();
+    m_timeline = &device.compute_timeline();
+    m_compute_family = device.compute_queue_family();
+    m_graphics_family = device.graphics_queue_family();
+
+    m_frames.resize(frame_count);
+
+    for (auto &frame : m_frames)
+    {
+        if (!frame.command_pool.init(m_device, m_compute_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT))
+        {
+            return false;
+        }
+
+        frame.command_buffer = frame.command_pool.allocate_primary();
+    }
+
+    return true;
+}
+
+void AsyncCompute::cleanup() noexcept
+{
+    for (auto &frame : m_frames)
+    {
+        frame.sync.wait();
+        frame.command_pool.cleanup();
+    }
+
+    m_frames.clear();
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frame_index) noexcept
+{
+    m_frame_index = frame_index;
+
+    ComputeFrame &frame = m_frames[frame_index];
+
+    frame.sync.wait();
+
+    frame.command_pool.reset();
+
+    m_buffer_releases.clear();
+    m_image_releases.clear();
+    m_buffer_acquires.clear();
+    m_image_acquires.clear();
+    m_release_stages = 0;
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(frame.command_buffer, &begin_info);
+
+    return frame.command_buffer;
+}
+
+void AsyncCompute::release_buffer(VkBuffer buffer, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage) noexcept
+{
+    bool transfer = is_dedicated();
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = transfer ? 0 : dst_access;
+    barrier.srcQueueFamilyIndex = transfer ? m_compute_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = transfer ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    m_buffer_releases.push_back(barrier);
+    m_release_stages |= dst_stage;
+
+    if (transfer)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dst_access;
+        m_buffer_acquires.push_back(barrier);
+    }
+}
+
+void AsyncCompute::release_image(VkImage image,
+                                 const VkImageSubresourceRange &range,
+                                 VkImageLayout old_layout,
+                                 VkImageLayout new_layout,
+                                 VkAccessFlags dst_access,
+                                 VkPipelineStageFlags dst_stage) noexcept
+{
+    bool transfer = is_dedicated();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = transfer ? 0 : dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = transfer ? m_compute_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = transfer ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    m_image_releases.push_back(barrier);
+    m_release_stages |= dst_stage;
+
+    if (transfer)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dst_access;
+        m_image_acquires.push_back(barrier);
+    }
+}
+
+SyncPoint AsyncCompute::submit(const SyncPoint &wait_for, VkPipelineStageFlags wait_stage) noexcept
+{
+    ComputeFrame &frame = m_frames[m_frame_index];
+
+    if (!m_buffer_releases.empty() || !m_image_releases.empty())
+    {
+        // A release only has to finish the writes, on a shared queue this is the whole dependency
+        vkCmdPipelineBarrier(frame.command_buffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             is_dedicated() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : m_release_stages,
+                             0,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_buffer_releases.size()), m_buffer_releases.data(),
+                             static_cast<uint32_t>(m_image_releases.size()), m_image_releases.data());
+    }
+
+    vkEndCommandBuffer(frame.command_buffer);
+
+    m_wait_stage = m_release_stages != 0 ? m_release_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    SubmitBatch batch;
+    batch.wait(wait_for, wait_stage);
+
+    frame.sync = m_timeline->submit(&frame.command_buffer, 1, std::move(batch));
+
+    return frame.sync;
+}
+
+void AsyncCompute::acquire(VkCommandBuffer graphics_command_buffer) noexcept
+{
+    if (m_buffer_acquires.empty() && m_image_acquires.empty())
+    {
+        return;
+    }
+
+    vkCmdPipelineBarrier(graphics_command_buffer,
+                         m_wait_stage,
+                         m_wait_stage,
+                         0,
+                         0, nullptr,
+                         static_cast<uint32_t>(m_buffer_acquires.size()), m_buffer_acquires.data(),
+                         static_cast<uint32_t>(m_image_acquires.size()), m_image_acquires.data());
+
+    m_buffer_acquires.clear();
+    m_image_acquires.clear();
+}
+
+VkPipelineStageFlags AsyncCompute::wait_stage() const noexcept
+{
+    return m_wait_stage;
+}
+
+bool AsyncCompute::is_dedicated() const noexcept
+{
+    return m_compute_family != m_graphics_family;
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include <graphics/bindless_heap.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+bool BindlessHeap::init(Device &device, uint32_t frames_in_flight) noexcept
+{
+    m_device = device.device();
+    m_frames_in_flight = frames_in_flight;
+
+    if (!device.supports_bindless())
+    {
+        LOG_WARN("Bindless Heap", "Descriptor indexing is not enabled, bindless heap disabled");
+        return true;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexing_properties{};
+    indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexing_properties;
+
+    vkGetPhysicalDeviceProperties2(device.gpu(), &properties);
+
+    uint32_t texture_limit = std::min(indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                      indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    uint32_t sampler_limit = std::min(indexing_properties.maxDescriptorSetUpdateAfterBindSamplers,
+                                      indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers);
+    uint32_t buffer_limit = std::min(indexing_properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                     indexing_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+
+    // Images and buffers also share one per stage budget
+    uint32_t resource_limit = indexing_properties.maxPerStageUpdateAfterBindResources / 2;
+
+    m_slots[static_cast<uint32_t>(BindlessType::Texture)].capacity = std::min({DESIRED_CAPACITY[0], texture_limit, resource_limit});
+    m_slots[static_cast<uint32_t>(BindlessType::Sampler)].capacity = std::min(DESIRED_CAPACITY[1], sampler_limit);
+    m_slots[static_cast<uint32_t>(BindlessType::Buffer)].capacity = std::min({DESIRED_CAPACITY[2], buffer_limit, resource_limit});
+
+    std::array<VkDescriptorSetLayoutBinding, TYPE_COUNT> bindings{};
+    std::array<VkDescriptorBindingFlags, TYPE_COUNT> binding_flags{};
+    std::array<VkDescriptorPoolSize, TYPE_COUNT> pool_sizes{};
+
+    for (uint32_t i = 0; i < TYPE_COUNT; ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = BINDLESS_DESCRIPTOR_TYPES[i];
+        bindings[i].descriptorCount = m_slots[i].capacity;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        pool_sizes[i].type = BINDLESS_DESCRIPTOR_TYPES[i];
+        pool_sizes[i].descriptorCount = m_slots[i].capacity;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.bindingCount = TYPE_COUNT;
+    binding_flags_info.pBindingFlags = binding_flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = TYPE_COUNT;
+    layout_info.pBindings = bindings.data();
+
+    LOG_INFO("Bindless Heap", "Creating bindless heap");
+
+    if (vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout) != VK_SUCCESS)
+    {
+        LOG_ERROR("Bindless Heap", "Failed to create descriptor set layout");
+        return false;
+    }
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = TYPE_COUNT;
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool) != VK_SUCCESS)
+    {
+        LOG_ERROR("Bindless Heap", "Failed to create descriptor pool");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = m_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &m_set_layout;
+
+    if (vkAllocateDescriptorSets(m_device, &alloc_info, &m_set) != VK_SUCCESS)
+    {
+        LOG_ERROR("Bindless Heap", "Failed to allocate descriptor set");
+        return false;
+    }
+
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_ALL;
+    push_constant_range.offset = 0;
+    push_constant_range.size = PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &m_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
+    {
+        LOG_ERROR("Bindless Heap", "Failed to create pipeline layout");
+        return false;
+    }
+
+    LOG_INFO("Bindless Heap", "Bindless heap created (" +
+                              std::to_string(capacity(BindlessType::Texture)) + " textures, " +
+                              std::to_string(capacity(BindlessType::Sampler)) + " samplers, " +
+                              std::to_string(capacity(BindlessType::Buffer)) + " buffers)");
+
+    return true;
+}
+
+void BindlessHeap::cleanup() noexcept
+{
+    if (m_pipeline_layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+        m_pipeline_layout = VK_NULL_HANDLE;
+    }
+
+    // Destroying the pool frees the set with it
+    if (m_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+        m_pool = VK_NULL_HANDLE;
+        m_set = VK_NULL_HANDLE;
+    }
+
+    if (m_set_layout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+        m_set_layout = VK_NULL_HANDLE;
+    }
+
+    m_slots = {};
+    m_retired.clear();
+}
+
+void BindlessHeap::begin_frame() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ++m_frame;
+
+    // Slots removed frames_in_flight frames ago can no longer be read by the GPU
+    auto retired = std::remove_if(m_retired.begin(), m_retired.end(), [this](const RetiredSlot &slot) {
+        if (m_frame - slot.frame <= m_frames_in_flight)
+        {
+            return false;
+        }
+
+        m_slots[static_cast<uint32_t>(slot.type)].free.push_back(slot.index);
+        return true;
+    });
+
+    m_retired.erase(retired, m_retired.end());
+}
+
+uint32_t BindlessHeap::add_texture(VkImageView view, VkImageLayout layout) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t index = allocate(BindlessType::Texture);
+
+    if (index != INVALID_INDEX)
+    {
+        VkDescriptorImageInfo image_info{};
+        image_info.imageView = view;
+        image_info.imageLayout = layout;
+
+        write(BindlessType::Texture, index, &image_info, nullptr);
+    }
+
+    return index;
+}
+
+uint32_t BindlessHeap::add_sampler(VkSampler sampler) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t index = allocate(BindlessType::Sampler);
+
+    if (index != INVALID_INDEX)
+    {
+        VkDescriptorImageInfo image_info{};
+        image_info.sampler = sampler;
+
+        write(BindlessType::Sampler, index, &image_info, nullptr);
+    }
+
+    return index;
+}
+
+uint32_t BindlessHeap::add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t index = allocate(BindlessType::Buffer);
+
+    if (index != INVALID_INDEX)
+    {
+        VkDescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = buffer;
+        buffer_info.offset = offset;
+        buffer_info.range = range;
+
+        write(BindlessType::Buffer, index, nullptr, &buffer_info);
+    }
+
+    return index;
+}
+
+void BindlessHeap::update_texture(uint32_t index, VkImageView view, VkImageLayout layout) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!is_live(BindlessType::Texture, index))
+    {
+        LOG_WARN("Bindless Heap", "Ignoring update of texture slot {}, it is not in use", index);
+        return;
+    }
+
+    VkDescriptorImageInfo image_info{};
+    image_info.imageView = view;
+    image_info.imageLayout = layout;
+
+    write(BindlessType::Texture, index, &image_info, nullptr);
+}
+
+void BindlessHeap::update_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!is_live(BindlessType::Buffer, index))
+    {
+        LOG_WARN("Bindless Heap", "Ignoring update of buffer slot {}, it is not in use", index);
+        return;
+    }
+
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+
+    write(BindlessType::Buffer, index, nullptr, &buffer_info);
+}
+
+void BindlessHeap::remove(BindlessType type, uint32_t index) noexcept
+{
+    if (index == INVALID_INDEX)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!is_live(type, index))
+    {
+        LOG_WARN("Bindless Heap", "Ignoring removal of slot {} of binding {}, it is not in use", index, static_cast<uint32_t>(type));
+        return;
+    }
+
+    m_slots[static_cast<uint32_t>(type)].live[index] = 0;
+
+    // The descriptor itself stays, partially bound slots are fine as long as nothing indexes them
+    m_retired.push_back({type, index, m_frame});
+}
+
+void BindlessHeap::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point) const noexcept
+{
+    if (m_set == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkCmdBindDescriptorSets(command_buffer, bind_point, m_pipeline_layout, 0, 1, &m_set, 0, nullptr);
+}
+
+bool BindlessHeap::is_enabled() const noexcept
+{
+    return m_set != VK_NULL_HANDLE;
+}
+
+uint32_t BindlessHeap::capacity(BindlessType type) const noexcept
+{
+    return m_slots[static_cast<uint32_t>(type)].capacity;
+}
+
+VkDescriptorSetLayout BindlessHeap::set_layout() const noexcept
+{
+    return m_set_layout;
+}
+
+VkPipelineLayout BindlessHeap::pipeline_layout() const noexcept
+{
+    return m_pipeline_layout;
+}
+
+VkDescriptorSet BindlessHeap::descriptor_set() const noexcept
+{
+    return m_set;
+}
+
+uint32_t BindlessHeap::allocate(BindlessType type) noexcept
+{
+    if (m_set == VK_NULL_HANDLE)
+    {
+        return INVALID_INDEX;
+    }
+
+    Slots &slots = m_slots[static_cast<uint32_t>(type)];
+
+    if (!slots.free.empty())
+    {
+        uint32_t index = slots.free.back();
+        slots.free.pop_back();
+
+        slots.live[index] = 1;
+
+        return index;
+    }
+
+    if (slots.next == slots.capacity)
+    {
+        LOG_ERROR("Bindless Heap", "Out of bindless slots for binding " + std::to_string(static_cast<uint32_t>(type)));
+        return INVALID_INDEX;
+    }
+
+    slots.live.push_back(1);
+
+    return slots.next++;
+}
+
+bool BindlessHeap::is_live(BindlessType type, uint32_t index) const noexcept
+{
+    if (static_cast<uint32_t>(type) >= TYPE_COUNT)
+    {
+        return false;
+    }
+
+    const Slots &slots = m_slots[static_cast<uint32_t>(type)];
+
+    return index < slots.next && slots.live[index] != 0;
+}
+
+void BindlessHeap::write(BindlessType type,
+                         uint32_t index,
+                         const VkDescriptorImageInfo *image_info,
+                         const VkDescriptorBufferInfo *buffer_info) noexcept
+{
+    if (index == INVALID_INDEX || m_set == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_set;
+    write.dstBinding = static_cast<uint32_t>(type);
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = BINDLESS_DESCRIPTOR_TYPES[static_cast<uint32_t>(type)];
+    write.pImageInfo = image_info;
+    write.pBufferInfo = buffer_info;
+
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -31,25 +31,42 @@ QueueFamilyIndices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR sur
     int32_t i = 0;
     for (const auto &queue_family : queue_families)
     {
-        if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (!indices.is_complete())
         {
-            indices.graphics_family = i;
-        }
-
-        if (surface != VK_NULL_HANDLE)
-        {
-            VkBool32 present_support = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+            if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                indices.graphics_family = i;
+            }
 
-            if (present_support)
+            if (surface != VK_NULL_HANDLE)
             {
-                indices.present_family = i;
+                VkBool32 present_support = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+
+                if (present_support)
+                {
+                    indices.present_family = i;
+                }
             }
         }
 
-        if (indices.is_complete())
+        bool graphics = queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        bool transfer = queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+        // Transfer-only families are the copy engines, any non-graphics family beats sharing the graphics queue
+        if (transfer && !graphics && !compute)
         {
-            break;
+            indices.transfer_family = i;
+        }
+        else if (transfer && !graphics && !indices.transfer_family.has_value())
+        {
+            indices.transfer_family = i;
+        }
+
+        if (compute && !graphics && !indices.compute_family.has_value())
+        {
+            indices.compute_family = i;
         }
 
         ++i;
@@ -76,7 +93,7 @@ static bool check_device_extension_support(VkPhysicalDevice device, const std::v
     return required_extensions.empty();
 }
 
-bool Device::init(VkInstance instance, VkSurfaceKHR surface) noexcept
+bool Device::init(VkInstance instance, VkSurfaceKHR surface, const std::string &pipeline_cache_path) noexcept
 {
     m_instance = instance;
 
@@ -90,6 +107,16 @@ bool Device::init(VkInstance instance, VkSurfaceKHR surface) noexcept
         return false;
     }
 
+    if (!m_allocator.init(m_gpu, m_device, m_properties))
+    {
+        return false;
+    }
+
+    if (!m_pipeline_cache.init(m_device, m_properties, pipeline_cache_path))
+    {
+        return false;
+    }
+
     return true;
 }
 
@@ -97,6 +124,13 @@ void Device::cleanup() noexcept
 {
     if (m_device != VK_NULL_HANDLE)
     {
+        m_present_timeline.cleanup();
+        m_transfer_timeline.cleanup();
+        m_compute_timeline.cleanup();
+        m_graphics_timeline.cleanup();
+
+        m_pipeline_cache.cleanup();
+        m_allocator.cleanup();
         vkDestroyDevice(m_device, nullptr);
     }
 }
@@ -111,6 +145,26 @@ VkDevice Device::device() const noexcept
     return m_device;
 }
 
+VkQueue Device::graphics_queue() const noexcept
+{
+    return m_graphics_queue;
+}
+
+VkQueue Device::present_queue() const noexcept
+{
+    return m_present_queue;
+}
+
+VkQueue Device::transfer_queue() const noexcept
+{
+    return m_transfer_queue;
+}
+
+VkQueue Device::compute_queue() const noexcept
+{
+    return m_compute_queue;
+}
+
 uint32_t Device::graphics_queue_family() const noexcept
 {
     return m_graphics_family;
@@ -121,27 +175,138 @@ uint32_t Device::present_queue_family() const noexcept
     return m_present_family;
 }
 
+uint32_t Device::transfer_queue_family() const noexcept
+{
+    return m_transfer_family;
+}
+
+uint32_t Device::compute_queue_family() const noexcept
+{
+    return m_compute_family;
+}
+
+bool Device::has_dedicated_transfer_queue() const noexcept
+{
+    return m_transfer_family != m_graphics_family;
+}
+
+bool Device::has_dedicated_compute_queue() const noexcept
+{
+    return m_compute_family != m_graphics_family;
+}
+
 VkPhysicalDeviceProperties Device::properties() const noexcept
 {
     return m_properties;
 }
 
-int32_t Device::rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface) noexcept
+VkPhysicalDeviceFeatures Device::features() const noexcept
 {
-    QueueFamilyIndices indices = find_queue_families(device, surface);
-    
-    if (!indices.is_complete())
+    return m_features;
+}
+
+const VkPhysicalDeviceVulkan12Features &Device::vulkan12_features() const noexcept
+{
+    return m_vulkan12_features;
+}
+
+const VkPhysicalDeviceVulkan13Features &Device::vulkan13_features() const noexcept
+{
+    return m_vulkan13_features;
+}
+
+bool Device::supports_bindless() const noexcept
+{
+    return m_bindless;
+}
+
+bool Device::supports_dynamic_rendering() const noexcept
+{
+    return m_dynamic_rendering;
+}
+
+bool Device::supports_present_wait() const noexcept
+{
+    return m_present_wait;
+}
+
+bool Device::supports_memory_budget() const noexcept
+{
+    return m_memory_budget;
+}
+
+bool Device::supports_draw_indirect_count() const noexcept
+{
+    return m_draw_indirect_count;
+}
+
+const DynamicStateSupport &Device::dynamic_state() const noexcept
+{
+    return m_dynamic_state;
+}
+
+Timeline &Device::graphics_timeline() noexcept
+{
+    return m_graphics_timeline;
+}
+
+Timeline &Device::compute_timeline() noexcept
+{
+    return m_compute_queue == m_graphics_queue ? m_graphics_timeline : m_compute_timeline;
+}
+
+Timeline &Device::transfer_timeline() noexcept
+{
+    if (m_transfer_queue == m_graphics_queue)
     {
-        return 0;
+        return m_graphics_timeline;
     }
 
-    if (!check_device_extension_support(device, {REQUIRED_EXTS.begin(), REQUIRED_EXTS.end()}))
+    return m_transfer_queue == m_compute_queue ? compute_timeline() : m_transfer_timeline;
+}
+
+Timeline &Device::present_timeline() noexcept
+{
+    if (m_present_queue == m_graphics_queue)
+    {
+        return m_graphics_timeline;
+    }
+
+    if (m_present_queue == m_compute_queue)
+    {
+        return compute_timeline();
+    }
+
+    return m_present_queue == m_transfer_queue ? transfer_timeline() : m_present_timeline;
+}
+
+MemoryAllocator &Device::allocator() noexcept
+{
+    return m_allocator;
+}
+
+PipelineCache &Device::pipeline_cache() noexcept
+{
+    return m_pipeline_cache;
+}
+
+int32_t Device::rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface) noexcept
+{
+    QueueFamilyIndices indices = find_queue_families(device, surface);
+    
+    // Headless devices only ever need a graphics queue
+    if (surface == VK_NULL_HANDLE ? !indices.graphics_family.has_value() : !indices.is_complete())
     {
         return 0;
     }
 
     if (surface != VK_NULL_HANDLE)
     {
+        if (!check_device_extension_support(device, {REQUIRED_EXTS.begin(), REQUIRED_EXTS.end()}))
+        {
+            return 0;
+        }
+
         SwapchainSupportDetails swapchain_support = query_swapchain_support(device, surface);
 
         if (swapchain_support.formats.empty() || swapchain_support.present_modes.empty())
@@ -232,10 +397,10 @@ bool Device::create_logical_device(VkSurfaceKHR surface) noexcept
     std::set<uint32_t> unique_queue_families;
 
     m_graphics_family = queue_families.graphics_family.value();
-    m_present_family = queue_families.present_family.value();
 
     if (surface != VK_NULL_HANDLE)
     {
+        m_present_family = queue_families.present_family.value();
         unique_queue_families = {queue_families.graphics_family.value(), queue_families.present_family.value()};
     }
     else 
@@ -243,12 +408,20 @@ bool Device::create_logical_device(VkSurfaceKHR surface) noexcept
         unique_queue_families = {queue_families.graphics_family.value()};
     }
 
+    // Without a separate family uploads share the graphics queue
+    m_transfer_family = queue_families.transfer_family.value_or(m_graphics_family);
+    unique_queue_families.insert(m_transfer_family);
+
+    // Same for async compute, it then runs in submission order on the graphics queue
+    m_compute_family = queue_families.compute_family.value_or(m_graphics_family);
+    unique_queue_families.insert(m_compute_family);
+
     queue_create_infos.reserve(unique_queue_families.size());
 
     float queue_priority = 1.0f;
     for (uint32_t queue_family : unique_queue_families)
     {
-        VkDeviceQueueCreateInfo queue_create_info;
+        VkDeviceQueueCreateInfo queue_create_info{};
         queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queue_create_info.queueFamilyIndex = queue_family;
         queue_create_info.queueCount = 1;
@@ -262,100 +435,248 @@ bool Device::create_logical_device(VkSurfaceKHR surface) noexcept
     physical_device_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     physical_device_features2.features = m_features;
 
-    void *p_next = nullptr;
-
     if (surface != VK_NULL_HANDLE)
     {
         enabled_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
 
     VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features{};
+    extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extended_dynamic_state2_features{};
+    extended_dynamic_state2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extended_dynamic_state3_features{};
+    extended_dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
 
-    if (is_device_extension_supported("VK_EXT_extended_dynamic_state"))
+    // The extensions only say the features may exist, each one is enabled only when supported
+    if (m_properties.apiVersion >= VK_API_VERSION_1_1)
     {
-        enabled_extensions.push_back("VK_EXT_extended_dynamic_state");
+        extended_dynamic_state_features.pNext = &extended_dynamic_state2_features;
+        extended_dynamic_state2_features.pNext = &extended_dynamic_state3_features;
+
+        VkPhysicalDeviceFeatures2 supported_features{};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext = &extended_dynamic_state_features;
 
-        extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
-        extended_dynamic_state_features.extendedDynamicState = VK_TRUE;
-        extended_dynamic_state_features.pNext = p_next;
+        vkGetPhysicalDeviceFeatures2(m_gpu, &supported_features);
 
-        p_next = &extended_dynamic_state_features;
+        extended_dynamic_state_features.pNext = nullptr;
+        extended_dynamic_state2_features.pNext = nullptr;
+        extended_dynamic_state3_features.pNext = nullptr;
     }
 
-    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extended_dynamic_state2_features{};
+    if (is_device_extension_supported("VK_EXT_extended_dynamic_state") && extended_dynamic_state_features.extendedDynamicState)
+    {
+        enabled_extensions.push_back("VK_EXT_extended_dynamic_state");
+
+        extended_dynamic_state_features.pNext = physical_device_features2.pNext;
+        physical_device_features2.pNext = &extended_dynamic_state_features;
+
+        m_dynamic_state.extended = true;
+    }
 
-    if (is_device_extension_supported("VK_EXT_extended_dynamic_state2"))
+    if (is_device_extension_supported("VK_EXT_extended_dynamic_state2") && extended_dynamic_state2_features.extendedDynamicState2)
     {
         enabled_extensions.push_back("VK_EXT_extended_dynamic_state2");
 
-        extended_dynamic_state2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
-        extended_dynamic_state2_features.extendedDynamicState2 = VK_TRUE;
-        extended_dynamic_state2_features.pNext = p_next;
+        // Logic op and patch control points are not used, only the base feature is enabled
+        extended_dynamic_state2_features.extendedDynamicState2LogicOp = VK_FALSE;
+        extended_dynamic_state2_features.extendedDynamicState2PatchControlPoints = VK_FALSE;
+        extended_dynamic_state2_features.pNext = physical_device_features2.pNext;
+        physical_device_features2.pNext = &extended_dynamic_state2_features;
 
-        p_next = &extended_dynamic_state2_features;
+        m_dynamic_state.extended2 = true;
     }
 
-    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extended_dynamic_state3_features{};
+    LOG_INFO("Device", m_dynamic_state.extended ? "Extended dynamic state enabled" : "Extended dynamic state not supported, raster state is baked into pipelines");
 
-    if (is_device_extension_supported("VK_EXT_extended_dynamic_state3"))
+    if (is_device_extension_supported("VK_EXT_extended_dynamic_state3") &&
+        (extended_dynamic_state3_features.extendedDynamicState3PolygonMode ||
+         extended_dynamic_state3_features.extendedDynamicState3DepthClampEnable))
     {
         enabled_extensions.push_back("VK_EXT_extended_dynamic_state3");
 
+        // Depth clip also needs VK_EXT_depth_clip_enable, which is not enabled
+        VkBool32 polygon_mode = extended_dynamic_state3_features.extendedDynamicState3PolygonMode;
+        VkBool32 depth_clamp = extended_dynamic_state3_features.extendedDynamicState3DepthClampEnable && m_features.depthClamp;
+
+        extended_dynamic_state3_features = {};
         extended_dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
-        extended_dynamic_state3_features.extendedDynamicState3PolygonMode = VK_TRUE;
-        extended_dynamic_state3_features.extendedDynamicState3DepthClampEnable = VK_TRUE;
-        extended_dynamic_state3_features.extendedDynamicState3DepthClipEnable = VK_TRUE;
+        extended_dynamic_state3_features.extendedDynamicState3PolygonMode = polygon_mode;
+        extended_dynamic_state3_features.extendedDynamicState3DepthClampEnable = depth_clamp;
         extended_dynamic_state3_features.pNext = physical_device_features2.pNext;
-
         physical_device_features2.pNext = &extended_dynamic_state3_features;
+
+        m_dynamic_state.polygon_mode = polygon_mode;
+        m_dynamic_state.depth_clamp = depth_clamp;
     }
-    
+
+    // Both are core in 1.3 without a feature bit
+    if (m_properties.apiVersion >= VK_API_VERSION_1_3)
+    {
+        m_dynamic_state.extended = true;
+        m_dynamic_state.extended2 = true;
+    }
+
+    // Descriptor indexing and buffer device address are core 1.2 and have to come
+    // through this struct, their extension structs may not be chained next to it
+    VkPhysicalDeviceVulkan12Features supported_vulkan12_features{};
+    supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan13Features supported_vulkan13_features{};
+    supported_vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    if (m_properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceFeatures2 supported_features{};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext = &supported_vulkan12_features;
+
+        if (m_properties.apiVersion >= VK_API_VERSION_1_3)
+        {
+            supported_vulkan12_features.pNext = &supported_vulkan13_features;
+        }
+
+        vkGetPhysicalDeviceFeatures2(m_gpu, &supported_features);
+
+        supported_vulkan12_features.pNext = nullptr;
+
+        m_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        m_vulkan12_features.bufferDeviceAddress = supported_vulkan12_features.bufferDeviceAddress;
+        m_vulkan12_features.timelineSemaphore = supported_vulkan12_features.timelineSemaphore;
+
+        // The bindless heap needs all of these, partial support is no use to it
+        if (supported_vulkan12_features.runtimeDescriptorArray &&
+            supported_vulkan12_features.descriptorBindingPartiallyBound &&
+            supported_vulkan12_features.descriptorBindingVariableDescriptorCount &&
+            supported_vulkan12_features.descriptorBindingUpdateUnusedWhilePending &&
+            supported_vulkan12_features.descriptorBindingSampledImageUpdateAfterBind &&
+            supported_vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind &&
+            supported_vulkan12_features.shaderSampledImageArrayNonUniformIndexing)
+        {
+            m_vulkan12_features.descriptorIndexing = supported_vulkan12_features.descriptorIndexing;
+            m_vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+            m_vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+            m_vulkan12_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            m_vulkan12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            m_vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            m_vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            m_vulkan12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            m_vulkan12_features.shaderStorageBufferArrayNonUniformIndexing = supported_vulkan12_features.shaderStorageBufferArrayNonUniformIndexing;
+
+            m_bindless = true;
+        }
+
+        // GPU driven draws take their count from a buffer and their object from the first instance
+        if (supported_vulkan12_features.drawIndirectCount && m_features.multiDrawIndirect && m_features.drawIndirectFirstInstance)
+        {
+            m_vulkan12_features.drawIndirectCount = VK_TRUE;
+            m_draw_indirect_count = true;
+        }
+
+        m_vulkan12_features.pNext = physical_device_features2.pNext;
+        physical_device_features2.pNext = &m_vulkan12_features;
+    }
+
+    // Every queue submit is synchronized through timelines, there is no fence fallback
+    if (!m_vulkan12_features.timelineSemaphore)
+    {
+        LOG_ERROR("Device", "Timeline semaphores are not supported, Vulkan 1.2 is required");
+        return false;
+    }
+
+    LOG_INFO("Device", m_bindless ? "Descriptor indexing enabled" : "Descriptor indexing not supported, bindless heap disabled");
+    LOG_INFO("Device", m_draw_indirect_count ? "Indirect draw count enabled" : "Indirect draw count not supported, GPU driven rendering disabled");
+
+    if (m_properties.apiVersion >= VK_API_VERSION_1_3)
+    {
+        m_vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+        // The dynamic rendering path does its layout transitions with synchronization2, one is no use without the other
+        if (supported_vulkan13_features.dynamicRendering && supported_vulkan13_features.synchronization2)
+        {
+            m_vulkan13_features.dynamicRendering = VK_TRUE;
+            m_vulkan13_features.synchronization2 = VK_TRUE;
+
+            m_dynamic_rendering = true;
+        }
+
+        m_vulkan13_features.pNext = physical_device_features2.pNext;
+        physical_device_features2.pNext = &m_vulkan13_features;
+    }
+
+    LOG_INFO("Device", m_dynamic_rendering ? "Dynamic rendering enabled" : "Dynamic rendering not supported, using render passes");
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    if (surface != VK_NULL_HANDLE &&
+        m_properties.apiVersion >= VK_API_VERSION_1_1 &&
+        is_device_extension_supported(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        is_device_extension_supported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        present_id_features.pNext = &present_wait_features;
+
+        VkPhysicalDeviceFeatures2 supported_features{};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext = &present_id_features;
+
+        vkGetPhysicalDeviceFeatures2(m_gpu, &supported_features);
+
+        // Present wait waits on present ids, neither is useful alone
+        if (present_id_features.presentId && present_wait_features.presentWait)
+        {
+            enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+            present_wait_features.pNext = physical_device_features2.pNext;
+            physical_device_features2.pNext = &present_id_features;
+
+            m_present_wait = true;
+        }
+    }
+
+    // Only a query, there are no features to enable
+    if (m_properties.apiVersion >= VK_API_VERSION_1_1 &&
+        is_device_extension_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        enabled_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        m_memory_budget = true;
+    }
+
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR ray_tracing_pipeline_features{};
     VkPhysicalDeviceAccelerationStructureFeaturesKHR acceleration_structure_features{};
-    VkPhysicalDeviceBufferDeviceAddressFeaturesKHR buffer_device_address_features{};
-    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features{};
-    VkPhysicalDeviceRayQueryFeaturesKHR ray_query_features;
+    VkPhysicalDeviceRayQueryFeaturesKHR ray_query_features{};
 
-    if (is_device_extension_supported(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) &&
+    if (m_vulkan12_features.bufferDeviceAddress &&
+        is_device_extension_supported(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) &&
         is_device_extension_supported(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) &&
-        is_device_extension_supported(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) &&
         is_device_extension_supported(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) &&
-        is_device_extension_supported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
         is_device_extension_supported(VK_KHR_RAY_QUERY_EXTENSION_NAME))
     {
         enabled_extensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
         enabled_extensions.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
-        enabled_extensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
         enabled_extensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
-        enabled_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
         enabled_extensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
 
         ray_tracing_pipeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+        ray_tracing_pipeline_features.rayTracingPipeline = VK_TRUE;
         ray_tracing_pipeline_features.pNext = physical_device_features2.pNext;
         physical_device_features2.pNext = &ray_tracing_pipeline_features;
 
         acceleration_structure_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
-        acceleration_structure_features.accelerationStructure = true;
+        acceleration_structure_features.accelerationStructure = VK_TRUE;
         acceleration_structure_features.pNext = physical_device_features2.pNext;
-        physical_device_features2.pNext = &ray_tracing_pipeline_features;
+        physical_device_features2.pNext = &acceleration_structure_features;
 
         ray_query_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
-        ray_query_features.rayQuery = true;
+        ray_query_features.rayQuery = VK_TRUE;
         ray_query_features.pNext = physical_device_features2.pNext;
-        physical_device_features2.pNext = &acceleration_structure_features;
-
-        buffer_device_address_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
-        buffer_device_address_features.bufferDeviceAddress = true;
-        buffer_device_address_features.pNext = physical_device_features2.pNext;
         physical_device_features2.pNext = &ray_query_features;
-
-        descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
-        descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = true;
-        descriptor_indexing_features.runtimeDescriptorArray = true;
-        descriptor_indexing_features.descriptorBindingVariableDescriptorCount = true;
-        descriptor_indexing_features.descriptorBindingPartiallyBound = true;
-        descriptor_indexing_features.pNext = physical_device_features2.pNext;
-        physical_device_features2.pNext = &descriptor_indexing_features;
     }
 
     VkDeviceCreateInfo create_info{};
@@ -387,6 +708,19 @@ bool Device::create_logical_device(VkSurfaceKHR surface) noexcept
 
     LOG_INFO("Device", "Device created");
 
+    if (m_present_wait)
+    {
+        m_wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+        m_present_wait = m_wait_for_present != nullptr;
+    }
+
+    LOG_INFO("Device", m_present_wait ? "Present wait enabled" : "Present wait not supported, low latency mode paces on GPU completion");
+    LOG_INFO("Device", m_memory_budget ? "Memory budget enabled" : "Memory budget not supported, budgets fall back to heap sizes");
+
+    // The rest of the chain was local to this function
+    m_vulkan12_features.pNext = nullptr;
+    m_vulkan13_features.pNext = nullptr;
+
     vkGetDeviceQueue(m_device, queue_families.graphics_family.value(), 0, &m_graphics_queue);
 
     if (surface != VK_NULL_HANDLE)
@@ -394,6 +728,78 @@ bool Device::create_logical_device(VkSurfaceKHR surface) noexcept
         vkGetDeviceQueue(m_device, queue_families.present_family.value(), 0, &m_present_queue);
     }
 
+    vkGetDeviceQueue(m_device, m_transfer_family, 0, &m_transfer_queue);
+
+    vkGetDeviceQueue(m_device, m_compute_family, 0, &m_compute_queue);
+
+    // Queues that turned out to be the same VkQueue share its timeline
+    if (!m_graphics_timeline.init(m_device, m_graphics_queue))
+    {
+        return false;
+    }
+
+    if (m_compute_queue != m_graphics_queue && !m_compute_timeline.init(m_device, m_compute_queue))
+    {
+        return false;
+    }
+
+    if (m_transfer_queue != m_graphics_queue && 
+        m_transfer_queue != m_compute_queue && 
+        !m_transfer_timeline.init(m_device, m_transfer_queue))
+    {
+        return false;
+    }
+
+    // Only ever presented on, it still needs the lock if the present family gets other work
+    if (m_present_queue != VK_NULL_HANDLE &&
+        m_present_queue != m_graphics_queue &&
+        m_present_queue != m_compute_queue &&
+        m_present_queue != m_transfer_queue &&
+        !m_present_timeline.init(m_device, m_present_queue))
+    {
+        return false;
+    }
+
+    LOG_INFO("Device", has_dedicated_transfer_queue() ? "Using a dedicated transfer queue" : "Uploads share the graphics queue");
+    LOG_INFO("Device", has_dedicated_compute_queue() ? "Using a dedicated compute queue" : "Async compute shares the graphics queue");
+
+    return true;
+}
+
+VkResult Device::wait_for_present(VkSwapchainKHR swapchain, uint64_t present_id, uint64_t timeout) const noexcept
+{
+    if (!m_present_wait)
+    {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    return m_wait_for_present(m_device, swapchain, present_id, timeout);
+}
+
+bool Device::memory_budget(MemoryBudget &budget) const noexcept
+{
+    if (!m_memory_budget)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+    budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget_properties;
+
+    vkGetPhysicalDeviceMemoryProperties2(m_gpu, &properties);
+
+    budget.heap_count = properties.memoryProperties.memoryHeapCount;
+
+    for (uint32_t i = 0; i < budget.heap_count; ++i)
+    {
+        budget.budget[i] = budget_properties.heapBudget[i];
+        budget.usage[i] = budget_properties.heapUsage[i];
+    }
+
     return true;
 }
 
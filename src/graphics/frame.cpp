@@ -6,7 +6,7 @@ namespace niqqa
 {
 namespace graphics
 {
-bool Frame::init(VkDevice device, uint32_t queue_family_index) noexcept
+bool Frame::init(VkDevice device, uint32_t queue_family_index, uint32_t thread_count) noexcept
 {
     if (!command_pool.init(device, 
                            queue_family_index,
@@ -17,13 +17,20 @@ bool Frame::init(VkDevice device, uint32_t queue_family_index) noexcept
 
     command_buffer = command_pool.allocate_primary();
 
+    thread_commands.resize(thread_count);
+
+    for (auto &commands : thread_commands)
+    {
+        if (!commands.command_pool.init(device, queue_family_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT))
+        {
+            destroy(device);
+            return false;
+        }
+    }
+
     VkSemaphoreCreateInfo semaphore_info{};
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fence_info{};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     if (vkCreateSemaphore(device, &semaphore_info, nullptr, &acquire_semaphore) != VK_SUCCESS)
     {
         LOG_ERROR("Frame", "Failed to create acquire semaphore");
@@ -31,52 +38,43 @@ bool Frame::init(VkDevice device, uint32_t queue_family_index) noexcept
 
         return false;
     }
-    
-    if (vkCreateSemaphore(device, &semaphore_info, nullptr, &present_semaphore) != VK_SUCCESS)
-    {
-        LOG_ERROR("Frame", "Failed to create present semaphore");
-        destroy(device);
-        
-        return false;
-    }
-
-    if (vkCreateFence(device, &fence_info, nullptr, &frame_fence) != VK_SUCCESS)
-    {
-        LOG_ERROR("Frame", "Failed to create frame fence");
-        destroy(device);
-
-        return false;
-    }
 
     return true;
 }
 
 void Frame::destroy(VkDevice device) noexcept
 {
-    if (frame_fence != VK_NULL_HANDLE)
-    {
-        vkDestroyFence(device, frame_fence, nullptr);
-    }
-
     if (acquire_semaphore != VK_NULL_HANDLE)
     {
         vkDestroySemaphore(device, acquire_semaphore, nullptr);
     }
 
-    if (present_semaphore != VK_NULL_HANDLE)
+    queries.destroy(device);
+
+    for (auto &commands : thread_commands)
     {
-        vkDestroySemaphore(device, present_semaphore, nullptr);
+        commands.command_pool.cleanup();
     }
 
+    thread_commands.clear();
+
     command_pool.cleanup();
 }
 
-void Frame::wait_and_reset(VkDevice device) noexcept
+void Frame::wait() const noexcept
 {
-    vkWaitForFences(device, 1, &frame_fence, VK_TRUE, UINT64_MAX);
-    vkResetFences(device, 1, &frame_fence);
+    sync.wait();
+}
 
+void Frame::reset() noexcept
+{
     command_pool.reset();
+
+    for (auto &commands : thread_commands)
+    {
+        commands.command_pool.reset();
+        commands.used_secondary_buffers = 0;
+    }
 }
 
 void Frame::begin_commands() noexcept
@@ -92,5 +90,17 @@ void Frame::end_commands() noexcept
 {
     vkEndCommandBuffer(command_buffer);
 }
+
+VkCommandBuffer Frame::acquire_secondary(uint32_t thread_index) noexcept
+{
+    ThreadCommands &commands = thread_commands[thread_index];
+
+    if (commands.used_secondary_buffers == commands.secondary_buffers.size())
+    {
+        commands.secondary_buffers.push_back(commands.command_pool.allocate_secondary());
+    }
+
+    return commands.secondary_buffers[commands.used_secondary_buffers++];
+}
 } // namespace graphics
 } // namespace niqqa
\ No newline at end of file
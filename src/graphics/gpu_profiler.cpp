@@ -0,0 +1,385 @@
+#include <graphics/gpu_profiler.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace niqqa
+{
+namespace graphics
+{
+bool FrameQueries::init(Device &device, uint32_t max_passes) noexcept
+{
+    m_max_passes = max_passes;
+    m_timestamp_period = static_cast<double>(device.properties().limits.timestampPeriod);
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device.gpu(), &queue_family_count, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device.gpu(), &queue_family_count, queue_families.data());
+
+    uint32_t valid_bits = queue_families[device.graphics_queue_family()].timestampValidBits;
+
+    if (valid_bits == 0)
+    {
+        LOG_WARN("GPU Profiler", "Graphics queue does not support timestamps, profiling disabled");
+        return true;
+    }
+
+    m_timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo timestamp_info{};
+    timestamp_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    timestamp_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    timestamp_info.queryCount = max_passes * 2;
+
+    if (vkCreateQueryPool(device.device(), &timestamp_info, nullptr, &m_timestamp_pool) != VK_SUCCESS)
+    {
+        LOG_ERROR("GPU Profiler", "Failed to create timestamp query pool");
+        return false;
+    }
+
+    if (device.features().pipelineStatisticsQuery)
+    {
+        VkQueryPoolCreateInfo statistics_info{};
+        statistics_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        statistics_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        statistics_info.queryCount = max_passes;
+        statistics_info.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+
+        if (vkCreateQueryPool(device.device(), &statistics_info, nullptr, &m_statistics_pool) != VK_SUCCESS)
+        {
+            LOG_ERROR("GPU Profiler", "Failed to create pipeline statistics query pool");
+            return false;
+        }
+    }
+
+    m_pass_names.resize(max_passes);
+    m_pass_depths.resize(max_passes);
+    m_pass_statistics.resize(max_passes);
+    m_timestamp_results.resize(max_passes * 2);
+    m_statistics_results.resize(PIPELINE_STATISTIC_COUNT);
+
+    return true;
+}
+
+void FrameQueries::destroy(VkDevice device) noexcept
+{
+    if (m_timestamp_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, m_timestamp_pool, nullptr);
+        m_timestamp_pool = VK_NULL_HANDLE;
+    }
+
+    if (m_statistics_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, m_statistics_pool, nullptr);
+        m_statistics_pool = VK_NULL_HANDLE;
+    }
+}
+
+void FrameQueries::reset(VkCommandBuffer command_buffer, uint64_t frame_number) noexcept
+{
+    if (m_timestamp_pool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkCmdResetQueryPool(command_buffer, m_timestamp_pool, 0, m_max_passes * 2);
+
+    if (m_statistics_pool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(command_buffer, m_statistics_pool, 0, m_max_passes);
+    }
+
+    m_frame_number = frame_number;
+    m_pass_count = 0;
+    m_depth = 0;
+    m_statistics_pass = INVALID_PASS;
+    m_pending = true;
+}
+
+uint32_t FrameQueries::begin_pass(VkCommandBuffer command_buffer, const char *name) noexcept
+{
+    if (m_timestamp_pool == VK_NULL_HANDLE || m_pass_count == m_max_passes)
+    {
+        return INVALID_PASS;
+    }
+
+    uint32_t pass_index = m_pass_count++;
+
+    m_pass_names[pass_index] = name;
+    m_pass_depths[pass_index] = m_depth++;
+    m_pass_statistics[pass_index] = false;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestamp_pool, pass_index * 2);
+
+    // Only one statistics query can be active at a time, so nested passes just get timestamps
+    if (m_statistics_pool != VK_NULL_HANDLE && m_statistics_pass == INVALID_PASS)
+    {
+        vkCmdBeginQuery(command_buffer, m_statistics_pool, pass_index, 0);
+
+        m_statistics_pass = pass_index;
+        m_pass_statistics[pass_index] = true;
+    }
+
+    return pass_index;
+}
+
+void FrameQueries::end_pass(VkCommandBuffer command_buffer, uint32_t pass_index) noexcept
+{
+    if (pass_index == INVALID_PASS)
+    {
+        return;
+    }
+
+    --m_depth;
+
+    if (m_statistics_pass == pass_index)
+    {
+        vkCmdEndQuery(command_buffer, m_statistics_pool, pass_index);
+        m_statistics_pass = INVALID_PASS;
+    }
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestamp_pool, pass_index * 2 + 1);
+}
+
+bool FrameQueries::collect(VkDevice device, FrameTimings &timings) noexcept
+{
+    if (!m_pending || m_pass_count == 0)
+    {
+        return false;
+    }
+
+    m_pending = false;
+
+    // No WAIT bit: the frame's timeline value has already been reached, anything else means the queries are lost
+    if (vkGetQueryPoolResults(device,
+                              m_timestamp_pool,
+                              0,
+                              m_pass_count * 2,
+                              m_pass_count * 2 * sizeof(uint64_t),
+                              m_timestamp_results.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    double ticks_to_ms = m_timestamp_period / 1000000.0;
+    uint64_t frame_begin = m_timestamp_results[0] & m_timestamp_mask;
+
+    timings.frame_number = m_frame_number;
+    timings.gpu_begin_ms = static_cast<double>(frame_begin) * ticks_to_ms;
+    timings.passes.resize(m_pass_count);
+
+    for (uint32_t i = 0; i < m_pass_count; ++i)
+    {
+        uint64_t begin = m_timestamp_results[i * 2] & m_timestamp_mask;
+        uint64_t end = m_timestamp_results[i * 2 + 1] & m_timestamp_mask;
+
+        PassTiming &pass = timings.passes[i];
+        pass.name = m_pass_names[i];
+        pass.depth = m_pass_depths[i];
+        pass.begin_ms = static_cast<double>(begin - frame_begin) * ticks_to_ms;
+        pass.gpu_ms = static_cast<double>(end - begin) * ticks_to_ms;
+        pass.has_statistics = false;
+
+        if (!m_pass_statistics[i])
+        {
+            continue;
+        }
+
+        if (vkGetQueryPoolResults(device,
+                                  m_statistics_pool,
+                                  i,
+                                  1,
+                                  PIPELINE_STATISTIC_COUNT * sizeof(uint64_t),
+                                  m_statistics_results.data(),
+                                  PIPELINE_STATISTIC_COUNT * sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            pass.has_statistics = true;
+            std::copy(m_statistics_results.begin(), m_statistics_results.end(), pass.statistics.begin());
+        }
+    }
+
+    return true;
+}
+
+VkQueryPipelineStatisticFlags FrameQueries::active_statistics() const noexcept
+{
+    return m_statistics_pass != INVALID_PASS ? PIPELINE_STATISTIC_FLAGS : 0;
+}
+
+GpuScope::GpuScope(FrameQueries &queries, VkCommandBuffer command_buffer, const char *name) noexcept
+    : m_queries(queries),
+      m_command_buffer(command_buffer),
+      m_pass_index(queries.begin_pass(command_buffer, name))
+{
+}
+
+GpuScope::~GpuScope() noexcept
+{
+    m_queries.end_pass(m_command_buffer, m_pass_index);
+}
+
+void GpuProfiler::submit(FrameTimings &&timings) noexcept
+{
+    if (m_capture && m_captured.size() < MAX_CAPTURED_FRAMES)
+    {
+        m_captured.push_back(timings);
+    }
+
+    m_history.push_back(timings);
+
+    if (m_history.size() > HISTORY_SIZE)
+    {
+        m_history.pop_front();
+    }
+
+    m_latest = std::move(timings);
+}
+
+const FrameTimings &GpuProfiler::latest() const noexcept
+{
+    return m_latest;
+}
+
+double GpuProfiler::average_pass_ms(const std::string &name) const noexcept
+{
+    double total = 0.0;
+    uint32_t count = 0;
+
+    for (const auto &frame : m_history)
+    {
+        for (const auto &pass : frame.passes)
+        {
+            if (pass.name == name)
+            {
+                total += pass.gpu_ms;
+                ++count;
+            }
+        }
+    }
+
+    return count > 0 ? total / count : 0.0;
+}
+
+void GpuProfiler::set_capture(bool capture) noexcept
+{
+    m_capture = capture;
+
+    if (capture)
+    {
+        m_captured.clear();
+    }
+}
+
+// Quotes, backslashes and control characters in a pass name would break the JSON string
+static void write_json_string(std::ofstream &file, const std::string &text) noexcept
+{
+    file << '"';
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            file << "\\\"";
+            break;
+        case '\\':
+            file << "\\\\";
+            break;
+        case '\n':
+            file << "\\n";
+            break;
+        case '\r':
+            file << "\\r";
+            break;
+        case '\t':
+            file << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned int>(c));
+                file << buffer;
+            }
+            else
+            {
+                file << c;
+            }
+            break;
+        }
+    }
+
+    file << '"';
+}
+
+bool GpuProfiler::write_chrome_trace(const std::string &path) const noexcept
+{
+    std::ofstream file(path, std::ios::trunc);
+
+    if (!file)
+    {
+        LOG_ERROR("GPU Profiler", "Failed to open " + path);
+        return false;
+    }
+
+    double base_ms = m_captured.empty() ? 0.0 : m_captured.front().gpu_begin_ms;
+
+    file << "{\"traceEvents\":[";
+
+    bool first = true;
+    char buffer[128];
+
+    for (const auto &frame : m_captured)
+    {
+        for (const auto &pass : frame.passes)
+        {
+            double ts_us = (frame.gpu_begin_ms + pass.begin_ms - base_ms) * 1000.0;
+            double dur_us = pass.gpu_ms * 1000.0;
+
+            file << (first ? "\n" : ",\n");
+            first = false;
+
+            file << "{\"name\":";
+            write_json_string(file, pass.name);
+            file << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0";
+
+            std::snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f", ts_us, dur_us);
+            file << buffer;
+
+            file << ",\"args\":{\"frame\":" << frame.frame_number;
+
+            if (pass.has_statistics)
+            {
+                for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; ++i)
+                {
+                    file << ",\"" << PIPELINE_STATISTIC_NAMES[i] << "\":" << pass.statistics[i];
+                }
+            }
+
+            file << "}}";
+        }
+    }
+
+    file << "\n]}\n";
+
+    if (!file)
+    {
+        LOG_ERROR("GPU Profiler", "Failed to write " + path);
+        return false;
+    }
+
+    LOG_INFO("GPU Profiler", "Wrote chrome trace to " + path);
+
+    return true;
+}
+} // namespace graphics
+} // namespace niqqa
@@ -0,0 +1,664 @@
+#include <graphics/gpu_scene.hpp>
+
+#include <math/bounds.hpp>
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+// Matches the push constant block of shaders/gpu_driven/cull.comp
+struct CullConstants
+{
+    uint32_t view;
+    uint32_t objects;
+    uint32_t meshes;
+    uint32_t batches;
+    uint32_t commands;
+    uint32_t counts;
+    uint32_t object_count;
+    uint32_t mesh_count;
+    uint32_t batch_count;
+};
+
+static_assert(sizeof(GpuObject) == 80, "GpuObject has to match Object in scene.glsl");
+static_assert(sizeof(GpuMesh) == 80, "GpuMesh has to match Mesh in scene.glsl");
+static_assert(sizeof(CullConstants) <= BindlessHeap::PUSH_CONSTANT_SIZE, "Cull constants do not fit the push constant range");
+
+// Previous frames' cull and draws may still read what this frame's update writes
+static constexpr VkPipelineStageFlags2 SCENE_READ_STAGES = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+                                                           VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                                           VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+
+// Sorted dirty indices become one copy per run of consecutive indices
+template <typename T>
+static uint32_t stage_dirty(std::vector<uint32_t> &dirty,
+                            std::vector<bool> &dirty_flags,
+                            const std::vector<T> &data,
+                            uint8_t *staging,
+                            VkDeviceSize staging_offset,
+                            VkDeviceSize &used,
+                            VkDeviceSize capacity,
+                            std::vector<VkBufferCopy> &copies) noexcept
+{
+    std::sort(dirty.begin(), dirty.end());
+
+    size_t staged = 0;
+
+    for (; staged < dirty.size() && used + sizeof(T) <= capacity; ++staged)
+    {
+        uint32_t index = dirty[staged];
+
+        std::memcpy(staging + used, &data[index], sizeof(T));
+
+        VkDeviceSize dst_offset = static_cast<VkDeviceSize>(index) * sizeof(T);
+
+        if (!copies.empty() &&
+            copies.back().dstOffset + copies.back().size == dst_offset &&
+            copies.back().srcOffset + copies.back().size == staging_offset + used)
+        {
+            copies.back().size += sizeof(T);
+        }
+        else
+        {
+            copies.push_back({staging_offset + used, dst_offset, sizeof(T)});
+        }
+
+        dirty_flags[index] = false;
+        used += sizeof(T);
+    }
+
+    // What did not fit goes next frame. Everything below the first index left over is resident.
+    uint32_t first_left = staged < dirty.size() ? dirty[staged] : static_cast<uint32_t>(data.size());
+    dirty.erase(dirty.begin(), dirty.begin() + static_cast<std::ptrdiff_t>(staged));
+
+    return first_left;
+}
+
+bool GpuScene::init(Device &device,
+                    BindlessHeap &bindless,
+                    ShaderManager &shaders,
+                    uint32_t frame_count,
+                    const GpuSceneLimits &limits) noexcept
+{
+    m_device = &device;
+    m_bindless = &bindless;
+    m_shaders = &shaders;
+    m_limits = limits;
+    m_limits.max_updates_per_frame = std::max(m_limits.max_updates_per_frame, 1u);
+
+    if (!bindless.is_enabled() || !device.supports_draw_indirect_count())
+    {
+        LOG_WARN("GPU Scene", "Needs the bindless heap and indirect draw counts, GPU driven rendering disabled");
+        return false;
+    }
+
+    constexpr VkMemoryPropertyFlags device_local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    constexpr VkBufferUsageFlags scene_data = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    bool created = create_buffer(m_objects, sizeof(GpuObject) * m_limits.max_objects, scene_data, device_local) &&
+                   create_buffer(m_meshes, sizeof(GpuMesh) * m_limits.max_meshes, scene_data, device_local) &&
+                   create_buffer(m_batches_buffer, sizeof(GpuBatch) * m_limits.max_batches, scene_data, device_local) &&
+                   create_buffer(m_view_buffer, sizeof(GpuView), scene_data, device_local) &&
+                   create_buffer(m_commands,
+                                 sizeof(VkDrawIndexedIndirectCommand) * m_limits.max_objects,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                 device_local) &&
+                   create_buffer(m_counts,
+                                 sizeof(uint32_t) * m_limits.max_batches,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 device_local);
+
+    // The batch table always fits next to the updates, it moves whenever an object is added
+    m_staging_slice = sizeof(GpuObject) * m_limits.max_updates_per_frame + sizeof(GpuBatch) * m_limits.max_batches;
+
+    created = created && create_buffer(m_staging,
+                                       m_staging_slice * frame_count,
+                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (!created)
+    {
+        return false;
+    }
+
+    ShaderDesc cull_desc;
+    cull_desc.path = "gpu_driven/cull.comp";
+    cull_desc.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    m_cull_shader = shaders.load(cull_desc);
+
+    if (m_cull_shader == ShaderManager::INVALID_HANDLE || !create_cull_pipeline(shaders.module(m_cull_shader)))
+    {
+        LOG_ERROR("GPU Scene", "Failed to create the cull pipeline");
+        return false;
+    }
+
+    m_cull_reload = shaders.on_reload(m_cull_shader, [this](ShaderHandle, VkShaderModule module, VkShaderModule) {
+        create_cull_pipeline(module);
+    });
+
+    m_object_data.reserve(m_limits.max_objects);
+    m_object_dirty.reserve(m_limits.max_objects);
+
+    LOG_INFO("GPU Scene", "GPU driven rendering enabled for up to " + std::to_string(m_limits.max_objects) + " objects");
+
+    return true;
+}
+
+void GpuScene::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    // A reload after this would rebuild the pipeline on a scene that is gone
+    if (m_cull_reload != ShaderManager::INVALID_CALLBACK)
+    {
+        m_shaders->remove_reload_callback(m_cull_shader, m_cull_reload);
+        m_cull_reload = ShaderManager::INVALID_CALLBACK;
+    }
+
+    for (const auto &retired : m_retired)
+    {
+        vkDestroyPipeline(m_device->device(), retired.pipeline, nullptr);
+    }
+
+    m_retired.clear();
+
+    if (m_cull_pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(m_device->device(), m_cull_pipeline, nullptr);
+        m_cull_pipeline = VK_NULL_HANDLE;
+    }
+
+    destroy_buffer(m_objects);
+    destroy_buffer(m_meshes);
+    destroy_buffer(m_batches_buffer);
+    destroy_buffer(m_view_buffer);
+    destroy_buffer(m_commands);
+    destroy_buffer(m_counts);
+    destroy_buffer(m_staging);
+
+    m_object_data.clear();
+    m_mesh_data.clear();
+    m_batches.clear();
+    m_dirty_objects.clear();
+    m_dirty_meshes.clear();
+    m_object_dirty.clear();
+    m_mesh_dirty.clear();
+    m_resident_objects = 0;
+    m_resident_meshes = 0;
+    m_uploaded_batches = 0;
+
+    m_device = nullptr;
+}
+
+uint32_t GpuScene::add_mesh(const GpuMesh &mesh) noexcept
+{
+    if (m_mesh_data.size() >= m_limits.max_meshes)
+    {
+        LOG_WARN("GPU Scene", "Mesh limit reached");
+        return INVALID_INDEX;
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_mesh_data.size());
+
+    m_mesh_data.push_back(mesh);
+    m_mesh_dirty.push_back(true);
+    m_dirty_meshes.push_back(index);
+
+    return index;
+}
+
+uint32_t GpuScene::add_batch(const GraphicsPipeline &pipeline) noexcept
+{
+    if (m_batches.size() >= m_limits.max_batches)
+    {
+        LOG_WARN("GPU Scene", "Batch limit reached");
+        return INVALID_INDEX;
+    }
+
+    Batch batch;
+    batch.pipeline = pipeline;
+    m_batches.push_back(batch);
+    m_batches_dirty = true;
+
+    return static_cast<uint32_t>(m_batches.size() - 1);
+}
+
+uint32_t GpuScene::add_object(const GpuObject &object) noexcept
+{
+    if (m_object_data.size() >= m_limits.max_objects)
+    {
+        LOG_WARN("GPU Scene", "Object limit reached");
+        return INVALID_INDEX;
+    }
+
+    if (object.batch >= m_batches.size())
+    {
+        LOG_ERROR("GPU Scene", "Object refers to batch " + std::to_string(object.batch) + " which does not exist");
+        return INVALID_INDEX;
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_object_data.size());
+
+    m_object_data.push_back(object);
+    m_object_dirty.push_back(true);
+    m_dirty_objects.push_back(index);
+
+    ++m_batches[object.batch].object_count;
+    m_batches_dirty = true;
+
+    return index;
+}
+
+void GpuScene::update_mesh(uint32_t index, const GpuMesh &mesh) noexcept
+{
+    if (index >= m_mesh_data.size())
+    {
+        return;
+    }
+
+    m_mesh_data[index] = mesh;
+
+    if (!m_mesh_dirty[index])
+    {
+        m_mesh_dirty[index] = true;
+        m_dirty_meshes.push_back(index);
+    }
+}
+
+void GpuScene::update_object(uint32_t index, const GpuObject &object) noexcept
+{
+    if (index >= m_object_data.size() || object.batch >= m_batches.size())
+    {
+        return;
+    }
+
+    uint32_t old_batch = m_object_data[index].batch;
+
+    if (old_batch != object.batch)
+    {
+        --m_batches[old_batch].object_count;
+        ++m_batches[object.batch].object_count;
+        m_batches_dirty = true;
+    }
+
+    m_object_data[index] = object;
+
+    if (!m_object_dirty[index])
+    {
+        m_object_dirty[index] = true;
+        m_dirty_objects.push_back(index);
+    }
+}
+
+void GpuScene::update_batch(uint32_t index, const GraphicsPipeline &pipeline) noexcept
+{
+    if (index < m_batches.size())
+    {
+        m_batches[index].pipeline = pipeline;
+    }
+}
+
+void GpuScene::set_geometry(VkBuffer index_buffer, VkIndexType index_type, VkBuffer vertex_buffer) noexcept
+{
+    m_index_buffer = index_buffer;
+    m_index_type = index_type;
+    m_vertex_buffer = vertex_buffer;
+}
+
+void GpuScene::set_view(const std::array<float, 16> &view_projection,
+                        const std::array<float, 3> &camera_position,
+                        float lod_scale) noexcept
+{
+    math::mat4 matrix;
+
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        matrix.columns[c] = {view_projection[c * 4], view_projection[c * 4 + 1], view_projection[c * 4 + 2], view_projection[c * 4 + 3]};
+    }
+
+    math::Frustum frustum = math::extract_frustum(matrix);
+
+    for (uint32_t p = 0; p < frustum.planes.size(); ++p)
+    {
+        const math::Plane &plane = frustum.planes[p];
+
+        m_view.planes[p * 4 + 0] = plane.normal.x;
+        m_view.planes[p * 4 + 1] = plane.normal.y;
+        m_view.planes[p * 4 + 2] = plane.normal.z;
+        m_view.planes[p * 4 + 3] = plane.distance;
+    }
+
+    m_view.camera = {camera_position[0], camera_position[1], camera_position[2], lod_scale};
+}
+
+void GpuScene::add_passes(RenderGraph &graph, uint32_t frame_index) noexcept
+{
+    ImportedState in_use;
+    in_use.stages = SCENE_READ_STAGES;
+
+    m_objects.graph = graph.import_buffer("scene_objects", m_objects.buffer, 0, VK_WHOLE_SIZE, in_use);
+    m_meshes.graph = graph.import_buffer("scene_meshes", m_meshes.buffer, 0, VK_WHOLE_SIZE, in_use);
+    m_batches_buffer.graph = graph.import_buffer("scene_batches", m_batches_buffer.buffer, 0, VK_WHOLE_SIZE, in_use);
+    m_view_buffer.graph = graph.import_buffer("scene_view", m_view_buffer.buffer, 0, VK_WHOLE_SIZE, in_use);
+    m_commands.graph = graph.import_buffer("scene_commands", m_commands.buffer, 0, VK_WHOLE_SIZE, in_use);
+    m_counts.graph = graph.import_buffer("scene_counts", m_counts.buffer, 0, VK_WHOLE_SIZE, in_use);
+
+    graph.add_pass("scene_update", RenderGraphPassType::Transfer)
+        .write(m_objects.graph, BufferUse::TransferDst)
+        .write(m_meshes.graph, BufferUse::TransferDst)
+        .write(m_batches_buffer.graph, BufferUse::TransferDst)
+        .write(m_view_buffer.graph, BufferUse::TransferDst)
+        .write(m_counts.graph, BufferUse::TransferDst)
+        .execute([this, frame_index](VkCommandBuffer command_buffer, const RenderGraph &) {
+            record_update(command_buffer, frame_index);
+        });
+
+    graph.add_pass("cull", RenderGraphPassType::Compute)
+        .read(m_objects.graph, BufferUse::Storage)
+        .read(m_meshes.graph, BufferUse::Storage)
+        .read(m_batches_buffer.graph, BufferUse::Storage)
+        .read(m_view_buffer.graph, BufferUse::Storage)
+        .write(m_commands.graph, BufferUse::Storage)
+        .write(m_counts.graph, BufferUse::Storage)
+        .execute([this](VkCommandBuffer command_buffer, const RenderGraph &) {
+            record_dispatch(command_buffer);
+        });
+}
+
+void GpuScene::read_draws(RenderGraphPass &pass) const noexcept
+{
+    pass.read(m_commands.graph, BufferUse::Indirect)
+        .read(m_counts.graph, BufferUse::Indirect)
+        .read(m_objects.graph, BufferUse::Storage, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+}
+
+void GpuScene::record_cull(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept
+{
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         0, nullptr);
+
+    record_update(command_buffer, frame_index);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+
+    record_dispatch(command_buffer);
+
+    // Objects are read by the draws' vertex shaders too, straight from the update
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
+void GpuScene::draw(VkCommandBuffer command_buffer, const PipelineBuilder &pipelines) const noexcept
+{
+    if (m_index_buffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if (m_vertex_buffer != VK_NULL_HANDLE)
+    {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_vertex_buffer, &offset);
+    }
+
+    vkCmdBindIndexBuffer(command_buffer, m_index_buffer, 0, m_index_type);
+
+    for (uint32_t i = 0; i < m_uploaded_batches; ++i)
+    {
+        const Batch &batch = m_batches[i];
+
+        if (batch.capacity == 0 || batch.pipeline.pipeline == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        pipelines.bind(command_buffer, batch.pipeline);
+
+        vkCmdPushConstants(command_buffer,
+                           batch.pipeline.layout,
+                           VK_SHADER_STAGE_ALL,
+                           0,
+                           sizeof(uint32_t),
+                           &m_objects.bindless_index);
+
+        vkCmdDrawIndexedIndirectCount(command_buffer,
+                                      m_commands.buffer,
+                                      batch.first_command * sizeof(VkDrawIndexedIndirectCommand),
+                                      m_counts.buffer,
+                                      i * sizeof(uint32_t),
+                                      batch.capacity,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+uint32_t GpuScene::object_count() const noexcept
+{
+    return static_cast<uint32_t>(m_object_data.size());
+}
+
+uint32_t GpuScene::object_buffer_index() const noexcept
+{
+    return m_objects.bindless_index;
+}
+
+bool GpuScene::create_buffer(SceneBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) noexcept
+{
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device->device(), &buffer_info, nullptr, &buffer.buffer) != VK_SUCCESS)
+    {
+        LOG_ERROR("GPU Scene", "Failed to create buffer");
+        return false;
+    }
+
+    if (!m_device->allocator().allocate_buffer(buffer.buffer, properties, buffer.allocation))
+    {
+        LOG_ERROR("GPU Scene", "Failed to allocate buffer memory");
+        return false;
+    }
+
+    buffer.size = size;
+
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    {
+        buffer.bindless_index = m_bindless->add_buffer(buffer.buffer);
+
+        if (buffer.bindless_index == BindlessHeap::INVALID_INDEX)
+        {
+            LOG_ERROR("GPU Scene", "Bindless heap is out of buffer slots");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GpuScene::destroy_buffer(SceneBuffer &buffer) noexcept
+{
+    if (buffer.bindless_index != BindlessHeap::INVALID_INDEX)
+    {
+        m_bindless->remove(BindlessType::Buffer, buffer.bindless_index);
+    }
+
+    if (buffer.buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device->device(), buffer.buffer, nullptr);
+    }
+
+    if (buffer.allocation.is_valid())
+    {
+        m_device->allocator().free(buffer.allocation);
+    }
+
+    buffer = {};
+}
+
+bool GpuScene::create_cull_pipeline(VkShaderModule module) noexcept
+{
+    VkComputePipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_info.stage.module = module;
+    create_info.stage.pName = m_shaders->desc(m_cull_shader).entry_point.c_str();
+    create_info.layout = m_bindless->pipeline_layout();
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (m_device->pipeline_cache().create_compute_pipeline(create_info, pipeline) != VK_SUCCESS)
+    {
+        LOG_ERROR("GPU Scene", "Failed to create cull pipeline");
+        return false;
+    }
+
+    // Frames already submitted may still cull with the old one
+    if (m_cull_pipeline != VK_NULL_HANDLE)
+    {
+        m_retired.push_back({m_cull_pipeline, m_device->graphics_timeline().last_submitted()});
+    }
+
+    m_cull_pipeline = pipeline;
+
+    return true;
+}
+
+void GpuScene::collect_retired() noexcept
+{
+    auto done = std::remove_if(m_retired.begin(), m_retired.end(), [&](const RetiredPipeline &retired) {
+        if (!retired.in_use.is_complete())
+        {
+            return false;
+        }
+
+        vkDestroyPipeline(m_device->device(), retired.pipeline, nullptr);
+        return true;
+    });
+
+    m_retired.erase(done, m_retired.end());
+}
+
+void GpuScene::record_update(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept
+{
+    collect_retired();
+
+    // The renderer waited for the frame that last used this slice
+    VkDeviceSize staging_offset = m_staging_slice * frame_index;
+    uint8_t *staging = static_cast<uint8_t *>(m_staging.allocation.mapped) + staging_offset;
+    VkDeviceSize used = 0;
+
+    if (m_batches_dirty)
+    {
+        uint32_t first_command = 0;
+
+        for (auto &batch : m_batches)
+        {
+            batch.first_command = first_command;
+            batch.capacity = batch.object_count;
+            first_command += batch.object_count;
+
+            GpuBatch gpu_batch{batch.first_command, batch.capacity};
+            std::memcpy(staging + used, &gpu_batch, sizeof(GpuBatch));
+            used += sizeof(GpuBatch);
+        }
+
+        if (used > 0)
+        {
+            VkBufferCopy copy{staging_offset, 0, used};
+            vkCmdCopyBuffer(command_buffer, m_staging.buffer, m_batches_buffer.buffer, 1, &copy);
+        }
+
+        m_uploaded_batches = static_cast<uint32_t>(m_batches.size());
+        m_batches_dirty = false;
+    }
+
+    std::vector<VkBufferCopy> copies;
+
+    uint32_t first_left = stage_dirty(m_dirty_meshes, m_mesh_dirty, m_mesh_data, staging, staging_offset, used, m_staging_slice, copies);
+    m_resident_meshes = std::max(m_resident_meshes, first_left);
+
+    if (!copies.empty())
+    {
+        vkCmdCopyBuffer(command_buffer, m_staging.buffer, m_meshes.buffer, static_cast<uint32_t>(copies.size()), copies.data());
+        copies.clear();
+    }
+
+    first_left = stage_dirty(m_dirty_objects, m_object_dirty, m_object_data, staging, staging_offset, used, m_staging_slice, copies);
+    m_resident_objects = std::max(m_resident_objects, first_left);
+
+    if (!copies.empty())
+    {
+        vkCmdCopyBuffer(command_buffer, m_staging.buffer, m_objects.buffer, static_cast<uint32_t>(copies.size()), copies.data());
+    }
+
+    vkCmdUpdateBuffer(command_buffer, m_view_buffer.buffer, 0, sizeof(GpuView), &m_view);
+
+    if (m_uploaded_batches > 0)
+    {
+        vkCmdFillBuffer(command_buffer, m_counts.buffer, 0, sizeof(uint32_t) * m_uploaded_batches, 0);
+    }
+}
+
+void GpuScene::record_dispatch(VkCommandBuffer command_buffer) const noexcept
+{
+    if (m_cull_pipeline == VK_NULL_HANDLE || m_resident_objects == 0)
+    {
+        return;
+    }
+
+    CullConstants constants{};
+    constants.view = m_view_buffer.bindless_index;
+    constants.objects = m_objects.bindless_index;
+    constants.meshes = m_meshes.bindless_index;
+    constants.batches = m_batches_buffer.bindless_index;
+    constants.commands = m_commands.bindless_index;
+    constants.counts = m_counts.bindless_index;
+    constants.object_count = m_resident_objects;
+    constants.mesh_count = m_resident_meshes;
+    constants.batch_count = m_uploaded_batches;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+    m_bindless->bind(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+    vkCmdPushConstants(command_buffer, m_bindless->pipeline_layout(), VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+
+    vkCmdDispatch(command_buffer, (m_resident_objects + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
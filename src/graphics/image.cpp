@@ -0,0 +1,92 @@
+#include <graphics/image.hpp>
+
+namespace niqqa
+{
+namespace graphics
+{
+VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags) noexcept
+{
+    VkImageViewCreateInfo image_view_info{};
+    image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_info.image = image;
+    image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    image_view_info.format = format;
+
+    image_view_info.subresourceRange.aspectMask = aspect_flags;
+    image_view_info.subresourceRange.baseMipLevel = 0;
+    image_view_info.subresourceRange.levelCount = 1;
+    image_view_info.subresourceRange.baseArrayLayer = 0;
+    image_view_info.subresourceRange.layerCount = 1;
+
+    VkImageView image_view = VK_NULL_HANDLE;
+
+    if (vkCreateImageView(device, &image_view_info, nullptr, &image_view) != VK_SUCCESS)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    return image_view;
+}
+
+VkFormat find_supported_format(VkPhysicalDevice gpu, const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags feature_flag) noexcept
+{
+    for (VkFormat format : candidates)
+    {
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(gpu, format, &format_properties);
+
+        if (tiling == VK_IMAGE_TILING_OPTIMAL && (format_properties.optimalTilingFeatures & feature_flag) == feature_flag)
+        {
+            return format;
+        }
+
+        if (tiling == VK_IMAGE_TILING_LINEAR && (format_properties.linearTilingFeatures & feature_flag) == feature_flag)
+        {
+            return format;
+        }
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+VkFormat find_depth_format(VkPhysicalDevice gpu) noexcept
+{
+    return find_supported_format(gpu, 
+                                 {
+                                    VK_FORMAT_D32_SFLOAT,
+                                    VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                    VK_FORMAT_D24_UNORM_S8_UINT
+                                 }, 
+                                 VK_IMAGE_TILING_OPTIMAL, 
+                                 VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+VkImageAspectFlags depth_aspect_flags(VkFormat depth_format) noexcept
+{
+    VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    if (depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT)
+    {
+        aspect_flags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    return aspect_flags;
+}
+
+bool is_depth_format(VkFormat format) noexcept
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return true;
+    default:
+        return false;
+    }
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
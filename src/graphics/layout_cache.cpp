@@ -0,0 +1,196 @@
+#include <graphics/layout_cache.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace niqqa
+{
+namespace graphics
+{
+template <typename T>
+static void append_bytes(std::string &key, const T &value) noexcept
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+bool LayoutCache::init(VkDevice device) noexcept
+{
+    m_device = device;
+
+    return true;
+}
+
+void LayoutCache::cleanup() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto &[key, layout] : m_pipeline_layouts)
+    {
+        vkDestroyPipelineLayout(m_device, layout, nullptr);
+    }
+
+    for (auto &[key, layout] : m_set_layouts)
+    {
+        vkDestroyDescriptorSetLayout(m_device, layout, nullptr);
+    }
+
+    m_pipeline_layouts.clear();
+    m_set_layouts.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::set_layout(const std::vector<ReflectedBinding> &bindings) noexcept
+{
+    std::string key;
+    std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+    layout_bindings.reserve(bindings.size());
+
+    for (const auto &binding : bindings)
+    {
+        if (binding.count == 0)
+        {
+            LOG_ERROR("Layout Cache", "Set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) +
+                                      " is a runtime array, pass a layout for that set instead");
+            return VK_NULL_HANDLE;
+        }
+
+        VkDescriptorSetLayoutBinding layout_binding{};
+        layout_binding.binding = binding.binding;
+        layout_binding.descriptorType = binding.type;
+        layout_binding.descriptorCount = binding.count;
+        layout_binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+        layout_bindings.push_back(layout_binding);
+
+        append_bytes(key, binding.binding);
+        append_bytes(key, binding.type);
+        append_bytes(key, binding.count);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (auto it = m_set_layouts.find(key); it != m_set_layouts.end())
+    {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings = layout_bindings.data();
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+    if (vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &layout) != VK_SUCCESS)
+    {
+        LOG_ERROR("Layout Cache", "Failed to create descriptor set layout");
+        return VK_NULL_HANDLE;
+    }
+
+    m_set_layouts.emplace(std::move(key), layout);
+
+    return layout;
+}
+
+VkPipelineLayout LayoutCache::pipeline_layout(const ShaderReflection &reflection,
+                                              const std::vector<VkDescriptorSetLayout> &set_overrides) noexcept
+{
+    if (reflection.push_constants.offset + reflection.push_constants.size > PUSH_CONSTANT_SIZE)
+    {
+        LOG_WARN("Layout Cache", "Push constants use " + std::to_string(reflection.push_constants.offset + reflection.push_constants.size) +
+                                 " bytes, only " + std::to_string(PUSH_CONSTANT_SIZE) + " are guaranteed");
+    }
+
+    uint32_t set_count = std::max<uint32_t>(reflection.set_count(), static_cast<uint32_t>(set_overrides.size()));
+
+    std::vector<VkDescriptorSetLayout> set_layouts(set_count, VK_NULL_HANDLE);
+    auto binding = reflection.bindings.begin();
+
+    for (uint32_t set = 0; set < set_count; ++set)
+    {
+        // Bindings are sorted by set, so each set is one run of them
+        auto end = binding;
+
+        while (end != reflection.bindings.end() && end->set == set)
+        {
+            ++end;
+        }
+
+        if (set < set_overrides.size() && set_overrides[set] != VK_NULL_HANDLE)
+        {
+            set_layouts[set] = set_overrides[set];
+        }
+        else
+        {
+            // Unused sets in between still need a layout, an empty one
+            set_layouts[set] = set_layout(std::vector<ReflectedBinding>(binding, end));
+
+            if (set_layouts[set] == VK_NULL_HANDLE)
+            {
+                return VK_NULL_HANDLE;
+            }
+        }
+
+        binding = end;
+    }
+
+    return pipeline_layout(set_layouts);
+}
+
+VkPipelineLayout LayoutCache::pipeline_layout(const std::vector<VkDescriptorSetLayout> &set_layouts) noexcept
+{
+    std::string key;
+
+    for (VkDescriptorSetLayout set_layout : set_layouts)
+    {
+        append_bytes(key, set_layout);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (auto it = m_pipeline_layouts.find(key); it != m_pipeline_layouts.end())
+    {
+        return it->second;
+    }
+
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_ALL;
+    push_constant_range.offset = 0;
+    push_constant_range.size = PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    pipeline_layout_info.pSetLayouts = set_layouts.data();
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &layout) != VK_SUCCESS)
+    {
+        LOG_ERROR("Layout Cache", "Failed to create pipeline layout");
+        return VK_NULL_HANDLE;
+    }
+
+    m_pipeline_layouts.emplace(std::move(key), layout);
+
+    return layout;
+}
+
+size_t LayoutCache::set_layout_count() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_set_layouts.size();
+}
+
+size_t LayoutCache::pipeline_layout_count() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_pipeline_layouts.size();
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
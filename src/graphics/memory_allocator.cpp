@@ -0,0 +1,546 @@
+#include <graphics/memory_allocator.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+static VkDeviceSize next_power_of_two(VkDeviceSize value) noexcept
+{
+    return std::bit_ceil(value);
+}
+
+bool Allocation::is_valid() const noexcept
+{
+    return memory != VK_NULL_HANDLE;
+}
+
+bool MemoryAllocator::init(VkPhysicalDevice gpu, VkDevice device, const VkPhysicalDeviceProperties &properties) noexcept
+{
+    m_device = device;
+
+    vkGetPhysicalDeviceMemoryProperties(gpu, &m_memory_properties);
+
+    // Keeping every sub-allocation at least one granularity page wide means linear
+    // and optimal resources can never share a page, whatever type they are
+    m_min_allocation = next_power_of_two(std::max(MIN_ALLOCATION_SIZE, properties.limits.bufferImageGranularity));
+    m_max_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+    for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; ++i)
+    {
+        m_heap_stats[i].heap_size = m_memory_properties.memoryHeaps[i].size;
+        m_heap_stats[i].flags = m_memory_properties.memoryHeaps[i].flags;
+    }
+
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i)
+    {
+        VkDeviceSize heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[i].heapIndex].size;
+
+        // Small heaps (BAR, integrated carve-outs) get smaller blocks so one block can't eat the heap
+        VkDeviceSize block_size = std::bit_floor(heap_size / 8);
+        m_block_sizes[i] = std::clamp(block_size, MIN_BLOCK_SIZE, DEFAULT_BLOCK_SIZE);
+    }
+
+    LOG_INFO("Allocator", "Memory allocator initialized");
+
+    return true;
+}
+
+void MemoryAllocator::cleanup() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+    {
+        for (auto &block : m_blocks[i])
+        {
+            if (block->allocation_count > 0)
+            {
+                LOG_WARN("Allocator", "Destroying a memory block with live allocations");
+            }
+
+            free_device_memory(block->memory);
+        }
+
+        m_blocks[i].clear();
+    }
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements &requirements,
+                               VkMemoryPropertyFlags property_flags,
+                               bool dedicated,
+                               Allocation &allocation) noexcept
+{
+    uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, property_flags);
+
+    if (memory_type == UINT32_MAX)
+    {
+        LOG_ERROR("Allocator", "No suitable memory type found");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (dedicated || requirements.size > m_block_sizes[memory_type] / 2)
+    {
+        return allocate_dedicated(requirements.size, memory_type, nullptr, allocation);
+    }
+
+    return allocate_from_blocks(requirements, memory_type, allocation);
+}
+
+bool MemoryAllocator::allocate_image(VkImage image, VkMemoryPropertyFlags property_flags, Allocation &allocation, bool dedicated) noexcept
+{
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+
+    VkImageMemoryRequirementsInfo2 requirements_info{};
+    requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.image = image;
+
+    vkGetImageMemoryRequirements2(m_device, &requirements_info, &requirements);
+
+    const VkMemoryRequirements &memory_requirements = requirements.memoryRequirements;
+
+    uint32_t memory_type = find_memory_type(memory_requirements.memoryTypeBits, property_flags);
+
+    if (memory_type == UINT32_MAX)
+    {
+        LOG_ERROR("Allocator", "No suitable memory type found");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        bool use_dedicated = dedicated ||
+                             dedicated_requirements.prefersDedicatedAllocation ||
+                             dedicated_requirements.requiresDedicatedAllocation ||
+                             memory_requirements.size > m_block_sizes[memory_type] / 2;
+
+        bool allocated = false;
+
+        if (use_dedicated)
+        {
+            VkMemoryDedicatedAllocateInfo dedicated_info{};
+            dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+            dedicated_info.image = image;
+
+            allocated = allocate_dedicated(memory_requirements.size, memory_type, &dedicated_info, allocation);
+        }
+        else
+        {
+            allocated = allocate_from_blocks(memory_requirements, memory_type, allocation);
+        }
+
+        if (!allocated)
+        {
+            return false;
+        }
+    }
+
+    if (vkBindImageMemory(m_device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        LOG_ERROR("Allocator", "Failed to bind image memory");
+        free(allocation);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool MemoryAllocator::allocate_buffer(VkBuffer buffer, VkMemoryPropertyFlags property_flags, Allocation &allocation, bool dedicated) noexcept
+{
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+
+    VkBufferMemoryRequirementsInfo2 requirements_info{};
+    requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.buffer = buffer;
+
+    vkGetBufferMemoryRequirements2(m_device, &requirements_info, &requirements);
+
+    const VkMemoryRequirements &memory_requirements = requirements.memoryRequirements;
+
+    uint32_t memory_type = find_memory_type(memory_requirements.memoryTypeBits, property_flags);
+
+    if (memory_type == UINT32_MAX)
+    {
+        LOG_ERROR("Allocator", "No suitable memory type found");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        bool use_dedicated = dedicated ||
+                             dedicated_requirements.prefersDedicatedAllocation ||
+                             dedicated_requirements.requiresDedicatedAllocation ||
+                             memory_requirements.size > m_block_sizes[memory_type] / 2;
+
+        bool allocated = false;
+
+        if (use_dedicated)
+        {
+            VkMemoryDedicatedAllocateInfo dedicated_info{};
+            dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+            dedicated_info.buffer = buffer;
+
+            allocated = allocate_dedicated(memory_requirements.size, memory_type, &dedicated_info, allocation);
+        }
+        else
+        {
+            allocated = allocate_from_blocks(memory_requirements, memory_type, allocation);
+        }
+
+        if (!allocated)
+        {
+            return false;
+        }
+    }
+
+    if (vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        LOG_ERROR("Allocator", "Failed to bind buffer memory");
+        free(allocation);
+
+        return false;
+    }
+
+    return true;
+}
+
+void MemoryAllocator::free(Allocation &allocation) noexcept
+{
+    if (!allocation.is_valid())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t heap_index = m_memory_properties.memoryTypes[allocation.memory_type].heapIndex;
+    HeapStats &stats = m_heap_stats[heap_index];
+
+    if (allocation.block == nullptr)
+    {
+        free_device_memory(allocation.memory);
+
+        stats.dedicated_count -= 1;
+        stats.dedicated_bytes -= allocation.size;
+    }
+    else
+    {
+        MemoryBlock *block = allocation.block;
+        VkDeviceSize allocated_size = m_min_allocation << allocation.order;
+
+        block_free(*block, allocation.order, allocation.offset);
+
+        block->used -= allocated_size;
+        block->allocation_count -= 1;
+
+        stats.used_bytes -= allocated_size;
+        stats.allocation_count -= 1;
+
+        // Keep one empty block around per type so alloc/free churn doesn't hit the driver
+        if (block->allocation_count == 0 && m_blocks[allocation.memory_type].size() > 1)
+        {
+            destroy_block(allocation.memory_type, block);
+        }
+    }
+
+    allocation = Allocation{};
+}
+
+uint32_t MemoryAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const noexcept
+{
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i)
+    {
+        if ((type_filter & (1 << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags)
+        {
+            return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+const VkPhysicalDeviceMemoryProperties &MemoryAllocator::memory_properties() const noexcept
+{
+    return m_memory_properties;
+}
+
+std::vector<HeapStats> MemoryAllocator::heap_stats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return {m_heap_stats.begin(), m_heap_stats.begin() + m_memory_properties.memoryHeapCount};
+}
+
+void MemoryAllocator::log_stats() const noexcept
+{
+    std::vector<HeapStats> stats = heap_stats();
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        LOG_INFO("Allocator", "Heap " + std::to_string(i) +
+                              ": blocks " + std::to_string(stats[i].block_count) +
+                              " (" + std::to_string(stats[i].block_bytes >> 20) + " MiB)" +
+                              ", used " + std::to_string(stats[i].used_bytes >> 20) + " MiB" +
+                              " in " + std::to_string(stats[i].allocation_count) + " allocations" +
+                              ", dedicated " + std::to_string(stats[i].dedicated_bytes >> 20) + " MiB" +
+                              " in " + std::to_string(stats[i].dedicated_count) + " allocations");
+    }
+}
+
+bool MemoryAllocator::allocate_device_memory(VkDeviceSize size,
+                                             uint32_t memory_type,
+                                             const void *p_next,
+                                             VkDeviceMemory &memory,
+                                             void *&mapped) noexcept
+{
+    if (m_device_allocation_count >= m_max_allocation_count)
+    {
+        LOG_ERROR("Allocator", "maxMemoryAllocationCount reached");
+        return false;
+    }
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.pNext = p_next;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    if (vkAllocateMemory(m_device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+    {
+        LOG_ERROR("Allocator", "Failed to allocate device memory");
+        return false;
+    }
+
+    ++m_device_allocation_count;
+
+    mapped = nullptr;
+
+    // Host visible memory stays mapped for its whole lifetime
+    if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+        {
+            LOG_ERROR("Allocator", "Failed to map device memory");
+            free_device_memory(memory);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MemoryAllocator::free_device_memory(VkDeviceMemory memory) noexcept
+{
+    vkFreeMemory(m_device, memory, nullptr);
+
+    --m_device_allocation_count;
+}
+
+bool MemoryAllocator::allocate_dedicated(VkDeviceSize size,
+                                         uint32_t memory_type,
+                                         const VkMemoryDedicatedAllocateInfo *dedicated_info,
+                                         Allocation &allocation) noexcept
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+
+    if (!allocate_device_memory(size, memory_type, dedicated_info, memory, mapped))
+    {
+        return false;
+    }
+
+    allocation.memory = memory;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.mapped = mapped;
+    allocation.memory_type = memory_type;
+    allocation.order = 0;
+    allocation.block = nullptr;
+
+    HeapStats &stats = m_heap_stats[m_memory_properties.memoryTypes[memory_type].heapIndex];
+    stats.dedicated_count += 1;
+    stats.dedicated_bytes += size;
+
+    return true;
+}
+
+bool MemoryAllocator::allocate_from_blocks(const VkMemoryRequirements &requirements, uint32_t memory_type, Allocation &allocation) noexcept
+{
+    // Buddy offsets are multiples of their own size, so rounding up to the
+    // alignment is all it takes to satisfy it
+    uint32_t order = order_for_size(std::max(requirements.size, requirements.alignment));
+
+    VkDeviceSize offset = 0;
+    MemoryBlock *target = nullptr;
+
+    for (auto &block : m_blocks[memory_type])
+    {
+        if (block_allocate(*block, order, offset))
+        {
+            target = block.get();
+            break;
+        }
+    }
+
+    if (target == nullptr)
+    {
+        target = create_block(memory_type);
+
+        if (target == nullptr || !block_allocate(*target, order, offset))
+        {
+            return false;
+        }
+    }
+
+    VkDeviceSize allocated_size = m_min_allocation << order;
+
+    target->used += allocated_size;
+    target->allocation_count += 1;
+
+    allocation.memory = target->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = target->mapped ? static_cast<char *>(target->mapped) + offset : nullptr;
+    allocation.memory_type = memory_type;
+    allocation.order = order;
+    allocation.block = target;
+
+    HeapStats &stats = m_heap_stats[m_memory_properties.memoryTypes[memory_type].heapIndex];
+    stats.used_bytes += allocated_size;
+    stats.allocation_count += 1;
+
+    return true;
+}
+
+MemoryBlock *MemoryAllocator::create_block(uint32_t memory_type) noexcept
+{
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = m_block_sizes[memory_type];
+    block->memory_type = memory_type;
+
+    if (!allocate_device_memory(block->size, memory_type, nullptr, block->memory, block->mapped))
+    {
+        return nullptr;
+    }
+
+    uint32_t max_order = order_for_size(block->size);
+
+    block->free_lists.resize(max_order + 1);
+    block->free_lists[max_order].insert(0);
+
+    HeapStats &stats = m_heap_stats[m_memory_properties.memoryTypes[memory_type].heapIndex];
+    stats.block_count += 1;
+    stats.block_bytes += block->size;
+
+    m_blocks[memory_type].push_back(std::move(block));
+
+    return m_blocks[memory_type].back().get();
+}
+
+void MemoryAllocator::destroy_block(uint32_t memory_type, MemoryBlock *block) noexcept
+{
+    auto &blocks = m_blocks[memory_type];
+
+    auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto &candidate) {
+        return candidate.get() == block;
+    });
+
+    if (it == blocks.end())
+    {
+        return;
+    }
+
+    HeapStats &stats = m_heap_stats[m_memory_properties.memoryTypes[memory_type].heapIndex];
+    stats.block_count -= 1;
+    stats.block_bytes -= block->size;
+
+    free_device_memory(block->memory);
+
+    blocks.erase(it);
+}
+
+uint32_t MemoryAllocator::order_for_size(VkDeviceSize size) const noexcept
+{
+    VkDeviceSize rounded = next_power_of_two(std::max(size, m_min_allocation));
+
+    return static_cast<uint32_t>(std::countr_zero(rounded) - std::countr_zero(m_min_allocation));
+}
+
+bool MemoryAllocator::block_allocate(MemoryBlock &block, uint32_t order, VkDeviceSize &offset) noexcept
+{
+    if (order >= block.free_lists.size())
+    {
+        return false;
+    }
+
+    uint32_t current = order;
+
+    while (current < block.free_lists.size() && block.free_lists[current].empty())
+    {
+        ++current;
+    }
+
+    if (current == block.free_lists.size())
+    {
+        return false;
+    }
+
+    // Lowest offset first keeps the block packed towards the front
+    VkDeviceSize found = *block.free_lists[current].begin();
+    block.free_lists[current].erase(block.free_lists[current].begin());
+
+    while (current > order)
+    {
+        --current;
+        block.free_lists[current].insert(found + (m_min_allocation << current));
+    }
+
+    offset = found;
+
+    return true;
+}
+
+void MemoryAllocator::block_free(MemoryBlock &block, uint32_t order, VkDeviceSize offset) noexcept
+{
+    uint32_t max_order = static_cast<uint32_t>(block.free_lists.size() - 1);
+
+    while (order < max_order)
+    {
+        VkDeviceSize buddy = offset ^ (m_min_allocation << order);
+        auto it = block.free_lists[order].find(buddy);
+
+        if (it == block.free_lists[order].end())
+        {
+            break;
+        }
+
+        block.free_lists[order].erase(it);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+
+    block.free_lists[order].insert(offset);
+}
+} // namespace graphics
+} // namespace niqqa
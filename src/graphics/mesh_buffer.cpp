@@ -0,0 +1,203 @@
+#include <graphics/mesh_buffer.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+void MeshBuffer::vertex_input(std::vector<VkVertexInputBindingDescription> &bindings,
+                              std::vector<VkVertexInputAttributeDescription> &attributes) noexcept
+{
+    bindings = {
+        {0, sizeof(assets::MeshPosition), VK_VERTEX_INPUT_RATE_VERTEX},
+        {1, sizeof(assets::MeshAttributes), VK_VERTEX_INPUT_RATE_VERTEX}
+    };
+
+    attributes = {
+        {0, 0, POSITION_FORMAT, 0},
+        {1, 1, NORMAL_FORMAT, offsetof(assets::MeshAttributes, normal)},
+        {2, 1, UV_FORMAT, offsetof(assets::MeshAttributes, uv)}
+    };
+}
+
+bool MeshBuffer::init(Device &device, UploadQueue &uploads, const assets::MeshFile &file) noexcept
+{
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    m_device = &device;
+
+    const assets::MeshFileHeader &header = file.header();
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = file.data_size();
+    buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device.device(), &buffer_info, nullptr, &m_buffer) != VK_SUCCESS)
+    {
+        LOG_ERROR("Mesh Buffer", "Failed to create buffer");
+        return false;
+    }
+
+    if (!device.allocator().allocate_buffer(m_buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_allocation))
+    {
+        LOG_ERROR("Mesh Buffer", "Failed to allocate buffer memory");
+        return false;
+    }
+
+    file.prefetch();
+
+    const uint8_t *data = static_cast<const uint8_t *>(file.data());
+
+    for (VkDeviceSize offset = 0; offset < file.data_size(); offset += UPLOAD_CHUNK_SIZE)
+    {
+        VkDeviceSize size = std::min(UPLOAD_CHUNK_SIZE, file.data_size() - offset);
+
+        // A full ring drains once, a chunk that still does not fit never will
+        if (!uploads.upload_buffer(m_buffer, offset, data + offset, size))
+        {
+            uploads.flush_and_wait();
+
+            if (!uploads.upload_buffer(m_buffer, offset, data + offset, size))
+            {
+                LOG_ERROR("Mesh Buffer", "Staging ring is too small for the mesh upload");
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < m_stream_offsets.size(); ++i)
+    {
+        m_stream_offsets[i] = header.streams[i].offset - header.data_offset;
+    }
+
+    m_index_type = header.index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    m_vertex_count = header.vertex_count;
+    m_index_count = header.index_count;
+    m_lods.assign(file.lods(), file.lods() + header.lod_count);
+
+    m_quantize_min = header.quantize_min;
+    m_quantize_scale = header.quantize_scale;
+    m_bounds = header.bounds;
+
+    return true;
+}
+
+void MeshBuffer::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    if (m_buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device->device(), m_buffer, nullptr);
+        m_buffer = VK_NULL_HANDLE;
+    }
+
+    if (m_allocation.is_valid())
+    {
+        m_device->allocator().free(m_allocation);
+    }
+
+    m_lods.clear();
+    m_vertex_count = 0;
+    m_index_count = 0;
+
+    m_device = nullptr;
+}
+
+void MeshBuffer::bind(VkCommandBuffer command_buffer) const noexcept
+{
+    VkBuffer buffers[] = {m_buffer, m_buffer};
+    VkDeviceSize offsets[] = {
+        m_stream_offsets[static_cast<size_t>(assets::MeshStream::Positions)],
+        m_stream_offsets[static_cast<size_t>(assets::MeshStream::Attributes)]
+    };
+
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, m_buffer, m_stream_offsets[static_cast<size_t>(assets::MeshStream::Indices)], m_index_type);
+}
+
+void MeshBuffer::draw(VkCommandBuffer command_buffer, uint32_t lod, uint32_t instance_count, uint32_t first_instance) const noexcept
+{
+    if (lod >= m_lods.size())
+    {
+        return;
+    }
+
+    vkCmdDrawIndexed(command_buffer, m_lods[lod].index_count, instance_count, m_lods[lod].first_index, 0, first_instance);
+}
+
+uint32_t MeshBuffer::select_lod(float distance) const noexcept
+{
+    for (uint32_t lod = 0; lod < m_lods.size(); ++lod)
+    {
+        if (distance <= m_lods[lod].max_distance)
+        {
+            return lod;
+        }
+    }
+
+    return m_lods.empty() ? 0 : static_cast<uint32_t>(m_lods.size() - 1);
+}
+
+VkBuffer MeshBuffer::buffer() const noexcept
+{
+    return m_buffer;
+}
+
+VkDeviceSize MeshBuffer::stream_offset(assets::MeshStream stream) const noexcept
+{
+    return m_stream_offsets[static_cast<size_t>(stream)];
+}
+
+VkIndexType MeshBuffer::index_type() const noexcept
+{
+    return m_index_type;
+}
+
+uint32_t MeshBuffer::vertex_count() const noexcept
+{
+    return m_vertex_count;
+}
+
+uint32_t MeshBuffer::index_count() const noexcept
+{
+    return m_index_count;
+}
+
+const std::vector<assets::MeshFileLod> &MeshBuffer::lods() const noexcept
+{
+    return m_lods;
+}
+
+const std::array<float, 3> &MeshBuffer::quantize_min() const noexcept
+{
+    return m_quantize_min;
+}
+
+const std::array<float, 3> &MeshBuffer::quantize_scale() const noexcept
+{
+    return m_quantize_scale;
+}
+
+const std::array<float, 4> &MeshBuffer::bounds() const noexcept
+{
+    return m_bounds;
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
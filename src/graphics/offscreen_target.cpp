@@ -0,0 +1,357 @@
+#include <graphics/offscreen_target.hpp>
+
+#include <log.hpp>
+
+namespace niqqa
+{
+namespace graphics
+{
+static VkDeviceSize bytes_per_pixel(VkFormat format) noexcept
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool OffscreenTarget::init(Device &device,
+                           VkExtent2D extent,
+                           uint32_t image_count,
+                           VkFormat color_format,
+                           bool readback) noexcept
+{
+    m_device = device.device();
+    m_allocator = &device.allocator();
+    m_extent = extent;
+    m_color_format = color_format;
+    m_depth_format = find_depth_format(device.gpu());
+    m_readback = readback;
+
+    if (m_readback && bytes_per_pixel(m_color_format) == 0)
+    {
+        LOG_WARN("Offscreen", "Readback is not supported for this color format, disabling it");
+        m_readback = false;
+    }
+
+    LOG_INFO("Offscreen", "Creating offscreen images");
+
+    m_images.resize(image_count);
+
+    VkImageUsageFlags color_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    if (m_readback)
+    {
+        color_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    for (auto &image : m_images)
+    {
+        if (!create_image(m_color_format, color_usage, VK_IMAGE_ASPECT_COLOR_BIT, image.color, image.color_allocation))
+        {
+            return false;
+        }
+
+        if (m_readback && !create_readback_buffer(image))
+        {
+            return false;
+        }
+    }
+
+    if (!create_image(m_depth_format,
+                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                      depth_aspect_flags(m_depth_format),
+                      m_depth,
+                      m_depth_allocation))
+    {
+        return false;
+    }
+
+    LOG_INFO("Offscreen", "Offscreen images created");
+
+    return true;
+}
+
+bool OffscreenTarget::create_framebuffers(VkRenderPass render_pass) noexcept
+{
+    for (auto &image : m_images)
+    {
+        VkImageView attachments[] = {
+            image.color.image_view,
+            m_depth.image_view
+        };
+
+        VkFramebufferCreateInfo framebuffer_info{};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = render_pass;
+        framebuffer_info.attachmentCount = 2;
+        framebuffer_info.pAttachments = attachments;
+        framebuffer_info.width = m_extent.width;
+        framebuffer_info.height = m_extent.height;
+        framebuffer_info.layers = 1;
+
+        if (vkCreateFramebuffer(m_device, &framebuffer_info, nullptr, &image.framebuffer) != VK_SUCCESS)
+        {
+            LOG_ERROR("Offscreen", "Failed to create framebuffer");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void OffscreenTarget::cleanup() noexcept
+{
+    for (auto &image : m_images)
+    {
+        if (image.framebuffer != VK_NULL_HANDLE)
+        {
+            vkDestroyFramebuffer(m_device, image.framebuffer, nullptr);
+        }
+
+        if (image.color.image_view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(m_device, image.color.image_view, nullptr);
+        }
+
+        if (image.color.image != VK_NULL_HANDLE)
+        {
+            vkDestroyImage(m_device, image.color.image, nullptr);
+        }
+
+        if (image.readback_buffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(m_device, image.readback_buffer, nullptr);
+        }
+
+        m_allocator->free(image.color_allocation);
+        m_allocator->free(image.readback_allocation);
+    }
+
+    m_images.clear();
+
+    if (m_depth.image_view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_device, m_depth.image_view, nullptr);
+    }
+
+    if (m_depth.image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(m_device, m_depth.image, nullptr);
+    }
+
+    if (m_allocator != nullptr)
+    {
+        m_allocator->free(m_depth_allocation);
+    }
+}
+
+uint32_t OffscreenTarget::acquire_next_image() noexcept
+{
+    uint32_t image_index = m_next_image;
+    m_next_image = (m_next_image + 1) % static_cast<uint32_t>(m_images.size());
+
+    return image_index;
+}
+
+void OffscreenTarget::record_readback(VkCommandBuffer command_buffer, uint32_t image_index) noexcept
+{
+    if (!m_readback)
+    {
+        return;
+    }
+
+    OffscreenImage &image = m_images[image_index];
+
+    // Rendering already left the image in TRANSFER_SRC_OPTIMAL, this only
+    // makes the attachment writes visible to the copy
+    VkImageMemoryBarrier image_barrier{};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = image.color.image;
+    image_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &image_barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {m_extent.width, m_extent.height, 1};
+
+    vkCmdCopyImageToBuffer(command_buffer,
+                           image.color.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           image.readback_buffer,
+                           1,
+                           &region);
+
+    VkBufferMemoryBarrier buffer_barrier{};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = image.readback_buffer;
+    buffer_barrier.offset = 0;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0,
+                         0, nullptr,
+                         1, &buffer_barrier,
+                         0, nullptr);
+}
+
+void OffscreenTarget::set_rendered(uint32_t image_index, const SyncPoint &sync) noexcept
+{
+    m_images[image_index].rendered = sync;
+}
+
+const void *OffscreenTarget::readback_data(uint32_t image_index) const noexcept
+{
+    if (!m_readback)
+    {
+        return nullptr;
+    }
+
+    const OffscreenImage &image = m_images[image_index];
+
+    // Host coherent, so the copy is visible as soon as the submit is done
+    image.rendered.wait();
+
+    return image.readback_allocation.mapped;
+}
+
+VkExtent2D OffscreenTarget::extent() const noexcept
+{
+    return m_extent;
+}
+
+VkFormat OffscreenTarget::color_format() const noexcept
+{
+    return m_color_format;
+}
+
+VkFormat OffscreenTarget::depth_format() const noexcept
+{
+    return m_depth_format;
+}
+
+VkImageLayout OffscreenTarget::color_final_layout() const noexcept
+{
+    return m_readback ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+}
+
+uint32_t OffscreenTarget::image_count() const noexcept
+{
+    return static_cast<uint32_t>(m_images.size());
+}
+
+bool OffscreenTarget::readback_enabled() const noexcept
+{
+    return m_readback;
+}
+
+VkFramebuffer OffscreenTarget::framebuffer(uint32_t image_index) const noexcept
+{
+    return m_images[image_index].framebuffer;
+}
+
+const Image &OffscreenTarget::color_image(uint32_t image_index) const noexcept
+{
+    return m_images[image_index].color;
+}
+
+const Image &OffscreenTarget::depth_image() const noexcept
+{
+    return m_depth;
+}
+
+bool OffscreenTarget::create_image(VkFormat format, VkImageUsageFlags usage_flags, VkImageAspectFlags aspect_flags, Image &image, Allocation &allocation) noexcept
+{
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent.width = m_extent.width;
+    image_info.extent.height = m_extent.height;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.format = format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = usage_flags;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(m_device, &image_info, nullptr, &image.image) != VK_SUCCESS)
+    {
+        LOG_ERROR("Offscreen", "Failed to create image");
+        return false;
+    }
+
+    if (!m_allocator->allocate_image(image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocation, true))
+    {
+        LOG_ERROR("Offscreen", "Failed to allocate image memory");
+        return false;
+    }
+
+    image.image_view = create_image_view(m_device, image.image, format, aspect_flags);
+
+    if (image.image_view == VK_NULL_HANDLE)
+    {
+        LOG_ERROR("Offscreen", "Failed to create image view");
+        return false;
+    }
+
+    return true;
+}
+
+bool OffscreenTarget::create_readback_buffer(OffscreenImage &image) noexcept
+{
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = static_cast<VkDeviceSize>(m_extent.width) * m_extent.height * bytes_per_pixel(m_color_format);
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &buffer_info, nullptr, &image.readback_buffer) != VK_SUCCESS)
+    {
+        LOG_ERROR("Offscreen", "Failed to create readback buffer");
+        return false;
+    }
+
+    if (!m_allocator->allocate_buffer(image.readback_buffer,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      image.readback_allocation))
+    {
+        LOG_ERROR("Offscreen", "Failed to allocate readback memory");
+        return false;
+    }
+
+    return true;
+}
+} // namespace graphics
+} // namespace niqqa
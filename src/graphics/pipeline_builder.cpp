@@ -0,0 +1,544 @@
+#include <graphics/pipeline_builder.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace niqqa
+{
+namespace graphics
+{
+template <typename T>
+static void append_bytes(std::string &key, const T &value) noexcept
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static void append_vector(std::string &key, const std::vector<T> &values) noexcept
+{
+    append_bytes(key, values.size());
+    key.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+// With dynamic topology a pipeline still fixes the class of primitives it draws
+static uint32_t topology_class(VkPrimitiveTopology topology) noexcept
+{
+    switch (topology)
+    {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return 0;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return 1;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::shader(VkShaderStageFlagBits stage, VkShaderModule module, const std::string &entry_point) noexcept
+{
+    stages.push_back({stage, module, entry_point});
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::vertex_input(const ShaderReflection &reflection) noexcept
+{
+    vertex_bindings.clear();
+    vertex_attributes.clear();
+
+    uint32_t stride = reflection.packed_vertex_attributes(0, vertex_attributes);
+
+    if (stride != 0)
+    {
+        vertex_bindings.push_back({0, stride, VK_VERTEX_INPUT_RATE_VERTEX});
+    }
+
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::pipeline_layout(VkPipelineLayout pipeline_layout) noexcept
+{
+    layout = pipeline_layout;
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::target(VkRenderPass pass, uint32_t subpass_index) noexcept
+{
+    render_pass = pass;
+    subpass = subpass_index;
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::target(const std::vector<VkFormat> &color, VkFormat depth) noexcept
+{
+    render_pass = VK_NULL_HANDLE;
+    color_formats = color;
+    depth_format = depth;
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::alpha_blend() noexcept
+{
+    VkPipelineColorBlendAttachmentState attachment{};
+    attachment.blendEnable = VK_TRUE;
+    attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    blend.assign(std::max<size_t>(color_formats.size(), 1), attachment);
+    return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::raster_state(const RasterState &state) noexcept
+{
+    raster = state;
+    return *this;
+}
+
+bool PipelineBuilder::init(Device &device) noexcept
+{
+    m_device = &device;
+    m_dynamic = device.dynamic_state();
+
+    VkDevice vk_device = device.device();
+    bool core = device.properties().apiVersion >= VK_API_VERSION_1_3;
+
+    // Core names from 1.3 on, the extension aliases before
+    auto load = [&](const char *core_name, const char *ext_name) {
+        return vkGetDeviceProcAddr(vk_device, core ? core_name : ext_name);
+    };
+
+    if (m_dynamic.extended)
+    {
+        m_set_cull_mode = reinterpret_cast<PFN_vkCmdSetCullMode>(load("vkCmdSetCullMode", "vkCmdSetCullModeEXT"));
+        m_set_front_face = reinterpret_cast<PFN_vkCmdSetFrontFace>(load("vkCmdSetFrontFace", "vkCmdSetFrontFaceEXT"));
+        m_set_primitive_topology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopology>(load("vkCmdSetPrimitiveTopology", "vkCmdSetPrimitiveTopologyEXT"));
+        m_set_depth_test_enable = reinterpret_cast<PFN_vkCmdSetDepthTestEnable>(load("vkCmdSetDepthTestEnable", "vkCmdSetDepthTestEnableEXT"));
+        m_set_depth_write_enable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnable>(load("vkCmdSetDepthWriteEnable", "vkCmdSetDepthWriteEnableEXT"));
+        m_set_depth_compare_op = reinterpret_cast<PFN_vkCmdSetDepthCompareOp>(load("vkCmdSetDepthCompareOp", "vkCmdSetDepthCompareOpEXT"));
+
+        m_dynamic.extended = m_set_cull_mode && m_set_front_face && m_set_primitive_topology &&
+                             m_set_depth_test_enable && m_set_depth_write_enable && m_set_depth_compare_op;
+    }
+
+    if (m_dynamic.extended2)
+    {
+        m_set_depth_bias_enable = reinterpret_cast<PFN_vkCmdSetDepthBiasEnable>(load("vkCmdSetDepthBiasEnable", "vkCmdSetDepthBiasEnableEXT"));
+        m_set_primitive_restart_enable = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnable>(load("vkCmdSetPrimitiveRestartEnable", "vkCmdSetPrimitiveRestartEnableEXT"));
+
+        m_dynamic.extended2 = m_set_depth_bias_enable && m_set_primitive_restart_enable;
+    }
+
+    if (m_dynamic.polygon_mode)
+    {
+        m_set_polygon_mode = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(vk_device, "vkCmdSetPolygonModeEXT"));
+        m_dynamic.polygon_mode = m_set_polygon_mode != nullptr;
+    }
+
+    if (m_dynamic.depth_clamp)
+    {
+        m_set_depth_clamp_enable = reinterpret_cast<PFN_vkCmdSetDepthClampEnableEXT>(vkGetDeviceProcAddr(vk_device, "vkCmdSetDepthClampEnableEXT"));
+        m_dynamic.depth_clamp = m_set_depth_clamp_enable != nullptr;
+    }
+
+    LOG_INFO("Pipeline Builder", std::string("Dynamic raster state:") +
+                                 (m_dynamic.extended ? " cull/depth/topology" : "") +
+                                 (m_dynamic.extended2 ? " bias/restart" : "") +
+                                 (m_dynamic.polygon_mode ? " polygon mode" : "") +
+                                 (m_dynamic.depth_clamp ? " depth clamp" : "") +
+                                 (!m_dynamic.extended && !m_dynamic.extended2 ? " none" : ""));
+
+    return true;
+}
+
+void PipelineBuilder::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_requests > 0)
+    {
+        LOG_INFO("Pipeline Builder", std::to_string(m_requests) + " pipeline requests served by " + std::to_string(m_pipelines.size()) + " pipelines");
+    }
+
+    for (auto &[key, cached] : m_pipelines)
+    {
+        vkDestroyPipeline(m_device->device(), cached.pipeline, nullptr);
+    }
+
+    for (auto &retired : m_retired)
+    {
+        vkDestroyPipeline(m_device->device(), retired.pipeline, nullptr);
+    }
+
+    m_pipelines.clear();
+    m_retired.clear();
+    m_device = nullptr;
+}
+
+GraphicsPipeline PipelineBuilder::get(const GraphicsPipelineDesc &desc) noexcept
+{
+    GraphicsPipeline result;
+    result.layout = desc.layout;
+    result.raster = desc.raster;
+
+    std::string key = static_key(desc);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        collect_retired();
+        ++m_requests;
+
+        if (auto it = m_pipelines.find(key); it != m_pipelines.end())
+        {
+            result.pipeline = it->second.pipeline;
+            return result;
+        }
+    }
+
+    // Created outside the lock, compiling can take a while and other keys should not wait on it
+    VkPipeline pipeline = create(desc);
+
+    if (pipeline == VK_NULL_HANDLE)
+    {
+        return result;
+    }
+
+    CachedPipeline cached;
+    cached.pipeline = pipeline;
+
+    for (const auto &stage : desc.stages)
+    {
+        cached.modules.push_back(stage.module);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto [it, inserted] = m_pipelines.emplace(std::move(key), std::move(cached));
+
+    // Another thread created the same pipeline meanwhile, theirs wins
+    if (!inserted)
+    {
+        vkDestroyPipeline(m_device->device(), pipeline, nullptr);
+    }
+
+    result.pipeline = it->second.pipeline;
+    return result;
+}
+
+void PipelineBuilder::bind(VkCommandBuffer command_buffer, const GraphicsPipeline &pipeline) const noexcept
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    set_raster_state(command_buffer, pipeline.raster);
+}
+
+void PipelineBuilder::set_raster_state(VkCommandBuffer command_buffer, const RasterState &raster) const noexcept
+{
+    if (m_dynamic.extended)
+    {
+        m_set_cull_mode(command_buffer, raster.cull_mode);
+        m_set_front_face(command_buffer, raster.front_face);
+        m_set_primitive_topology(command_buffer, raster.topology);
+        m_set_depth_test_enable(command_buffer, raster.depth_test);
+        m_set_depth_write_enable(command_buffer, raster.depth_write);
+        m_set_depth_compare_op(command_buffer, raster.depth_compare);
+    }
+
+    if (m_dynamic.extended2)
+    {
+        m_set_depth_bias_enable(command_buffer, raster.depth_bias);
+        m_set_primitive_restart_enable(command_buffer, raster.primitive_restart);
+    }
+
+    if (m_dynamic.polygon_mode)
+    {
+        m_set_polygon_mode(command_buffer, raster.polygon_mode);
+    }
+
+    if (m_dynamic.depth_clamp)
+    {
+        m_set_depth_clamp_enable(command_buffer, raster.depth_clamp);
+    }
+
+    // Dynamic on every device
+    vkCmdSetLineWidth(command_buffer, raster.line_width);
+    vkCmdSetDepthBias(command_buffer, raster.depth_bias_constant, 0.0f, raster.depth_bias_slope);
+}
+
+void PipelineBuilder::evict(VkShaderModule module) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Frames already submitted may still draw with them, nothing later does
+    SyncPoint in_use = m_device->graphics_timeline().last_submitted();
+
+    for (auto it = m_pipelines.begin(); it != m_pipelines.end();)
+    {
+        const auto &modules = it->second.modules;
+
+        if (std::find(modules.begin(), modules.end(), module) != modules.end())
+        {
+            m_retired.push_back({it->second.pipeline, in_use});
+            it = m_pipelines.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+PipelineBuilderStats PipelineBuilder::stats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PipelineBuilderStats stats;
+    stats.requests = m_requests;
+    stats.pipelines = static_cast<uint32_t>(m_pipelines.size());
+
+    return stats;
+}
+
+std::string PipelineBuilder::static_key(const GraphicsPipelineDesc &desc) const noexcept
+{
+    std::string key;
+    key.reserve(256);
+
+    append_bytes(key, desc.stages.size());
+
+    for (const auto &stage : desc.stages)
+    {
+        append_bytes(key, stage.stage);
+        append_bytes(key, stage.module);
+        key.append(stage.entry_point.c_str(), stage.entry_point.size() + 1);
+    }
+
+    append_vector(key, desc.vertex_bindings);
+    append_vector(key, desc.vertex_attributes);
+    append_vector(key, desc.color_formats);
+    append_vector(key, desc.blend);
+
+    append_bytes(key, desc.layout);
+    append_bytes(key, desc.render_pass);
+    append_bytes(key, desc.subpass);
+    append_bytes(key, desc.depth_format);
+    append_bytes(key, desc.samples);
+
+    // Only what the device can not set while recording tells pipelines apart
+    const RasterState &raster = desc.raster;
+
+    if (m_dynamic.extended)
+    {
+        append_bytes(key, topology_class(raster.topology));
+    }
+    else
+    {
+        append_bytes(key, raster.cull_mode);
+        append_bytes(key, raster.front_face);
+        append_bytes(key, raster.topology);
+        append_bytes(key, raster.depth_test);
+        append_bytes(key, raster.depth_write);
+        append_bytes(key, raster.depth_compare);
+    }
+
+    if (!m_dynamic.extended2)
+    {
+        append_bytes(key, raster.depth_bias);
+        append_bytes(key, raster.primitive_restart);
+    }
+
+    if (!m_dynamic.polygon_mode)
+    {
+        append_bytes(key, raster.polygon_mode);
+    }
+
+    if (!m_dynamic.depth_clamp)
+    {
+        append_bytes(key, raster.depth_clamp);
+    }
+
+    return key;
+}
+
+VkPipeline PipelineBuilder::create(const GraphicsPipelineDesc &desc) noexcept
+{
+    const RasterState &raster = desc.raster;
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    stages.reserve(desc.stages.size());
+
+    for (const auto &stage : desc.stages)
+    {
+        VkPipelineShaderStageCreateInfo stage_info{};
+        stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_info.stage = stage.stage;
+        stage_info.module = stage.module;
+        stage_info.pName = stage.entry_point.c_str();
+
+        stages.push_back(stage_info);
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input{};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertex_bindings.size());
+    vertex_input.pVertexBindingDescriptions = desc.vertex_bindings.data();
+    vertex_input.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertex_attributes.size());
+    vertex_input.pVertexAttributeDescriptions = desc.vertex_attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = raster.topology;
+    input_assembly.primitiveRestartEnable = raster.primitive_restart;
+
+    VkPipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization{};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.depthClampEnable = raster.depth_clamp;
+    rasterization.polygonMode = raster.polygon_mode;
+    rasterization.cullMode = raster.cull_mode;
+    rasterization.frontFace = raster.front_face;
+    rasterization.depthBiasEnable = raster.depth_bias;
+    rasterization.lineWidth = raster.line_width;
+
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = desc.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = raster.depth_test;
+    depth_stencil.depthWriteEnable = raster.depth_write;
+    depth_stencil.depthCompareOp = raster.depth_compare;
+
+    // With a render pass the attachment count is not known here, the passes in use have one
+    size_t attachment_count = desc.render_pass == VK_NULL_HANDLE ? desc.color_formats.size() : std::max<size_t>(desc.blend.size(), 1);
+
+    VkPipelineColorBlendAttachmentState opaque{};
+    opaque.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments(attachment_count, opaque);
+    std::copy_n(desc.blend.begin(), std::min(desc.blend.size(), attachment_count), blend_attachments.begin());
+
+    VkPipelineColorBlendStateCreateInfo color_blend{};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = static_cast<uint32_t>(blend_attachments.size());
+    color_blend.pAttachments = blend_attachments.data();
+
+    std::vector<VkDynamicState> states = dynamic_states();
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(states.size());
+    dynamic_state.pDynamicStates = states.data();
+
+    VkPipelineRenderingCreateInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = static_cast<uint32_t>(desc.color_formats.size());
+    rendering_info.pColorAttachmentFormats = desc.color_formats.data();
+    rendering_info.depthAttachmentFormat = desc.depth_format;
+
+    VkGraphicsPipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.pNext = desc.render_pass == VK_NULL_HANDLE ? &rendering_info : nullptr;
+    create_info.stageCount = static_cast<uint32_t>(stages.size());
+    create_info.pStages = stages.data();
+    create_info.pVertexInputState = &vertex_input;
+    create_info.pInputAssemblyState = &input_assembly;
+    create_info.pViewportState = &viewport_state;
+    create_info.pRasterizationState = &rasterization;
+    create_info.pMultisampleState = &multisample;
+    create_info.pDepthStencilState = &depth_stencil;
+    create_info.pColorBlendState = &color_blend;
+    create_info.pDynamicState = &dynamic_state;
+    create_info.layout = desc.layout;
+    create_info.renderPass = desc.render_pass;
+    create_info.subpass = desc.subpass;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (m_device->pipeline_cache().create_graphics_pipeline(create_info, pipeline) != VK_SUCCESS)
+    {
+        LOG_ERROR("Pipeline Builder", "Failed to create graphics pipeline");
+        return VK_NULL_HANDLE;
+    }
+
+    return pipeline;
+}
+
+std::vector<VkDynamicState> PipelineBuilder::dynamic_states() const noexcept
+{
+    std::vector<VkDynamicState> states = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_LINE_WIDTH,
+        VK_DYNAMIC_STATE_DEPTH_BIAS
+    };
+
+    if (m_dynamic.extended)
+    {
+        states.insert(states.end(), {
+            VK_DYNAMIC_STATE_CULL_MODE,
+            VK_DYNAMIC_STATE_FRONT_FACE,
+            VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP
+        });
+    }
+
+    if (m_dynamic.extended2)
+    {
+        states.insert(states.end(), {
+            VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,
+            VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE
+        });
+    }
+
+    if (m_dynamic.polygon_mode)
+    {
+        states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+    }
+
+    if (m_dynamic.depth_clamp)
+    {
+        states.push_back(VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT);
+    }
+
+    return states;
+}
+
+void PipelineBuilder::collect_retired() noexcept
+{
+    auto done = std::remove_if(m_retired.begin(), m_retired.end(), [&](const RetiredPipeline &retired) {
+        if (!retired.in_use.is_complete())
+        {
+            return false;
+        }
+
+        vkDestroyPipeline(m_device->device(), retired.pipeline, nullptr);
+        return true;
+    });
+
+    m_retired.erase(done, m_retired.end());
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include <graphics/pipeline_cache.hpp>
+
+#include <log.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <unistd.h>
+
+namespace niqqa
+{
+namespace graphics
+{
+static uint64_t fnv1a(const void *data, size_t size) noexcept
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+bool PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path) noexcept
+{
+    m_device = device;
+    m_properties = properties;
+    m_path = path;
+
+    // Creation feedback is core in 1.3, which is what the instance asks for
+    m_creation_feedback = VK_API_VERSION_MINOR(properties.apiVersion) >= 3 || VK_API_VERSION_MAJOR(properties.apiVersion) > 1;
+
+    std::string data;
+
+    if (!m_path.empty() && load(data))
+    {
+        m_loaded_from_disk = true;
+        m_loaded_bytes = data.size();
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = m_loaded_from_disk ? data.size() : 0;
+    create_info.pInitialData = m_loaded_from_disk ? data.data() : nullptr;
+
+    LOG_INFO("Pipeline Cache", "Creating pipeline cache");
+
+    if (vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache) != VK_SUCCESS)
+    {
+        // A blob that passed validation can still be rejected, an empty cache is always fine
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        m_loaded_from_disk = false;
+        m_loaded_bytes = 0;
+
+        if (vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache) != VK_SUCCESS)
+        {
+            LOG_ERROR("Pipeline Cache", "Failed to create pipeline cache");
+            return false;
+        }
+    }
+
+    LOG_INFO("Pipeline Cache", m_loaded_from_disk ? "Pipeline cache loaded from " + m_path : std::string("Pipeline cache created empty"));
+
+    return true;
+}
+
+void PipelineCache::cleanup() noexcept
+{
+    if (m_cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    log_stats();
+    save();
+
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save() noexcept
+{
+    if (m_cache == VK_NULL_HANDLE || m_path.empty())
+    {
+        return false;
+    }
+
+    size_t data_size = 0;
+
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0)
+    {
+        return false;
+    }
+
+    std::vector<char> data(data_size);
+
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, data.data()) != VK_SUCCESS)
+    {
+        LOG_ERROR("Pipeline Cache", "Failed to get pipeline cache data");
+        return false;
+    }
+
+    FileHeader header{};
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.vendor_id = m_properties.vendorID;
+    header.device_id = m_properties.deviceID;
+    header.driver_version = m_properties.driverVersion;
+    std::memcpy(header.pipeline_cache_uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data_size;
+    header.checksum = fnv1a(data.data(), data_size);
+
+    // Write next to the target and rename over it, so a crash mid-save leaves the
+    // previous cache intact instead of a truncated one
+    std::string temp_path = m_path + ".tmp";
+
+    FILE *file = std::fopen(temp_path.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        LOG_ERROR("Pipeline Cache", "Failed to open " + temp_path);
+        return false;
+    }
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(data.data(), 1, data_size, file) == data_size &&
+                   std::fflush(file) == 0 &&
+                   fsync(fileno(file)) == 0;
+
+    std::fclose(file);
+
+    if (!written || std::rename(temp_path.c_str(), m_path.c_str()) != 0)
+    {
+        LOG_ERROR("Pipeline Cache", "Failed to write " + m_path);
+        std::remove(temp_path.c_str());
+
+        return false;
+    }
+
+    LOG_INFO("Pipeline Cache", "Saved " + std::to_string(data_size) + " bytes to " + m_path);
+
+    return true;
+}
+
+VkResult PipelineCache::create_graphics_pipeline(const VkGraphicsPipelineCreateInfo &create_info, VkPipeline &pipeline) noexcept
+{
+    VkGraphicsPipelineCreateInfo info = create_info;
+
+    VkPipelineCreationFeedback feedback{};
+
+    VkPipelineCreationFeedbackCreateInfo feedback_info{};
+    feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+    feedback_info.pPipelineCreationFeedback = &feedback;
+
+    if (m_creation_feedback)
+    {
+        feedback_info.pNext = info.pNext;
+        info.pNext = &feedback_info;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VkResult result = vkCreateGraphicsPipelines(m_device, m_cache, 1, &info, nullptr, &pipeline);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (result == VK_SUCCESS)
+    {
+        record_feedback(feedback, static_cast<uint64_t>(elapsed));
+    }
+
+    return result;
+}
+
+VkResult PipelineCache::create_compute_pipeline(const VkComputePipelineCreateInfo &create_info, VkPipeline &pipeline) noexcept
+{
+    VkComputePipelineCreateInfo info = create_info;
+
+    VkPipelineCreationFeedback feedback{};
+
+    VkPipelineCreationFeedbackCreateInfo feedback_info{};
+    feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+    feedback_info.pPipelineCreationFeedback = &feedback;
+
+    if (m_creation_feedback)
+    {
+        feedback_info.pNext = info.pNext;
+        info.pNext = &feedback_info;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VkResult result = vkCreateComputePipelines(m_device, m_cache, 1, &info, nullptr, &pipeline);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (result == VK_SUCCESS)
+    {
+        record_feedback(feedback, static_cast<uint64_t>(elapsed));
+    }
+
+    return result;
+}
+
+VkPipelineCache PipelineCache::cache() const noexcept
+{
+    return m_cache;
+}
+
+PipelineCacheStats PipelineCache::stats() const noexcept
+{
+    PipelineCacheStats stats;
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.unknown = m_unknown.load(std::memory_order_relaxed);
+    stats.creation_ms = static_cast<double>(m_creation_ns.load(std::memory_order_relaxed)) / 1000000.0;
+    stats.loaded_from_disk = m_loaded_from_disk;
+    stats.loaded_bytes = m_loaded_bytes;
+
+    return stats;
+}
+
+void PipelineCache::log_stats() const noexcept
+{
+    PipelineCacheStats current = stats();
+
+    LOG_INFO("Pipeline Cache", std::string(current.loaded_from_disk ? "Warm" : "Cold") + " start: " +
+                               std::to_string(current.hits) + " hits, " +
+                               std::to_string(current.misses) + " misses, " +
+                               std::to_string(current.unknown) + " unknown, " +
+                               std::to_string(current.creation_ms) + " ms spent creating pipelines");
+}
+
+bool PipelineCache::load(std::string &data) noexcept
+{
+    std::ifstream file(m_path, std::ios::binary);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (contents.size() < sizeof(FileHeader))
+    {
+        LOG_WARN("Pipeline Cache", "Ignoring truncated pipeline cache " + m_path);
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, contents.data(), sizeof(header));
+
+    data = contents.substr(sizeof(FileHeader));
+
+    if (!validate(header, data))
+    {
+        LOG_WARN("Pipeline Cache", "Ignoring pipeline cache from a different device, driver or build " + m_path);
+        data.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool PipelineCache::validate(const FileHeader &header, const std::string &data) const noexcept
+{
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION)
+    {
+        return false;
+    }
+
+    if (header.vendor_id != m_properties.vendorID ||
+        header.device_id != m_properties.deviceID ||
+        header.driver_version != m_properties.driverVersion ||
+        std::memcmp(header.pipeline_cache_uuid, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        return false;
+    }
+
+    if (header.data_size != data.size() || header.checksum != fnv1a(data.data(), data.size()))
+    {
+        return false;
+    }
+
+    // The driver's own header has to agree as well, drivers are not all equally careful
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+    {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne driver_header;
+    std::memcpy(&driver_header, data.data(), sizeof(driver_header));
+
+    return driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           driver_header.vendorID == m_properties.vendorID &&
+           driver_header.deviceID == m_properties.deviceID &&
+           std::memcmp(driver_header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::record_feedback(const VkPipelineCreationFeedback &feedback, uint64_t elapsed_ns) noexcept
+{
+    m_creation_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+
+    if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT))
+    {
+        m_unknown.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+} // namespace graphics
+} // namespace niqqa
@@ -0,0 +1,1302 @@
+#include <graphics/render_graph.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace niqqa
+{
+namespace graphics
+{
+static constexpr VkPipelineStageFlags2 DEPTH_TEST_STAGES =
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+static constexpr VkAccessFlags2 WRITE_ACCESS =
+    VK_ACCESS_2_SHADER_WRITE_BIT |
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT |
+    VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static bool ranges_overlap(VkDeviceSize a_offset, VkDeviceSize a_size, VkDeviceSize b_offset, VkDeviceSize b_size) noexcept
+{
+    return a_offset < b_offset + b_size && b_offset < a_offset + a_size;
+}
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+RenderGraphPass &RenderGraphPass::color(RenderGraphImage image, VkAttachmentLoadOp load_op, VkClearColorValue clear) noexcept
+{
+    bool load = load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    add_image(image,
+              VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT : VK_ACCESS_2_NONE),
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+              load,
+              true);
+
+    Attachment attachment;
+    attachment.image = image;
+    attachment.load_op = load_op;
+    attachment.clear.color = clear;
+
+    m_colors.push_back(attachment);
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::depth(RenderGraphImage image, VkAttachmentLoadOp load_op, float clear) noexcept
+{
+    add_image(image,
+              DEPTH_TEST_STAGES,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+              load_op == VK_ATTACHMENT_LOAD_OP_LOAD,
+              true);
+
+    m_depth.image = image;
+    m_depth.load_op = load_op;
+    m_depth.clear.depthStencil = {clear, 0};
+    m_depth.read_only = false;
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::depth_read(RenderGraphImage image) noexcept
+{
+    add_image(image,
+              DEPTH_TEST_STAGES,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+              true,
+              false);
+
+    m_depth.image = image;
+    m_depth.load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+    m_depth.store_op = VK_ATTACHMENT_STORE_OP_NONE;
+    m_depth.read_only = true;
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::sample(RenderGraphImage image, VkPipelineStageFlags2 stages) noexcept
+{
+    // Depth can be sampled in its read only attachment layout, so a pass may test and sample it at once
+    bool depth = is_depth_format(m_graph->m_images[image].format);
+
+    add_image(image,
+              shader_stages(stages),
+              VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+              depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_SAMPLED_BIT,
+              true,
+              false);
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::storage(RenderGraphImage image, bool write, VkPipelineStageFlags2 stages) noexcept
+{
+    add_image(image,
+              shader_stages(stages),
+              write ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+              VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT,
+              !write,
+              write);
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::copy_from(RenderGraphImage image) noexcept
+{
+    add_image(image,
+              VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+              VK_ACCESS_2_TRANSFER_READ_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+              true,
+              false);
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::copy_to(RenderGraphImage image) noexcept
+{
+    add_image(image,
+              VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+              VK_ACCESS_2_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              false,
+              true);
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::read(RenderGraphBuffer buffer, BufferUse use, VkPipelineStageFlags2 stages) noexcept
+{
+    switch (use)
+    {
+    case BufferUse::Vertex:
+        add_buffer(buffer, stages ? stages : VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, true, false);
+        break;
+    case BufferUse::Index:
+        add_buffer(buffer, stages ? stages : VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, true, false);
+        break;
+    case BufferUse::Indirect:
+        add_buffer(buffer, stages ? stages : VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, true, false);
+        break;
+    case BufferUse::Uniform:
+        add_buffer(buffer, shader_stages(stages), VK_ACCESS_2_UNIFORM_READ_BIT, true, false);
+        break;
+    case BufferUse::Storage:
+        add_buffer(buffer, shader_stages(stages), VK_ACCESS_2_SHADER_STORAGE_READ_BIT, true, false);
+        break;
+    case BufferUse::TransferSrc:
+    case BufferUse::TransferDst:
+        add_buffer(buffer, stages ? stages : VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, true, false);
+        break;
+    }
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::write(RenderGraphBuffer buffer, BufferUse use, VkPipelineStageFlags2 stages) noexcept
+{
+    // Only storage and transfers write, the other uses are read by fixed function stages
+    if (use == BufferUse::TransferDst || use == BufferUse::TransferSrc)
+    {
+        add_buffer(buffer, stages ? stages : VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, false, true);
+    }
+    else
+    {
+        // Storage writes include atomics, which read too
+        add_buffer(buffer, shader_stages(stages), VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, false, true);
+    }
+
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::side_effect() noexcept
+{
+    m_side_effect = true;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::secondary_contents() noexcept
+{
+    m_secondary_contents = true;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::execute(RenderGraphCallback callback) noexcept
+{
+    m_callback = std::move(callback);
+    return *this;
+}
+
+void RenderGraphPass::add_image(RenderGraphImage image,
+                                VkPipelineStageFlags2 stages,
+                                VkAccessFlags2 access,
+                                VkImageLayout layout,
+                                VkImageUsageFlags usage,
+                                bool read,
+                                bool write) noexcept
+{
+    // One access per image and pass, a pass can not have an image in two layouts at once
+    for (auto &existing : m_images)
+    {
+        if (existing.image != image)
+        {
+            continue;
+        }
+
+        if (existing.layout != layout)
+        {
+            LOG_WARN("Render Graph", "Pass " + m_name + " uses " + m_graph->m_images[image].name + " in two layouts, using GENERAL");
+            existing.layout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        existing.stages |= stages;
+        existing.access |= access;
+        existing.usage |= usage;
+        existing.read = existing.read || read;
+        existing.write = existing.write || write;
+        return;
+    }
+
+    m_images.push_back({image, stages, access, layout, usage, read, write});
+}
+
+void RenderGraphPass::add_buffer(RenderGraphBuffer buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access, bool read, bool write) noexcept
+{
+    for (auto &existing : m_buffers)
+    {
+        if (existing.buffer == buffer)
+        {
+            existing.stages |= stages;
+            existing.access |= access;
+            existing.read = existing.read || read;
+            existing.write = existing.write || write;
+            return;
+        }
+    }
+
+    m_buffers.push_back({buffer, stages, access, read, write});
+}
+
+VkPipelineStageFlags2 RenderGraphPass::shader_stages(VkPipelineStageFlags2 stages) const noexcept
+{
+    if (stages != 0)
+    {
+        return stages;
+    }
+
+    switch (m_type)
+    {
+    case RenderGraphPassType::Compute:
+        return VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    case RenderGraphPassType::Transfer:
+        return VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    default:
+        return VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    }
+}
+
+bool RenderGraph::init(Device &device) noexcept
+{
+    m_device = &device;
+
+    return true;
+}
+
+void RenderGraph::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    reset();
+
+    destroy_transients(m_physical, m_heaps);
+
+    for (auto &retired : m_retired)
+    {
+        destroy_transients(retired.images, retired.heaps);
+    }
+
+    m_retired.clear();
+    m_transient_signature.clear();
+    m_device = nullptr;
+}
+
+void RenderGraph::reset() noexcept
+{
+    m_passes.clear();
+    m_images.clear();
+    m_buffers.clear();
+    m_final_image_barriers.clear();
+    m_final_buffer_barriers.clear();
+    m_culled_passes = 0;
+}
+
+RenderGraphImage RenderGraph::import_image(const std::string &name,
+                                           const Image &image,
+                                           VkFormat format,
+                                           VkExtent2D extent,
+                                           const ImportedState &initial,
+                                           const ImportedState &final) noexcept
+{
+    ImageResource resource;
+    resource.name = name;
+    resource.image = image;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = is_depth_format(format) ? depth_aspect_flags(format) : VK_IMAGE_ASPECT_COLOR_BIT;
+    resource.imported = true;
+    resource.initial = initial;
+    resource.final = final;
+
+    m_images.push_back(std::move(resource));
+
+    return static_cast<RenderGraphImage>(m_images.size() - 1);
+}
+
+RenderGraphImage RenderGraph::create_image(const std::string &name, const TransientImageDesc &desc) noexcept
+{
+    ImageResource resource;
+    resource.name = name;
+    resource.format = desc.format;
+    resource.extent = desc.extent;
+    resource.aspect = is_depth_format(desc.format) ? depth_aspect_flags(desc.format) : VK_IMAGE_ASPECT_COLOR_BIT;
+    resource.desc = desc;
+
+    m_images.push_back(std::move(resource));
+
+    return static_cast<RenderGraphImage>(m_images.size() - 1);
+}
+
+RenderGraphBuffer RenderGraph::import_buffer(const std::string &name,
+                                             VkBuffer buffer,
+                                             VkDeviceSize offset,
+                                             VkDeviceSize size,
+                                             const ImportedState &initial,
+                                             const ImportedState &final) noexcept
+{
+    BufferResource resource;
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.offset = offset;
+    resource.size = size;
+    resource.initial = initial;
+    resource.final = final;
+
+    m_buffers.push_back(std::move(resource));
+
+    return static_cast<RenderGraphBuffer>(m_buffers.size() - 1);
+}
+
+RenderGraphPass &RenderGraph::add_pass(const std::string &name, RenderGraphPassType type) noexcept
+{
+    RenderGraphPass &pass = m_passes.emplace_back();
+    pass.m_graph = this;
+    pass.m_name = name;
+    pass.m_type = type;
+
+    return pass;
+}
+
+bool RenderGraph::compile() noexcept
+{
+    collect_retired();
+
+    cull_passes();
+    compute_lifetimes();
+
+    if (!allocate_transients())
+    {
+        return false;
+    }
+
+    build_barriers();
+    choose_store_ops();
+
+    return true;
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, FrameQueries *queries) noexcept
+{
+    for (const auto &pass : m_passes)
+    {
+        if (pass.m_culled)
+        {
+            continue;
+        }
+
+        uint32_t query = queries != nullptr ? queries->begin_pass(command_buffer, pass.m_name.c_str()) : 0;
+
+        if (!pass.m_image_barriers.empty() || !pass.m_buffer_barriers.empty())
+        {
+            VkDependencyInfo dependency_info{};
+            dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(pass.m_image_barriers.size());
+            dependency_info.pImageMemoryBarriers = pass.m_image_barriers.data();
+            dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(pass.m_buffer_barriers.size());
+            dependency_info.pBufferMemoryBarriers = pass.m_buffer_barriers.data();
+
+            vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+        }
+
+        bool rendering = !pass.m_colors.empty() || pass.m_depth.image != INVALID_GRAPH_RESOURCE;
+
+        if (rendering)
+        {
+            begin_rendering(command_buffer, pass);
+        }
+
+        if (pass.m_callback)
+        {
+            pass.m_callback(command_buffer, *this);
+        }
+
+        if (rendering)
+        {
+            vkCmdEndRendering(command_buffer);
+        }
+
+        if (queries != nullptr)
+        {
+            queries->end_pass(command_buffer, query);
+        }
+    }
+
+    if (!m_final_image_barriers.empty() || !m_final_buffer_barriers.empty())
+    {
+        VkDependencyInfo dependency_info{};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(m_final_image_barriers.size());
+        dependency_info.pImageMemoryBarriers = m_final_image_barriers.data();
+        dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(m_final_buffer_barriers.size());
+        dependency_info.pBufferMemoryBarriers = m_final_buffer_barriers.data();
+
+        vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+}
+
+const Image &RenderGraph::image(RenderGraphImage handle) const noexcept
+{
+    return m_images[handle].image;
+}
+
+VkExtent2D RenderGraph::extent(RenderGraphImage handle) const noexcept
+{
+    return m_images[handle].extent;
+}
+
+VkFormat RenderGraph::format(RenderGraphImage handle) const noexcept
+{
+    return m_images[handle].format;
+}
+
+VkBuffer RenderGraph::buffer(RenderGraphBuffer handle) const noexcept
+{
+    return m_buffers[handle].buffer;
+}
+
+uint32_t RenderGraph::culled_pass_count() const noexcept
+{
+    return m_culled_passes;
+}
+
+VkDeviceSize RenderGraph::transient_bytes() const noexcept
+{
+    VkDeviceSize bytes = 0;
+
+    for (const auto &heap : m_heaps)
+    {
+        bytes += heap.size;
+    }
+
+    for (const auto &physical : m_physical)
+    {
+        bytes += physical.allocation.size;
+    }
+
+    return bytes;
+}
+
+VkDeviceSize RenderGraph::unaliased_bytes() const noexcept
+{
+    return m_unaliased_bytes;
+}
+
+void RenderGraph::cull_passes() noexcept
+{
+    // Reference counting from the outputs back: a pass survives while something reads what it writes
+    std::vector<uint32_t> pass_refs(m_passes.size(), 0);
+
+    for (auto &image : m_images)
+    {
+        image.readers = image.imported ? 1 : 0;
+        image.writers.clear();
+    }
+
+    for (auto &buffer : m_buffers)
+    {
+        buffer.readers = 1;
+        buffer.writers.clear();
+    }
+
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        RenderGraphPass &pass = m_passes[i];
+        pass.m_culled = false;
+
+        for (const auto &access : pass.m_images)
+        {
+            if (access.read)
+            {
+                ++m_images[access.image].readers;
+            }
+
+            if (access.write)
+            {
+                m_images[access.image].writers.push_back(i);
+                ++pass_refs[i];
+            }
+        }
+
+        for (const auto &access : pass.m_buffers)
+        {
+            if (access.read)
+            {
+                ++m_buffers[access.buffer].readers;
+            }
+
+            if (access.write)
+            {
+                m_buffers[access.buffer].writers.push_back(i);
+                ++pass_refs[i];
+            }
+        }
+    }
+
+    // Imported buffers count as read from outside, so only transient images start the walk
+    std::vector<RenderGraphImage> unread;
+
+    for (uint32_t i = 0; i < m_images.size(); ++i)
+    {
+        if (m_images[i].readers == 0)
+        {
+            unread.push_back(i);
+        }
+    }
+
+    m_culled_passes = 0;
+
+    while (!unread.empty())
+    {
+        RenderGraphImage image = unread.back();
+        unread.pop_back();
+
+        for (uint32_t writer : m_images[image].writers)
+        {
+            RenderGraphPass &pass = m_passes[writer];
+
+            if (pass.m_culled || pass.m_side_effect || --pass_refs[writer] > 0)
+            {
+                continue;
+            }
+
+            pass.m_culled = true;
+            ++m_culled_passes;
+
+            for (const auto &access : pass.m_images)
+            {
+                if (access.read && --m_images[access.image].readers == 0)
+                {
+                    unread.push_back(access.image);
+                }
+            }
+        }
+    }
+}
+
+void RenderGraph::compute_lifetimes() noexcept
+{
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        if (m_passes[i].m_culled)
+        {
+            continue;
+        }
+
+        for (const auto &access : m_passes[i].m_images)
+        {
+            ImageResource &image = m_images[access.image];
+
+            image.first_use = std::min(image.first_use, i);
+            image.last_use = std::max(image.last_use, i);
+            image.usage |= access.usage;
+        }
+    }
+}
+
+bool RenderGraph::allocate_transients() noexcept
+{
+    // Everything that decides which images exist and where they may alias
+    std::string signature;
+
+    for (const auto &image : m_images)
+    {
+        if (image.imported || image.first_use == UINT32_MAX)
+        {
+            continue;
+        }
+
+        signature.append(reinterpret_cast<const char *>(&image.desc), sizeof(image.desc));
+        signature.append(reinterpret_cast<const char *>(&image.usage), sizeof(image.usage));
+        signature.append(reinterpret_cast<const char *>(&image.first_use), sizeof(image.first_use));
+        signature.append(reinterpret_cast<const char *>(&image.last_use), sizeof(image.last_use));
+    }
+
+    if (signature != m_transient_signature)
+    {
+        // Frames already submitted may still use the old images
+        if (!m_physical.empty() || !m_heaps.empty())
+        {
+            RetiredTransients retired;
+            retired.images = std::move(m_physical);
+            retired.heaps = std::move(m_heaps);
+            retired.in_use = m_device->graphics_timeline().last_submitted();
+
+            m_retired.push_back(std::move(retired));
+        }
+
+        m_physical.clear();
+        m_heaps.clear();
+        m_transient_signature.clear();
+        m_unaliased_bytes = 0;
+
+        VkDevice device = m_device->device();
+
+        for (auto &image : m_images)
+        {
+            if (image.imported || image.first_use == UINT32_MAX)
+            {
+                continue;
+            }
+
+            VkImageCreateInfo image_info{};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = image.desc.format;
+            image_info.extent = {image.desc.extent.width, image.desc.extent.height, 1};
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = image.desc.samples;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = image.usage;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            PhysicalImage physical;
+
+            if (vkCreateImage(device, &image_info, nullptr, &physical.image.image) != VK_SUCCESS)
+            {
+                LOG_ERROR("Render Graph", "Failed to create transient image " + image.name);
+                return false;
+            }
+
+            VkMemoryDedicatedRequirements dedicated_requirements{};
+            dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+            VkMemoryRequirements2 requirements{};
+            requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+            requirements.pNext = &dedicated_requirements;
+
+            VkImageMemoryRequirementsInfo2 requirements_info{};
+            requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+            requirements_info.image = physical.image.image;
+
+            vkGetImageMemoryRequirements2(device, &requirements_info, &requirements);
+
+            physical.requirements = requirements.memoryRequirements;
+            m_unaliased_bytes += physical.requirements.size;
+
+            // Images that insist on their own memory can not share any
+            if (dedicated_requirements.requiresDedicatedAllocation &&
+                !m_device->allocator().allocate_image(physical.image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, physical.allocation, true))
+            {
+                vkDestroyImage(device, physical.image.image, nullptr);
+                LOG_ERROR("Render Graph", "Failed to allocate transient image " + image.name);
+                return false;
+            }
+
+            image.physical = static_cast<uint32_t>(m_physical.size());
+            m_physical.push_back(physical);
+        }
+
+        place_in_heaps();
+
+        for (auto &heap : m_heaps)
+        {
+            VkMemoryRequirements requirements{};
+            requirements.size = heap.size;
+            requirements.alignment = heap.alignment;
+            requirements.memoryTypeBits = heap.memory_type_bits;
+
+            if (!m_device->allocator().allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, heap.allocation))
+            {
+                LOG_ERROR("Render Graph", "Failed to allocate transient memory");
+                return false;
+            }
+        }
+
+        for (auto &image : m_images)
+        {
+            if (image.physical == UINT32_MAX)
+            {
+                continue;
+            }
+
+            PhysicalImage &physical = m_physical[image.physical];
+
+            if (physical.heap != UINT32_MAX)
+            {
+                const Allocation &allocation = m_heaps[physical.heap].allocation;
+
+                vkBindImageMemory(device, physical.image.image, allocation.memory, allocation.offset + physical.offset);
+            }
+
+            physical.image.image_view = create_image_view(device, physical.image.image, image.format, image.aspect);
+
+            if (physical.image.image_view == VK_NULL_HANDLE)
+            {
+                LOG_ERROR("Render Graph", "Failed to create view of transient image " + image.name);
+                return false;
+            }
+        }
+
+        m_transient_signature = std::move(signature);
+
+        LOG_INFO("Render Graph", "Transient images take " + std::to_string(transient_bytes() / 1024) + " KiB, " +
+                                 std::to_string(m_unaliased_bytes / 1024) + " KiB without aliasing");
+    }
+    else
+    {
+        // Same images in the same order as when they were created
+        uint32_t physical = 0;
+
+        for (auto &image : m_images)
+        {
+            if (!image.imported && image.first_use != UINT32_MAX)
+            {
+                image.physical = physical++;
+            }
+        }
+    }
+
+    for (auto &image : m_images)
+    {
+        if (image.physical != UINT32_MAX)
+        {
+            image.image = m_physical[image.physical].image;
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::place_in_heaps() noexcept
+{
+    // Biggest first, each at the lowest offset no image alive at the same time occupies
+    std::vector<RenderGraphImage> order;
+
+    for (uint32_t i = 0; i < m_images.size(); ++i)
+    {
+        if (m_images[i].physical != UINT32_MAX && m_physical[m_images[i].physical].allocation.memory == VK_NULL_HANDLE)
+        {
+            order.push_back(i);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&](RenderGraphImage a, RenderGraphImage b) {
+        return m_physical[m_images[a].physical].requirements.size > m_physical[m_images[b].physical].requirements.size;
+    });
+
+    std::vector<RenderGraphImage> placed;
+
+    for (RenderGraphImage index : order)
+    {
+        const ImageResource &image = m_images[index];
+        PhysicalImage &physical = m_physical[image.physical];
+
+        // Images only share a heap when one memory type suits all of them
+        uint32_t heap_index = UINT32_MAX;
+
+        for (uint32_t h = 0; h < m_heaps.size(); ++h)
+        {
+            if (m_heaps[h].memory_type_bits == physical.requirements.memoryTypeBits)
+            {
+                heap_index = h;
+                break;
+            }
+        }
+
+        if (heap_index == UINT32_MAX)
+        {
+            Heap heap;
+            heap.memory_type_bits = physical.requirements.memoryTypeBits;
+
+            heap_index = static_cast<uint32_t>(m_heaps.size());
+            m_heaps.push_back(heap);
+        }
+
+        Heap &heap = m_heaps[heap_index];
+
+        // Candidates are the start of the heap and the end of every live neighbour
+        std::vector<VkDeviceSize> candidates{0};
+        std::vector<const PhysicalImage *> neighbours;
+
+        for (RenderGraphImage other_index : placed)
+        {
+            const ImageResource &other = m_images[other_index];
+            const PhysicalImage &other_physical = m_physical[other.physical];
+
+            bool lifetimes_overlap = image.first_use <= other.last_use && other.first_use <= image.last_use;
+
+            if (other_physical.heap == heap_index && lifetimes_overlap)
+            {
+                neighbours.push_back(&other_physical);
+                candidates.push_back(other_physical.offset + other_physical.requirements.size);
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+
+        VkDeviceSize alignment = physical.requirements.alignment;
+        VkDeviceSize size = physical.requirements.size;
+
+        for (VkDeviceSize candidate : candidates)
+        {
+            VkDeviceSize offset = align_up(candidate, alignment);
+
+            bool free = std::none_of(neighbours.begin(), neighbours.end(), [&](const PhysicalImage *neighbour) {
+                return ranges_overlap(offset, size, neighbour->offset, neighbour->requirements.size);
+            });
+
+            if (free)
+            {
+                physical.offset = offset;
+                break;
+            }
+        }
+
+        physical.heap = heap_index;
+        heap.alignment = std::max(heap.alignment, alignment);
+        heap.size = std::max(heap.size, physical.offset + size);
+
+        placed.push_back(index);
+    }
+}
+
+bool RenderGraph::images_alias(const ImageResource &a, const ImageResource &b) const noexcept
+{
+    if (a.physical == UINT32_MAX || b.physical == UINT32_MAX)
+    {
+        return false;
+    }
+
+    const PhysicalImage &pa = m_physical[a.physical];
+    const PhysicalImage &pb = m_physical[b.physical];
+
+    if (a.physical == b.physical)
+    {
+        return true;
+    }
+
+    return pa.heap != UINT32_MAX && pa.heap == pb.heap &&
+           ranges_overlap(pa.offset, pa.requirements.size, pb.offset, pb.requirements.size);
+}
+
+void RenderGraph::build_barriers() noexcept
+{
+    std::vector<ResourceState> image_states(m_images.size());
+    std::vector<ResourceState> buffer_states(m_buffers.size());
+
+    // Whatever the frame starts with counts as a write still in flight
+    for (size_t i = 0; i < m_images.size(); ++i)
+    {
+        if (m_images[i].imported)
+        {
+            image_states[i].layout = m_images[i].initial.layout;
+            image_states[i].write_stages = m_images[i].initial.stages;
+            image_states[i].write_access = m_images[i].initial.access;
+        }
+    }
+
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        buffer_states[i].write_stages = m_buffers[i].initial.stages;
+        buffer_states[i].write_access = m_buffers[i].initial.access;
+    }
+
+    // First uses of transient memory whose previous user is last frame's, patched once every final state is known
+    struct PendingFirstUse
+    {
+        uint32_t pass;
+        size_t barrier;
+        RenderGraphImage image;
+    };
+
+    std::vector<PendingFirstUse> pending;
+
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        RenderGraphPass &pass = m_passes[i];
+
+        pass.m_image_barriers.clear();
+        pass.m_buffer_barriers.clear();
+
+        if (pass.m_culled)
+        {
+            continue;
+        }
+
+        for (const auto &access : pass.m_images)
+        {
+            ImageResource &image = m_images[access.image];
+            ResourceState &state = image_states[access.image];
+
+            bool first_transient_use = !image.imported && image.first_use == i;
+            bool has_predecessor = false;
+
+            // Aliased memory was last used by whatever image occupied it before, wait for that
+            if (first_transient_use)
+            {
+                for (uint32_t other = 0; other < m_images.size(); ++other)
+                {
+                    if (other != access.image && images_alias(image, m_images[other]) && m_images[other].last_use < i)
+                    {
+                        state.write_stages |= image_states[other].write_stages | image_states[other].read_stages;
+                        state.write_access |= image_states[other].write_access;
+                        has_predecessor = true;
+                    }
+                }
+            }
+
+            VkPipelineStageFlags2 src_stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+            bool barrier = false;
+
+            if (access.layout != state.layout || access.write)
+            {
+                // Layout changes and writes wait on everything before, reads included
+                src_stages = state.write_stages | state.read_stages;
+                src_access = state.write_access;
+                barrier = access.layout != state.layout || src_stages != VK_PIPELINE_STAGE_2_NONE;
+            }
+            else if (state.write_stages != VK_PIPELINE_STAGE_2_NONE &&
+                     ((access.stages & ~state.visible_stages) != 0 || (access.access & ~state.visible_access) != 0))
+            {
+                // Reading a write that was not made visible to this stage yet
+                src_stages = state.write_stages;
+                src_access = state.write_access;
+                barrier = true;
+            }
+
+            if (barrier)
+            {
+                VkImageMemoryBarrier2 image_barrier{};
+                image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+                image_barrier.srcStageMask = src_stages;
+                image_barrier.srcAccessMask = src_access;
+                image_barrier.dstStageMask = access.stages;
+                image_barrier.dstAccessMask = access.access;
+                image_barrier.oldLayout = first_transient_use ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                image_barrier.newLayout = access.layout;
+                image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                image_barrier.image = image.image.image;
+                image_barrier.subresourceRange = {image.aspect, 0, 1, 0, 1};
+
+                if (first_transient_use && !has_predecessor)
+                {
+                    pending.push_back({i, pass.m_image_barriers.size(), access.image});
+                }
+
+                pass.m_image_barriers.push_back(image_barrier);
+            }
+
+            bool transitioned = access.layout != state.layout;
+            state.layout = access.layout;
+
+            if (access.write)
+            {
+                state.write_stages = access.stages;
+                state.write_access = access.access & WRITE_ACCESS;
+                state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+                state.visible_stages = access.stages;
+                state.visible_access = access.access;
+            }
+            else if (transitioned)
+            {
+                // A transition is a write itself, made visible to this access only
+                state.write_stages = access.stages;
+                state.write_access = VK_ACCESS_2_NONE;
+                state.read_stages = access.stages;
+                state.visible_stages = access.stages;
+                state.visible_access = access.access;
+            }
+            else
+            {
+                state.read_stages |= access.stages;
+
+                if (barrier)
+                {
+                    state.visible_stages |= access.stages;
+                    state.visible_access |= access.access;
+                }
+            }
+        }
+
+        for (const auto &access : pass.m_buffers)
+        {
+            BufferResource &buffer = m_buffers[access.buffer];
+            ResourceState &state = buffer_states[access.buffer];
+
+            VkPipelineStageFlags2 src_stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+
+            if (access.write)
+            {
+                src_stages = state.write_stages | state.read_stages;
+                src_access = state.write_access;
+            }
+            else if (state.write_stages != VK_PIPELINE_STAGE_2_NONE &&
+                     ((access.stages & ~state.visible_stages) != 0 || (access.access & ~state.visible_access) != 0))
+            {
+                src_stages = state.write_stages;
+                src_access = state.write_access;
+            }
+
+            if (src_stages != VK_PIPELINE_STAGE_2_NONE)
+            {
+                VkBufferMemoryBarrier2 buffer_barrier{};
+                buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+                buffer_barrier.srcStageMask = src_stages;
+                buffer_barrier.srcAccessMask = src_access;
+                buffer_barrier.dstStageMask = access.stages;
+                buffer_barrier.dstAccessMask = access.access;
+                buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                buffer_barrier.buffer = buffer.buffer;
+                buffer_barrier.offset = buffer.offset;
+                buffer_barrier.size = buffer.size;
+
+                pass.m_buffer_barriers.push_back(buffer_barrier);
+            }
+
+            if (access.write)
+            {
+                state.write_stages = access.stages;
+                state.write_access = access.access & WRITE_ACCESS;
+                state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+                state.visible_stages = access.stages;
+                state.visible_access = access.access;
+            }
+            else
+            {
+                state.read_stages |= access.stages;
+
+                if (src_stages != VK_PIPELINE_STAGE_2_NONE)
+                {
+                    state.visible_stages |= access.stages;
+                    state.visible_access |= access.access;
+                }
+            }
+        }
+    }
+
+    // The layout is the same every frame, so last frame's final users of the memory are this frame's too
+    for (const auto &first_use : pending)
+    {
+        VkImageMemoryBarrier2 &image_barrier = m_passes[first_use.pass].m_image_barriers[first_use.barrier];
+
+        for (uint32_t other = 0; other < m_images.size(); ++other)
+        {
+            if (images_alias(m_images[first_use.image], m_images[other]))
+            {
+                image_barrier.srcStageMask |= image_states[other].write_stages | image_states[other].read_stages;
+                image_barrier.srcAccessMask |= image_states[other].write_access;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < m_images.size(); ++i)
+    {
+        const ImageResource &image = m_images[i];
+        const ResourceState &state = image_states[i];
+
+        if (!image.imported || image.final.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+        {
+            continue;
+        }
+
+        if (image.final.layout == state.layout && image.final.access == VK_ACCESS_2_NONE)
+        {
+            continue;
+        }
+
+        VkImageMemoryBarrier2 image_barrier{};
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        image_barrier.srcStageMask = state.write_stages | state.read_stages;
+        image_barrier.srcAccessMask = state.write_access;
+        image_barrier.dstStageMask = image.final.stages;
+        image_barrier.dstAccessMask = image.final.access;
+        image_barrier.oldLayout = state.layout;
+        image_barrier.newLayout = image.final.layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = image.image.image;
+        image_barrier.subresourceRange = {image.aspect, 0, 1, 0, 1};
+
+        m_final_image_barriers.push_back(image_barrier);
+    }
+
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        const BufferResource &buffer = m_buffers[i];
+        const ResourceState &state = buffer_states[i];
+
+        if (buffer.final.stages == VK_PIPELINE_STAGE_2_NONE || state.write_stages == VK_PIPELINE_STAGE_2_NONE)
+        {
+            continue;
+        }
+
+        VkBufferMemoryBarrier2 buffer_barrier{};
+        buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        buffer_barrier.srcStageMask = state.write_stages | state.read_stages;
+        buffer_barrier.srcAccessMask = state.write_access;
+        buffer_barrier.dstStageMask = buffer.final.stages;
+        buffer_barrier.dstAccessMask = buffer.final.access;
+        buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.buffer = buffer.buffer;
+        buffer_barrier.offset = buffer.offset;
+        buffer_barrier.size = buffer.size;
+
+        m_final_buffer_barriers.push_back(buffer_barrier);
+    }
+}
+
+void RenderGraph::choose_store_ops() noexcept
+{
+    // Attachments nobody reads afterwards never have to leave tile memory
+    std::vector<uint32_t> last_read(m_images.size(), 0);
+    std::vector<bool> read_later(m_images.size(), false);
+
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        if (m_passes[i].m_culled)
+        {
+            continue;
+        }
+
+        for (const auto &access : m_passes[i].m_images)
+        {
+            if (access.read)
+            {
+                last_read[access.image] = i;
+                read_later[access.image] = true;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        RenderGraphPass &pass = m_passes[i];
+
+        auto store_op = [&](RenderGraphImage image) {
+            bool kept = m_images[image].imported && m_images[image].final.preserve;
+            bool needed = kept || (read_later[image] && last_read[image] > i);
+            return needed ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        };
+
+        for (auto &attachment : pass.m_colors)
+        {
+            attachment.store_op = store_op(attachment.image);
+        }
+
+        if (pass.m_depth.image != INVALID_GRAPH_RESOURCE && !pass.m_depth.read_only)
+        {
+            pass.m_depth.store_op = store_op(pass.m_depth.image);
+        }
+    }
+}
+
+void RenderGraph::begin_rendering(VkCommandBuffer command_buffer, const RenderGraphPass &pass) const noexcept
+{
+    std::vector<VkRenderingAttachmentInfo> color_attachments;
+    color_attachments.reserve(pass.m_colors.size());
+
+    for (const auto &attachment : pass.m_colors)
+    {
+        VkRenderingAttachmentInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        info.imageView = m_images[attachment.image].image.image_view;
+        info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        info.loadOp = attachment.load_op;
+        info.storeOp = attachment.store_op;
+        info.clearValue = attachment.clear;
+
+        color_attachments.push_back(info);
+    }
+
+    VkRenderingAttachmentInfo depth_attachment{};
+
+    if (pass.m_depth.image != INVALID_GRAPH_RESOURCE)
+    {
+        depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depth_attachment.imageView = m_images[pass.m_depth.image].image.image_view;
+        depth_attachment.imageLayout = pass.m_depth.read_only ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depth_attachment.loadOp = pass.m_depth.load_op;
+        depth_attachment.storeOp = pass.m_depth.store_op;
+        depth_attachment.clearValue = pass.m_depth.clear;
+    }
+
+    RenderGraphImage first = pass.m_colors.empty() ? pass.m_depth.image : pass.m_colors.front().image;
+
+    VkRenderingInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.flags = pass.m_secondary_contents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    rendering_info.renderArea.offset = {0, 0};
+    rendering_info.renderArea.extent = m_images[first].extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = static_cast<uint32_t>(color_attachments.size());
+    rendering_info.pColorAttachments = color_attachments.data();
+    rendering_info.pDepthAttachment = pass.m_depth.image != INVALID_GRAPH_RESOURCE ? &depth_attachment : nullptr;
+
+    vkCmdBeginRendering(command_buffer, &rendering_info);
+}
+
+void RenderGraph::destroy_transients(std::vector<PhysicalImage> &images, std::vector<Heap> &heaps) noexcept
+{
+    VkDevice device = m_device->device();
+
+    for (auto &physical : images)
+    {
+        if (physical.image.image_view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device, physical.image.image_view, nullptr);
+        }
+
+        vkDestroyImage(device, physical.image.image, nullptr);
+
+        if (physical.allocation.is_valid())
+        {
+            m_device->allocator().free(physical.allocation);
+        }
+    }
+
+    for (auto &heap : heaps)
+    {
+        if (heap.allocation.is_valid())
+        {
+            m_device->allocator().free(heap.allocation);
+        }
+    }
+
+    images.clear();
+    heaps.clear();
+}
+
+void RenderGraph::collect_retired() noexcept
+{
+    for (auto it = m_retired.begin(); it != m_retired.end();)
+    {
+        if (it->in_use.is_complete())
+        {
+            destroy_transients(it->images, it->heaps);
+            it = m_retired.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -6,7 +6,10 @@ namespace niqqa
 {
 namespace graphics
 {
-bool RenderPass::init(VkDevice device, VkFormat color_format, VkFormat depth_format) noexcept
+bool RenderPass::init(VkDevice device,
+                      VkFormat color_format,
+                      VkFormat depth_format,
+                      VkImageLayout color_final_layout) noexcept
 {
     VkAttachmentDescription color_attachment{};
     color_attachment.format = color_format;
@@ -14,7 +17,7 @@ bool RenderPass::init(VkDevice device, VkFormat color_format, VkFormat depth_for
     color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout = color_final_layout;
 
     VkAttachmentDescription depth_attachment{};
     depth_attachment.format = depth_format;
@@ -40,10 +43,10 @@ bool RenderPass::init(VkDevice device, VkFormat color_format, VkFormat depth_for
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     VkAttachmentDescription attachments[] = {
         color_attachment,
@@ -52,7 +55,7 @@ bool RenderPass::init(VkDevice device, VkFormat color_format, VkFormat depth_for
 
     VkRenderPassCreateInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.attachmentCount = 1;
+    render_pass_info.attachmentCount = 2;
     render_pass_info.pAttachments = attachments;
     render_pass_info.dependencyCount = 1;
     render_pass_info.pDependencies = &dependency;
@@ -0,0 +1,841 @@
+#include <graphics/shader_manager.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+#ifdef NIQQA_HAS_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace niqqa
+{
+namespace graphics
+{
+static constexpr uint32_t SPIRV_MAGIC{0x07230203};
+
+static uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) noexcept
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool read_file(const std::string &path, std::string &contents) noexcept
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    return true;
+}
+
+static std::string normalize_path(const std::string &path) noexcept
+{
+    std::error_code error;
+    std::filesystem::path normalized = std::filesystem::weakly_canonical(path, error);
+
+    return error ? std::filesystem::path(path).lexically_normal().string() : normalized.string();
+}
+
+static bool ends_with(const std::string &value, const std::string &suffix) noexcept
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+#ifdef NIQQA_HAS_SHADERC
+static shaderc_shader_kind shader_kind(VkShaderStageFlagBits stage) noexcept
+{
+    switch (stage)
+    {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        return shaderc_vertex_shader;
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return shaderc_fragment_shader;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return shaderc_compute_shader;
+    case VK_SHADER_STAGE_GEOMETRY_BIT:
+        return shaderc_geometry_shader;
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+        return shaderc_tess_control_shader;
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+        return shaderc_tess_evaluation_shader;
+    default:
+        return shaderc_glsl_infer_from_source;
+    }
+}
+
+// Owns the strings a shaderc_include_result points into until shaderc releases it
+struct IncludeResult
+{
+    shaderc_include_result result{};
+    std::string name;
+    std::string content;
+};
+
+struct IncludeContext
+{
+    const ShaderManager *manager;
+    std::string (*resolve)(const ShaderManager *manager, const std::string &name, const std::string &includer);
+};
+
+static shaderc_include_result *resolve_include_callback(void *user_data,
+                                                        const char *requested_source,
+                                                        int,
+                                                        const char *requesting_source,
+                                                        size_t) noexcept
+{
+    IncludeContext *context = static_cast<IncludeContext *>(user_data);
+    IncludeResult *include = new IncludeResult;
+
+    include->name = context->resolve(context->manager, requested_source, requesting_source);
+
+    // shaderc reports an empty name as a failed include, with content as the message
+    if (include->name.empty() || !read_file(include->name, include->content))
+    {
+        include->name.clear();
+        include->content = std::string("Cannot find include ") + requested_source;
+    }
+
+    include->result.source_name = include->name.c_str();
+    include->result.source_name_length = include->name.size();
+    include->result.content = include->content.c_str();
+    include->result.content_length = include->content.size();
+    include->result.user_data = include;
+
+    return &include->result;
+}
+
+static void release_include_callback(void *, shaderc_include_result *result) noexcept
+{
+    delete static_cast<IncludeResult *>(result->user_data);
+}
+#endif
+
+bool ShaderManager::init(Device &device, const std::string &root, const std::string &cache_dir, bool watch) noexcept
+{
+    m_device = device.device();
+    m_root = normalize_path(root);
+    m_cache_dir = cache_dir;
+
+    std::error_code error;
+    std::filesystem::create_directories(m_cache_dir, error);
+
+    if (error)
+    {
+        LOG_WARN("Shader Manager", "Cannot create shader cache directory " + m_cache_dir + ", compiled shaders will not be cached");
+    }
+
+#ifdef NIQQA_HAS_SHADERC
+    m_compiler = shaderc_compiler_initialize();
+
+    if (m_compiler == nullptr)
+    {
+        LOG_ERROR("Shader Manager", "Failed to create shader compiler");
+        return false;
+    }
+#else
+    LOG_WARN("Shader Manager", "Built without shaderc, only SPIR-V and cached shaders can be loaded");
+#endif
+
+    if (watch && !start_watching())
+    {
+        LOG_WARN("Shader Manager", "Cannot watch " + m_root + ", hot reload disabled");
+    }
+
+    LOG_INFO("Shader Manager", "Shader manager created");
+
+    return true;
+}
+
+void ShaderManager::cleanup() noexcept
+{
+    m_running = false;
+
+    if (m_watcher.joinable())
+    {
+        m_watcher.join();
+    }
+
+#ifdef __linux__
+    if (m_inotify >= 0)
+    {
+        close(m_inotify);
+        m_inotify = -1;
+    }
+#endif
+
+    m_watch_dirs.clear();
+
+    for (auto &shader : m_shaders)
+    {
+        if (shader.module != VK_NULL_HANDLE)
+        {
+            vkDestroyShaderModule(m_device, shader.module, nullptr);
+        }
+    }
+
+    m_shaders.clear();
+    m_completed.clear();
+    m_requests.clear();
+
+#ifdef NIQQA_HAS_SHADERC
+    if (m_compiler != nullptr)
+    {
+        shaderc_compiler_release(static_cast<shaderc_compiler_t>(m_compiler));
+        m_compiler = nullptr;
+    }
+#endif
+}
+
+ShaderHandle ShaderManager::load(const ShaderDesc &desc) noexcept
+{
+    CompiledShader compiled;
+
+    if (!compile(desc, compiled))
+    {
+        return INVALID_HANDLE;
+    }
+
+    VkShaderModule module = create_module(compiled.spirv);
+
+    if (module == VK_NULL_HANDLE)
+    {
+        return INVALID_HANDLE;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ShaderEntry entry;
+    entry.desc = desc;
+    entry.module = module;
+    entry.hash = compiled.hash;
+    entry.reflection = std::move(compiled.reflection);
+    entry.dependencies = std::move(compiled.dependencies);
+
+    m_shaders.push_back(std::move(entry));
+
+    return static_cast<ShaderHandle>(m_shaders.size() - 1);
+}
+
+VkShaderModule ShaderManager::module(ShaderHandle handle) const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return handle < m_shaders.size() ? m_shaders[handle].module : VK_NULL_HANDLE;
+}
+
+const ShaderDesc &ShaderManager::desc(ShaderHandle handle) const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_shaders[handle].desc;
+}
+
+const ShaderReflection &ShaderManager::reflection(ShaderHandle handle) const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_shaders[handle].reflection;
+}
+
+ShaderReloadCallbackId ShaderManager::on_reload(ShaderHandle handle, ShaderReloadCallback callback) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle >= m_shaders.size())
+    {
+        return INVALID_CALLBACK;
+    }
+
+    ShaderReloadCallbackId id = m_next_callback++;
+
+    m_shaders[handle].callbacks.emplace_back(id, std::move(callback));
+
+    return id;
+}
+
+void ShaderManager::remove_reload_callback(ShaderHandle handle, ShaderReloadCallbackId id) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle >= m_shaders.size())
+    {
+        return;
+    }
+
+    auto &callbacks = m_shaders[handle].callbacks;
+
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(), [id](const auto &callback) {
+        return callback.first == id;
+    }), callbacks.end());
+}
+
+void ShaderManager::reload(ShaderHandle handle) noexcept
+{
+    if (m_running)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // The watcher indexes m_shaders with it
+        if (handle >= m_shaders.size())
+        {
+            return;
+        }
+
+        if (std::find(m_requests.begin(), m_requests.end(), handle) == m_requests.end())
+        {
+            m_requests.push_back(handle);
+        }
+
+        return;
+    }
+
+    // Nobody is watching, so nobody would pick the request up
+    ShaderDesc shader_desc;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (handle >= m_shaders.size())
+        {
+            return;
+        }
+
+        shader_desc = m_shaders[handle].desc;
+    }
+
+    CompiledShader compiled;
+
+    if (compile(shader_desc, compiled))
+    {
+        compiled.handle = handle;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_completed.push_back(std::move(compiled));
+    }
+}
+
+void ShaderManager::update() noexcept
+{
+    std::vector<CompiledShader> completed;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        completed.swap(m_completed);
+    }
+
+    for (auto &compiled : completed)
+    {
+        VkShaderModule module = create_module(compiled.spirv);
+
+        if (module == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        VkShaderModule old_module = VK_NULL_HANDLE;
+        std::vector<std::pair<ShaderReloadCallbackId, ShaderReloadCallback>> callbacks;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            ShaderEntry &shader = m_shaders[compiled.handle];
+
+            old_module = shader.module;
+            shader.module = module;
+            shader.hash = compiled.hash;
+            shader.reflection = std::move(compiled.reflection);
+            shader.dependencies = std::move(compiled.dependencies);
+            callbacks = shader.callbacks;
+
+            LOG_INFO("Shader Manager", "Reloaded " + shader.desc.path);
+        }
+
+        // Modules are only read while pipelines are created, so the old one can go
+        // as soon as everything using it has been rebuilt
+        for (auto &callback : callbacks)
+        {
+            callback.second(compiled.handle, module, old_module);
+        }
+
+        vkDestroyShaderModule(m_device, old_module, nullptr);
+    }
+}
+
+bool ShaderManager::can_compile() const noexcept
+{
+    return m_compiler != nullptr;
+}
+
+bool ShaderManager::compile(const ShaderDesc &desc, CompiledShader &compiled) noexcept
+{
+    if (!compile_spirv(desc, compiled))
+    {
+        return false;
+    }
+
+    // Done here so a reload reflects on the watcher thread, not in update()
+    if (!reflect_spirv(compiled.spirv.data(), compiled.spirv.size(), compiled.reflection, desc.entry_point))
+    {
+        LOG_ERROR("Shader Manager", "Cannot reflect " + desc.path);
+        return false;
+    }
+
+    return true;
+}
+
+bool ShaderManager::compile_spirv(const ShaderDesc &desc, CompiledShader &compiled) noexcept
+{
+    std::string path = normalize_path(m_root + "/" + desc.path);
+
+    std::vector<std::string> dependencies;
+    std::string contents;
+
+    collect_dependencies(path, dependencies, contents);
+
+    if (dependencies.empty())
+    {
+        LOG_ERROR("Shader Manager", "Cannot read shader " + path);
+        return false;
+    }
+
+    compiled.dependencies = dependencies;
+
+    // Prebuilt SPIR-V is its own cache entry
+    if (ends_with(path, ".spv"))
+    {
+        if (contents.size() % sizeof(uint32_t) != 0)
+        {
+            LOG_ERROR("Shader Manager", path + " is not SPIR-V");
+            return false;
+        }
+
+        compiled.spirv.resize(contents.size() / sizeof(uint32_t));
+        std::memcpy(compiled.spirv.data(), contents.data(), contents.size());
+        compiled.hash = fnv1a(contents.data(), contents.size());
+
+        return true;
+    }
+
+    // Includes are part of contents already, what is left is how the source gets compiled
+    uint64_t hash = fnv1a(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = fnv1a(contents.data(), contents.size(), hash);
+    hash = fnv1a(&desc.stage, sizeof(desc.stage), hash);
+    hash = fnv1a(desc.entry_point.data(), desc.entry_point.size(), hash);
+
+    for (const auto &[name, value] : desc.defines)
+    {
+        hash = fnv1a(name.data(), name.size() + 1, hash);
+        hash = fnv1a(value.data(), value.size() + 1, hash);
+    }
+
+    compiled.hash = hash;
+
+    if (load_cached(hash, compiled.spirv))
+    {
+        return true;
+    }
+
+    std::string source;
+    read_file(path, source);
+
+    if (!compile_glsl(desc, source, compiled.spirv))
+    {
+        return false;
+    }
+
+    store_cached(hash, compiled.spirv);
+
+    return true;
+}
+
+bool ShaderManager::compile_glsl(const ShaderDesc &desc, const std::string &source, std::vector<uint32_t> &spirv) noexcept
+{
+#ifdef NIQQA_HAS_SHADERC
+    std::string path = normalize_path(m_root + "/" + desc.path);
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+
+    for (const auto &[name, value] : desc.defines)
+    {
+        shaderc_compile_options_add_macro_definition(options, name.c_str(), name.size(), value.c_str(), value.size());
+    }
+
+    IncludeContext context{this, [](const ShaderManager *manager, const std::string &name, const std::string &includer) {
+        return manager->resolve_include(name, includer);
+    }};
+
+    shaderc_compile_options_set_include_callbacks(options, resolve_include_callback, release_include_callback, &context);
+    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+    // The compiler object is safe to use from several threads at once
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(m_compiler),
+                                                                   source.c_str(),
+                                                                   source.size(),
+                                                                   shader_kind(desc.stage),
+                                                                   path.c_str(),
+                                                                   desc.entry_point.c_str(),
+                                                                   options);
+
+    bool success = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+
+    if (success)
+    {
+        size_t size = shaderc_result_get_length(result);
+
+        spirv.resize(size / sizeof(uint32_t));
+        std::memcpy(spirv.data(), shaderc_result_get_bytes(result), size);
+    }
+    else
+    {
+        LOG_ERROR("Shader Manager", "Failed to compile " + desc.path + ":\n" + shaderc_result_get_error_message(result));
+    }
+
+    shaderc_result_release(result);
+    shaderc_compile_options_release(options);
+
+    return success;
+#else
+    (void)source;
+    (void)spirv;
+
+    LOG_ERROR("Shader Manager", "Cannot compile " + desc.path + ", built without shaderc and not in the cache");
+
+    return false;
+#endif
+}
+
+bool ShaderManager::load_cached(uint64_t hash, std::vector<uint32_t> &spirv) const noexcept
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(hash));
+
+    std::string contents;
+
+    if (!read_file(m_cache_dir + "/" + name, contents))
+    {
+        return false;
+    }
+
+    // A truncated or foreign file is just a miss
+    if (contents.size() < sizeof(uint32_t) || contents.size() % sizeof(uint32_t) != 0)
+    {
+        return false;
+    }
+
+    spirv.resize(contents.size() / sizeof(uint32_t));
+    std::memcpy(spirv.data(), contents.data(), contents.size());
+
+    return spirv[0] == SPIRV_MAGIC;
+}
+
+void ShaderManager::store_cached(uint64_t hash, const std::vector<uint32_t> &spirv) const noexcept
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(hash));
+
+    std::string path = m_cache_dir + "/" + name;
+    std::string temp_path = path + ".tmp";
+
+    // Written aside and renamed, another process never sees half a file
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            return;
+        }
+
+        file.write(reinterpret_cast<const char *>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+
+        if (!file)
+        {
+            return;
+        }
+    }
+
+    std::rename(temp_path.c_str(), path.c_str());
+}
+
+VkShaderModule ShaderManager::create_module(const std::vector<uint32_t> &spirv) const noexcept
+{
+    VkShaderModuleCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = spirv.size() * sizeof(uint32_t);
+    create_info.pCode = spirv.data();
+
+    VkShaderModule module = VK_NULL_HANDLE;
+
+    if (vkCreateShaderModule(m_device, &create_info, nullptr, &module) != VK_SUCCESS)
+    {
+        LOG_ERROR("Shader Manager", "Failed to create shader module");
+        return VK_NULL_HANDLE;
+    }
+
+    return module;
+}
+
+std::string ShaderManager::resolve_include(const std::string &name, const std::string &includer) const noexcept
+{
+    std::error_code error;
+
+    // Next to the including file first, then from the shader root
+    std::string relative = normalize_path((std::filesystem::path(includer).parent_path() / name).string());
+
+    if (std::filesystem::exists(relative, error))
+    {
+        return relative;
+    }
+
+    std::string from_root = normalize_path(m_root + "/" + name);
+
+    if (std::filesystem::exists(from_root, error))
+    {
+        return from_root;
+    }
+
+    return {};
+}
+
+void ShaderManager::collect_dependencies(const std::string &path, std::vector<std::string> &dependencies, std::string &contents) const noexcept
+{
+    if (std::find(dependencies.begin(), dependencies.end(), path) != dependencies.end())
+    {
+        return;
+    }
+
+    std::string source;
+
+    if (!read_file(path, source))
+    {
+        return;
+    }
+
+    dependencies.push_back(path);
+
+    if (ends_with(path, ".spv"))
+    {
+        contents = std::move(source);
+        return;
+    }
+
+    contents += path;
+    contents.push_back('\0');
+    contents += source;
+
+    // Only has to find what the preprocessor would, a commented out include just costs a spurious reload
+    std::istringstream lines(source);
+    std::string line;
+
+    while (std::getline(lines, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            continue;
+        }
+
+        size_t open = line.find_first_of("\"<", start + 8);
+
+        if (open == std::string::npos)
+        {
+            continue;
+        }
+
+        size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+
+        if (close == std::string::npos)
+        {
+            continue;
+        }
+
+        std::string include = resolve_include(line.substr(open + 1, close - open - 1), path);
+
+        if (!include.empty())
+        {
+            collect_dependencies(include, dependencies, contents);
+        }
+    }
+}
+
+bool ShaderManager::start_watching() noexcept
+{
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (m_inotify < 0)
+    {
+        return false;
+    }
+
+    // inotify is not recursive, every directory below the root needs its own watch
+    watch_directory(m_root);
+
+    std::error_code error;
+
+    for (auto it = std::filesystem::recursive_directory_iterator(m_root, error);
+         !error && it != std::filesystem::recursive_directory_iterator();
+         it.increment(error))
+    {
+        if (it->is_directory(error))
+        {
+            watch_directory(it->path().string());
+        }
+    }
+
+    if (m_watch_dirs.empty())
+    {
+        close(m_inotify);
+        m_inotify = -1;
+
+        return false;
+    }
+
+    m_running = true;
+    m_watcher = std::thread(&ShaderManager::watch_loop, this);
+
+    LOG_INFO("Shader Manager", "Watching " + m_root + " for changes");
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ShaderManager::watch_directory(const std::string &path) noexcept
+{
+#ifdef __linux__
+    // Editors often save by writing a new file and renaming it over the old one
+    int watch = inotify_add_watch(m_inotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+    if (watch >= 0)
+    {
+        m_watch_dirs[watch] = normalize_path(path);
+    }
+#else
+    (void)path;
+#endif
+}
+
+void ShaderManager::watch_loop() noexcept
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+
+    while (m_running)
+    {
+        pollfd descriptor{};
+        descriptor.fd = m_inotify;
+        descriptor.events = POLLIN;
+
+        if (poll(&descriptor, 1, WATCH_POLL_MS) > 0)
+        {
+            ssize_t length = 0;
+
+            while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *event_data = buffer; event_data < buffer + length;)
+                {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(event_data);
+                    event_data += sizeof(inotify_event) + event->len;
+
+                    auto directory = m_watch_dirs.find(event->wd);
+
+                    if (directory == m_watch_dirs.end() || event->len == 0)
+                    {
+                        continue;
+                    }
+
+                    std::string path = directory->second + "/" + event->name;
+
+                    if (event->mask & IN_ISDIR)
+                    {
+                        watch_directory(path);
+                        continue;
+                    }
+
+                    // IN_CREATE alone is an empty file, the write that follows reports it again
+                    if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                    {
+                        file_changed(path);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<ShaderHandle, ShaderDesc>> requests;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for (ShaderHandle handle : m_requests)
+            {
+                requests.emplace_back(handle, m_shaders[handle].desc);
+            }
+
+            m_requests.clear();
+        }
+
+        // Compiled here, off the render thread, update() only creates the modules
+        for (auto &[handle, shader_desc] : requests)
+        {
+            CompiledShader compiled;
+
+            if (compile(shader_desc, compiled))
+            {
+                compiled.handle = handle;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_completed.push_back(std::move(compiled));
+            }
+        }
+    }
+#endif
+}
+
+void ShaderManager::file_changed(const std::string &path) noexcept
+{
+    std::string changed = normalize_path(path);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (ShaderHandle handle = 0; handle < m_shaders.size(); ++handle)
+    {
+        const auto &dependencies = m_shaders[handle].dependencies;
+
+        if (std::find(dependencies.begin(), dependencies.end(), changed) != dependencies.end() &&
+            std::find(m_requests.begin(), m_requests.end(), handle) == m_requests.end())
+        {
+            m_requests.push_back(handle);
+        }
+    }
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
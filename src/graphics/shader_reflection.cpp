@@ -0,0 +1,666 @@
+#include <graphics/shader_reflection.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace niqqa
+{
+namespace graphics
+{
+// Only the parts of the SPIR-V spec reflection needs
+namespace spirv
+{
+static constexpr uint32_t MAGIC{0x07230203};
+static constexpr size_t HEADER_WORDS{5};
+
+enum Op : uint32_t
+{
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeBool = 20,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpTypeAccelerationStructureKHR = 5341
+};
+
+enum Decoration : uint32_t
+{
+    Block = 2,
+    BufferBlock = 3,
+    ArrayStride = 6,
+    MatrixStride = 7,
+    BuiltIn = 11,
+    Location = 30,
+    Binding = 33,
+    DescriptorSet = 34,
+    Offset = 35
+};
+
+enum StorageClass : uint32_t
+{
+    UniformConstant = 0,
+    Input = 1,
+    Uniform = 2,
+    PushConstant = 9,
+    StorageBuffer = 12
+};
+
+enum ExecutionModel : uint32_t
+{
+    Vertex = 0,
+    TessellationControl = 1,
+    TessellationEvaluation = 2,
+    Geometry = 3,
+    Fragment = 4,
+    GLCompute = 5
+};
+
+static constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE{17};
+static constexpr uint32_t DIM_BUFFER{5};
+static constexpr uint32_t DIM_SUBPASS_DATA{6};
+} // namespace spirv
+
+struct SpirvId
+{
+    uint32_t opcode{0};
+
+    // Pointee of a pointer, element of an array or vector, column of a matrix, type of a variable
+    uint32_t type{0};
+    uint32_t storage_class{0};
+
+    // Width of a scalar, component count of a vector or matrix, id of an array's length
+    uint32_t width{0};
+    uint32_t count{0};
+    bool is_signed{false};
+
+    uint32_t image_dim{0};
+    uint32_t image_sampled{0};
+
+    uint64_t constant{0};
+
+    uint32_t set{UINT32_MAX};
+    uint32_t binding{UINT32_MAX};
+    uint32_t location{UINT32_MAX};
+    uint32_t array_stride{0};
+    bool built_in{false};
+    bool block{false};
+    bool buffer_block{false};
+
+    std::vector<uint32_t> members;
+    std::vector<uint32_t> member_offsets;
+    std::vector<uint32_t> member_matrix_strides;
+};
+
+static VkShaderStageFlagBits stage_from_model(uint32_t model) noexcept
+{
+    switch (model)
+    {
+    case spirv::Vertex:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case spirv::TessellationControl:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case spirv::TessellationEvaluation:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case spirv::Geometry:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case spirv::Fragment:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case spirv::GLCompute:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        return VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
+    }
+}
+
+static uint32_t type_size(const std::vector<SpirvId> &ids, uint32_t type_id, uint32_t matrix_stride = 0) noexcept
+{
+    const SpirvId &type = ids[type_id];
+
+    switch (type.opcode)
+    {
+    case spirv::OpTypeBool:
+        return 4;
+    case spirv::OpTypeInt:
+    case spirv::OpTypeFloat:
+        return type.width / 8;
+    case spirv::OpTypeVector:
+        return type.count * type_size(ids, type.type);
+    case spirv::OpTypeMatrix:
+        return type.count * (matrix_stride != 0 ? matrix_stride : type_size(ids, type.type));
+    case spirv::OpTypeArray:
+    {
+        uint32_t stride = type.array_stride != 0 ? type.array_stride : type_size(ids, type.type);
+        return static_cast<uint32_t>(ids[type.count].constant) * stride;
+    }
+    case spirv::OpTypeStruct:
+    {
+        uint32_t size = 0;
+
+        for (size_t i = 0; i < type.members.size(); ++i)
+        {
+            uint32_t offset = i < type.member_offsets.size() ? type.member_offsets[i] : 0;
+            uint32_t stride = i < type.member_matrix_strides.size() ? type.member_matrix_strides[i] : 0;
+
+            size = std::max(size, offset + type_size(ids, type.members[i], stride));
+        }
+
+        return size;
+    }
+    case spirv::OpTypePointer:
+        // Buffer device address
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static VkFormat vertex_format(const std::vector<SpirvId> &ids, uint32_t type_id) noexcept
+{
+    const SpirvId &type = ids[type_id];
+
+    uint32_t components = type.opcode == spirv::OpTypeVector ? type.count : 1;
+    const SpirvId &scalar = type.opcode == spirv::OpTypeVector ? ids[type.type] : type;
+
+    if (scalar.width != 32 || components < 1 || components > 4)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    static constexpr VkFormat FLOAT_FORMATS[] = {
+        VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+    };
+
+    static constexpr VkFormat SINT_FORMATS[] = {
+        VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+    };
+
+    static constexpr VkFormat UINT_FORMATS[] = {
+        VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+    };
+
+    if (scalar.opcode == spirv::OpTypeFloat)
+    {
+        return FLOAT_FORMATS[components - 1];
+    }
+
+    if (scalar.opcode == spirv::OpTypeInt)
+    {
+        return scalar.is_signed ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+static uint32_t format_size(VkFormat format) noexcept
+{
+    switch (format)
+    {
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32_UINT:
+        return 4;
+    case VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32_UINT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32_UINT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R32G32B32A32_UINT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+static VkDescriptorType descriptor_type(const std::vector<SpirvId> &ids, const SpirvId &variable, uint32_t type_id) noexcept
+{
+    const SpirvId &type = ids[type_id];
+
+    switch (type.opcode)
+    {
+    case spirv::OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case spirv::OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case spirv::OpTypeAccelerationStructureKHR:
+        return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    case spirv::OpTypeImage:
+        if (type.image_dim == spirv::DIM_BUFFER)
+        {
+            return type.image_sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+
+        if (type.image_dim == spirv::DIM_SUBPASS_DATA)
+        {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+
+        return type.image_sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    case spirv::OpTypeStruct:
+        // Before SPIR-V 1.3 storage buffers were Uniform blocks decorated BufferBlock
+        if (variable.storage_class == spirv::StorageBuffer || type.buffer_block)
+        {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+
+        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    default:
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+}
+
+bool reflect_spirv(const uint32_t *code, size_t word_count, ShaderReflection &reflection, const std::string &entry_point) noexcept
+{
+    if (word_count < spirv::HEADER_WORDS || code[0] != spirv::MAGIC)
+    {
+        LOG_ERROR("Shader Reflection", "Not a SPIR-V module");
+        return false;
+    }
+
+    uint32_t bound = code[3];
+    std::vector<SpirvId> ids(bound);
+
+    uint32_t entry_id = UINT32_MAX;
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
+    std::vector<uint32_t> interface_ids;
+
+    size_t offset = spirv::HEADER_WORDS;
+
+    while (offset < word_count)
+    {
+        uint32_t opcode = code[offset] & 0xffff;
+        uint32_t length = code[offset] >> 16;
+
+        if (length == 0 || offset + length > word_count)
+        {
+            LOG_ERROR("Shader Reflection", "Truncated SPIR-V instruction");
+            return false;
+        }
+
+        const uint32_t *words = code + offset;
+
+        // Result ids are checked against the bound before they index anything
+        auto id = [&](uint32_t word) -> SpirvId * {
+            return words[word] < bound ? &ids[words[word]] : nullptr;
+        };
+
+        switch (opcode)
+        {
+        case spirv::OpEntryPoint:
+        {
+            const char *name = reinterpret_cast<const char *>(words + 3);
+            size_t name_words = std::strlen(name) / 4 + 1;
+
+            if (entry_id == UINT32_MAX && entry_point == name)
+            {
+                stage = stage_from_model(words[1]);
+                entry_id = words[2];
+                interface_ids.assign(words + 3 + name_words, words + length);
+            }
+
+            break;
+        }
+        case spirv::OpExecutionMode:
+            if (words[1] == entry_id && words[2] == spirv::EXECUTION_MODE_LOCAL_SIZE && length >= 6)
+            {
+                reflection.local_size[0] = words[3];
+                reflection.local_size[1] = words[4];
+                reflection.local_size[2] = words[5];
+            }
+
+            break;
+        case spirv::OpTypeBool:
+        case spirv::OpTypeSampler:
+        case spirv::OpTypeAccelerationStructureKHR:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+            }
+
+            break;
+        case spirv::OpTypeInt:
+        case spirv::OpTypeFloat:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->width = words[2];
+                result->is_signed = opcode == spirv::OpTypeInt ? words[3] != 0 : true;
+            }
+
+            break;
+        case spirv::OpTypeVector:
+        case spirv::OpTypeMatrix:
+        case spirv::OpTypeArray:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->type = words[2];
+                result->count = words[3];
+            }
+
+            break;
+        case spirv::OpTypeRuntimeArray:
+        case spirv::OpTypeSampledImage:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->type = words[2];
+            }
+
+            break;
+        case spirv::OpTypeImage:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->image_dim = words[3];
+                result->image_sampled = words[7];
+            }
+
+            break;
+        case spirv::OpTypeStruct:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->members.assign(words + 2, words + length);
+                result->member_offsets.resize(result->members.size(), 0);
+                result->member_matrix_strides.resize(result->members.size(), 0);
+            }
+
+            break;
+        case spirv::OpTypePointer:
+            if (SpirvId *result = id(1))
+            {
+                result->opcode = opcode;
+                result->storage_class = words[2];
+                result->type = words[3];
+            }
+
+            break;
+        case spirv::OpConstant:
+            if (SpirvId *result = id(2))
+            {
+                result->opcode = opcode;
+                result->constant = words[3];
+
+                if (length > 4)
+                {
+                    result->constant |= static_cast<uint64_t>(words[4]) << 32;
+                }
+            }
+
+            break;
+        case spirv::OpVariable:
+            if (SpirvId *result = id(2))
+            {
+                result->opcode = opcode;
+                result->type = words[1];
+                result->storage_class = words[3];
+            }
+
+            break;
+        case spirv::OpDecorate:
+            if (SpirvId *target = id(1))
+            {
+                uint32_t literal = length > 3 ? words[3] : 0;
+
+                switch (words[2])
+                {
+                case spirv::Block:
+                    target->block = true;
+                    break;
+                case spirv::BufferBlock:
+                    target->buffer_block = true;
+                    break;
+                case spirv::ArrayStride:
+                    target->array_stride = literal;
+                    break;
+                case spirv::BuiltIn:
+                    target->built_in = true;
+                    break;
+                case spirv::Location:
+                    target->location = literal;
+                    break;
+                case spirv::Binding:
+                    target->binding = literal;
+                    break;
+                case spirv::DescriptorSet:
+                    target->set = literal;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            break;
+        case spirv::OpMemberDecorate:
+            // Member decorations may come before the struct type, so the vectors grow on demand
+            if (SpirvId *target = id(1); target != nullptr && length > 4)
+            {
+                uint32_t member = words[2];
+
+                if (target->member_offsets.size() <= member)
+                {
+                    target->member_offsets.resize(member + 1, 0);
+                    target->member_matrix_strides.resize(member + 1, 0);
+                }
+
+                if (words[3] == spirv::Offset)
+                {
+                    target->member_offsets[member] = words[4];
+                }
+                else if (words[3] == spirv::MatrixStride)
+                {
+                    target->member_matrix_strides[member] = words[4];
+                }
+            }
+
+            break;
+        default:
+            break;
+        }
+
+        offset += length;
+    }
+
+    if (entry_id == UINT32_MAX || stage == VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM)
+    {
+        LOG_ERROR("Shader Reflection", "No supported entry point named " + entry_point);
+        return false;
+    }
+
+    reflection.stages = stage;
+
+    for (uint32_t variable_id = 0; variable_id < bound; ++variable_id)
+    {
+        const SpirvId &variable = ids[variable_id];
+
+        if (variable.opcode != spirv::OpVariable || variable.type >= bound)
+        {
+            continue;
+        }
+
+        uint32_t type_id = ids[variable.type].type;
+
+        if (variable.storage_class == spirv::PushConstant)
+        {
+            const SpirvId &block = ids[type_id];
+
+            uint32_t begin = block.member_offsets.empty() ? 0 : *std::min_element(block.member_offsets.begin(), block.member_offsets.end());
+            uint32_t end = type_size(ids, type_id);
+
+            reflection.push_constants = {static_cast<VkShaderStageFlags>(stage), begin, end - begin};
+            continue;
+        }
+
+        if (variable.storage_class == spirv::Input)
+        {
+            // Since SPIR-V 1.4 the interface lists every global, before it only inputs and outputs
+            bool in_interface = std::find(interface_ids.begin(), interface_ids.end(), variable_id) != interface_ids.end();
+
+            if (stage == VK_SHADER_STAGE_VERTEX_BIT && in_interface && !variable.built_in && variable.location != UINT32_MAX)
+            {
+                VkFormat format = vertex_format(ids, type_id);
+
+                if (format == VK_FORMAT_UNDEFINED)
+                {
+                    LOG_WARN("Shader Reflection", "Vertex input at location " + std::to_string(variable.location) + " has an unsupported type");
+                    continue;
+                }
+
+                reflection.vertex_inputs.push_back({variable.location, format});
+            }
+
+            continue;
+        }
+
+        if (variable.storage_class != spirv::UniformConstant &&
+            variable.storage_class != spirv::Uniform &&
+            variable.storage_class != spirv::StorageBuffer)
+        {
+            continue;
+        }
+
+        if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX)
+        {
+            continue;
+        }
+
+        ReflectedBinding binding;
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.stages = stage;
+
+        // Arrays of descriptors, possibly nested
+        while (ids[type_id].opcode == spirv::OpTypeArray || ids[type_id].opcode == spirv::OpTypeRuntimeArray)
+        {
+            const SpirvId &array = ids[type_id];
+
+            binding.count = array.opcode == spirv::OpTypeRuntimeArray ? 0 : binding.count * static_cast<uint32_t>(ids[array.count].constant);
+            type_id = array.type;
+        }
+
+        binding.type = descriptor_type(ids, variable, type_id);
+
+        if (binding.type == VK_DESCRIPTOR_TYPE_MAX_ENUM)
+        {
+            continue;
+        }
+
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding &a, const ReflectedBinding &b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    std::sort(reflection.vertex_inputs.begin(), reflection.vertex_inputs.end(), [](const ReflectedVertexInput &a, const ReflectedVertexInput &b) {
+        return a.location < b.location;
+    });
+
+    return true;
+}
+
+bool ShaderReflection::merge(const ShaderReflection &other) noexcept
+{
+    for (const auto &binding : other.bindings)
+    {
+        auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const ReflectedBinding &candidate) {
+            return candidate.set == binding.set && candidate.binding == binding.binding;
+        });
+
+        if (existing == bindings.end())
+        {
+            bindings.push_back(binding);
+            continue;
+        }
+
+        if (existing->type != binding.type || existing->count != binding.count)
+        {
+            LOG_ERROR("Shader Reflection", "Set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) +
+                                           " is declared differently between stages");
+            return false;
+        }
+
+        existing->stages |= binding.stages;
+    }
+
+    std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding &a, const ReflectedBinding &b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    // One range covering both, the layout cache widens it further anyway
+    if (other.push_constants.size != 0)
+    {
+        if (push_constants.size == 0)
+        {
+            push_constants = other.push_constants;
+        }
+        else
+        {
+            uint32_t begin = std::min(push_constants.offset, other.push_constants.offset);
+            uint32_t end = std::max(push_constants.offset + push_constants.size, other.push_constants.offset + other.push_constants.size);
+
+            push_constants = {push_constants.stageFlags | other.push_constants.stageFlags, begin, end - begin};
+        }
+    }
+
+    if (other.stages & VK_SHADER_STAGE_VERTEX_BIT)
+    {
+        vertex_inputs = other.vertex_inputs;
+    }
+
+    if (other.stages & VK_SHADER_STAGE_COMPUTE_BIT)
+    {
+        std::copy(other.local_size, other.local_size + 3, local_size);
+    }
+
+    stages |= other.stages;
+
+    return true;
+}
+
+uint32_t ShaderReflection::set_count() const noexcept
+{
+    return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+uint32_t ShaderReflection::packed_vertex_attributes(uint32_t binding, std::vector<VkVertexInputAttributeDescription> &attributes) const noexcept
+{
+    uint32_t stride = 0;
+
+    for (const auto &input : vertex_inputs)
+    {
+        VkVertexInputAttributeDescription attribute{};
+        attribute.location = input.location;
+        attribute.binding = binding;
+        attribute.format = input.format;
+        attribute.offset = stride;
+
+        attributes.push_back(attribute);
+
+        stride += format_size(input.format);
+    }
+
+    return stride;
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
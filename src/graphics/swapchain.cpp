@@ -5,6 +5,7 @@
 
 #include <cstdint>
 #include <limits>
+#include <string>
 #include <algorithm>
 #include <vector>
 
@@ -39,65 +40,132 @@ SwapchainSupportDetails query_swapchain_support(VkPhysicalDevice device, VkSurfa
     return details;
 }
 
-static uint32_t find_memory_type(VkPhysicalDevice gpu, uint32_t type_filter, VkMemoryPropertyFlags property_flags)
+bool Swapchain::create(Device &device, 
+                       VkSurfaceKHR surface,
+                       VkExtent2D actual_extent,
+                       VkFormat user_defined_format,
+                       VkPresentModeKHR user_defined_present_mode,
+                       VkRenderPass render_pass) noexcept
 {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
+    m_device = device.device();
+    m_gpu = device.gpu();
+    m_allocator = &device.allocator();
+    m_surface = surface;
+    m_desired_format = user_defined_format;
+    m_desired_present_mode = user_defined_present_mode;
+    m_depth_format = find_depth_format(m_gpu);
 
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+    if (!create_swapchain(actual_extent, VK_NULL_HANDLE))
     {
-        if ((type_filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags)
-        {
-            return i;
-        }
+        return false;
     }
 
-    return UINT32_MAX;
+    if (!create_present_semaphores())
+    {
+        return false;
+    }
+
+    if (!create_depth_resources())
+    {
+        return false;
+    }
+
+    if (render_pass != VK_NULL_HANDLE && !create_framebuffers(render_pass))
+    {
+        return false;
+    }
+
+    return true;
 }
 
-static VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags) noexcept
+bool Swapchain::recreate(VkExtent2D actual_extent, uint64_t frame_number) noexcept
 {
-    VkImageViewCreateInfo image_view_info{};
-    image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    image_view_info.image = image;
-    image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    image_view_info.format = format;
+    RetiredSwapchain retired;
+    retired.swapchain = m_swapchain;
+    retired.present_images = std::move(m_present_images);
+    retired.framebuffers = std::move(m_framebuffers);
+    retired.present_semaphores = std::move(m_present_semaphores);
+    retired.frame_number = frame_number;
+
+    m_swapchain = VK_NULL_HANDLE;
+    m_present_images.clear();
+    m_framebuffers.clear();
+    m_present_semaphores.clear();
+
+    VkExtent2D old_extent = m_extent;
+
+    // Handing over the old swapchain lets the driver reuse its resources, and it
+    // stays valid for the frames still presenting from it until they are collected
+    bool created = create_swapchain(actual_extent, retired.swapchain);
+
+    // Depth only depends on the extent, a present mode or format change keeps it
+    if (!created || m_extent.width != old_extent.width || m_extent.height != old_extent.height)
+    {
+        retired.depth_image = m_depth_image;
+        retired.depth_image_view = m_depth_image_view;
+        retired.depth_allocation = m_depth_allocation;
 
-    image_view_info.subresourceRange.aspectMask = aspect_flags;
-    image_view_info.subresourceRange.baseMipLevel = 0;
-    image_view_info.subresourceRange.levelCount = 1;
-    image_view_info.subresourceRange.baseArrayLayer = 0;
-    image_view_info.subresourceRange.layerCount = 1;
+        m_depth_image = VK_NULL_HANDLE;
+        m_depth_image_view = VK_NULL_HANDLE;
+        m_depth_allocation = Allocation{};
+    }
 
-    VkImageView image_view = VK_NULL_HANDLE;
+    m_retired.push_back(std::move(retired));
 
-    if (vkCreateImageView(device, &image_view_info, nullptr, &image_view) != VK_SUCCESS)
+    if (!created)
     {
-        return VK_NULL_HANDLE;
+        return false;
     }
 
-    return image_view;
+    // The image count may have changed, and presents of the old images can still be waiting on theirs
+    if (!create_present_semaphores())
+    {
+        return false;
+    }
+
+    if (m_depth_image == VK_NULL_HANDLE && !create_depth_resources())
+    {
+        return false;
+    }
+
+    if (m_render_pass != VK_NULL_HANDLE && !create_framebuffers(m_render_pass))
+    {
+        return false;
+    }
+
+    LOG_INFO("Swapchain", "Swapchain recreated at {}x{}", m_extent.width, m_extent.height);
+
+    return true;
 }
 
-bool Swapchain::create(Device &device, 
-                       VkSurfaceKHR surface,
-                       VkExtent2D actual_extent,
-                       VkFormat user_defined_format,
-                       VkPresentModeKHR user_defined_present_mode,
-                       VkRenderPass render_pass) noexcept
+void Swapchain::collect_retired(uint64_t completed_frames) noexcept
 {
-    m_device = device.device();
-    m_surface = surface;
+    auto retired = m_retired.begin();
+
+    while (retired != m_retired.end())
+    {
+        if (retired->frame_number > completed_frames)
+        {
+            ++retired;
+            continue;
+        }
+
+        destroy_retired(*retired);
+        retired = m_retired.erase(retired);
+    }
+}
 
-    SwapchainSupportDetails swap_chain_support = query_swapchain_support(device.gpu(), m_surface);
-    QueueFamilyIndices indices = find_queue_families(device.gpu(), m_surface);
+bool Swapchain::create_swapchain(VkExtent2D actual_extent, VkSwapchainKHR old_swapchain) noexcept
+{
+    SwapchainSupportDetails swap_chain_support = query_swapchain_support(m_gpu, m_surface);
+    QueueFamilyIndices indices = find_queue_families(m_gpu, m_surface);
     uint32_t queue_family_indices[] = {
         indices.graphics_family.value(),
         indices.present_family.value()
     };
 
-    VkSurfaceFormatKHR surface_format = choose_swapchain_surface_format(swap_chain_support.formats, user_defined_format);
-    VkPresentModeKHR present_mode = choose_swapchain_present_mode(swap_chain_support.present_modes, user_defined_present_mode);
+    VkSurfaceFormatKHR surface_format = choose_swapchain_surface_format(swap_chain_support.formats, m_desired_format);
+    VkPresentModeKHR present_mode = choose_swapchain_present_mode(swap_chain_support.present_modes, m_desired_present_mode);
     VkExtent2D extent = choose_swapchain_extent(swap_chain_support.capabilities, actual_extent);
     
     uint32_t image_count;
@@ -114,7 +182,7 @@ bool Swapchain::create(Device &device,
     create_info.minImageCount = image_count;
     create_info.imageFormat = surface_format.format;
     create_info.imageColorSpace = surface_format.colorSpace;
-    create_info.imageExtent = actual_extent;
+    create_info.imageExtent = extent;
     create_info.imageArrayLayers = 1;
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
@@ -135,7 +203,7 @@ bool Swapchain::create(Device &device,
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = old_swapchain;
 
     LOG_INFO("Swapchain", "Creating swapchain");
 
@@ -147,6 +215,9 @@ bool Swapchain::create(Device &device,
 
     LOG_INFO("Swapchain", "Swapchain created");
 
+    // The driver may create more images than asked for
+    vkGetSwapchainImagesKHR(m_device, m_swapchain, &image_count, nullptr);
+
     std::vector<VkImage> images(image_count);
 
     LOG_INFO("Swapchain", "Creating swapchain images");
@@ -167,7 +238,7 @@ bool Swapchain::create(Device &device,
     }
 
     m_present_format = surface_format.format;
-    m_depth_format = find_depth_format(device.gpu());
+    m_present_mode = present_mode;
     m_extent = extent;
 
     if (!create_image_views())
@@ -180,46 +251,43 @@ bool Swapchain::create(Device &device,
 
 void Swapchain::cleanup() noexcept
 {
-    for (size_t i = 0; i < m_present_images.size(); ++i)
+    for (auto &retired : m_retired)
     {
-        if (m_present_images[i].image_view != VK_NULL_HANDLE)
-        {
-            vkDestroyImageView(m_device, m_present_images[i].image_view, nullptr);
-        }
+        destroy_retired(retired);
     }
 
-    if (m_swapchain != VK_NULL_HANDLE)
+    m_retired.clear();
+
+    destroy_framebuffers();
+    destroy_present_semaphores(m_present_semaphores);
+
+    if (m_depth_image_view != VK_NULL_HANDLE)
     {
-        vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+        vkDestroyImageView(m_device, m_depth_image_view, nullptr);
     }
-}
 
-VkFormat Swapchain::find_supported_format(VkPhysicalDevice gpu, const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags feature_flag) noexcept
-{
-    for (VkFormat format : candidates)
+    if (m_depth_image != VK_NULL_HANDLE)
     {
-        VkFormatProperties format_properties;
-        vkGetPhysicalDeviceFormatProperties(gpu, format, &format_properties);
+        vkDestroyImage(m_device, m_depth_image, nullptr);
+    }
 
-        if (tiling == VK_IMAGE_TILING_OPTIMAL && (format_properties.optimalTilingFeatures & feature_flag) == feature_flag)
+    if (m_allocator != nullptr)
+    {
+        m_allocator->free(m_depth_allocation);
+    }
+
+    for (size_t i = 0; i < m_present_images.size(); ++i)
+    {
+        if (m_present_images[i].image_view != VK_NULL_HANDLE)
         {
-            return format;
+            vkDestroyImageView(m_device, m_present_images[i].image_view, nullptr);
         }
     }
 
-    return VK_FORMAT_UNDEFINED;
-}
-
-VkFormat Swapchain::find_depth_format(VkPhysicalDevice gpu) noexcept
-{
-    return find_supported_format(gpu, 
-                                 {
-                                    VK_FORMAT_D32_SFLOAT,
-                                    VK_FORMAT_D32_SFLOAT_S8_UINT,
-                                    VK_FORMAT_D24_UNORM_S8_UINT
-                                 }, 
-                                 VK_IMAGE_TILING_OPTIMAL, 
-                                 VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    if (m_swapchain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+    }
 }
 
 VkSurfaceFormatKHR Swapchain::choose_swapchain_surface_format(const std::vector<VkSurfaceFormatKHR> &available_formats, VkFormat desired_format) noexcept
@@ -245,6 +313,12 @@ VkPresentModeKHR Swapchain::choose_swapchain_present_mode(const std::vector<VkPr
         }
     }
 
+    // FIFO is the only mode every device has to support, it queues a frame more than MAILBOX
+    if (desired_mode != VK_PRESENT_MODE_FIFO_KHR)
+    {
+        LOG_WARN("Swapchain", "Requested present mode " + std::to_string(desired_mode) + " is not supported, falling back to FIFO");
+    }
+
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -276,6 +350,11 @@ VkExtent2D Swapchain::extent() const noexcept
     return m_extent;
 }
 
+VkPresentModeKHR Swapchain::present_mode() const noexcept
+{
+    return m_present_mode;
+}
+
 VkFormat Swapchain::present_format() const noexcept
 {
     return m_present_format;
@@ -286,6 +365,31 @@ VkFormat Swapchain::depth_format() const noexcept
     return m_depth_format;
 }
 
+uint32_t Swapchain::image_count() const noexcept
+{
+    return static_cast<uint32_t>(m_present_images.size());
+}
+
+const Image &Swapchain::present_image(uint32_t image_index) const noexcept
+{
+    return m_present_images[image_index];
+}
+
+Image Swapchain::depth_image() const noexcept
+{
+    return {m_depth_image, m_depth_image_view};
+}
+
+VkFramebuffer Swapchain::framebuffer(uint32_t image_index) const noexcept
+{
+    return m_framebuffers.empty() ? VK_NULL_HANDLE : m_framebuffers[image_index];
+}
+
+VkSemaphore Swapchain::present_semaphore(uint32_t image_index) const noexcept
+{
+    return m_present_semaphores[image_index];
+}
+
 bool Swapchain::create_image_views() noexcept
 {
     LOG_INFO("Swapchain", "Creating swapchain image views");
@@ -323,38 +427,134 @@ bool Swapchain::create_image_views() noexcept
     return true; 
 }
 
+bool Swapchain::create_present_semaphores() noexcept
+{
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    m_present_semaphores.resize(m_present_images.size(), VK_NULL_HANDLE);
+
+    for (VkSemaphore &semaphore : m_present_semaphores)
+    {
+        if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &semaphore) != VK_SUCCESS)
+        {
+            LOG_ERROR("Swapchain", "Failed to create present semaphore");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Swapchain::destroy_present_semaphores(std::vector<VkSemaphore> &semaphores) noexcept
+{
+    for (VkSemaphore semaphore : semaphores)
+    {
+        if (semaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(m_device, semaphore, nullptr);
+        }
+    }
+
+    semaphores.clear();
+}
+
 bool Swapchain::create_framebuffers(VkRenderPass render_pass) noexcept
 {
-    m_framebuffers.resize(m_present_images.size());
+    destroy_framebuffers();
+
+    m_render_pass = render_pass;
+
+    LOG_INFO("Swapchain", "Creating framebuffers");
+
+    m_framebuffers.resize(m_present_images.size(), VK_NULL_HANDLE);
 
     for (size_t i = 0; i < m_framebuffers.size(); ++i)
     {
-        // Attachments here
+        VkImageView attachments[] = {
+            m_present_images[i].image_view,
+            m_depth_image_view
+        };
 
         VkFramebufferCreateInfo framebuffer_info{};
         framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebuffer_info.renderPass = render_pass;
-        framebuffer_info.attachmentCount = 1;
-
-        // TODO: Complete this shit
+        framebuffer_info.attachmentCount = 2;
+        framebuffer_info.pAttachments = attachments;
+        framebuffer_info.width = m_extent.width;
+        framebuffer_info.height = m_extent.height;
+        framebuffer_info.layers = 1;
 
+        if (vkCreateFramebuffer(m_device, &framebuffer_info, nullptr, &m_framebuffers[i]) != VK_SUCCESS)
+        {
+            LOG_ERROR("Swapchain", "Failed to create framebuffer");
+            return false;
+        }
     }
 
+    LOG_INFO("Swapchain", "Framebuffers created");
+
     return true;
 }
 
-bool Swapchain::create_image(VkPhysicalDevice gpu,
-                             uint32_t width,
+void Swapchain::destroy_framebuffers() noexcept
+{
+    for (VkFramebuffer framebuffer : m_framebuffers)
+    {
+        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    }
+
+    m_framebuffers.clear();
+}
+
+void Swapchain::destroy_retired(RetiredSwapchain &retired) noexcept
+{
+    for (VkFramebuffer framebuffer : retired.framebuffers)
+    {
+        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    }
+
+    for (auto &image : retired.present_images)
+    {
+        if (image.image_view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(m_device, image.image_view, nullptr);
+        }
+    }
+
+    if (retired.depth_image_view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_device, retired.depth_image_view, nullptr);
+    }
+
+    if (retired.depth_image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(m_device, retired.depth_image, nullptr);
+    }
+
+    m_allocator->free(retired.depth_allocation);
+
+    if (retired.swapchain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(m_device, retired.swapchain, nullptr);
+    }
+
+    destroy_present_semaphores(retired.present_semaphores);
+}
+
+bool Swapchain::create_image(uint32_t width,
                              uint32_t height,
                              VkFormat format,
                              VkImageTiling tiling,
                              VkImageUsageFlags usage_flags,
                              VkMemoryPropertyFlags property_flags,
+                             bool dedicated,
                              VkImage &image,
-                             VkDeviceMemory &image_memory) noexcept
+                             Allocation &allocation) noexcept
 {
     VkImageCreateInfo image_info{};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
     image_info.extent.width = width;
     image_info.extent.height = height;
     image_info.extent.depth = 1;
@@ -369,67 +569,47 @@ bool Swapchain::create_image(VkPhysicalDevice gpu,
 
     if (vkCreateImage(m_device, &image_info, nullptr, &image) != VK_SUCCESS)
     {
-        std::cerr << "Failed to create image\n";
+        LOG_ERROR("Swapchain", "Failed to create image");
         return false;
     }
 
-    VkMemoryRequirements memory_requirements;
-    vkGetImageMemoryRequirements(m_device, image, &memory_requirements);
-
-    VkMemoryAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = memory_requirements.size;
-    alloc_info.memoryTypeIndex = find_memory_type(gpu, memory_requirements.memoryTypeBits, property_flags);
-
-    if (alloc_info.memoryTypeIndex == UINT32_MAX)
+    if (!m_allocator->allocate_image(image, property_flags, allocation, dedicated))
     {
-        std::cerr << "No suitable memory type found\n";
-        return false;
-    }
+        LOG_ERROR("Swapchain", "Failed to allocate image memory");
+
+        vkDestroyImage(m_device, image, nullptr);
+        image = VK_NULL_HANDLE;
 
-    if (vkAllocateMemory(m_device, &alloc_info, nullptr, &image_memory) != VK_SUCCESS)
-    {
-        std::cerr << "Failed to allocate image memory\n";
         return false;
     }
-    
-    vkBindImageMemory(m_device, image, image_memory, 0);
 
     return true;
 }
 
-bool Swapchain::create_depth_resources(VkPhysicalDevice gpu) noexcept
+bool Swapchain::create_depth_resources() noexcept
 {
-    VkImage depth_image = VK_NULL_HANDLE;
-
-    if (!create_image(gpu,
-                      m_extent.width, 
+    // Render targets are large and live as long as the swapchain, so they get their own allocation
+    if (!create_image(m_extent.width, 
                       m_extent.height, 
                       m_depth_format, 
                       VK_IMAGE_TILING_OPTIMAL,
                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                      depth_image,
-                      m_depth_memory))
+                      true,
+                      m_depth_image,
+                      m_depth_allocation))
     {
         return false;
     }
 
-    VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-    if (m_depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || m_depth_format == VK_FORMAT_D24_UNORM_S8_UINT)
-    {
-        aspect_flags |= VK_IMAGE_ASPECT_STENCIL_BIT;
-    }
-
     m_depth_image_view = create_image_view(m_device, 
-                                           depth_image, 
+                                           m_depth_image, 
                                            m_depth_format, 
-                                           aspect_flags);
+                                           depth_aspect_flags(m_depth_format));
 
     if (m_depth_image_view == VK_NULL_HANDLE)
     {
-        std::cerr << "Failed to create depth resources\n";
+        LOG_ERROR("Swapchain", "Failed to create depth resources");
         return false;
     }
 
@@ -0,0 +1,1051 @@
+#include <graphics/texture_streamer.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace niqqa
+{
+namespace graphics
+{
+static constexpr VkPipelineStageFlags SHADER_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+// Finest mip wanted for a texture whose mip 0 covers texels texels per pixel
+static uint32_t mip_for_texels(float texels, float bias, uint32_t tail_mip) noexcept
+{
+    float mip = std::floor(std::log2(std::max(texels, 1.0f)) + bias);
+
+    return static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(tail_mip)));
+}
+
+bool TextureStreamer::init(Device &device,
+                           BindlessHeap &bindless,
+                           UploadQueue &uploads,
+                           assets::AssetIo &io,
+                           uint32_t frames_in_flight,
+                           const TextureStreamerConfig &config) noexcept
+{
+    if (!bindless.is_enabled())
+    {
+        LOG_WARN("Texture Streamer", "Needs the bindless heap, texture streaming disabled");
+        return false;
+    }
+
+    m_device = &device;
+    m_bindless = &bindless;
+    m_uploads = &uploads;
+    m_io = &io;
+    m_frames_in_flight = frames_in_flight;
+    m_config = config;
+    m_config.max_streams = std::max(m_config.max_streams, 1u);
+
+    m_feedback.resize(frames_in_flight + 1);
+
+    VkDeviceSize feedback_size = sizeof(uint32_t) * bindless.capacity(BindlessType::Texture);
+
+    for (auto &feedback : m_feedback)
+    {
+        VkBufferCreateInfo buffer_info{};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = feedback_size;
+        buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device.device(), &buffer_info, nullptr, &feedback.buffer) != VK_SUCCESS ||
+            !device.allocator().allocate_buffer(feedback.buffer,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                feedback.allocation))
+        {
+            LOG_ERROR("Texture Streamer", "Failed to create a feedback buffer");
+            cleanup();
+            return false;
+        }
+
+        std::memset(feedback.allocation.mapped, 0xFF, feedback_size);
+
+        feedback.bindless_index = bindless.add_buffer(feedback.buffer);
+
+        if (feedback.bindless_index == BindlessHeap::INVALID_INDEX)
+        {
+            LOG_ERROR("Texture Streamer", "Bindless heap is out of buffer slots");
+            cleanup();
+            return false;
+        }
+    }
+
+    if (!create_placeholder())
+    {
+        cleanup();
+        return false;
+    }
+
+    refresh_budget();
+
+    LOG_INFO("Texture Streamer", "Texture budget " + std::to_string(m_budget / (1024 * 1024)) + " MiB" +
+                                 (device.supports_memory_budget() ? "" : ", from heap sizes"));
+
+    return true;
+}
+
+void TextureStreamer::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    for (auto &texture : m_textures)
+    {
+        // Their callbacks find the streamer cleaned up and return
+        if (texture.request != assets::AssetIo::INVALID_REQUEST)
+        {
+            m_io->cancel(texture.request);
+        }
+
+        if (texture.bindless_index != BindlessHeap::INVALID_INDEX)
+        {
+            m_bindless->remove(BindlessType::Texture, texture.bindless_index);
+        }
+
+        destroy_image(texture.image);
+    }
+
+    for (auto &pending : m_pending)
+    {
+        destroy_image(pending.image);
+    }
+
+    for (auto &retired : m_retired)
+    {
+        destroy_image(retired.image);
+    }
+
+    if (m_placeholder_index != BindlessHeap::INVALID_INDEX)
+    {
+        m_bindless->remove(BindlessType::Texture, m_placeholder_index);
+        m_placeholder_index = BindlessHeap::INVALID_INDEX;
+    }
+
+    destroy_image(m_placeholder);
+
+    for (auto &feedback : m_feedback)
+    {
+        if (feedback.bindless_index != BindlessHeap::INVALID_INDEX)
+        {
+            m_bindless->remove(BindlessType::Buffer, feedback.bindless_index);
+        }
+
+        if (feedback.buffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(m_device->device(), feedback.buffer, nullptr);
+        }
+
+        if (feedback.allocation.is_valid())
+        {
+            m_device->allocator().free(feedback.allocation);
+        }
+    }
+
+    m_textures.clear();
+    m_free.clear();
+    m_unloading.clear();
+    m_pending.clear();
+    m_retired.clear();
+    m_feedback.clear();
+
+    m_resident_bytes = 0;
+    m_reserved_bytes = 0;
+    m_streams = 0;
+
+    m_device = nullptr;
+}
+
+TextureHandle TextureStreamer::load(const std::string &path) noexcept
+{
+    if (m_device == nullptr)
+    {
+        return INVALID_HANDLE;
+    }
+
+    TextureHandle handle;
+
+    if (!m_free.empty())
+    {
+        handle = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        handle = static_cast<TextureHandle>(m_textures.size());
+        m_textures.emplace_back();
+    }
+
+    Texture &texture = m_textures[handle];
+    texture = Texture{};
+    texture.path = path;
+    texture.state = TextureState::LoadingHeader;
+    texture.last_used = m_frame;
+
+    assets::IoRequest request;
+    request.path = path;
+    request.size = sizeof(assets::TextureFileHeader);
+    request.priority = assets::IoPriority::High;
+    request.callback = [this, handle](assets::IoResult &result) { on_header(handle, result); };
+
+    texture.request = m_io->read(std::move(request));
+
+    if (texture.request == assets::AssetIo::INVALID_REQUEST)
+    {
+        LOG_WARN("Texture Streamer", "Failed to start reading " + path);
+        texture.state = TextureState::Failed;
+    }
+
+    return handle;
+}
+
+void TextureStreamer::unload(TextureHandle handle) noexcept
+{
+    if (handle >= m_textures.size() ||
+        m_textures[handle].state == TextureState::Free ||
+        m_textures[handle].unloading)
+    {
+        return;
+    }
+
+    Texture &texture = m_textures[handle];
+    texture.unloading = true;
+
+    // Freed by record() once the read's callback has run
+    if (texture.request != assets::AssetIo::INVALID_REQUEST)
+    {
+        m_io->cancel(texture.request);
+    }
+
+    m_unloading.push_back(handle);
+}
+
+uint32_t TextureStreamer::bindless_index(TextureHandle handle) const noexcept
+{
+    if (handle >= m_textures.size() || m_textures[handle].bindless_index == BindlessHeap::INVALID_INDEX)
+    {
+        return m_placeholder_index;
+    }
+
+    return m_textures[handle].bindless_index;
+}
+
+uint32_t TextureStreamer::resident_mip(TextureHandle handle) const noexcept
+{
+    if (handle >= m_textures.size())
+    {
+        return 0;
+    }
+
+    const Texture &texture = m_textures[handle];
+
+    return texture.state == TextureState::Resident ? texture.image.first_mip : texture.header.mip_count;
+}
+
+void TextureStreamer::request_size(TextureHandle handle, float screen_size) noexcept
+{
+    if (handle >= m_textures.size() || screen_size <= 0.0f)
+    {
+        return;
+    }
+
+    Texture &texture = m_textures[handle];
+
+    if (texture.state != TextureState::Resident)
+    {
+        return;
+    }
+
+    float texels = static_cast<float>(std::max(texture.header.width, texture.header.height)) / screen_size;
+    texture.requested_mip = std::min(texture.requested_mip, mip_for_texels(texels, m_config.mip_bias, texture.tail_mip));
+}
+
+uint32_t TextureStreamer::feedback_index() const noexcept
+{
+    if (m_feedback.empty())
+    {
+        return BindlessHeap::INVALID_INDEX;
+    }
+
+    return m_feedback[m_frame % m_feedback.size()].bindless_index;
+}
+
+void TextureStreamer::update() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    refresh_budget();
+    evict();
+    stream();
+}
+
+void TextureStreamer::record(VkCommandBuffer command_buffer) noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    ++m_frame;
+
+    std::erase_if(m_retired, [this](RetiredImage &retired)
+    {
+        if (retired.frame + m_frames_in_flight > m_frame)
+        {
+            return false;
+        }
+
+        destroy_image(retired.image);
+        return true;
+    });
+
+    // Makes every feedback write submitted so far visible to the host once this frame is done
+    VkMemoryBarrier feedback_barrier{};
+    feedback_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    feedback_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    feedback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0,
+                         1, &feedback_barrier,
+                         0, nullptr,
+                         0, nullptr);
+
+    read_feedback();
+    swap_pending(command_buffer);
+    finish_unloads();
+}
+
+VkDeviceSize TextureStreamer::resident_bytes() const noexcept
+{
+    return m_resident_bytes;
+}
+
+VkDeviceSize TextureStreamer::budget() const noexcept
+{
+    return m_budget;
+}
+
+bool TextureStreamer::create_image(const assets::TextureFileHeader &header, uint32_t first_mip, TextureImage &image) noexcept
+{
+    VkFormat format = static_cast<VkFormat>(header.format);
+    uint32_t level_count = header.mip_count - first_mip;
+
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = {header.mips[first_mip].width, header.mips[first_mip].height, 1};
+    image_info.mipLevels = level_count;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(m_device->device(), &image_info, nullptr, &image.image) != VK_SUCCESS)
+    {
+        LOG_ERROR("Texture Streamer", "Failed to create image");
+        return false;
+    }
+
+    // Running out is expected under pressure from elsewhere, the budget catches up next frame
+    if (!m_device->allocator().allocate_image(image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.allocation))
+    {
+        LOG_WARN("Texture Streamer", "Failed to allocate image memory");
+        destroy_image(image);
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1};
+
+    if (vkCreateImageView(m_device->device(), &view_info, nullptr, &image.view) != VK_SUCCESS)
+    {
+        LOG_ERROR("Texture Streamer", "Failed to create image view");
+        destroy_image(image);
+        return false;
+    }
+
+    image.first_mip = first_mip;
+
+    return true;
+}
+
+bool TextureStreamer::create_placeholder() noexcept
+{
+    assets::TextureFileHeader header{};
+    header.format = VK_FORMAT_R8G8B8A8_UNORM;
+    header.width = 1;
+    header.height = 1;
+    header.mip_count = 1;
+    header.mips[0].width = 1;
+    header.mips[0].height = 1;
+
+    const uint8_t grey[] = {128, 128, 128, 255};
+
+    if (!create_image(header, 0, m_placeholder) ||
+        !m_uploads->upload_image(m_placeholder.image, VK_IMAGE_ASPECT_COLOR_BIT, {1, 1, 1}, grey, sizeof(grey)))
+    {
+        LOG_ERROR("Texture Streamer", "Failed to create the placeholder texture");
+        return false;
+    }
+
+    m_placeholder_index = m_bindless->add_texture(m_placeholder.view);
+
+    if (m_placeholder_index == BindlessHeap::INVALID_INDEX)
+    {
+        LOG_ERROR("Texture Streamer", "Bindless heap is out of texture slots");
+        return false;
+    }
+
+    return true;
+}
+
+void TextureStreamer::destroy_image(TextureImage &image) noexcept
+{
+    if (image.view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_device->device(), image.view, nullptr);
+    }
+
+    if (image.image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(m_device->device(), image.image, nullptr);
+    }
+
+    if (image.allocation.is_valid())
+    {
+        m_device->allocator().free(image.allocation);
+    }
+
+    image = TextureImage{};
+}
+
+void TextureStreamer::retire(TextureImage &image, uint64_t frame) noexcept
+{
+    if (image.image == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    m_retired.push_back({image, frame});
+    image = TextureImage{};
+}
+
+void TextureStreamer::read_mips(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, assets::IoPriority priority) noexcept
+{
+    Texture &texture = m_textures[handle];
+
+    assets::IoRequest request;
+    request.path = texture.path;
+    request.offset = texture.header.mips[first_mip].offset;
+    request.size = assets::texture_mip_range_size(texture.header, first_mip, last_mip);
+    request.priority = priority;
+    request.callback = [this, handle, first_mip, last_mip](assets::IoResult &result) { on_mips(handle, first_mip, last_mip, result); };
+
+    texture.request = m_io->read(std::move(request));
+}
+
+void TextureStreamer::on_header(TextureHandle handle, assets::IoResult &result) noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    Texture &texture = m_textures[handle];
+    texture.request = assets::AssetIo::INVALID_REQUEST;
+
+    if (texture.unloading)
+    {
+        return;
+    }
+
+    if (result.status != assets::IoStatus::Complete || result.data.size() < sizeof(assets::TextureFileHeader))
+    {
+        LOG_WARN("Texture Streamer", "Failed to read " + texture.path);
+        texture.state = TextureState::Failed;
+        return;
+    }
+
+    std::memcpy(&texture.header, result.data.data(), sizeof(assets::TextureFileHeader));
+
+    if (!assets::validate_texture_header(texture.header))
+    {
+        LOG_WARN("Texture Streamer", texture.path + " is not a texture of version " +
+                                     std::to_string(assets::TEXTURE_FILE_VERSION) + ", recook it");
+        texture.state = TextureState::Failed;
+        return;
+    }
+
+    // The coarsest mip is the tail even when it is larger than tail_size
+    texture.tail_mip = texture.header.mip_count - 1;
+
+    for (uint32_t mip = 0; mip < texture.header.mip_count; ++mip)
+    {
+        if (std::max(texture.header.mips[mip].width, texture.header.mips[mip].height) <= m_config.tail_size)
+        {
+            texture.tail_mip = mip;
+            break;
+        }
+    }
+
+    texture.wanted_mip = texture.tail_mip;
+    texture.state = TextureState::LoadingTail;
+
+    read_mips(handle, texture.tail_mip, texture.header.mip_count, assets::IoPriority::High);
+
+    if (texture.request == assets::AssetIo::INVALID_REQUEST)
+    {
+        texture.state = TextureState::Failed;
+    }
+}
+
+void TextureStreamer::on_mips(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, assets::IoResult &result) noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    Texture &texture = m_textures[handle];
+    texture.request = assets::AssetIo::INVALID_REQUEST;
+
+    bool grow = texture.state == TextureState::Resident;
+
+    if (grow)
+    {
+        --m_streams;
+        m_reserved_bytes -= texture.reserved;
+        texture.reserved = 0;
+    }
+
+    if (texture.unloading)
+    {
+        return;
+    }
+
+    bool staged = result.status == assets::IoStatus::Complete &&
+                  result.data.size() >= assets::texture_mip_range_size(texture.header, first_mip, last_mip) &&
+                  stage(handle, first_mip, last_mip, result.data.data());
+
+    if (staged)
+    {
+        return;
+    }
+
+    if (result.status == assets::IoStatus::Failed)
+    {
+        LOG_WARN("Texture Streamer", "Failed to read mips of " + texture.path);
+    }
+
+    if (grow)
+    {
+        texture.retry_frame = m_frame + RETRY_FRAMES;
+    }
+    else
+    {
+        texture.state = TextureState::Failed;
+    }
+}
+
+bool TextureStreamer::stage(TextureHandle handle, uint32_t first_mip, uint32_t last_mip, const uint8_t *data) noexcept
+{
+    Texture &texture = m_textures[handle];
+    const assets::TextureFileHeader &header = texture.header;
+
+    TextureImage image;
+
+    if (!create_image(header, first_mip, image))
+    {
+        return false;
+    }
+
+    for (uint32_t mip = first_mip; mip < last_mip; ++mip)
+    {
+        const assets::TextureFileMip &file_mip = header.mips[mip];
+
+        if (!m_uploads->upload_image(image.image,
+                                     VK_IMAGE_ASPECT_COLOR_BIT,
+                                     {file_mip.width, file_mip.height, 1},
+                                     data + (file_mip.offset - header.mips[first_mip].offset),
+                                     file_mip.size,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                     mip - first_mip))
+        {
+            LOG_WARN("Texture Streamer", "Staging ring is too small for the mips of " + texture.path);
+
+            // Copies into it may be recorded already, they land with the next frame
+            retire(image, m_frame + 1);
+            return false;
+        }
+    }
+
+    m_resident_bytes += image.allocation.size;
+    m_resident_bytes -= texture.image.allocation.size;
+
+    texture.pending = true;
+    m_pending.push_back({handle, image, last_mip});
+
+    return true;
+}
+
+void TextureStreamer::refresh_budget() noexcept
+{
+    const VkPhysicalDeviceMemoryProperties &properties = m_device->allocator().memory_properties();
+
+    MemoryBudget heaps;
+    bool has_budget = m_device->memory_budget(heaps);
+
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    VkDeviceSize heap_size = 0;
+
+    for (uint32_t i = 0; i < properties.memoryHeapCount; ++i)
+    {
+        if (!(properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+        {
+            continue;
+        }
+
+        heap_size += properties.memoryHeaps[i].size;
+
+        if (has_budget)
+        {
+            budget += heaps.budget[i];
+            usage += heaps.usage[i];
+        }
+    }
+
+    double limit;
+
+    if (has_budget)
+    {
+        // Whatever the rest of the process and other processes use stays theirs
+        VkDeviceSize others = usage - std::min(usage, m_resident_bytes);
+        limit = static_cast<double>(budget - std::min(budget, others)) * m_config.budget_fraction;
+    }
+    else
+    {
+        limit = static_cast<double>(heap_size) * m_config.heap_fraction;
+    }
+
+    m_budget = static_cast<VkDeviceSize>(limit);
+
+    if (m_config.max_bytes != 0)
+    {
+        m_budget = std::min(m_budget, m_config.max_bytes);
+    }
+}
+
+bool TextureStreamer::is_busy(const Texture &texture) const noexcept
+{
+    return texture.request != assets::AssetIo::INVALID_REQUEST || texture.pending || texture.unloading;
+}
+
+void TextureStreamer::evict() noexcept
+{
+    VkDeviceSize used = m_resident_bytes + m_reserved_bytes;
+
+    if (used <= m_budget)
+    {
+        return;
+    }
+
+    std::vector<TextureHandle> candidates;
+
+    for (TextureHandle handle = 0; handle < m_textures.size(); ++handle)
+    {
+        const Texture &texture = m_textures[handle];
+
+        if (texture.state == TextureState::Resident && !is_busy(texture) && texture.image.first_mip < texture.tail_mip)
+        {
+            candidates.push_back(handle);
+        }
+    }
+
+    // Mips nothing asked for go first, then the least recently used
+    std::sort(candidates.begin(), candidates.end(), [this](TextureHandle a, TextureHandle b)
+    {
+        const Texture &texture_a = m_textures[a];
+        const Texture &texture_b = m_textures[b];
+
+        bool unwanted_a = texture_a.image.first_mip < texture_a.wanted_mip;
+        bool unwanted_b = texture_b.image.first_mip < texture_b.wanted_mip;
+
+        if (unwanted_a != unwanted_b)
+        {
+            return unwanted_a;
+        }
+
+        return texture_a.last_used < texture_b.last_used;
+    });
+
+    for (TextureHandle handle : candidates)
+    {
+        if (used <= m_budget)
+        {
+            break;
+        }
+
+        Texture &texture = m_textures[handle];
+
+        bool unwanted = texture.image.first_mip < texture.wanted_mip;
+        uint32_t target = unwanted ? texture.wanted_mip : texture.image.first_mip + 1;
+
+        TextureImage image;
+
+        if (!create_image(texture.header, target, image))
+        {
+            continue;
+        }
+
+        VkDeviceSize freed = texture.image.allocation.size - std::min(texture.image.allocation.size, image.allocation.size);
+
+        m_resident_bytes += image.allocation.size;
+        m_resident_bytes -= texture.image.allocation.size;
+        used -= std::min(used, freed);
+
+        // A wanted mip is not streamed back in right away, or the two would take turns
+        if (!unwanted)
+        {
+            texture.retry_frame = m_frame + RETRY_FRAMES;
+        }
+
+        texture.pending = true;
+        m_pending.push_back({handle, image, target});
+    }
+}
+
+void TextureStreamer::stream() noexcept
+{
+    if (m_streams >= m_config.max_streams)
+    {
+        return;
+    }
+
+    std::vector<TextureHandle> candidates;
+
+    for (TextureHandle handle = 0; handle < m_textures.size(); ++handle)
+    {
+        const Texture &texture = m_textures[handle];
+
+        if (texture.state == TextureState::Resident &&
+            !is_busy(texture) &&
+            texture.wanted_mip < texture.image.first_mip &&
+            texture.retry_frame <= m_frame)
+        {
+            candidates.push_back(handle);
+        }
+    }
+
+    // The blurriest first, then the most recently seen
+    std::sort(candidates.begin(), candidates.end(), [this](TextureHandle a, TextureHandle b)
+    {
+        const Texture &texture_a = m_textures[a];
+        const Texture &texture_b = m_textures[b];
+
+        uint32_t missing_a = texture_a.image.first_mip - texture_a.wanted_mip;
+        uint32_t missing_b = texture_b.image.first_mip - texture_b.wanted_mip;
+
+        if (missing_a != missing_b)
+        {
+            return missing_a > missing_b;
+        }
+
+        return texture_a.last_used > texture_b.last_used;
+    });
+
+    VkDeviceSize used = m_resident_bytes + m_reserved_bytes;
+
+    for (TextureHandle handle : candidates)
+    {
+        if (m_streams >= m_config.max_streams)
+        {
+            break;
+        }
+
+        Texture &texture = m_textures[handle];
+
+        uint32_t last_mip = texture.image.first_mip;
+        uint32_t first_mip = texture.wanted_mip;
+        VkDeviceSize current = texture.image.allocation.size;
+        VkDeviceSize growth = 0;
+
+        // As fine as fits, image sizes estimated from the file
+        for (; first_mip < last_mip; ++first_mip)
+        {
+            VkDeviceSize size = assets::texture_mip_range_size(texture.header, first_mip, texture.header.mip_count);
+            growth = size - std::min(size, current);
+
+            if (used + growth <= m_budget)
+            {
+                break;
+            }
+        }
+
+        if (first_mip == last_mip)
+        {
+            continue;
+        }
+
+        read_mips(handle, first_mip, last_mip, last_mip - first_mip > 1 ? assets::IoPriority::High : assets::IoPriority::Normal);
+
+        if (texture.request == assets::AssetIo::INVALID_REQUEST)
+        {
+            continue;
+        }
+
+        texture.reserved = growth;
+        m_reserved_bytes += growth;
+        used += growth;
+        ++m_streams;
+    }
+}
+
+void TextureStreamer::read_feedback() noexcept
+{
+    uint32_t *footprints = static_cast<uint32_t *>(m_feedback[m_frame % m_feedback.size()].allocation.mapped);
+
+    for (auto &texture : m_textures)
+    {
+        if (texture.state != TextureState::Resident || texture.unloading)
+        {
+            continue;
+        }
+
+        uint32_t bits = footprints[texture.bindless_index];
+
+        if (bits != NO_FEEDBACK)
+        {
+            footprints[texture.bindless_index] = NO_FEEDBACK;
+
+            float footprint;
+            std::memcpy(&footprint, &bits, sizeof(footprint));
+
+            float texels = footprint * static_cast<float>(std::max(texture.header.width, texture.header.height));
+            texture.requested_mip = std::min(texture.requested_mip, mip_for_texels(texels, m_config.mip_bias, texture.tail_mip));
+        }
+
+        if (texture.requested_mip != UINT32_MAX)
+        {
+            texture.wanted_mip = texture.requested_mip;
+            texture.requested_mip = UINT32_MAX;
+            texture.last_used = m_frame;
+        }
+        else if (m_frame - texture.last_used > m_config.idle_frames)
+        {
+            texture.wanted_mip = texture.tail_mip;
+        }
+    }
+}
+
+void TextureStreamer::swap_pending(VkCommandBuffer command_buffer) noexcept
+{
+    if (m_pending.empty())
+    {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> before;
+    std::vector<VkImageMemoryBarrier> after;
+    std::vector<PendingImage> swaps;
+
+    for (auto &pending : m_pending)
+    {
+        Texture &texture = m_textures[pending.handle];
+        texture.pending = false;
+
+        if (texture.unloading)
+        {
+            m_resident_bytes -= pending.image.allocation.size;
+            m_resident_bytes += texture.image.allocation.size;
+            retire(pending.image, m_frame);
+            continue;
+        }
+
+        swaps.push_back(pending);
+
+        uint32_t copy_count = texture.header.mip_count - pending.copy_mip;
+
+        if (copy_count == 0)
+        {
+            continue;
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        // Kept mips of the current image
+        barrier.image = texture.image.image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, pending.copy_mip - texture.image.first_mip, copy_count, 0, 1};
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        before.push_back(barrier);
+
+        // Back for anything still holding the old bindless index this frame
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        after.push_back(barrier);
+
+        // And where they go in the new one
+        barrier.image = pending.image.image;
+        barrier.subresourceRange.baseMipLevel = pending.copy_mip - pending.image.first_mip;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        before.push_back(barrier);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        after.push_back(barrier);
+    }
+
+    m_pending.clear();
+
+    if (!before.empty())
+    {
+        vkCmdPipelineBarrier(command_buffer,
+                             SHADER_STAGES,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(before.size()), before.data());
+
+        std::vector<VkImageCopy> regions;
+
+        for (const auto &pending : swaps)
+        {
+            const Texture &texture = m_textures[pending.handle];
+
+            regions.clear();
+
+            for (uint32_t mip = pending.copy_mip; mip < texture.header.mip_count; ++mip)
+            {
+                VkImageCopy region{};
+                region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.image.first_mip, 0, 1};
+                region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - pending.image.first_mip, 0, 1};
+                region.extent = {texture.header.mips[mip].width, texture.header.mips[mip].height, 1};
+                regions.push_back(region);
+            }
+
+            if (!regions.empty())
+            {
+                vkCmdCopyImage(command_buffer,
+                               texture.image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               pending.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+            }
+        }
+
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             SHADER_STAGES,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(after.size()), after.data());
+    }
+
+    for (auto &pending : swaps)
+    {
+        Texture &texture = m_textures[pending.handle];
+
+        uint32_t index = m_bindless->add_texture(pending.image.view);
+
+        if (index == BindlessHeap::INVALID_INDEX)
+        {
+            LOG_WARN("Texture Streamer", "Bindless heap is out of texture slots, keeping the mips of " + texture.path);
+
+            m_resident_bytes -= pending.image.allocation.size;
+            m_resident_bytes += texture.image.allocation.size;
+            retire(pending.image, m_frame);
+
+            if (texture.state == TextureState::LoadingTail)
+            {
+                texture.state = TextureState::Failed;
+            }
+
+            continue;
+        }
+
+        if (texture.bindless_index != BindlessHeap::INVALID_INDEX)
+        {
+            m_bindless->remove(BindlessType::Texture, texture.bindless_index);
+        }
+
+        retire(texture.image, m_frame);
+
+        texture.image = pending.image;
+        texture.bindless_index = index;
+        texture.state = TextureState::Resident;
+
+        set_feedback_slot(index);
+    }
+}
+
+void TextureStreamer::finish_unloads() noexcept
+{
+    std::erase_if(m_unloading, [this](TextureHandle handle)
+    {
+        Texture &texture = m_textures[handle];
+
+        // The callback still has to run
+        if (texture.request != assets::AssetIo::INVALID_REQUEST)
+        {
+            return false;
+        }
+
+        if (texture.bindless_index != BindlessHeap::INVALID_INDEX)
+        {
+            m_bindless->remove(BindlessType::Texture, texture.bindless_index);
+        }
+
+        m_resident_bytes -= texture.image.allocation.size;
+        retire(texture.image, m_frame);
+
+        texture = Texture{};
+        m_free.push_back(handle);
+
+        return true;
+    });
+}
+
+void TextureStreamer::set_feedback_slot(uint32_t bindless_index) noexcept
+{
+    for (auto &feedback : m_feedback)
+    {
+        static_cast<uint32_t *>(feedback.allocation.mapped)[bindless_index] = NO_FEEDBACK;
+    }
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include <graphics/timeline.hpp>
+
+#include <log.hpp>
+
+namespace niqqa
+{
+namespace graphics
+{
+bool SyncPoint::is_complete() const noexcept
+{
+    return timeline == nullptr || timeline->is_complete(value);
+}
+
+void SyncPoint::wait() const noexcept
+{
+    if (timeline != nullptr)
+    {
+        timeline->wait(value);
+    }
+}
+
+void SubmitBatch::wait(const SyncPoint &point, VkPipelineStageFlags stage) noexcept
+{
+    if (point.is_complete())
+    {
+        return;
+    }
+
+    wait_semaphores.push_back(point.timeline->semaphore());
+    wait_values.push_back(point.value);
+    wait_stages.push_back(stage);
+}
+
+void SubmitBatch::wait_binary(VkSemaphore semaphore, VkPipelineStageFlags stage) noexcept
+{
+    wait_semaphores.push_back(semaphore);
+    wait_values.push_back(0);
+    wait_stages.push_back(stage);
+}
+
+void SubmitBatch::signal_binary(VkSemaphore semaphore) noexcept
+{
+    signal_semaphores.push_back(semaphore);
+    signal_values.push_back(0);
+}
+
+bool Timeline::init(VkDevice device, VkQueue queue) noexcept
+{
+    m_device = device;
+    m_queue = queue;
+
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_semaphore) != VK_SUCCESS)
+    {
+        LOG_ERROR("Timeline", "Failed to create timeline semaphore");
+        return false;
+    }
+
+    m_submitted = 0;
+    m_completed = 0;
+
+    return true;
+}
+
+void Timeline::cleanup() noexcept
+{
+    if (m_semaphore == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    wait(m_submitted);
+
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    m_semaphore = VK_NULL_HANDLE;
+}
+
+SyncPoint Timeline::submit(const VkCommandBuffer *command_buffers, uint32_t command_buffer_count, SubmitBatch batch) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_submit_mutex);
+
+    uint64_t value = m_submitted + 1;
+
+    batch.signal_semaphores.push_back(m_semaphore);
+    batch.signal_values.push_back(value);
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = static_cast<uint32_t>(batch.wait_values.size());
+    timeline_info.pWaitSemaphoreValues = batch.wait_values.data();
+    timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>(batch.signal_values.size());
+    timeline_info.pSignalSemaphoreValues = batch.signal_values.data();
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(batch.wait_semaphores.size());
+    submit_info.pWaitSemaphores = batch.wait_semaphores.data();
+    submit_info.pWaitDstStageMask = batch.wait_stages.data();
+    submit_info.commandBufferCount = command_buffer_count;
+    submit_info.pCommandBuffers = command_buffers;
+    submit_info.signalSemaphoreCount = static_cast<uint32_t>(batch.signal_semaphores.size());
+    submit_info.pSignalSemaphores = batch.signal_semaphores.data();
+
+    // A value that never gets signaled would hang every later wait, so it is only taken on success
+    if (vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        LOG_ERROR("Timeline", "Failed to submit to queue");
+        return last_submitted();
+    }
+
+    m_submitted = value;
+
+    return {this, value};
+}
+
+VkResult Timeline::present(const VkPresentInfoKHR &present_info) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_submit_mutex);
+
+    return vkQueuePresentKHR(m_queue, &present_info);
+}
+
+SyncPoint Timeline::last_submitted() const noexcept
+{
+    return {this, m_submitted};
+}
+
+uint64_t Timeline::completed_value() const noexcept
+{
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_device, m_semaphore, &value);
+
+    advance_completed(value);
+
+    return value;
+}
+
+bool Timeline::is_complete(uint64_t value) const noexcept
+{
+    if (value <= m_completed)
+    {
+        return true;
+    }
+
+    return value <= completed_value();
+}
+
+void Timeline::wait(uint64_t value) const noexcept
+{
+    if (value <= m_completed)
+    {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_semaphore;
+    wait_info.pValues = &value;
+
+    if (vkWaitSemaphores(m_device, &wait_info, UINT64_MAX) == VK_SUCCESS)
+    {
+        advance_completed(value);
+    }
+}
+
+void Timeline::advance_completed(uint64_t value) const noexcept
+{
+    // Several threads may update it, only ever move it forward
+    uint64_t completed = m_completed;
+
+    while (completed < value && !m_completed.compare_exchange_weak(completed, value))
+    {
+    }
+}
+
+VkSemaphore Timeline::semaphore() const noexcept
+{
+    return m_semaphore;
+}
+
+VkQueue Timeline::queue() const noexcept
+{
+    return m_queue;
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
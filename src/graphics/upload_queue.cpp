@@ -0,0 +1,481 @@
+#include <graphics/upload_queue.hpp>
+
+#include <log.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace niqqa
+{
+namespace graphics
+{
+static uint64_t align_up(uint64_t value, uint64_t alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool UploadBarriers::empty() const noexcept
+{
+    return buffers.empty() && images.empty();
+}
+
+void UploadBarriers::clear() noexcept
+{
+    buffers.clear();
+    images.clear();
+}
+
+bool UploadQueue::init(Device &device, VkDeviceSize staging_size) noexcept
+{
+    m_device = device.device();
+    m_allocator = &device.allocator();
+    m_timeline = &device.transfer_timeline();
+    m_transfer_family = device.transfer_queue_family();
+    m_graphics_family = device.graphics_queue_family();
+    m_capacity = staging_size / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+
+    LOG_INFO("Upload Queue", "Creating staging ring");
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = m_capacity;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &buffer_info, nullptr, &m_staging_buffer) != VK_SUCCESS)
+    {
+        LOG_ERROR("Upload Queue", "Failed to create staging buffer");
+        return false;
+    }
+
+    if (!m_allocator->allocate_buffer(m_staging_buffer,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      m_staging_allocation,
+                                      true))
+    {
+        LOG_ERROR("Upload Queue", "Failed to allocate staging memory");
+        return false;
+    }
+
+    m_staging_data = static_cast<uint8_t *>(m_staging_allocation.mapped);
+
+    if (!m_command_pool.init(m_device,
+                             m_transfer_family,
+                             VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT))
+    {
+        return false;
+    }
+
+    for (auto &batch : m_batches)
+    {
+        batch.command_buffer = m_command_pool.allocate_primary();
+    }
+
+    LOG_INFO("Upload Queue", "Staging ring created (" + std::to_string(m_capacity / (1024 * 1024)) + " MiB)");
+
+    return true;
+}
+
+void UploadQueue::cleanup() noexcept
+{
+    if (m_device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    while (m_retired < m_submitted)
+    {
+        retire(true);
+    }
+
+    for (auto &batch : m_batches)
+    {
+        batch = UploadBatch{};
+    }
+
+    m_pending = SyncPoint{};
+    m_leases.clear();
+    m_batch_barriers.clear();
+    m_acquire_barriers.clear();
+
+    m_command_pool.cleanup();
+
+    if (m_staging_buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device, m_staging_buffer, nullptr);
+        m_staging_buffer = VK_NULL_HANDLE;
+    }
+
+    m_allocator->free(m_staging_allocation);
+    m_staging_data = nullptr;
+
+    m_device = VK_NULL_HANDLE;
+}
+
+bool UploadQueue::upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VkDeviceSize staging_offset = 0;
+
+    if (!reserve(size, staging_offset))
+    {
+        return false;
+    }
+
+    std::memcpy(m_staging_data + staging_offset, data, size);
+
+    record_buffer_copy(staging_offset, buffer, offset, size);
+
+    return true;
+}
+
+bool UploadQueue::acquire_staging(VkDeviceSize size, StagingLease &lease) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VkDeviceSize staging_offset = 0;
+
+    if (!reserve(size, staging_offset, false))
+    {
+        return false;
+    }
+
+    lease.data = m_staging_data + staging_offset;
+    lease.size = size;
+    lease.position = m_head - size;
+
+    m_leases.insert(lease.position);
+
+    return true;
+}
+
+void UploadQueue::commit_staging(StagingLease &lease, VkBuffer buffer, VkDeviceSize offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The batch the copy goes into is the first one allowed to free the space
+    m_leases.erase(lease.position);
+
+    record_buffer_copy(lease.position % m_capacity, buffer, offset, lease.size);
+
+    lease = StagingLease{};
+}
+
+void UploadQueue::release_staging(StagingLease &lease) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_leases.erase(lease.position);
+
+    lease = StagingLease{};
+}
+
+bool UploadQueue::upload_image(VkImage image,
+                               VkImageAspectFlags aspect,
+                               VkExtent3D extent,
+                               const void *data,
+                               VkDeviceSize size,
+                               VkImageLayout final_layout,
+                               uint32_t mip_level) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VkDeviceSize staging_offset = 0;
+
+    if (!reserve(size, staging_offset))
+    {
+        return false;
+    }
+
+    std::memcpy(m_staging_data + staging_offset, data, size);
+
+    VkCommandBuffer command_buffer = begin_batch();
+
+    VkImageMemoryBarrier to_transfer{};
+    to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.srcAccessMask = 0;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = image;
+    to_transfer.subresourceRange = {aspect, mip_level, 1, 0, 1};
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &to_transfer);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging_offset;
+    region.imageSubresource = {aspect, mip_level, 0, 1};
+    region.imageExtent = extent;
+
+    vkCmdCopyBufferToImage(command_buffer, m_staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    bool transfer = ownership_transfer();
+
+    // With an ownership transfer the layout change happens between the release and the acquire
+    VkImageMemoryBarrier barrier = to_transfer;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = transfer ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcQueueFamilyIndex = transfer ? m_transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = transfer ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+
+    m_batch_barriers.images.push_back(barrier);
+
+    return true;
+}
+
+void UploadQueue::flush() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while (m_retired < m_submitted && retire(false))
+    {
+    }
+
+    submit();
+}
+
+void UploadQueue::flush_and_wait() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    submit();
+
+    while (m_retired < m_submitted)
+    {
+        retire(true);
+    }
+}
+
+SyncPoint UploadQueue::consume(VkCommandBuffer command_buffer) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_acquire_barriers.empty())
+    {
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_acquire_barriers.buffers.size()), m_acquire_barriers.buffers.data(),
+                             static_cast<uint32_t>(m_acquire_barriers.images.size()), m_acquire_barriers.images.data());
+
+        m_acquire_barriers.clear();
+    }
+
+    // Timeline values are ordered, waiting on the latest covers every earlier batch
+    SyncPoint pending = m_pending;
+    m_pending = SyncPoint{};
+
+    return pending;
+}
+
+void UploadQueue::collect() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while (m_retired < m_submitted && retire(false))
+    {
+    }
+}
+
+bool UploadQueue::ownership_transfer() const noexcept
+{
+    return m_transfer_family != m_graphics_family;
+}
+
+bool UploadQueue::reserve(VkDeviceSize size, VkDeviceSize &offset, bool wait) noexcept
+{
+    if (size > m_capacity)
+    {
+        LOG_ERROR("Upload Queue", "Upload of " + std::to_string(size) + " bytes does not fit the staging ring");
+        return false;
+    }
+
+    uint64_t begin = align_up(m_head, STAGING_ALIGNMENT);
+
+    // A copy never wraps around the end of the ring, skip to the start instead
+    if (begin % m_capacity + size > m_capacity)
+    {
+        begin = align_up(begin, m_capacity);
+    }
+
+    while (begin + size - m_tail > m_capacity)
+    {
+        if (m_retired < m_submitted)
+        {
+            if (!retire(wait))
+            {
+                return false;
+            }
+        }
+        else if (m_batches[m_submitted % BATCH_COUNT].recording)
+        {
+            // Leases never wait, leave it to the next flush()
+            if (!wait)
+            {
+                return false;
+            }
+
+            // The batch being recorded is holding the space, it has to go first
+            submit();
+        }
+        else if (!m_leases.empty())
+        {
+            // Leased space only comes back once its reads are done, waiting here would not help
+            return false;
+        }
+        else
+        {
+            // Nothing in flight, the whole ring is free
+            m_head = align_up(m_head, m_capacity);
+            m_tail = m_head;
+            begin = m_head;
+        }
+    }
+
+    m_head = begin + size;
+    offset = begin % m_capacity;
+
+    return true;
+}
+
+void UploadQueue::record_buffer_copy(VkDeviceSize staging_offset, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) noexcept
+{
+    VkCommandBuffer command_buffer = begin_batch();
+
+    VkBufferCopy region{};
+    region.srcOffset = staging_offset;
+    region.dstOffset = offset;
+    region.size = size;
+
+    vkCmdCopyBuffer(command_buffer, m_staging_buffer, buffer, 1, &region);
+
+    bool transfer = ownership_transfer();
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = transfer ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex = transfer ? m_transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = transfer ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+
+    m_batch_barriers.buffers.push_back(barrier);
+}
+
+VkCommandBuffer UploadQueue::begin_batch() noexcept
+{
+    if (m_submitted - m_retired == BATCH_COUNT)
+    {
+        retire(true);
+    }
+
+    UploadBatch &batch = m_batches[m_submitted % BATCH_COUNT];
+
+    if (batch.recording)
+    {
+        return batch.command_buffer;
+    }
+
+    vkResetCommandBuffer(batch.command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+    batch.recording = true;
+
+    return batch.command_buffer;
+}
+
+void UploadQueue::submit() noexcept
+{
+    UploadBatch &batch = m_batches[m_submitted % BATCH_COUNT];
+
+    if (!batch.recording)
+    {
+        return;
+    }
+
+    bool transfer = ownership_transfer();
+
+    if (!m_batch_barriers.empty())
+    {
+        // A release only needs to order the copies, on a shared family the barrier has to cover the reads too
+        vkCmdPipelineBarrier(batch.command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             transfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_batch_barriers.buffers.size()), m_batch_barriers.buffers.data(),
+                             static_cast<uint32_t>(m_batch_barriers.images.size()), m_batch_barriers.images.data());
+    }
+
+    vkEndCommandBuffer(batch.command_buffer);
+
+    if (transfer)
+    {
+        for (auto barrier : m_batch_barriers.buffers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            m_acquire_barriers.buffers.push_back(barrier);
+        }
+
+        for (auto barrier : m_batch_barriers.images)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            m_acquire_barriers.images.push_back(barrier);
+        }
+    }
+
+    m_batch_barriers.clear();
+
+    batch.sync = m_timeline->submit(&batch.command_buffer, 1);
+    m_pending = batch.sync;
+
+    // Leased space is still being filled, the ring is only free up to the oldest lease
+    batch.ring_end = m_leases.empty() ? m_head : std::min<uint64_t>(m_head, *m_leases.begin());
+    batch.recording = false;
+
+    ++m_submitted;
+}
+
+bool UploadQueue::retire(bool wait) noexcept
+{
+    UploadBatch &batch = m_batches[m_retired % BATCH_COUNT];
+
+    if (wait)
+    {
+        batch.sync.wait();
+    }
+    else if (!batch.sync.is_complete())
+    {
+        return false;
+    }
+
+    m_tail = batch.ring_end;
+    ++m_retired;
+
+    return true;
+}
+} // namespace graphics
+} // namespace niqqa
\ No newline at end of file
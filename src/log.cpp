@@ -0,0 +1,628 @@
+#include <log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace niqqa
+{
+namespace log
+{
+// Per thread ring size in KB, CMake sets it from NIQQA_LOG_RING_KB. The default holds a few
+// thousand messages, a burst that long is written out before it fills.
+#ifndef NIQQA_LOG_RING_KB
+#define NIQQA_LOG_RING_KB 256
+#endif
+
+static constexpr uint32_t RING_SIZE{NIQQA_LOG_RING_KB * 1024};
+static constexpr uint32_t RING_MASK{RING_SIZE - 1};
+
+static_assert(RING_SIZE >= 4096 && (RING_SIZE & RING_MASK) == 0, "NIQQA_LOG_RING_KB has to be a power of two, 4 or more");
+
+// Records bigger than this skip the ring, the logging thread writes them itself
+static constexpr uint32_t MAX_RECORD_SIZE{RING_SIZE / 4};
+
+// How long the background thread sleeps between drains unless woken
+static constexpr std::chrono::milliseconds DRAIN_INTERVAL{5};
+
+// How long a warning or info message waits on a full ring while the background thread gets
+// nowhere before it is dropped. Longer than that thread is usually kept off the CPU, short of a
+// visible hitch.
+static constexpr std::chrono::milliseconds DROP_BACKOFF{4 * DRAIN_INTERVAL};
+
+enum class RecordKind : uint8_t
+{
+    Message,
+
+    // Fills the end of the ring when a record does not fit there, the record starts over at 0
+    Padding
+};
+
+// Followed by the encoded arguments, the whole record padded to 8 bytes
+struct RecordHeader
+{
+    uint32_t size;
+    RecordKind kind;
+    Level level;
+    uint16_t argument_count;
+    uint64_t time;
+    const char *module;
+
+    // nullptr when the only argument is the message as it is
+    const char *format;
+};
+
+// Single producer, the thread it belongs to, and single consumer, the background thread.
+// Positions only grow, the ring index is the position masked.
+struct alignas(64) ThreadRing
+{
+    alignas(64) std::atomic<uint64_t> write{0};
+    alignas(64) std::atomic<uint64_t> read{0};
+
+    // Set when the thread exits, the ring is freed once drained
+    std::atomic<bool> retired{false};
+    ThreadRing *next{nullptr};
+
+    // Producer only, where the record being written ends
+    alignas(64) uint64_t pending{0};
+    alignas(64) uint8_t data[RING_SIZE];
+};
+
+// Owns the thread's ring, marks it retired on thread exit
+struct RingOwner
+{
+    ThreadRing *ring{nullptr};
+
+    ~RingOwner()
+    {
+        if (ring != nullptr)
+        {
+            ring->retired.store(true, std::memory_order_release);
+            ring = nullptr;
+        }
+    }
+};
+
+static thread_local RingOwner t_ring;
+
+// A record that skips the ring, too big or logged once the background thread is gone.
+// Plain pointers, this still works while the thread's other thread locals are destroyed.
+static thread_local uint8_t *t_direct{nullptr};
+
+// Set before the background thread stops, logging from then on is synchronous
+static std::atomic<bool> s_shutdown{false};
+
+static const char *level_name(Level level) noexcept
+{
+    switch (level)
+    {
+    case Level::Info:
+        return "INFO";
+    case Level::Warn:
+        return "WARN";
+    case Level::Error:
+        return "ERROR";
+    }
+
+    return "";
+}
+
+static void append_argument(const uint8_t *&in, std::string &out) noexcept
+{
+    detail::ArgType type = static_cast<detail::ArgType>(*in++);
+    char number[32];
+
+    switch (type)
+    {
+    case detail::ArgType::Int:
+    {
+        int64_t value;
+        std::memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+
+        out.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+        break;
+    }
+    case detail::ArgType::Uint:
+    {
+        uint64_t value;
+        std::memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+
+        out.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+        break;
+    }
+    case detail::ArgType::Double:
+    {
+        double value;
+        std::memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+
+        out.append(number, std::to_chars(number, number + sizeof(number), value, std::chars_format::general, 6).ptr);
+        break;
+    }
+    case detail::ArgType::Bool:
+    {
+        uint64_t value;
+        std::memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+
+        out += value ? "true" : "false";
+        break;
+    }
+    case detail::ArgType::String:
+    {
+        uint32_t length;
+        std::memcpy(&length, in, sizeof(length));
+        in += sizeof(length);
+
+        out.append(reinterpret_cast<const char *>(in), length);
+        in += length;
+        break;
+    }
+    }
+}
+
+// [LEVEL][module]message, the same lines the iostream macros wrote
+static void format_record(const RecordHeader &header, const uint8_t *arguments, std::string &out) noexcept
+{
+    out += '[';
+    out += level_name(header.level);
+    out += "][";
+    out += header.module;
+    out += ']';
+
+    const uint8_t *in = arguments;
+    uint32_t remaining = header.argument_count;
+
+    if (header.format == nullptr)
+    {
+        if (remaining > 0)
+        {
+            append_argument(in, out);
+        }
+    }
+    else
+    {
+        for (const char *c = header.format; *c != '\0'; ++c)
+        {
+            if (c[0] == '{' && c[1] == '}' && remaining > 0)
+            {
+                append_argument(in, out);
+                --remaining;
+                ++c;
+
+                continue;
+            }
+
+            out += *c;
+        }
+    }
+
+    out += '\n';
+}
+
+static void write_out(Level level, const char *text, size_t length) noexcept
+{
+    std::fwrite(text, 1, length, level == Level::Error ? stderr : stdout);
+}
+
+class Logger
+{
+public:
+    Logger() noexcept
+    {
+        m_thread = std::thread([this]() {
+            drain_main();
+        });
+    }
+
+    ~Logger()
+    {
+        s_shutdown.store(true, std::memory_order_seq_cst);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_wake.notify_one();
+        m_thread.join();
+
+        // Rings threads still hold are left to the OS, those threads may log until they exit
+    }
+
+    ThreadRing *thread_ring() noexcept
+    {
+        if (t_ring.ring == nullptr)
+        {
+            ThreadRing *ring = new (std::nothrow) ThreadRing;
+
+            if (ring == nullptr)
+            {
+                return nullptr;
+            }
+
+            ring->next = m_rings.load(std::memory_order_relaxed);
+
+            while (!m_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+
+            t_ring.ring = ring;
+        }
+
+        return t_ring.ring;
+    }
+
+    // Never blocks on the background thread, only nudges it
+    void wake() noexcept
+    {
+        if (!m_wake_pending.exchange(true, std::memory_order_relaxed))
+        {
+            m_wake.notify_one();
+        }
+    }
+
+    void flush() noexcept
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        uint64_t ticket = ++m_flush_requested;
+
+        m_wake.notify_one();
+        m_flushed.wait(lock, [&]() {
+            return m_flush_done >= ticket || m_stop;
+        });
+    }
+
+    void count_dropped() noexcept
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        m_dropped_total.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t dropped() const noexcept
+    {
+        return m_dropped_total.load(std::memory_order_relaxed);
+    }
+
+    // Goes up with every record the background thread formats or writes out, whichever ring
+    uint64_t progress() const noexcept
+    {
+        return m_progress.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Line
+    {
+        uint64_t time;
+        Level level;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    std::atomic<ThreadRing *> m_rings{nullptr};
+    std::atomic<bool> m_wake_pending{false};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_dropped_total{0};
+    std::atomic<uint64_t> m_progress{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_flushed;
+    uint64_t m_flush_requested{0};
+    uint64_t m_flush_done{0};
+    bool m_stop{false};
+
+    std::thread m_thread;
+
+    // Background thread only
+    std::vector<Line> m_lines;
+    std::string m_text;
+
+    void drain_main() noexcept
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (;;)
+        {
+            m_wake.wait_for(lock, DRAIN_INTERVAL, [&]() {
+                return m_stop || m_flush_requested > m_flush_done || m_wake_pending.load(std::memory_order_relaxed);
+            });
+
+            bool stop = m_stop;
+            uint64_t ticket = m_flush_requested;
+
+            m_wake_pending.store(false, std::memory_order_relaxed);
+            lock.unlock();
+
+            drain();
+
+            lock.lock();
+            m_flush_done = ticket;
+            m_flushed.notify_all();
+
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    void drain() noexcept
+    {
+        m_lines.clear();
+        m_text.clear();
+
+        ThreadRing *previous = nullptr;
+        ThreadRing *ring = m_rings.load(std::memory_order_acquire);
+
+        while (ring != nullptr)
+        {
+            ThreadRing *next = ring->next;
+
+            // Read before draining, so a retired ring is known to be complete once drained
+            bool retired = ring->retired.load(std::memory_order_acquire);
+
+            drain_ring(*ring);
+
+            // The head is left alone, new threads push in front of it without the drain knowing
+            if (retired && previous != nullptr)
+            {
+                previous->next = next;
+                delete ring;
+            }
+            else
+            {
+                previous = ring;
+            }
+
+            ring = next;
+        }
+
+        uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+
+        if (dropped > 0)
+        {
+            uint32_t begin = static_cast<uint32_t>(m_text.size());
+
+            m_text += "[WARN][Log]" + std::to_string(dropped) + " messages dropped, logged faster than they were written out\n";
+            m_lines.push_back({UINT64_MAX, Level::Warn, begin, static_cast<uint32_t>(m_text.size())});
+        }
+
+        if (m_lines.empty())
+        {
+            return;
+        }
+
+        // Each ring is in order already, this interleaves the threads
+        std::stable_sort(m_lines.begin(), m_lines.end(), [](const Line &a, const Line &b) {
+            return a.time < b.time;
+        });
+
+        for (const Line &line : m_lines)
+        {
+            write_out(line.level, m_text.data() + line.begin, line.end - line.begin);
+            advance();
+        }
+
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+
+    void drain_ring(ThreadRing &ring) noexcept
+    {
+        uint64_t read = ring.read.load(std::memory_order_relaxed);
+        uint64_t write = ring.write.load(std::memory_order_acquire);
+
+        while (read < write)
+        {
+            const uint8_t *record = ring.data + (read & RING_MASK);
+
+            // Padding can be as small as 8 bytes, only its size and kind are there
+            uint32_t size;
+            RecordKind kind;
+
+            std::memcpy(&size, record, sizeof(size));
+            std::memcpy(&kind, record + offsetof(RecordHeader, kind), sizeof(kind));
+
+            if (kind == RecordKind::Message)
+            {
+                RecordHeader header;
+                std::memcpy(&header, record, sizeof(header));
+
+                uint32_t begin = static_cast<uint32_t>(m_text.size());
+
+                format_record(header, record + sizeof(RecordHeader), m_text);
+                m_lines.push_back({header.time, header.level, begin, static_cast<uint32_t>(m_text.size())});
+            }
+
+            read += size;
+
+            // Record by record, a producer waiting for room gets it as soon as there is some
+            ring.read.store(read, std::memory_order_release);
+            advance();
+        }
+    }
+
+    // Only the background thread writes it
+    void advance() noexcept
+    {
+        m_progress.store(m_progress.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+static Logger &logger() noexcept
+{
+    static Logger instance;
+
+    return instance;
+}
+
+static uint64_t now() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+static void write_header(uint8_t *record, uint32_t size, Level level, const char *module, const char *format, uint32_t argument_count) noexcept
+{
+    RecordHeader header{size, RecordKind::Message, level, static_cast<uint16_t>(argument_count), now(), module, format};
+
+    std::memcpy(record, &header, sizeof(header));
+}
+
+void flush() noexcept
+{
+    if (!s_shutdown.load(std::memory_order_acquire))
+    {
+        logger().flush();
+    }
+}
+
+uint64_t dropped() noexcept
+{
+    return s_shutdown.load(std::memory_order_acquire) ? 0 : logger().dropped();
+}
+
+namespace detail
+{
+uint8_t *begin_record(Level level, const char *module, const char *format, uint32_t argument_count, uint32_t arguments_size) noexcept
+{
+    uint32_t size = (static_cast<uint32_t>(sizeof(RecordHeader)) + arguments_size + 7) & ~7u;
+
+    ThreadRing *ring = nullptr;
+    std::chrono::steady_clock::time_point backoff_start{};
+    uint64_t backoff_progress = 0;
+
+    if (size <= MAX_RECORD_SIZE && !s_shutdown.load(std::memory_order_acquire))
+    {
+        ring = logger().thread_ring();
+    }
+
+    if (ring == nullptr)
+    {
+        // Whatever was queued comes out first
+        flush();
+
+        t_direct = new (std::nothrow) uint8_t[size];
+
+        if (t_direct == nullptr)
+        {
+            return nullptr;
+        }
+
+        write_header(t_direct, size, level, module, format, argument_count);
+
+        return t_direct + sizeof(RecordHeader);
+    }
+
+    for (;;)
+    {
+        uint64_t write = ring->write.load(std::memory_order_relaxed);
+        uint64_t read = ring->read.load(std::memory_order_acquire);
+
+        uint32_t offset = static_cast<uint32_t>(write & RING_MASK);
+        uint32_t contiguous = RING_SIZE - offset;
+        uint32_t needed = size <= contiguous ? size : size + contiguous;
+
+        if (write + needed - read <= RING_SIZE)
+        {
+            if (size > contiguous)
+            {
+                RecordHeader padding{};
+                padding.size = contiguous;
+                padding.kind = RecordKind::Padding;
+
+                // Only size and kind, the padding may be smaller than a header
+                std::memcpy(ring->data + offset, &padding.size, sizeof(padding.size));
+                std::memcpy(ring->data + offset + offsetof(RecordHeader, kind), &padding.kind, sizeof(padding.kind));
+
+                write += contiguous;
+                offset = 0;
+            }
+
+            // Half full, drain before it fills up
+            if (write + size - read > RING_SIZE / 2)
+            {
+                logger().wake();
+            }
+
+            ring->pending = write + size;
+            write_header(ring->data + offset, size, level, module, format, argument_count);
+
+            return ring->data + offset + sizeof(RecordHeader);
+        }
+
+        // Errors wait for room. Anything else waits as long as the background thread gets on,
+        // slowing this thread down to what gets written, and is dropped once it got nowhere for
+        // DROP_BACKOFF rather than stall the thread behind a stuck writer.
+        if (s_shutdown.load(std::memory_order_acquire))
+        {
+            logger().count_dropped();
+
+            return nullptr;
+        }
+
+        if (level != Level::Error)
+        {
+            auto time = std::chrono::steady_clock::now();
+            uint64_t progress = logger().progress();
+
+            if (backoff_start == std::chrono::steady_clock::time_point{} || progress != backoff_progress)
+            {
+                backoff_start = time;
+                backoff_progress = progress;
+            }
+            else if (time - backoff_start > DROP_BACKOFF)
+            {
+                logger().count_dropped();
+
+                return nullptr;
+            }
+        }
+
+        logger().wake();
+        std::this_thread::yield();
+    }
+}
+
+void end_record(Level level) noexcept
+{
+    if (t_direct != nullptr)
+    {
+        RecordHeader header;
+        std::memcpy(&header, t_direct, sizeof(header));
+
+        std::string line;
+        format_record(header, t_direct + sizeof(RecordHeader), line);
+
+        delete[] t_direct;
+        t_direct = nullptr;
+
+        write_out(level, line.data(), line.size());
+        std::fflush(level == Level::Error ? stderr : stdout);
+
+        return;
+    }
+
+    ThreadRing *ring = t_ring.ring;
+
+    ring->write.store(ring->pending, std::memory_order_release);
+
+    // Written out before the call returns, an abort or crash right after loses nothing
+    if (level == Level::Error)
+    {
+        logger().flush();
+    }
+}
+} // namespace detail
+} // namespace log
+} // namespace niqqa
\ No newline at end of file
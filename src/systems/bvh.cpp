@@ -0,0 +1,1315 @@
+#include <systems/bvh.hpp>
+
+#include <math/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace niqqa
+{
+namespace systems
+{
+// Nodes are tested one at a time, so lanes wider than a node's four slots are no use
+#ifdef NIQQA_MATH_SSE2
+using NodeLanes = math::SseLanes;
+#else
+using NodeLanes = math::ScalarLanes;
+#endif
+
+// Below this the parallel query costs more in job overhead than the traversal itself
+static constexpr uint32_t PARALLEL_QUERY_MIN_ITEMS{4096};
+
+static float area(const math::Aabb &box) noexcept
+{
+    if (box.max.x < box.min.x)
+    {
+        return 0.0f;
+    }
+
+    math::vec3 size = box.max - box.min;
+
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool equal(const math::Aabb &a, const math::Aabb &b) noexcept
+{
+    return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+           a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+// Each query thread keeps its own traversal stack
+static std::vector<uint32_t> &traversal_stack() noexcept
+{
+    static thread_local std::vector<uint32_t> stack;
+
+    stack.clear();
+
+    return stack;
+}
+
+// Bit s set for the slots that touch the frustum, and in inside for those entirely within
+// it. Per plane only the box corner furthest along the normal decides whether a box is out,
+// the nearest one whether it is in.
+template <typename L>
+static uint32_t test_frustum(const math::Frustum &frustum, const BvhNode &node, uint32_t &inside) noexcept
+{
+    const typename L::value zero = L::set1(0.0f);
+
+    uint32_t visible_bits = 0;
+    inside = 0;
+
+    for (uint32_t s = 0; s < 4; s += L::WIDTH)
+    {
+        typename L::mask visible = L::greater_equal(zero, zero);
+        typename L::mask within = visible;
+
+        for (const math::Plane &plane : frustum.planes)
+        {
+            const float *far_x = plane.normal.x >= 0.0f ? node.max_x.data() : node.min_x.data();
+            const float *far_y = plane.normal.y >= 0.0f ? node.max_y.data() : node.min_y.data();
+            const float *far_z = plane.normal.z >= 0.0f ? node.max_z.data() : node.min_z.data();
+            const float *near_x = plane.normal.x >= 0.0f ? node.min_x.data() : node.max_x.data();
+            const float *near_y = plane.normal.y >= 0.0f ? node.min_y.data() : node.max_y.data();
+            const float *near_z = plane.normal.z >= 0.0f ? node.min_z.data() : node.max_z.data();
+
+            typename L::value normal_x = L::set1(plane.normal.x);
+            typename L::value normal_y = L::set1(plane.normal.y);
+            typename L::value normal_z = L::set1(plane.normal.z);
+            typename L::value distance = L::set1(plane.distance);
+
+            typename L::value far_distance = L::fmadd(normal_x, L::load(far_x + s),
+                                                      L::fmadd(normal_y, L::load(far_y + s),
+                                                               L::fmadd(normal_z, L::load(far_z + s), distance)));
+            typename L::value near_distance = L::fmadd(normal_x, L::load(near_x + s),
+                                                       L::fmadd(normal_y, L::load(near_y + s),
+                                                                L::fmadd(normal_z, L::load(near_z + s), distance)));
+
+            visible = L::mask_and(visible, L::greater_equal(far_distance, zero));
+            within = L::mask_and(within, L::greater_equal(near_distance, zero));
+        }
+
+        visible_bits |= L::bits(visible) << s;
+        inside |= L::bits(L::mask_and(visible, within)) << s;
+    }
+
+    return visible_bits;
+}
+
+// Bit s set for the slots the ray enters before max_distance, enter holding where. Empty
+// slots are masked out explicitly, their inverted boxes look like slabs to the ray.
+template <typename L>
+static uint32_t test_ray(const math::Ray &ray, const math::vec3 &inverse, float max_distance, const BvhNode &node, float *enter) noexcept
+{
+    const typename L::value zero = L::set1(0.0f);
+
+    typename L::value origin_x = L::set1(ray.origin.x);
+    typename L::value origin_y = L::set1(ray.origin.y);
+    typename L::value origin_z = L::set1(ray.origin.z);
+    typename L::value inverse_x = L::set1(inverse.x);
+    typename L::value inverse_y = L::set1(inverse.y);
+    typename L::value inverse_z = L::set1(inverse.z);
+    typename L::value exit_limit = L::set1(max_distance);
+
+    uint32_t hit_bits = 0;
+
+    for (uint32_t s = 0; s < 4; s += L::WIDTH)
+    {
+        typename L::value min_x = L::load(node.min_x.data() + s);
+        typename L::value max_x = L::load(node.max_x.data() + s);
+
+        typename L::value t1_x = L::mul(L::sub(min_x, origin_x), inverse_x);
+        typename L::value t2_x = L::mul(L::sub(max_x, origin_x), inverse_x);
+        typename L::value t1_y = L::mul(L::sub(L::load(node.min_y.data() + s), origin_y), inverse_y);
+        typename L::value t2_y = L::mul(L::sub(L::load(node.max_y.data() + s), origin_y), inverse_y);
+        typename L::value t1_z = L::mul(L::sub(L::load(node.min_z.data() + s), origin_z), inverse_z);
+        typename L::value t2_z = L::mul(L::sub(L::load(node.max_z.data() + s), origin_z), inverse_z);
+
+        typename L::value t_near = L::max(L::max(L::min(t1_x, t2_x), L::min(t1_y, t2_y)), L::max(L::min(t1_z, t2_z), zero));
+        typename L::value t_far = L::min(L::min(L::max(t1_x, t2_x), L::max(t1_y, t2_y)), L::min(L::max(t1_z, t2_z), exit_limit));
+
+        typename L::mask hit = L::mask_and(L::greater_equal(t_far, t_near), L::greater_equal(max_x, min_x));
+
+        L::store(enter + s, t_near);
+        hit_bits |= L::bits(hit) << s;
+    }
+
+    return hit_bits;
+}
+
+bool Bvh::init(uint32_t capacity) noexcept
+{
+    // About one node per two items, the rest is room for garbage between compactions
+    m_items.reserve(capacity);
+    m_nodes.reserve(capacity + 1);
+    m_dirty.reserve(capacity + 1);
+
+    return true;
+}
+
+void Bvh::cleanup() noexcept
+{
+    m_nodes = {};
+    m_dirty = {};
+    m_refit = false;
+    m_root = NO_NODE;
+    m_garbage_nodes = 0;
+
+    m_items = {};
+    m_free_items = {};
+    m_item_count = 0;
+    m_changes = 0;
+    m_rebuild_cursor = 0;
+
+    m_entity_items = {};
+    m_scene_layout = UINT64_MAX;
+
+    m_build_refs = {};
+    m_node_order = {};
+    m_node_remap = {};
+    m_tasks = {};
+    m_expanded = {};
+    m_task_visible = {};
+}
+
+uint32_t Bvh::insert(const math::Aabb &bounds, uint32_t value) noexcept
+{
+    uint32_t item;
+
+    if (!m_free_items.empty())
+    {
+        item = m_free_items.back();
+        m_free_items.pop_back();
+    }
+    else
+    {
+        item = static_cast<uint32_t>(m_items.size());
+        m_items.emplace_back();
+    }
+
+    m_items[item].bounds = bounds;
+    m_items[item].value = value;
+
+    ++m_item_count;
+    ++m_changes;
+
+    if (m_root == NO_NODE)
+    {
+        m_root = allocate_node(NO_NODE, 0);
+        set_slot(m_root, 0, ITEM_BIT | item, bounds);
+
+        return item;
+    }
+
+    // Down the slots that grow the least, until a free one or an item to pair up with
+    uint32_t node = m_root;
+
+    for (;;)
+    {
+        const BvhNode &current = m_nodes[node];
+
+        uint32_t best_slot = 0;
+        float best_growth = FLT_MAX;
+        float best_area = FLT_MAX;
+
+        for (uint32_t s = 0; s < 4; ++s)
+        {
+            if (current.children[s] == EMPTY_SLOT)
+            {
+                best_slot = s;
+                best_growth = -1.0f;
+
+                break;
+            }
+
+            math::Aabb slot = slot_bounds(node, s);
+            float slot_area = area(slot);
+            float growth = area(math::merge(slot, bounds)) - slot_area;
+
+            if (growth < best_growth || (growth == best_growth && slot_area < best_area))
+            {
+                best_slot = s;
+                best_growth = growth;
+                best_area = slot_area;
+            }
+        }
+
+        uint32_t child = current.children[best_slot];
+
+        if (child == EMPTY_SLOT)
+        {
+            set_slot(node, best_slot, ITEM_BIT | item, bounds);
+            mark_dirty(node);
+
+            return item;
+        }
+
+        if (!(child & ITEM_BIT))
+        {
+            node = child;
+
+            continue;
+        }
+
+        math::Aabb paired = slot_bounds(node, best_slot);
+        uint32_t pair = allocate_node(node, best_slot);
+
+        set_slot(pair, 0, child, paired);
+        set_slot(pair, 1, ITEM_BIT | item, bounds);
+        set_slot(node, best_slot, pair, math::merge(paired, bounds));
+        mark_dirty(node);
+
+        return item;
+    }
+}
+
+void Bvh::move(uint32_t item, const math::Aabb &bounds) noexcept
+{
+    if (item >= m_items.size() || m_items[item].node == NO_NODE)
+    {
+        return;
+    }
+
+    Item &entry = m_items[item];
+
+    entry.bounds = bounds;
+    set_slot(entry.node, entry.slot, ITEM_BIT | item, bounds);
+    mark_dirty(entry.node);
+}
+
+void Bvh::set_value(uint32_t item, uint32_t value) noexcept
+{
+    if (item < m_items.size())
+    {
+        m_items[item].value = value;
+    }
+}
+
+void Bvh::remove(uint32_t item) noexcept
+{
+    if (item >= m_items.size() || m_items[item].node == NO_NODE)
+    {
+        return;
+    }
+
+    Item &entry = m_items[item];
+
+    // Nodes left empty stay until a rebuild, their inverted boxes fail every test
+    set_slot(entry.node, entry.slot, EMPTY_SLOT, {});
+    mark_dirty(entry.node);
+
+    entry.node = NO_NODE;
+    m_free_items.push_back(item);
+
+    --m_item_count;
+    ++m_changes;
+}
+
+void Bvh::sync(const Scene &scene) noexcept
+{
+    const ScenePools &pools = scene.pools();
+    uint32_t count = scene.entity_count();
+
+    // A new layout means destroyed entities are gone from the pools, look for them by id
+    bool relayout = scene.layout_version() != m_scene_layout;
+
+    if (relayout)
+    {
+        m_scene_layout = scene.layout_version();
+
+        for (Entity entity = 0; entity < m_entity_items.size(); ++entity)
+        {
+            if (m_entity_items[entity] != INVALID_ITEM && !scene.is_alive(entity))
+            {
+                remove(m_entity_items[entity]);
+                m_entity_items[entity] = INVALID_ITEM;
+            }
+        }
+    }
+
+    auto sync_range = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t index = begin; index < end; ++index)
+        {
+            Entity entity = pools.entity[index];
+
+            if (entity >= m_entity_items.size())
+            {
+                m_entity_items.resize(entity + 1, INVALID_ITEM);
+            }
+
+            uint32_t &item = m_entity_items[entity];
+            uint32_t handle = pools.render_handle[index];
+
+            if (!pools.alive[index] || handle == Scene::NO_RENDER_HANDLE)
+            {
+                if (item != INVALID_ITEM)
+                {
+                    remove(item);
+                    item = INVALID_ITEM;
+                }
+
+                continue;
+            }
+
+            std::array<float, 4> sphere = pools.world_bounds(index);
+
+            math::vec3 center{sphere[0], sphere[1], sphere[2]};
+            math::vec3 radius{sphere[3], sphere[3], sphere[3]};
+            math::Aabb bounds{center - radius, center + radius};
+
+            if (item == INVALID_ITEM)
+            {
+                item = insert(bounds, handle);
+            }
+            else
+            {
+                move(item, bounds);
+                set_value(item, handle);
+            }
+        }
+    };
+
+    if (relayout)
+    {
+        sync_range(0, count);
+
+        return;
+    }
+
+    for (const SceneRange &range : scene.changed())
+    {
+        sync_range(range.begin, range.end);
+    }
+}
+
+void Bvh::update() noexcept
+{
+    // Worth starting over once a quarter of the items came or went
+    if (m_changes > m_item_count / 4)
+    {
+        rebuild();
+
+        return;
+    }
+
+    if (m_refit)
+    {
+        refit();
+    }
+
+    if (m_root == NO_NODE)
+    {
+        return;
+    }
+
+    // Rebuilt subtrees leave their old nodes behind, packed away once they outnumber the rest,
+    // or earlier when the next rebuild would make the array grow and copy all of them. That
+    // call skips its rebuild turn, so one update() does one of the two at most.
+    bool full = m_nodes.size() + MAX_REBUILD_ITEMS > m_nodes.capacity();
+
+    if (m_garbage_nodes > node_count() || (full && m_garbage_nodes >= MAX_REBUILD_ITEMS))
+    {
+        compact();
+
+        return;
+    }
+
+    // The subtrees REBUILD_DEPTH levels down take turns, one per update, and are rebuilt once
+    // moving items made them noticeably worse than they were built. The root takes its turn
+    // too, for the levels above them.
+    std::array<uint32_t, MAX_REBUILD_CANDIDATES> level{m_root};
+    std::array<uint32_t, MAX_REBUILD_CANDIDATES> next;
+    uint32_t level_count = 1;
+
+    for (uint32_t depth = 0; depth < REBUILD_DEPTH; ++depth)
+    {
+        uint32_t next_count = 0;
+
+        for (uint32_t n = 0; n < level_count; ++n)
+        {
+            for (uint32_t child : m_nodes[level[n]].children)
+            {
+                if (child != EMPTY_SLOT && !(child & ITEM_BIT))
+                {
+                    next[next_count++] = child;
+                }
+            }
+        }
+
+        if (next_count == 0)
+        {
+            break;
+        }
+
+        level = next;
+        level_count = next_count;
+    }
+
+    uint32_t turn = m_rebuild_cursor++ % (level_count + 1);
+    uint32_t candidate = turn == level_count ? m_root : level[turn];
+    float build_cost = m_nodes[candidate].build_cost;
+
+    if (candidate == m_root)
+    {
+        if (build_cost > 0.0f && top_cost() > build_cost * REBUILD_COST_RATIO)
+        {
+            rebuild_top();
+        }
+
+        return;
+    }
+
+    uint32_t item_count = 0;
+
+    if (build_cost > 0.0f && subtree_cost(candidate, item_count) > build_cost * REBUILD_COST_RATIO)
+    {
+        rebuild_subtree(rebuild_target(candidate, item_count));
+    }
+}
+
+void Bvh::rebuild() noexcept
+{
+    m_build_refs.clear();
+
+    for (uint32_t item = 0; item < m_items.size(); ++item)
+    {
+        if (m_items[item].node != NO_NODE)
+        {
+            m_build_refs.push_back({m_items[item].bounds, math::center(m_items[item].bounds), ITEM_BIT | item});
+        }
+    }
+
+    m_nodes.clear();
+    m_dirty.clear();
+    m_refit = false;
+    m_garbage_nodes = 0;
+    m_changes = 0;
+    m_root = NO_NODE;
+
+    if (m_build_refs.empty())
+    {
+        return;
+    }
+
+    float area_sum = 0.0f;
+
+    m_root = build(m_build_refs.data(), static_cast<uint32_t>(m_build_refs.size()), NO_NODE, 0, area_sum);
+
+    // The root's turn in update() looks at the levels rebuild_top() redoes, not the whole tree
+    m_nodes[m_root].build_cost = top_cost();
+}
+
+void Bvh::query(const math::Frustum &frustum, std::vector<uint32_t> &visible) const noexcept
+{
+    visible.clear();
+
+    if (m_root != NO_NODE)
+    {
+        traverse(frustum, m_root, false, visible);
+    }
+}
+
+void Bvh::query(const math::Frustum &frustum, JobSystem &jobs, std::vector<uint32_t> &visible) noexcept
+{
+    if (m_item_count < PARALLEL_QUERY_MIN_ITEMS || jobs.thread_count() < 2)
+    {
+        query(frustum, visible);
+
+        return;
+    }
+
+    visible.clear();
+
+    // Breadth first from the root until there are enough subtrees to go around. Items met on
+    // the way become tasks of their own, which keeps the output in tree order.
+    uint32_t target = jobs.thread_count() * TASKS_PER_THREAD;
+
+    m_tasks.assign(1, {m_root, false});
+
+    std::vector<Task> &next = m_expanded;
+
+    for (bool expanded = true; expanded && m_tasks.size() < target;)
+    {
+        expanded = false;
+        next.clear();
+
+        for (const Task &task : m_tasks)
+        {
+            if ((task.node & ITEM_BIT) || task.all_visible)
+            {
+                next.push_back(task);
+
+                continue;
+            }
+
+            const BvhNode &node = m_nodes[task.node];
+
+            uint32_t inside;
+            uint32_t hits = test_frustum<NodeLanes>(frustum, node, inside);
+
+            for (uint32_t s = 0; s < 4; ++s)
+            {
+                if (hits & (1u << s))
+                {
+                    next.push_back({node.children[s], (inside & (1u << s)) != 0});
+                }
+            }
+
+            expanded = true;
+        }
+
+        m_tasks.swap(next);
+    }
+
+    if (m_task_visible.size() < m_tasks.size())
+    {
+        m_task_visible.resize(m_tasks.size());
+    }
+
+    jobs.parallel_for(static_cast<uint32_t>(m_tasks.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; ++t)
+        {
+            const Task &task = m_tasks[t];
+            std::vector<uint32_t> &output = m_task_visible[t];
+
+            output.clear();
+
+            if (task.node & ITEM_BIT)
+            {
+                output.push_back(m_items[task.node & ~ITEM_BIT].value);
+            }
+            else
+            {
+                traverse(frustum, task.node, task.all_visible, output);
+            }
+        }
+    });
+
+    for (uint32_t t = 0; t < m_tasks.size(); ++t)
+    {
+        visible.insert(visible.end(), m_task_visible[t].begin(), m_task_visible[t].end());
+    }
+}
+
+bool Bvh::raycast(const math::Ray &ray, BvhHit &hit) const noexcept
+{
+    if (m_root == NO_NODE)
+    {
+        return false;
+    }
+
+    math::vec3 inverse{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    float nearest = ray.max_distance;
+    uint32_t nearest_item = INVALID_ITEM;
+
+    // Nodes with the distance their box was entered at, so those behind a closer hit are skipped
+    static thread_local std::vector<std::pair<uint32_t, float>> stack;
+
+    stack.clear();
+    stack.push_back({m_root, 0.0f});
+
+    while (!stack.empty())
+    {
+        auto [node_index, node_enter] = stack.back();
+
+        stack.pop_back();
+
+        if (node_enter > nearest)
+        {
+            continue;
+        }
+
+        const BvhNode &node = m_nodes[node_index];
+
+        alignas(16) float enter[4];
+        uint32_t hits = test_ray<NodeLanes>(ray, inverse, nearest, node, enter);
+
+        // Children pushed far to near, so the nearest is visited next
+        uint32_t order[4];
+        uint32_t order_count = 0;
+
+        for (uint32_t s = 0; s < 4; ++s)
+        {
+            if (!(hits & (1u << s)))
+            {
+                continue;
+            }
+
+            uint32_t child = node.children[s];
+
+            if (child & ITEM_BIT)
+            {
+                if (enter[s] < nearest || nearest_item == INVALID_ITEM)
+                {
+                    nearest = enter[s];
+                    nearest_item = child & ~ITEM_BIT;
+                }
+
+                continue;
+            }
+
+            uint32_t position = order_count++;
+
+            for (; position > 0 && enter[order[position - 1]] < enter[s]; --position)
+            {
+                order[position] = order[position - 1];
+            }
+
+            order[position] = s;
+        }
+
+        for (uint32_t o = 0; o < order_count; ++o)
+        {
+            stack.push_back({node.children[order[o]], enter[order[o]]});
+        }
+    }
+
+    if (nearest_item == INVALID_ITEM)
+    {
+        return false;
+    }
+
+    hit.item = nearest_item;
+    hit.value = m_items[nearest_item].value;
+    hit.distance = nearest;
+
+    return true;
+}
+
+uint32_t Bvh::value(uint32_t item) const noexcept
+{
+    return item < m_items.size() ? m_items[item].value : 0;
+}
+
+uint32_t Bvh::item_count() const noexcept
+{
+    return m_item_count;
+}
+
+uint32_t Bvh::node_count() const noexcept
+{
+    return static_cast<uint32_t>(m_nodes.size()) - m_garbage_nodes;
+}
+
+uint32_t Bvh::allocate_node(uint32_t parent, uint32_t parent_slot) noexcept
+{
+    BvhNode node;
+
+    node.min_x.fill(FLT_MAX);
+    node.min_y.fill(FLT_MAX);
+    node.min_z.fill(FLT_MAX);
+    node.max_x.fill(-FLT_MAX);
+    node.max_y.fill(-FLT_MAX);
+    node.max_z.fill(-FLT_MAX);
+    node.children.fill(EMPTY_SLOT);
+    node.parent = parent;
+    node.parent_slot = parent_slot;
+    node.build_cost = 0.0f;
+
+    m_nodes.push_back(node);
+    m_dirty.push_back(0);
+
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void Bvh::set_slot(uint32_t node, uint32_t slot, uint32_t child, const math::Aabb &bounds) noexcept
+{
+    BvhNode &target = m_nodes[node];
+
+    target.min_x[slot] = bounds.min.x;
+    target.min_y[slot] = bounds.min.y;
+    target.min_z[slot] = bounds.min.z;
+    target.max_x[slot] = bounds.max.x;
+    target.max_y[slot] = bounds.max.y;
+    target.max_z[slot] = bounds.max.z;
+    target.children[slot] = child;
+
+    if (child == EMPTY_SLOT)
+    {
+        return;
+    }
+
+    if (child & ITEM_BIT)
+    {
+        m_items[child & ~ITEM_BIT].node = node;
+        m_items[child & ~ITEM_BIT].slot = slot;
+    }
+    else
+    {
+        m_nodes[child].parent = node;
+        m_nodes[child].parent_slot = slot;
+    }
+}
+
+math::Aabb Bvh::slot_bounds(uint32_t node, uint32_t slot) const noexcept
+{
+    const BvhNode &source = m_nodes[node];
+
+    return {{source.min_x[slot], source.min_y[slot], source.min_z[slot]},
+            {source.max_x[slot], source.max_y[slot], source.max_z[slot]}};
+}
+
+math::Aabb Bvh::node_bounds(uint32_t node) const noexcept
+{
+    const BvhNode &source = m_nodes[node];
+
+    math::Aabb bounds;
+
+    bounds.min = {std::min(std::min(source.min_x[0], source.min_x[1]), std::min(source.min_x[2], source.min_x[3])),
+                  std::min(std::min(source.min_y[0], source.min_y[1]), std::min(source.min_y[2], source.min_y[3])),
+                  std::min(std::min(source.min_z[0], source.min_z[1]), std::min(source.min_z[2], source.min_z[3]))};
+    bounds.max = {std::max(std::max(source.max_x[0], source.max_x[1]), std::max(source.max_x[2], source.max_x[3])),
+                  std::max(std::max(source.max_y[0], source.max_y[1]), std::max(source.max_y[2], source.max_y[3])),
+                  std::max(std::max(source.max_z[0], source.max_z[1]), std::max(source.max_z[2], source.max_z[3]))};
+
+    return bounds;
+}
+
+void Bvh::mark_dirty(uint32_t node) noexcept
+{
+    m_dirty[node] = 1;
+    m_refit = true;
+}
+
+void Bvh::refit() noexcept
+{
+    // Parents come before their children, so one backward sweep finishes every node before
+    // its parent. A box that did not change stops the walk up. The levels rebuild_top() put
+    // after the subtrees below them take a second sweep.
+    for (bool again = true; again;)
+    {
+        again = false;
+
+        for (uint32_t node = static_cast<uint32_t>(m_nodes.size()); node-- > 0;)
+        {
+            if (!m_dirty[node])
+            {
+                continue;
+            }
+
+            m_dirty[node] = 0;
+
+            uint32_t parent = m_nodes[node].parent;
+
+            if (parent == NO_NODE)
+            {
+                continue;
+            }
+
+            uint32_t slot = m_nodes[node].parent_slot;
+            math::Aabb bounds = node_bounds(node);
+
+            if (!equal(bounds, slot_bounds(parent, slot)))
+            {
+                set_slot(parent, slot, node, bounds);
+                m_dirty[parent] = 1;
+                again = again || parent > node;
+            }
+        }
+    }
+
+    m_refit = false;
+}
+
+uint32_t Bvh::build(BuildRef *refs, uint32_t count, uint32_t parent, uint32_t parent_slot, float &area_sum) noexcept
+{
+    uint32_t node = allocate_node(parent, parent_slot);
+
+    // Up to four groups, two binned SAH splits deep
+    uint32_t group_begin[4];
+    uint32_t group_count[4];
+    uint32_t groups = 0;
+
+    if (count <= 4)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            group_begin[groups] = i;
+            group_count[groups++] = 1;
+        }
+    }
+    else
+    {
+        uint32_t middle = split(refs, count);
+        uint32_t halves[2][2] = {{0, middle}, {middle, count - middle}};
+
+        for (const auto &half : halves)
+        {
+            if (half[1] < 2)
+            {
+                group_begin[groups] = half[0];
+                group_count[groups++] = half[1];
+
+                continue;
+            }
+
+            uint32_t quarter = split(refs + half[0], half[1]);
+
+            group_begin[groups] = half[0];
+            group_count[groups++] = quarter;
+            group_begin[groups] = half[0] + quarter;
+            group_count[groups++] = half[1] - quarter;
+        }
+    }
+
+    float subtree_area = 0.0f;
+
+    for (uint32_t g = 0; g < groups; ++g)
+    {
+        if (group_count[g] == 1)
+        {
+            const BuildRef &ref = refs[group_begin[g]];
+            const math::Aabb &bounds = ref.bounds;
+
+            set_slot(node, g, ref.child, bounds);
+            subtree_area += area(bounds);
+
+            continue;
+        }
+
+        float child_area = 0.0f;
+        uint32_t child = build(refs + group_begin[g], group_count[g], node, g, child_area);
+        math::Aabb bounds = node_bounds(child);
+
+        set_slot(node, g, child, bounds);
+        subtree_area += child_area + area(bounds);
+    }
+
+    float own_area = area(node_bounds(node));
+
+    m_nodes[node].build_cost = own_area > 0.0f ? subtree_area / own_area : 0.0f;
+    area_sum += subtree_area;
+
+    return node;
+}
+
+uint32_t Bvh::split(BuildRef *refs, uint32_t count) noexcept
+{
+    math::Aabb centroids;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        centroids = math::merge(centroids, refs[i].centroid);
+    }
+
+    math::vec3 size = centroids.max - centroids.min;
+    uint32_t axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+    float axis_min = axis == 0 ? centroids.min.x : (axis == 1 ? centroids.min.y : centroids.min.z);
+    float axis_size = axis == 0 ? size.x : (axis == 1 ? size.y : size.z);
+
+    // Every centroid in the same spot, any split is as good as another
+    if (axis_size <= 0.0f)
+    {
+        return count / 2;
+    }
+
+    // Too few to be worth binning, the median along the axis does about as well
+    if (count <= SMALL_SPLIT_COUNT)
+    {
+        std::nth_element(refs, refs + count / 2, refs + count, [axis](const BuildRef &a, const BuildRef &b) {
+            return axis == 0 ? a.centroid.x < b.centroid.x : (axis == 1 ? a.centroid.y < b.centroid.y : a.centroid.z < b.centroid.z);
+        });
+
+        return count / 2;
+    }
+
+    float bin_scale = BUILD_BINS / axis_size;
+
+    auto bin_of = [&](const BuildRef &ref) {
+        float position = axis == 0 ? ref.centroid.x : (axis == 1 ? ref.centroid.y : ref.centroid.z);
+
+        return std::min(static_cast<uint32_t>((position - axis_min) * bin_scale), BUILD_BINS - 1);
+    };
+
+    math::Aabb bin_bounds[BUILD_BINS];
+    uint32_t bin_counts[BUILD_BINS] = {};
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t bin = bin_of(refs[i]);
+
+        bin_bounds[bin] = math::merge(bin_bounds[bin], refs[i].bounds);
+        ++bin_counts[bin];
+    }
+
+    // Cost of splitting after each bin, left sides swept forwards and right sides backwards
+    float right_cost[BUILD_BINS];
+    math::Aabb right;
+    uint32_t right_count = 0;
+
+    for (uint32_t b = BUILD_BINS - 1; b > 0; --b)
+    {
+        right = math::merge(right, bin_bounds[b]);
+        right_count += bin_counts[b];
+        right_cost[b - 1] = area(right) * right_count;
+    }
+
+    math::Aabb left;
+    uint32_t left_count = 0;
+    uint32_t best_bin = 0;
+    float best_cost = FLT_MAX;
+
+    for (uint32_t b = 0; b < BUILD_BINS - 1; ++b)
+    {
+        left = math::merge(left, bin_bounds[b]);
+        left_count += bin_counts[b];
+
+        float cost = area(left) * left_count + right_cost[b];
+
+        if (left_count > 0 && left_count < count && cost < best_cost)
+        {
+            best_cost = cost;
+            best_bin = b;
+        }
+    }
+
+    BuildRef *middle = std::partition(refs, refs + count, [&](const BuildRef &ref) {
+        return bin_of(ref) <= best_bin;
+    });
+
+    uint32_t left_total = static_cast<uint32_t>(middle - refs);
+
+    return left_total > 0 && left_total < count ? left_total : count / 2;
+}
+
+void Bvh::rebuild_top() noexcept
+{
+    // Level by level down to the subtrees update() rebuilds, which are kept whole and built
+    // over like items
+    m_build_refs.clear();
+    m_node_order.assign(1, m_root);
+
+    uint32_t level_begin = 0;
+
+    for (uint32_t depth = 0; depth < REBUILD_DEPTH && level_begin < m_node_order.size(); ++depth)
+    {
+        uint32_t level_end = static_cast<uint32_t>(m_node_order.size());
+
+        for (uint32_t n = level_begin; n < level_end; ++n)
+        {
+            uint32_t node = m_node_order[n];
+
+            for (uint32_t s = 0; s < 4; ++s)
+            {
+                uint32_t child = m_nodes[node].children[s];
+
+                if (child == EMPTY_SLOT)
+                {
+                    continue;
+                }
+
+                if ((child & ITEM_BIT) || depth + 1 == REBUILD_DEPTH)
+                {
+                    math::Aabb bounds = slot_bounds(node, s);
+
+                    m_build_refs.push_back({bounds, math::center(bounds), child});
+                }
+                else
+                {
+                    m_node_order.push_back(child);
+                }
+            }
+
+            m_nodes[node].parent = NO_NODE;
+            m_dirty[node] = 0;
+            ++m_garbage_nodes;
+        }
+
+        level_begin = level_end;
+    }
+
+    if (m_build_refs.empty())
+    {
+        rebuild();
+
+        return;
+    }
+
+    float area_sum = 0.0f;
+
+    m_root = build(m_build_refs.data(), static_cast<uint32_t>(m_build_refs.size()), NO_NODE, 0, area_sum);
+
+    m_nodes[m_root].build_cost = top_cost();
+
+    // The new nodes come after the subtrees they sit above, refit() copes with that rather
+    // than this call paying for a pass over every node
+}
+
+void Bvh::compact() noexcept
+{
+    // Garbage is whatever lost its parent, apart from the root. Live nodes slide down in
+    // place and keep their order, so one linear pass does it and parents stay ahead of the
+    // children they were ahead of.
+    uint32_t count = static_cast<uint32_t>(m_nodes.size());
+    uint32_t live = 0;
+
+    m_node_remap.assign(count, NO_NODE);
+
+    for (uint32_t node = 0; node < count; ++node)
+    {
+        if (node == m_root || m_nodes[node].parent != NO_NODE)
+        {
+            m_node_remap[node] = live++;
+        }
+    }
+
+    for (uint32_t node = 0; node < count; ++node)
+    {
+        uint32_t index = m_node_remap[node];
+
+        if (index == NO_NODE)
+        {
+            continue;
+        }
+
+        BvhNode &target = m_nodes[index];
+
+        target = m_nodes[node];
+        target.parent = target.parent == NO_NODE ? NO_NODE : m_node_remap[target.parent];
+
+        for (uint32_t s = 0; s < 4; ++s)
+        {
+            uint32_t &child = target.children[s];
+
+            if (child == EMPTY_SLOT)
+            {
+                continue;
+            }
+
+            if (child & ITEM_BIT)
+            {
+                m_items[child & ~ITEM_BIT].node = index;
+            }
+            else
+            {
+                child = m_node_remap[child];
+            }
+        }
+    }
+
+    m_nodes.resize(live);
+    m_dirty.assign(live, 0);
+    m_root = m_node_remap[m_root];
+    m_garbage_nodes = 0;
+}
+
+void Bvh::rebuild_subtree(uint32_t node) noexcept
+{
+    uint32_t parent = m_nodes[node].parent;
+    uint32_t parent_slot = m_nodes[node].parent_slot;
+
+    m_build_refs.clear();
+    discard_subtree(node);
+
+    float area_sum = 0.0f;
+    uint32_t rebuilt = build(m_build_refs.data(), static_cast<uint32_t>(m_build_refs.size()), parent, parent_slot, area_sum);
+
+    set_slot(parent, parent_slot, rebuilt, node_bounds(rebuilt));
+}
+
+void Bvh::discard_subtree(uint32_t node) noexcept
+{
+    std::vector<uint32_t> &stack = traversal_stack();
+
+    stack.push_back(node);
+
+    while (!stack.empty())
+    {
+        uint32_t current = stack.back();
+
+        stack.pop_back();
+
+        for (uint32_t child : m_nodes[current].children)
+        {
+            if (child == EMPTY_SLOT)
+            {
+                continue;
+            }
+
+            if (child & ITEM_BIT)
+            {
+                const math::Aabb &bounds = m_items[child & ~ITEM_BIT].bounds;
+
+                m_build_refs.push_back({bounds, math::center(bounds), child});
+            }
+            else
+            {
+                stack.push_back(child);
+            }
+        }
+
+        m_nodes[current].parent = NO_NODE;
+        m_dirty[current] = 0;
+        ++m_garbage_nodes;
+    }
+}
+
+float Bvh::subtree_cost(uint32_t node, uint32_t &item_count) const noexcept
+{
+    item_count = 0;
+
+    float own_area = area(node_bounds(node));
+
+    if (own_area <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float area_sum = 0.0f;
+
+    std::vector<uint32_t> &stack = traversal_stack();
+
+    stack.push_back(node);
+
+    while (!stack.empty())
+    {
+        uint32_t current = stack.back();
+
+        stack.pop_back();
+
+        for (uint32_t s = 0; s < 4; ++s)
+        {
+            uint32_t child = m_nodes[current].children[s];
+
+            if (child == EMPTY_SLOT)
+            {
+                continue;
+            }
+
+            area_sum += area(slot_bounds(current, s));
+
+            if (child & ITEM_BIT)
+            {
+                ++item_count;
+            }
+            else
+            {
+                stack.push_back(child);
+            }
+        }
+    }
+
+    return area_sum / own_area;
+}
+
+uint32_t Bvh::rebuild_target(uint32_t node, uint32_t item_count) const noexcept
+{
+    // Down to the child that got worst, until what is left fits the budget
+    while (item_count > MAX_REBUILD_ITEMS)
+    {
+        uint32_t worst = NO_NODE;
+        uint32_t worst_items = 0;
+        float worst_ratio = 0.0f;
+
+        for (uint32_t child : m_nodes[node].children)
+        {
+            if (child == EMPTY_SLOT || (child & ITEM_BIT))
+            {
+                continue;
+            }
+
+            uint32_t child_items = 0;
+            float cost = subtree_cost(child, child_items);
+            float build_cost = m_nodes[child].build_cost;
+
+            // Never built, e.g. made by inserts, counts as due
+            float ratio = build_cost > 0.0f ? cost / build_cost : REBUILD_COST_RATIO;
+
+            if (worst == NO_NODE || ratio > worst_ratio)
+            {
+                worst = child;
+                worst_items = child_items;
+                worst_ratio = ratio;
+            }
+        }
+
+        if (worst == NO_NODE)
+        {
+            break;
+        }
+
+        node = worst;
+        item_count = worst_items;
+    }
+
+    return node;
+}
+
+float Bvh::top_cost() const noexcept
+{
+    float own_area = area(node_bounds(m_root));
+
+    return own_area > 0.0f ? top_area(m_root, 0) / own_area : 0.0f;
+}
+
+float Bvh::top_area(uint32_t node, uint32_t depth) const noexcept
+{
+    float area_sum = 0.0f;
+
+    for (uint32_t s = 0; s < 4; ++s)
+    {
+        uint32_t child = m_nodes[node].children[s];
+
+        if (child == EMPTY_SLOT)
+        {
+            continue;
+        }
+
+        area_sum += area(slot_bounds(node, s));
+
+        if (!(child & ITEM_BIT) && depth + 1 < REBUILD_DEPTH)
+        {
+            area_sum += top_area(child, depth + 1);
+        }
+    }
+
+    return area_sum;
+}
+
+void Bvh::traverse(const math::Frustum &frustum, uint32_t node, bool all_visible, std::vector<uint32_t> &visible) const noexcept
+{
+    // Subtrees inside the frustum go on the stack with ITEM_BIT set, which node indices never
+    // have, and are taken whole without testing
+    std::vector<uint32_t> &stack = traversal_stack();
+
+    stack.push_back(all_visible ? node | ITEM_BIT : node);
+
+    while (!stack.empty())
+    {
+        uint32_t entry = stack.back();
+
+        stack.pop_back();
+
+        const BvhNode &tested = m_nodes[entry & ~ITEM_BIT];
+
+        uint32_t inside = 0xf;
+        uint32_t hits = 0xf;
+
+        if (!(entry & ITEM_BIT))
+        {
+            hits = test_frustum<NodeLanes>(frustum, tested, inside);
+        }
+
+        for (uint32_t s = 0; s < 4; ++s)
+        {
+            uint32_t child = tested.children[s];
+
+            if (!(hits & (1u << s)) || child == EMPTY_SLOT)
+            {
+                continue;
+            }
+
+            if (child & ITEM_BIT)
+            {
+                visible.push_back(m_items[child & ~ITEM_BIT].value);
+            }
+            else
+            {
+                stack.push_back(inside & (1u << s) ? child | ITEM_BIT : child);
+            }
+        }
+    }
+}
+} // namespace systems
+} // namespace niqqa
\ No newline at end of file
@@ -1,18 +1,335 @@
 #include <systems/engine.hpp>
 
+#include <log.hpp>
+
+#include <chrono>
+#include <string>
+
 namespace niqqa
 {
 namespace systems
 {
 bool Engine::init(uint32_t width, uint32_t height, const std::string &title, bool resizable, bool fullscreen) noexcept
 {
+    if (!m_jobs.init())
+    {
+        return false;
+    }
+
+    if (!m_scene.init())
+    {
+        return false;
+    }
+
+    if (!m_bvh.init())
+    {
+        return false;
+    }
+
     if (!m_window.init(width, height, title, resizable, fullscreen))
     {
         return false;
     }
 
+    if (!m_instance.init())
+    {
+        return false;
+    }
+
+    if (!m_window.create_surface(m_instance.instance(), m_surface))
+    {
+        return false;
+    }
+
+    if (!m_device.init(m_instance.instance(), m_surface))
+    {
+        return false;
+    }
+
+    if (!m_uploads.init(m_device))
+    {
+        return false;
+    }
+
+    if (!m_io.init(&m_uploads))
+    {
+        return false;
+    }
+
+    if (!m_shaders.init(m_device))
+    {
+        return false;
+    }
+
+    if (!m_layouts.init(m_device.device()))
+    {
+        return false;
+    }
+
+    if (!m_swapchain.create(m_device, 
+                            m_surface, 
+                            m_window.framebuffer_extent(), 
+                            VK_FORMAT_B8G8R8A8_SRGB, 
+                            VK_PRESENT_MODE_MAILBOX_KHR))
+    {
+        return false;
+    }
+
+    if (!m_renderer.init(&m_device, &m_swapchain, &m_jobs))
+    {
+        return false;
+    }
+
+    m_renderer.set_upload_queue(&m_uploads);
+
+    // Optional, without it textures are up to the application
+    if (m_textures.init(m_device, m_renderer.bindless(), m_uploads, m_io, ForwardRenderer::MAX_FRAMES_IN_FLIGHT))
+    {
+        m_renderer.set_texture_streamer(&m_textures);
+    }
+
+    return true;
+}
+
+void Engine::run() noexcept
+{
+    while (!m_window.should_close())
+    {
+        // Minimized, there is nothing to draw to. Sleep until the window comes back rather
+        // than spinning through empty frames.
+        while (!m_window.should_close() &&
+               (m_window.framebuffer_extent().width == 0 || m_window.framebuffer_extent().height == 0))
+        {
+            m_window.wait_events();
+        }
+
+        // Input is polled as late as the frame pacing allows
+        m_renderer.pace_frame();
+        m_window.poll_events();
+
+        if (m_window.consume_resize())
+        {
+            m_renderer.resize(m_window.framebuffer_extent());
+        }
+
+        m_shaders.update();
+        m_io.update();
+        m_textures.update();
+        m_scene.update();
+        m_bvh.sync(m_scene);
+        m_bvh.update();
+
+        m_renderer.draw_frame();
+    }
+
+    const LatencyStats &latency = m_renderer.latency();
+
+    if (latency.samples > 0)
+    {
+        LOG_INFO("Engine", std::string(latency.to_present ? "Input to present" : "Input to GPU completion") + 
+                           " latency " + std::to_string(latency.average_ms) + " ms average, " + 
+                           std::to_string(latency.max_ms) + " ms max");
+    }
+}
+
+bool Engine::init_headless(const HeadlessConfig &config) noexcept
+{
+    m_headless = true;
+    m_trace_path = config.trace_path;
+
+    if (!m_jobs.init())
+    {
+        return false;
+    }
+
+    if (!m_scene.init())
+    {
+        return false;
+    }
+
+    if (!m_bvh.init())
+    {
+        return false;
+    }
+
+    if (!m_instance.init(true))
+    {
+        return false;
+    }
+
+    if (!m_device.init(m_instance.instance(), VK_NULL_HANDLE))
+    {
+        return false;
+    }
+
+    if (!m_uploads.init(m_device))
+    {
+        return false;
+    }
+
+    if (!m_io.init(&m_uploads))
+    {
+        return false;
+    }
+
+    // Nothing edits shaders during a headless run, the cache is still used
+    if (!m_shaders.init(m_device, "shaders", ".shader_cache", false))
+    {
+        return false;
+    }
+
+    if (!m_layouts.init(m_device.device()))
+    {
+        return false;
+    }
+
+    if (!m_offscreen.init(m_device, 
+                          {config.width, config.height}, 
+                          config.image_count, 
+                          config.color_format, 
+                          config.readback))
+    {
+        return false;
+    }
+
+    if (!m_renderer.init(&m_device, &m_offscreen, &m_jobs))
+    {
+        return false;
+    }
+
+    m_renderer.set_upload_queue(&m_uploads);
+
+    // Optional, without it textures are up to the application
+    if (m_textures.init(m_device, m_renderer.bindless(), m_uploads, m_io, ForwardRenderer::MAX_FRAMES_IN_FLIGHT))
+    {
+        m_renderer.set_texture_streamer(&m_textures);
+    }
+
+    m_renderer.profiler().set_capture(!m_trace_path.empty());
 
     return true;
 }
+
+void Engine::run_headless(uint32_t frame_count) noexcept
+{
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+
+    for (uint32_t i = 0; i < frame_count; ++i)
+    {
+        m_io.update();
+        m_textures.update();
+        m_scene.update();
+        m_bvh.sync(m_scene);
+        m_bvh.update();
+        m_renderer.draw_frame();
+    }
+
+    vkDeviceWaitIdle(m_device.device());
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    LOG_INFO("Engine", "Rendered {} frames in {} ms ({} fps)", frame_count, seconds * 1000.0, frame_count / seconds);
+
+    LOG_INFO("Engine", "Forward pass GPU time {} ms", m_renderer.profiler().average_pass_ms("forward"));
+
+    if (!m_trace_path.empty())
+    {
+        m_renderer.profiler().write_chrome_trace(m_trace_path);
+    }
+}
+
+void Engine::cleanup() noexcept
+{
+    if (m_device.device() != VK_NULL_HANDLE)
+    {
+        vkDeviceWaitIdle(m_device.device());
+    }
+
+    // Holds bindless slots of the renderer's heap
+    m_textures.cleanup();
+    m_renderer.cleanup();
+    m_layouts.cleanup();
+    m_shaders.cleanup();
+
+    // Reads still in flight hold staging space
+    m_io.cleanup();
+    m_uploads.cleanup();
+
+    if (m_headless)
+    {
+        m_offscreen.cleanup();
+    }
+    else
+    {
+        m_swapchain.cleanup();
+    }
+
+    m_device.cleanup();
+
+    if (m_surface != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(m_instance.instance(), m_surface, nullptr);
+    }
+
+    m_instance.cleanup();
+    m_bvh.cleanup();
+    m_scene.cleanup();
+    m_jobs.cleanup();
+
+    if (!m_headless)
+    {
+        m_window.cleanup();
+    }
+
+    // Whatever the shutdown logged is out before main returns or the process is torn down
+    log::flush();
+}
+
+JobSystem &Engine::jobs() noexcept
+{
+    return m_jobs;
+}
+
+graphics::UploadQueue &Engine::uploads() noexcept
+{
+    return m_uploads;
+}
+
+assets::AssetIo &Engine::io() noexcept
+{
+    return m_io;
+}
+
+graphics::TextureStreamer &Engine::textures() noexcept
+{
+    return m_textures;
+}
+
+Scene &Engine::scene() noexcept
+{
+    return m_scene;
+}
+
+Bvh &Engine::bvh() noexcept
+{
+    return m_bvh;
+}
+
+ForwardRenderer &Engine::renderer() noexcept
+{
+    return m_renderer;
+}
+
+graphics::ShaderManager &Engine::shaders() noexcept
+{
+    return m_shaders;
+}
+
+graphics::LayoutCache &Engine::layouts() noexcept
+{
+    return m_layouts;
+}
 } // namespace systems
 } // namespace niqqa
\ No newline at end of file
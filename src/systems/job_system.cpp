@@ -0,0 +1,312 @@
+#include <systems/job_system.hpp>
+
+#include <log.hpp>
+
+namespace niqqa
+{
+namespace systems
+{
+static thread_local uint32_t t_thread_index{JobSystem::INVALID_THREAD};
+
+bool WorkStealingQueue::push(Job *job) noexcept
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+
+    if (bottom - top >= CAPACITY)
+    {
+        return false;
+    }
+
+    m_jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+
+    return true;
+}
+
+Job *WorkStealingQueue::pop() noexcept
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = m_jobs[bottom & MASK].load(std::memory_order_relaxed);
+
+    if (top == bottom)
+    {
+        // Last job in the queue, race the thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job *WorkStealingQueue::steal() noexcept
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    Job *job = m_jobs[top & MASK].load(std::memory_order_relaxed);
+
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+
+    return job;
+}
+
+int64_t WorkStealingQueue::size() const noexcept
+{
+    return m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+}
+
+bool JobSystem::init(uint32_t worker_count) noexcept
+{
+    if (worker_count == 0)
+    {
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+    }
+
+    uint32_t thread_count = worker_count + 1;
+
+    m_threads.reserve(thread_count);
+
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        auto state = std::make_unique<ThreadState>();
+        state->jobs = std::make_unique<Job[]>(MAX_JOBS_PER_THREAD);
+
+        m_threads.push_back(std::move(state));
+    }
+
+    t_thread_index = 0;
+    m_running.store(true, std::memory_order_release);
+
+    m_workers.reserve(worker_count);
+
+    for (uint32_t i = 1; i < thread_count; ++i)
+    {
+        m_workers.emplace_back(&JobSystem::worker_main, this, i);
+    }
+
+    LOG_INFO("Job System", "Started {} workers", worker_count);
+
+    return true;
+}
+
+void JobSystem::cleanup() noexcept
+{
+    if (!m_running.exchange(false, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    m_pending.fetch_add(1, std::memory_order_release);
+    m_pending.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        worker.join();
+    }
+
+    m_workers.clear();
+    m_threads.clear();
+
+    t_thread_index = INVALID_THREAD;
+}
+
+void JobSystem::wait(const JobCounter &counter) noexcept
+{
+    uint32_t thread = t_thread_index;
+    bool blocked = false;
+
+    // Never block: run whatever is available until the counter drains
+    while (!counter.done())
+    {
+        Job *job = find_job(thread, blocked);
+
+        if (job != nullptr)
+        {
+            blocked = !execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+uint32_t JobSystem::thread_count() const noexcept
+{
+    return static_cast<uint32_t>(m_threads.size());
+}
+
+uint32_t JobSystem::thread_index() noexcept
+{
+    return t_thread_index;
+}
+
+Job *JobSystem::allocate_job() noexcept
+{
+    uint32_t thread = t_thread_index;
+    ThreadState &state = *m_threads[thread];
+    bool blocked = false;
+
+    // Ring of preallocated jobs per thread. Jobs finish out of order and requeued ones can sit
+    // in any queue, so skip slots still in flight and help run jobs while all of them are.
+    while (true)
+    {
+        for (uint32_t i = 0; i < MAX_JOBS_PER_THREAD; ++i)
+        {
+            Job *job = &state.jobs[state.next_job];
+
+            state.next_job = (state.next_job + 1) & (MAX_JOBS_PER_THREAD - 1);
+
+            if (!job->busy.load(std::memory_order_acquire))
+            {
+                job->busy.store(true, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        Job *job = find_job(thread, blocked);
+
+        if (job != nullptr)
+        {
+            blocked = !execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::push(Job *job) noexcept
+{
+    if (!m_threads[t_thread_index]->queue.push(job))
+    {
+        // Queue full, doing it now is better than dropping it
+        if (job->dependency != nullptr)
+        {
+            wait(*job->dependency);
+        }
+
+        execute(job);
+        return;
+    }
+
+    m_pending.fetch_add(1, std::memory_order_release);
+    m_pending.notify_one();
+}
+
+Job *JobSystem::find_job(uint32_t thread, bool oldest_first) noexcept
+{
+    uint32_t thread_count = static_cast<uint32_t>(m_threads.size());
+
+    // After a job got requeued for its dependency, popping would hand it straight
+    // back, so take the oldest work instead, from our own queue too
+    Job *job = oldest_first ? nullptr : m_threads[thread]->queue.pop();
+
+    for (uint32_t i = oldest_first ? 0 : 1; i < thread_count && job == nullptr; ++i)
+    {
+        job = m_threads[(thread + i) % thread_count]->queue.steal();
+    }
+
+    if (job == nullptr && oldest_first)
+    {
+        job = m_threads[thread]->queue.pop();
+    }
+
+    if (job != nullptr)
+    {
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+bool JobSystem::execute(Job *job) noexcept
+{
+    if (job->dependency != nullptr && !job->dependency->done())
+    {
+        // Not ready yet, put it back for whoever comes next
+        push(job);
+        return false;
+    }
+
+    job->function(job->payload);
+
+    if (job->counter != nullptr)
+    {
+        job->counter->value.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    job->busy.store(false, std::memory_order_release);
+
+    return true;
+}
+
+void JobSystem::worker_main(uint32_t thread) noexcept
+{
+    t_thread_index = thread;
+
+    constexpr uint32_t SPIN_COUNT{64};
+    uint32_t idle_spins = 0;
+    bool blocked = false;
+
+    while (m_running.load(std::memory_order_acquire))
+    {
+        Job *job = find_job(thread, blocked);
+
+        if (job != nullptr)
+        {
+            blocked = !execute(job);
+            idle_spins = 0;
+
+            continue;
+        }
+
+        if (++idle_spins < SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Sleep until something is queued somewhere
+        int32_t pending = m_pending.load(std::memory_order_acquire);
+
+        if (pending <= 0)
+        {
+            m_pending.wait(pending, std::memory_order_acquire);
+        }
+
+        idle_spins = 0;
+    }
+}
+} // namespace systems
+} // namespace niqqa
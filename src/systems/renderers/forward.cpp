@@ -1,48 +1,694 @@
 #include <systems/renderers/forward.hpp>
 
+#include <log.hpp>
+
+#include <algorithm>
+#include <string>
+
 namespace niqqa
 {
 namespace systems
 {
-bool ForwardRenderer::init(graphics::Device *device, graphics::Swapchain *swapchain) noexcept
+static void set_viewport_and_scissor(VkCommandBuffer command_buffer, VkExtent2D extent) noexcept
+{
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+bool ForwardRenderer::init(graphics::Device *device, graphics::Swapchain *swapchain, JobSystem *jobs, RenderPath render_path) noexcept
 {
     m_device = device;
+    m_jobs = jobs;
     m_swapchain = swapchain;
+    m_pending_extent = swapchain->extent();
+
+    choose_render_path(render_path);
+
+    if (!init_frames())
+    {
+        return false;
+    }
+
+    if (m_render_path == RenderPath::Dynamic)
+    {
+        return true;
+    }
+
+    if (!m_render_pass.init(m_device->device(), m_swapchain->present_format(), m_swapchain->depth_format()))
+    {
+        return false;
+    }
+
+    if (!m_swapchain->create_framebuffers(m_render_pass.render_pass()))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool ForwardRenderer::init(graphics::Device *device, graphics::OffscreenTarget *offscreen, JobSystem *jobs, RenderPath render_path) noexcept
+{
+    m_device = device;
+    m_jobs = jobs;
+    m_offscreen = offscreen;
+
+    choose_render_path(render_path);
+
+    if (!init_frames())
+    {
+        return false;
+    }
+
+    if (m_render_path == RenderPath::Dynamic)
+    {
+        return true;
+    }
+
+    if (!m_render_pass.init(m_device->device(), 
+                            m_offscreen->color_format(), 
+                            m_offscreen->depth_format(), 
+                            m_offscreen->color_final_layout()))
+    {
+        return false;
+    }
+
+    if (!m_offscreen->create_framebuffers(m_render_pass.render_pass()))
+    {
+        return false;
+    }
+
+    return true;
+}
 
+void ForwardRenderer::choose_render_path(RenderPath render_path) noexcept
+{
+    m_render_path = render_path;
+
+    if (m_render_path == RenderPath::Dynamic && !m_device->supports_dynamic_rendering())
+    {
+        LOG_WARN("Forward Renderer", "Dynamic rendering is not supported, falling back to render passes");
+        m_render_path = RenderPath::RenderPass;
+    }
+}
+
+bool ForwardRenderer::init_frames() noexcept
+{
+    // One pool per job system thread, a chunk records into the pool of whichever thread runs it
+    m_record_thread_count = m_jobs != nullptr ? m_jobs->thread_count() : 1;
+
+    // Every slot exists up front so the frame queue depth can change at runtime,
+    // only the first m_frames_in_flight of them are cycled through
     m_frames.resize(MAX_FRAMES_IN_FLIGHT);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
     {
-        if (!m_frames[i].init(m_device->device(), m_device->graphics_queue_family()))
+        if (!m_frames[i].init(m_device->device(), m_device->graphics_queue_family(), m_record_thread_count))
+        {
+            return false;
+        }
+
+        if (!m_frames[i].queries.init(*m_device, MAX_PROFILED_PASSES))
         {
             return false;
         }
     }
 
-    m_render_pass.init(m_device->device(), m_swapchain->present_format(), m_swapchain->depth_format());
+    if (!m_compute.init(*m_device, MAX_FRAMES_IN_FLIGHT))
+    {
+        return false;
+    }
+
+    if (!m_bindless.init(*m_device, MAX_FRAMES_IN_FLIGHT))
+    {
+        return false;
+    }
+
+    if (!m_pipelines.init(*m_device))
+    {
+        return false;
+    }
+
+    if (!m_graph.init(*m_device))
+    {
+        return false;
+    }
 
     return true;
 }
 
 void ForwardRenderer::draw_frame() noexcept
 {
+    pace_frame();
+    m_paced = false;
+
     graphics::Frame &current_frame = m_frames[m_frame_index];
 
-    current_frame.wait_and_reset(m_device->device());
+    if (m_swapchain != nullptr && m_swapchain_dirty)
+    {
+        // Minimized, nothing to present to until the window comes back
+        if (m_pending_extent.width == 0 || m_pending_extent.height == 0)
+        {
+            return;
+        }
+
+        if (!recreate_swapchain())
+        {
+            return;
+        }
+    }
+
+    current_frame.wait();
+
+    uint32_t image_index = 0;
+
+    if (m_offscreen != nullptr)
+    {
+        image_index = m_offscreen->acquire_next_image();
+    }
+    else 
+    {
+        VkResult result = vkAcquireNextImageKHR(m_device->device(), 
+                                                m_swapchain->swapchain(), 
+                                                UINT64_MAX, 
+                                                current_frame.acquire_semaphore, 
+                                                VK_NULL_HANDLE, 
+                                                &image_index);
+
+        // Nothing of the frame was reset yet, so it can simply be skipped
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            m_swapchain_dirty = true;
+            return;
+        }
+
+        // Suboptimal still signals the semaphore, finish the frame and recreate after presenting
+        if (result == VK_SUBOPTIMAL_KHR)
+        {
+            m_swapchain_dirty = true;
+        }
+        else if (result != VK_SUCCESS)
+        {
+            LOG_ERROR("Forward Renderer", "Failed to acquire swapchain image");
+            return;
+        }
+    }
+
+    current_frame.reset();
+    current_frame.input_time = m_input_time;
+    current_frame.present_id = 0;
+
+    if (m_swapchain != nullptr && m_frame_count + 1 >= m_frames_in_flight)
+    {
+        // The wait above covers every frame up to and including the one this slot last ran
+        m_swapchain->collect_retired(m_frame_count + 1 - m_frames_in_flight);
+    }
+
+    graphics::SyncPoint compute_sync;
 
-    uint32_t image_index;
+    if (m_compute_recorder)
+    {
+        // Submitted before the graphics work is even recorded so the GPU can overlap the two
+        VkCommandBuffer compute_commands = m_compute.begin(m_frame_index);
+        m_compute_recorder(compute_commands, m_compute, m_frame_index);
+        compute_sync = m_compute.submit();
+    }
 
-    vkAcquireNextImageKHR(m_device->device(), 
-                          m_swapchain->swapchain(), 
-                          UINT64_MAX, 
-                          current_frame.acquire_semaphore, 
-                          current_frame.frame_fence, 
-                          &image_index);
+    graphics::FrameTimings timings;
+
+    if (current_frame.queries.collect(m_device->device(), timings))
+    {
+        m_profiler.submit(std::move(timings));
+    }
+
+    m_bindless.begin_frame();
 
     current_frame.begin_commands();
+    current_frame.queries.reset(current_frame.command_buffer, m_frame_count);
+
+    graphics::SyncPoint upload_sync;
+
+    if (m_uploads != nullptr)
+    {
+        m_uploads->flush();
+        upload_sync = m_uploads->consume(current_frame.command_buffer);
+    }
+
+    if (m_textures != nullptr)
+    {
+        m_textures->record(current_frame.command_buffer);
+    }
+
+    if (m_compute_recorder)
+    {
+        m_compute.acquire(current_frame.command_buffer);
+    }
+
+    record_commands(current_frame.command_buffer, image_index);
+
+    if (m_offscreen != nullptr && m_offscreen->readback_enabled())
+    {
+        graphics::GpuScope scope(current_frame.queries, current_frame.command_buffer, "readback");
+        m_offscreen->record_readback(current_frame.command_buffer, image_index);
+    }
+
+    current_frame.end_commands();
+
+    // Uploads can feed any stage, the acquire barriers recorded above wait on all of them
+    graphics::SubmitBatch batch;
+    batch.wait(upload_sync, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    batch.wait(compute_sync, m_compute.wait_stage());
+
+    // Offscreen images are never acquired or presented, only the timeline orders them
+    if (m_swapchain != nullptr)
+    {
+        batch.wait_binary(current_frame.acquire_semaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        batch.signal_binary(m_swapchain->present_semaphore(image_index));
+    }
+
+    current_frame.sync = m_device->graphics_timeline().submit(&current_frame.command_buffer, 1, std::move(batch));
+
+    if (m_offscreen != nullptr)
+    {
+        m_offscreen->set_rendered(image_index, current_frame.sync);
+    }
+
+    if (m_swapchain != nullptr)
+    {
+        VkSwapchainKHR swapchain = m_swapchain->swapchain();
+        VkSemaphore present_semaphore = m_swapchain->present_semaphore(image_index);
+
+        VkPresentInfoKHR present_info{};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &present_semaphore;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &swapchain;
+        present_info.pImageIndices = &image_index;
+
+        VkPresentIdKHR present_id{};
+
+        if (m_device->supports_present_wait())
+        {
+            current_frame.present_id = ++m_present_id;
+
+            present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            present_id.swapchainCount = 1;
+            present_id.pPresentIds = &current_frame.present_id;
+
+            present_info.pNext = &present_id;
+        }
+
+        // Uploads may submit to this queue from other threads, the timeline holds the queue's lock
+        VkResult result = m_device->present_timeline().present(present_info);
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        {
+            m_swapchain_dirty = true;
+        }
+    }
+
+    m_frame_index = (m_frame_index + 1) % m_frames_in_flight;
+    ++m_frame_count;
+}
+
+void ForwardRenderer::pace_frame() noexcept
+{
+    if (m_paced)
+    {
+        return;
+    }
+
+    m_paced = true;
+
+    if (m_low_latency && m_frame_count > 0)
+    {
+        graphics::Frame &previous = m_frames[(m_frame_index + m_frames_in_flight - 1) % m_frames_in_flight];
+
+        // Starting the next frame only once the last one is on screen keeps the
+        // queue empty, so the input sampled right after this is as fresh as it gets
+        if (previous.present_id > m_measured_present_id && m_swapchain != nullptr)
+        {
+            VkResult result = m_device->wait_for_present(m_swapchain->swapchain(), previous.present_id, PRESENT_WAIT_TIMEOUT);
+
+            // Timeouts and out of date swapchains only mean this frame is not paced
+            if (result == VK_SUCCESS)
+            {
+                record_latency(previous, true);
+            }
+
+            m_measured_present_id = previous.present_id;
+        }
+        else if (previous.present_id == 0)
+        {
+            // Without present wait the best we know is when the GPU finished the frame
+            previous.wait();
+            record_latency(previous, false);
+        }
+    }
+
+    m_input_time = std::chrono::steady_clock::now();
+}
+
+void ForwardRenderer::record_latency(const graphics::Frame &frame, bool to_present) noexcept
+{
+    if (frame.input_time == std::chrono::steady_clock::time_point{})
+    {
+        return;
+    }
+
+    double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.input_time).count();
+
+    ++m_latency.samples;
+    m_latency.last_ms = latency_ms;
+    m_latency.average_ms += (latency_ms - m_latency.average_ms) / static_cast<double>(m_latency.samples);
+    m_latency.max_ms = std::max(m_latency.max_ms, latency_ms);
+    m_latency.to_present = to_present;
+}
+
+void ForwardRenderer::set_frame_pacing(const FramePacing &pacing) noexcept
+{
+    uint32_t frames_in_flight = std::clamp(pacing.frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT);
+
+    if (frames_in_flight != m_frames_in_flight && !m_frames.empty())
+    {
+        // Slots get reassigned, so everything in flight has to finish first. Only the
+        // frames are waited on, this is a settings change and not a device idle.
+        for (auto &frame : m_frames)
+        {
+            frame.wait();
+        }
+
+        m_frame_index = 0;
+    }
+
+    if (frames_in_flight != m_frames_in_flight)
+    {
+        LOG_INFO("Forward Renderer", "Frames in flight set to " + std::to_string(frames_in_flight));
+    }
+
+    m_frames_in_flight = frames_in_flight;
+    m_low_latency = pacing.low_latency;
+    m_latency = LatencyStats{};
+}
+
+FramePacing ForwardRenderer::frame_pacing() const noexcept
+{
+    return {m_frames_in_flight, m_low_latency};
+}
+
+const LatencyStats &ForwardRenderer::latency() const noexcept
+{
+    return m_latency;
+}
+
+void ForwardRenderer::resize(VkExtent2D extent) noexcept
+{
+    // Recreated lazily by the next draw_frame, a drag-resize only pays for the last size
+    m_pending_extent = extent;
+    m_swapchain_dirty = true;
+}
+
+bool ForwardRenderer::recreate_swapchain() noexcept
+{
+    // Frames still in flight keep using the old swapchain, it is retired instead of waited on
+    if (!m_swapchain->recreate(m_pending_extent, m_frame_count))
+    {
+        LOG_ERROR("Forward Renderer", "Failed to recreate swapchain");
+        return false;
+    }
+
+    m_swapchain_dirty = false;
+
+    return true;
+}
+
+void ForwardRenderer::cleanup() noexcept
+{
+    if (m_device == nullptr)
+    {
+        return;
+    }
+
+    for (auto &frame : m_frames)
+    {
+        frame.wait();
+        frame.destroy(m_device->device());
+    }
+
+    m_frames.clear();
+
+    m_compute.cleanup();
+    m_graph.cleanup();
+    m_scene.cleanup();
+    m_scene_enabled = false;
+    m_pipelines.cleanup();
+    m_bindless.cleanup();
+
+    m_render_pass.cleanup(m_device->device());
+}
+
+void ForwardRenderer::set_draws(uint32_t draw_count, DrawRecorder recorder) noexcept
+{
+    m_draw_count = draw_count;
+    m_draw_recorder = std::move(recorder);
+}
+
+void ForwardRenderer::set_draws(const std::vector<uint32_t> &items, ItemRecorder recorder) noexcept
+{
+    const uint32_t *data = items.data();
+
+    set_draws(static_cast<uint32_t>(items.size()), [data, recorder = std::move(recorder)](VkCommandBuffer command_buffer, uint32_t first, uint32_t count) {
+        recorder(command_buffer, data + first, count);
+    });
+}
+
+void ForwardRenderer::set_pre_passes(GraphSetup setup) noexcept
+{
+    m_pre_passes = std::move(setup);
+}
+
+void ForwardRenderer::set_post_passes(GraphSetup setup) noexcept
+{
+    m_post_passes = std::move(setup);
+}
+
+void ForwardRenderer::set_compute_work(ComputeRecorder recorder) noexcept
+{
+    m_compute_recorder = std::move(recorder);
+}
+
+void ForwardRenderer::set_upload_queue(graphics::UploadQueue *uploads) noexcept
+{
+    m_uploads = uploads;
+}
+
+void ForwardRenderer::set_texture_streamer(graphics::TextureStreamer *textures) noexcept
+{
+    m_textures = textures;
+}
+
+graphics::GpuProfiler &ForwardRenderer::profiler() noexcept
+{
+    return m_profiler;
+}
+
+graphics::BindlessHeap &ForwardRenderer::bindless() noexcept
+{
+    return m_bindless;
+}
+
+graphics::PipelineBuilder &ForwardRenderer::pipelines() noexcept
+{
+    return m_pipelines;
+}
+
+bool ForwardRenderer::enable_gpu_scene(graphics::ShaderManager &shaders, const graphics::GpuSceneLimits &limits) noexcept
+{
+    if (m_scene_enabled)
+    {
+        return true;
+    }
+
+    m_scene_enabled = m_scene.init(*m_device, m_bindless, shaders, MAX_FRAMES_IN_FLIGHT, limits);
+
+    if (!m_scene_enabled)
+    {
+        m_scene.cleanup();
+    }
+
+    return m_scene_enabled;
+}
+
+bool ForwardRenderer::gpu_scene_enabled() const noexcept
+{
+    return m_scene_enabled;
+}
+
+graphics::GpuScene &ForwardRenderer::gpu_scene() noexcept
+{
+    return m_scene;
+}
+
+graphics::GraphicsPipelineDesc ForwardRenderer::pipeline_desc() const noexcept
+{
+    graphics::GraphicsPipelineDesc desc;
+    desc.pipeline_layout(m_bindless.pipeline_layout());
+
+    if (m_render_path == RenderPath::RenderPass)
+    {
+        desc.target(m_render_pass.render_pass());
+    }
+    else
+    {
+        desc.target({target_color_format()}, target_depth_format());
+    }
+
+    return desc;
+}
+
+RenderPath ForwardRenderer::render_path() const noexcept
+{
+    return m_render_path;
+}
+
+VkExtent2D ForwardRenderer::target_extent() const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->extent() : m_swapchain->extent();
+}
+
+VkFramebuffer ForwardRenderer::target_framebuffer(uint32_t image_index) const noexcept
+{
+    if (m_render_path == RenderPath::Dynamic)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    return m_offscreen != nullptr ? m_offscreen->framebuffer(image_index) : m_swapchain->framebuffer(image_index);
+}
+
+graphics::Image ForwardRenderer::target_color_image(uint32_t image_index) const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->color_image(image_index) : m_swapchain->present_image(image_index);
+}
+
+graphics::Image ForwardRenderer::target_depth_image() const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->depth_image() : m_swapchain->depth_image();
+}
+
+VkFormat ForwardRenderer::target_color_format() const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->color_format() : m_swapchain->present_format();
+}
+
+VkFormat ForwardRenderer::target_depth_format() const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->depth_format() : m_swapchain->depth_format();
+}
+
+VkImageLayout ForwardRenderer::target_final_layout() const noexcept
+{
+    return m_offscreen != nullptr ? m_offscreen->color_final_layout() : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+uint32_t ForwardRenderer::draw_chunk_count(const graphics::Frame &frame) const noexcept
+{
+    if (m_jobs == nullptr || !m_draw_recorder || m_draw_count < MIN_DRAWS_PER_CHUNK * 2)
+    {
+        return 1;
+    }
+
+    // Scene draws are recorded inline, a rendering scope cannot mix them with secondaries
+    if (m_scene_enabled)
+    {
+        return 1;
+    }
+
+    // An active statistics query has to be inherited by the secondaries, which needs inheritedQueries
+    if (frame.queries.active_statistics() != 0 && !m_device->features().inheritedQueries)
+    {
+        return 1;
+    }
+
+    uint32_t chunk_count = (m_draw_count + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK;
+
+    return std::min(chunk_count, std::min(m_record_thread_count, MAX_RECORD_CHUNKS));
 }
 
-void ForwardRenderer::record_commands(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept
+void ForwardRenderer::record_draw_chunks(graphics::Frame &frame,
+                                         VkFramebuffer framebuffer,
+                                         VkExtent2D extent,
+                                         uint32_t chunk_count,
+                                         std::vector<VkCommandBuffer> &secondary_buffers) noexcept
+{
+    VkFormat color_format = target_color_format();
+
+    // Without a render pass the secondaries are told the attachment formats instead
+    VkCommandBufferInheritanceRenderingInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &color_format;
+    rendering_info.depthAttachmentFormat = target_depth_format();
+    rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext = m_render_path == RenderPath::Dynamic ? &rendering_info : nullptr;
+    inheritance_info.renderPass = m_render_pass.render_pass();
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = framebuffer;
+    inheritance_info.pipelineStatistics = frame.queries.active_statistics();
+
+    uint32_t draws_per_chunk = (m_draw_count + chunk_count - 1) / chunk_count;
+
+    secondary_buffers.resize(chunk_count);
+
+    JobCounter counter;
+
+    for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        m_jobs->run([&, chunk]() {
+            // Jobs on one thread never overlap, so the thread's pool needs no locking
+            VkCommandBuffer command_buffer = frame.acquire_secondary(JobSystem::thread_index());
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = &inheritance_info;
+
+            vkBeginCommandBuffer(command_buffer, &begin_info);
+
+            // Neither dynamic state nor descriptor sets are inherited from the primary
+            set_viewport_and_scissor(command_buffer, extent);
+            m_bindless.bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+            uint32_t first = chunk * draws_per_chunk;
+            uint32_t count = std::min(draws_per_chunk, m_draw_count - first);
+
+            m_draw_recorder(command_buffer, first, count);
+
+            vkEndCommandBuffer(command_buffer);
+
+            secondary_buffers[chunk] = command_buffer;
+        }, &counter);
+    }
+
+    // The render thread records chunks too while it waits
+    m_jobs->wait(counter);
+}
+
+void ForwardRenderer::begin_render_pass(VkCommandBuffer command_buffer, uint32_t image_index, bool secondary_contents) noexcept
 {
     VkClearValue clear_values[2]{};
     clear_values[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
@@ -51,30 +697,167 @@ void ForwardRenderer::record_commands(VkCommandBuffer command_buffer, uint32_t f
     VkRenderPassBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     begin_info.renderPass = m_render_pass.render_pass();
-
-    // TODO: framebuffers
-
+    begin_info.framebuffer = target_framebuffer(image_index);
     begin_info.clearValueCount = 2;
     begin_info.pClearValues = clear_values;
     begin_info.renderArea.offset = {0, 0};
-    begin_info.renderArea.extent = m_swapchain->extent();
+    begin_info.renderArea.extent = target_extent();
 
-    vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(command_buffer, 
+                         &begin_info, 
+                         secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
 
-    VkViewport viewport{};
-    viewport.width = static_cast<float>(m_swapchain->extent().width);
-    viewport.height = static_cast<float>(m_swapchain->extent().height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+void ForwardRenderer::build_graph(uint32_t image_index, bool secondary_contents, std::vector<VkCommandBuffer> &secondary_buffers) noexcept
+{
+    m_graph.reset();
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = m_swapchain->extent();
+    VkExtent2D extent = target_extent();
+    VkImageLayout final_layout = target_final_layout();
+    bool transfer = final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
-    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    // The image may still be read by last frame's readback copy. Presentation is ordered
+    // by the submit's semaphore, a readback copy needs the stage.
+    graphics::ImportedState color_initial;
+    color_initial.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_initial.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+
+    graphics::ImportedState color_final;
+    color_final.layout = final_layout;
+    color_final.stages = transfer ? VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT : VK_PIPELINE_STAGE_2_NONE;
+    color_final.access = transfer ? VK_ACCESS_2_TRANSFER_READ_BIT : VK_ACCESS_2_NONE;
+
+    graphics::ImportedState depth_initial;
+    depth_initial.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_initial.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    depth_initial.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // Depth is cleared every frame, nothing reads it after the graph
+    graphics::ImportedState depth_final;
+    depth_final.preserve = false;
+
+    ForwardGraph targets;
+    targets.extent = extent;
+    targets.backbuffer = m_graph.import_image("backbuffer", target_color_image(image_index), target_color_format(), extent, color_initial, color_final);
+    targets.depth = m_graph.import_image("depth", target_depth_image(), target_depth_format(), extent, depth_initial, depth_final);
+
+    // With post processing the scene goes to an intermediate the post passes read from
+    targets.scene_color = m_post_passes
+        ? m_graph.create_image("scene_color", {target_color_format(), extent, VK_SAMPLE_COUNT_1_BIT})
+        : targets.backbuffer;
+
+    // Culled first, so pre passes can draw the scene as well
+    if (m_scene_enabled)
+    {
+        m_scene.add_passes(m_graph, m_frame_index);
+    }
+
+    if (m_pre_passes)
+    {
+        m_pre_passes(m_graph, targets);
+    }
+
+    graphics::RenderGraphPass &forward = m_graph.add_pass("forward");
+    forward.color(targets.scene_color).depth(targets.depth);
+
+    if (m_scene_enabled)
+    {
+        m_scene.read_draws(forward);
+    }
+
+    if (secondary_contents)
+    {
+        forward.secondary_contents().execute([&secondary_buffers](VkCommandBuffer command_buffer, const graphics::RenderGraph &) {
+            vkCmdExecuteCommands(command_buffer, static_cast<uint32_t>(secondary_buffers.size()), secondary_buffers.data());
+        });
+    }
+    else
+    {
+        forward.execute([this, extent](VkCommandBuffer command_buffer, const graphics::RenderGraph &) {
+            set_viewport_and_scissor(command_buffer, extent);
+            m_bindless.bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+            if (m_scene_enabled)
+            {
+                m_scene.draw(command_buffer, m_pipelines);
+            }
+
+            // Pipelines are bound by the draw recorder, see pipelines()
+            if (m_draw_recorder)
+            {
+                m_draw_recorder(command_buffer, 0, m_draw_count);
+            }
+        });
+    }
+
+    if (m_post_passes)
+    {
+        m_post_passes(m_graph, targets);
+    }
+}
+
+void ForwardRenderer::record_commands(VkCommandBuffer command_buffer, uint32_t image_index) noexcept
+{
+    graphics::Frame &frame = m_frames[m_frame_index];
+
+    VkExtent2D extent = target_extent();
+
+    uint32_t chunk_count = draw_chunk_count(frame);
+
+    std::vector<VkCommandBuffer> secondary_buffers;
+
+    if (chunk_count > 1)
+    {
+        record_draw_chunks(frame, target_framebuffer(image_index), extent, chunk_count, secondary_buffers);
+    }
+
+    if (m_render_path == RenderPath::Dynamic)
+    {
+        build_graph(image_index, chunk_count > 1, secondary_buffers);
+
+        if (m_graph.compile())
+        {
+            m_graph.execute(command_buffer, &frame.queries);
+        }
+
+        return;
+    }
+
+    // Copies and dispatches are not allowed inside a render pass
+    if (m_scene_enabled)
+    {
+        graphics::GpuScope cull_scope(frame.queries, command_buffer, "cull");
+        m_scene.record_cull(command_buffer, m_frame_index);
+    }
+
+    // Render passes have their own attachment transitions, the graph is not involved
+    graphics::GpuScope scope(frame.queries, command_buffer, "forward");
+
+    if (chunk_count > 1)
+    {
+        begin_render_pass(command_buffer, image_index, true);
+        vkCmdExecuteCommands(command_buffer, static_cast<uint32_t>(secondary_buffers.size()), secondary_buffers.data());
+    }
+    else
+    {
+        begin_render_pass(command_buffer, image_index, false);
+
+        set_viewport_and_scissor(command_buffer, extent);
+        m_bindless.bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+        if (m_scene_enabled)
+        {
+            m_scene.draw(command_buffer, m_pipelines);
+        }
+
+        // Pipelines are bound by the draw recorder, see pipelines()
+        if (m_draw_recorder)
+        {
+            m_draw_recorder(command_buffer, 0, m_draw_count);
+        }
+    }
 
-    // TODO: pipeline
+    vkCmdEndRenderPass(command_buffer);
 }
 } // namespace systems
 } // namespace niqqa
\ No newline at end of file
@@ -0,0 +1,795 @@
+#include <systems/scene.hpp>
+
+#include <math/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace niqqa
+{
+namespace systems
+{
+// Dirty flags are swept instead of sorted once one entity in this many is dirty
+static constexpr size_t DIRTY_SCAN_RATIO{16};
+
+// Calls function with the same pool out of each ScenePools
+template <typename F, typename... Pools>
+static void for_each_pool(F &&function, Pools &...pools) noexcept
+{
+    function(pools.entity...);
+    function(pools.parent...);
+    function(pools.subtree_end...);
+    function(pools.position_x...);
+    function(pools.position_y...);
+    function(pools.position_z...);
+    function(pools.rotation_x...);
+    function(pools.rotation_y...);
+    function(pools.rotation_z...);
+    function(pools.rotation_w...);
+    function(pools.scale_x...);
+    function(pools.scale_y...);
+    function(pools.scale_z...);
+    function(pools.bounds_x...);
+    function(pools.bounds_y...);
+    function(pools.bounds_z...);
+    function(pools.bounds_radius...);
+    function(pools.world...);
+    function(pools.render_handle...);
+    function(pools.dirty...);
+    function(pools.alive...);
+}
+
+#ifdef NIQQA_MATH_SSE2
+// parent * local for affine matrices stored as their upper three rows, local in registers
+static void multiply_affine(const float *parent, __m128 &row0, __m128 &row1, __m128 &row2) noexcept
+{
+    // The implicit fourth row is 0 0 0 1, it only carries the parent translation over
+    const __m128 translation = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    __m128 rows[3];
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+        __m128 p = _mm_loadu_ps(parent + r * 4);
+
+        // Summed as a tree, children wait on this result so its latency is what counts
+        __m128 sum01 = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), row0),
+                                  _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+        __m128 sum23 = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), row2),
+                                  _mm_and_ps(p, translation));
+
+        rows[r] = _mm_add_ps(sum01, sum23);
+    }
+
+    row0 = rows[0];
+    row1 = rows[1];
+    row2 = rows[2];
+}
+#endif
+
+// Same in place, for what is left over after the four wide loop
+static void multiply_affine(const float *parent, float *local) noexcept
+{
+#ifdef NIQQA_MATH_SSE2
+    __m128 row0 = _mm_loadu_ps(local);
+    __m128 row1 = _mm_loadu_ps(local + 4);
+    __m128 row2 = _mm_loadu_ps(local + 8);
+
+    multiply_affine(parent, row0, row1, row2);
+
+    _mm_storeu_ps(local, row0);
+    _mm_storeu_ps(local + 4, row1);
+    _mm_storeu_ps(local + 8, row2);
+#else
+    float copy[12];
+    std::copy(local, local + 12, copy);
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+        const float *p = parent + r * 4;
+
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            local[r * 4 + c] = p[0] * copy[c] + p[1] * copy[4 + c] + p[2] * copy[8 + c] + (c == 3 ? p[3] : 0.0f);
+        }
+    }
+#endif
+}
+
+// Local matrices four entities at a time, each goes through its parent's world matrix while
+// still in registers, so world is stored once instead of stored, reloaded and stored again.
+// The parent is either before begin and clean or already done in this sweep, possibly a
+// lane earlier. Roots keep their local matrix.
+static void world_matrices(ScenePools &pools, uint32_t begin, uint32_t end) noexcept
+{
+    const uint32_t *parents = pools.parent.data();
+    const float *position_x = pools.position_x.data();
+    const float *position_y = pools.position_y.data();
+    const float *position_z = pools.position_z.data();
+    const float *rotation_x = pools.rotation_x.data();
+    const float *rotation_y = pools.rotation_y.data();
+    const float *rotation_z = pools.rotation_z.data();
+    const float *rotation_w = pools.rotation_w.data();
+    const float *scale_x = pools.scale_x.data();
+    const float *scale_y = pools.scale_y.data();
+    const float *scale_z = pools.scale_z.data();
+    WorldMatrix *world = pools.world.data();
+
+    uint32_t i = begin;
+
+#ifdef NIQQA_MATH_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(rotation_x + i);
+        __m128 y = _mm_loadu_ps(rotation_y + i);
+        __m128 z = _mm_loadu_ps(rotation_z + i);
+        __m128 w = _mm_loadu_ps(rotation_w + i);
+        __m128 sx = _mm_loadu_ps(scale_x + i);
+        __m128 sy = _mm_loadu_ps(scale_y + i);
+        __m128 sz = _mm_loadu_ps(scale_z + i);
+
+        __m128 xx = _mm_mul_ps(x, x);
+        __m128 yy = _mm_mul_ps(y, y);
+        __m128 zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y);
+        __m128 xz = _mm_mul_ps(x, z);
+        __m128 yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x);
+        __m128 wy = _mm_mul_ps(w, y);
+        __m128 wz = _mm_mul_ps(w, z);
+
+        // Columns of the three rows, one lane per entity
+        __m128 row0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+            _mm_loadu_ps(position_x + i)
+        };
+        __m128 row1[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+            _mm_loadu_ps(position_y + i)
+        };
+        __m128 row2[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+            _mm_loadu_ps(position_z + i)
+        };
+
+        // Now one register per entity and row
+        _MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+        _MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+        _MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+
+        // In order, a lane's parent may be the lane before it
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            uint32_t parent = parents[i + lane];
+
+            if (parent != ScenePools::NO_PARENT)
+            {
+                multiply_affine(world[parent].data(), row0[lane], row1[lane], row2[lane]);
+            }
+
+            float *m = world[i + lane].data();
+
+            _mm_storeu_ps(m, row0[lane]);
+            _mm_storeu_ps(m + 4, row1[lane]);
+            _mm_storeu_ps(m + 8, row2[lane]);
+        }
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        float x = rotation_x[i];
+        float y = rotation_y[i];
+        float z = rotation_z[i];
+        float w = rotation_w[i];
+
+        float xx = x * x;
+        float yy = y * y;
+        float zz = z * z;
+        float xy = x * y;
+        float xz = x * z;
+        float yz = y * z;
+        float wx = w * x;
+        float wy = w * y;
+        float wz = w * z;
+
+        world[i] = {
+            (1.0f - 2.0f * (yy + zz)) * scale_x[i], 2.0f * (xy - wz) * scale_y[i], 2.0f * (xz + wy) * scale_z[i], position_x[i],
+            2.0f * (xy + wz) * scale_x[i], (1.0f - 2.0f * (xx + zz)) * scale_y[i], 2.0f * (yz - wx) * scale_z[i], position_y[i],
+            2.0f * (xz - wy) * scale_x[i], 2.0f * (yz + wx) * scale_y[i], (1.0f - 2.0f * (xx + yy)) * scale_z[i], position_z[i]
+        };
+
+        if (parents[i] != ScenePools::NO_PARENT)
+        {
+            multiply_affine(world[parents[i]].data(), world[i].data());
+        }
+    }
+}
+
+std::array<float, 4> ScenePools::world_bounds(uint32_t index) const noexcept
+{
+    const float *m = world[index].data();
+
+    float cx = bounds_x[index];
+    float cy = bounds_y[index];
+    float cz = bounds_z[index];
+
+    // Scaled by the longest basis vector, exact for uniform scale and a bound otherwise
+    float axis_x = m[0] * m[0] + m[4] * m[4] + m[8] * m[8];
+    float axis_y = m[1] * m[1] + m[5] * m[5] + m[9] * m[9];
+    float axis_z = m[2] * m[2] + m[6] * m[6] + m[10] * m[10];
+
+    return {m[0] * cx + m[1] * cy + m[2] * cz + m[3],
+            m[4] * cx + m[5] * cy + m[6] * cz + m[7],
+            m[8] * cx + m[9] * cy + m[10] * cz + m[11],
+            bounds_radius[index] * std::sqrt(std::max(axis_x, std::max(axis_y, axis_z)))};
+}
+
+bool Scene::init(uint32_t capacity) noexcept
+{
+    for_each_pool([capacity](auto &pool) { pool.reserve(capacity); }, m_pools);
+
+    m_dense.reserve(capacity);
+
+    return true;
+}
+
+void Scene::cleanup() noexcept
+{
+    auto release = [](auto &pool)
+    {
+        pool.clear();
+        pool.shrink_to_fit();
+    };
+
+    for_each_pool(release, m_pools);
+    for_each_pool(release, m_reordered);
+
+    m_dense.clear();
+    m_free.clear();
+    m_dirty.clear();
+    m_changed.clear();
+    m_reorder = false;
+}
+
+Entity Scene::create(const Transform &local, Entity parent) noexcept
+{
+    uint32_t parent_index = ScenePools::NO_PARENT;
+
+    if (parent != INVALID_ENTITY)
+    {
+        if (!is_valid(parent))
+        {
+            return INVALID_ENTITY;
+        }
+
+        parent_index = m_dense[parent];
+    }
+
+    Entity entity;
+
+    if (!m_free.empty())
+    {
+        entity = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        entity = static_cast<Entity>(m_dense.size());
+        m_dense.push_back(INVALID_ENTITY);
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_pools.entity.size());
+    m_dense[entity] = index;
+
+    // Appending keeps the order as long as the parent's subtree is the last one, which is
+    // how hierarchies are usually built. Every ancestor's subtree then ends here too.
+    if (parent_index != ScenePools::NO_PARENT)
+    {
+        if (!m_reorder && m_pools.subtree_end[parent_index] == index)
+        {
+            for (uint32_t ancestor = parent_index; ancestor != ScenePools::NO_PARENT; ancestor = m_pools.parent[ancestor])
+            {
+                m_pools.subtree_end[ancestor] = index + 1;
+            }
+        }
+        else
+        {
+            m_reorder = true;
+        }
+    }
+
+    m_pools.entity.push_back(entity);
+    m_pools.parent.push_back(parent_index);
+    m_pools.subtree_end.push_back(index + 1);
+
+    m_pools.position_x.push_back(local.position[0]);
+    m_pools.position_y.push_back(local.position[1]);
+    m_pools.position_z.push_back(local.position[2]);
+    m_pools.rotation_x.push_back(local.rotation[0]);
+    m_pools.rotation_y.push_back(local.rotation[1]);
+    m_pools.rotation_z.push_back(local.rotation[2]);
+    m_pools.rotation_w.push_back(local.rotation[3]);
+    m_pools.scale_x.push_back(local.scale[0]);
+    m_pools.scale_y.push_back(local.scale[1]);
+    m_pools.scale_z.push_back(local.scale[2]);
+
+    m_pools.bounds_x.push_back(0.0f);
+    m_pools.bounds_y.push_back(0.0f);
+    m_pools.bounds_z.push_back(0.0f);
+    m_pools.bounds_radius.push_back(0.0f);
+
+    m_pools.world.push_back({1.0f, 0.0f, 0.0f, 0.0f,
+                             0.0f, 1.0f, 0.0f, 0.0f,
+                             0.0f, 0.0f, 1.0f, 0.0f});
+
+    m_pools.render_handle.push_back(NO_RENDER_HANDLE);
+    m_pools.dirty.push_back(0);
+    m_pools.alive.push_back(1);
+
+    mark_dirty(index);
+
+    return entity;
+}
+
+void Scene::destroy(Entity entity) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    // The slot and those of the descendants are dropped by the next reorder
+    m_pools.alive[m_dense[entity]] = 0;
+    m_dense[entity] = INVALID_ENTITY;
+    m_free.push_back(entity);
+
+    m_reorder = true;
+}
+
+bool Scene::set_parent(Entity entity, Entity parent) noexcept
+{
+    if (!is_valid(entity) || (parent != INVALID_ENTITY && !is_valid(parent)))
+    {
+        return false;
+    }
+
+    uint32_t index = m_dense[entity];
+    uint32_t parent_index = parent == INVALID_ENTITY ? ScenePools::NO_PARENT : m_dense[parent];
+
+    for (uint32_t ancestor = parent_index; ancestor != ScenePools::NO_PARENT; ancestor = m_pools.parent[ancestor])
+    {
+        if (ancestor == index)
+        {
+            return false;
+        }
+    }
+
+    m_pools.parent[index] = parent_index;
+    m_reorder = true;
+
+    mark_dirty(index);
+
+    return true;
+}
+
+Entity Scene::parent(Entity entity) const noexcept
+{
+    if (!is_valid(entity))
+    {
+        return INVALID_ENTITY;
+    }
+
+    uint32_t parent_index = m_pools.parent[m_dense[entity]];
+
+    return parent_index == ScenePools::NO_PARENT ? INVALID_ENTITY : m_pools.entity[parent_index];
+}
+
+void Scene::set_transform(Entity entity, const Transform &local) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.position_x[index] = local.position[0];
+    m_pools.position_y[index] = local.position[1];
+    m_pools.position_z[index] = local.position[2];
+    m_pools.rotation_x[index] = local.rotation[0];
+    m_pools.rotation_y[index] = local.rotation[1];
+    m_pools.rotation_z[index] = local.rotation[2];
+    m_pools.rotation_w[index] = local.rotation[3];
+    m_pools.scale_x[index] = local.scale[0];
+    m_pools.scale_y[index] = local.scale[1];
+    m_pools.scale_z[index] = local.scale[2];
+
+    mark_dirty(index);
+}
+
+void Scene::set_position(Entity entity, const std::array<float, 3> &position) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.position_x[index] = position[0];
+    m_pools.position_y[index] = position[1];
+    m_pools.position_z[index] = position[2];
+
+    mark_dirty(index);
+}
+
+void Scene::set_rotation(Entity entity, const std::array<float, 4> &rotation) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.rotation_x[index] = rotation[0];
+    m_pools.rotation_y[index] = rotation[1];
+    m_pools.rotation_z[index] = rotation[2];
+    m_pools.rotation_w[index] = rotation[3];
+
+    mark_dirty(index);
+}
+
+void Scene::set_scale(Entity entity, const std::array<float, 3> &scale) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.scale_x[index] = scale[0];
+    m_pools.scale_y[index] = scale[1];
+    m_pools.scale_z[index] = scale[2];
+
+    mark_dirty(index);
+}
+
+Transform Scene::transform(Entity entity) const noexcept
+{
+    if (!is_valid(entity))
+    {
+        return {};
+    }
+
+    uint32_t index = m_dense[entity];
+
+    Transform local;
+    local.position = {m_pools.position_x[index], m_pools.position_y[index], m_pools.position_z[index]};
+    local.rotation = {m_pools.rotation_x[index], m_pools.rotation_y[index], m_pools.rotation_z[index], m_pools.rotation_w[index]};
+    local.scale = {m_pools.scale_x[index], m_pools.scale_y[index], m_pools.scale_z[index]};
+
+    return local;
+}
+
+void Scene::set_bounds(Entity entity, const std::array<float, 4> &bounds) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.bounds_x[index] = bounds[0];
+    m_pools.bounds_y[index] = bounds[1];
+    m_pools.bounds_z[index] = bounds[2];
+    m_pools.bounds_radius[index] = bounds[3];
+
+    mark_dirty(index);
+}
+
+void Scene::set_render_handle(Entity entity, uint32_t handle) noexcept
+{
+    if (!is_valid(entity))
+    {
+        return;
+    }
+
+    uint32_t index = m_dense[entity];
+
+    m_pools.render_handle[index] = handle;
+
+    // So whoever mirrors the scene through changed() sees it
+    mark_dirty(index);
+}
+
+uint32_t Scene::render_handle(Entity entity) const noexcept
+{
+    return is_valid(entity) ? m_pools.render_handle[m_dense[entity]] : NO_RENDER_HANDLE;
+}
+
+void Scene::update() noexcept
+{
+    m_changed.clear();
+
+    bool reordered = m_reorder;
+
+    if (m_reorder)
+    {
+        reorder();
+    }
+
+    m_dirty_indices.clear();
+
+    if (m_dirty.size() * DIRTY_SCAN_RATIO >= m_pools.dirty.size())
+    {
+        // Most of the scene moved, a sweep over the flags beats sorting that many indices
+        uint8_t *dirty = m_pools.dirty.data();
+        uint32_t count = entity_count();
+
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            if (dirty[index])
+            {
+                dirty[index] = 0;
+                m_dirty_indices.push_back(index);
+            }
+        }
+    }
+    else
+    {
+        for (Entity entity : m_dirty)
+        {
+            if (entity >= m_dense.size() || m_dense[entity] == INVALID_ENTITY)
+            {
+                continue;
+            }
+
+            uint32_t index = m_dense[entity];
+
+            // An entity id reused since it was queued shows up twice
+            if (m_pools.dirty[index])
+            {
+                m_pools.dirty[index] = 0;
+                m_dirty_indices.push_back(index);
+            }
+        }
+
+        std::sort(m_dirty_indices.begin(), m_dirty_indices.end());
+    }
+
+    m_dirty.clear();
+
+    // A dirty subtree covers every dirty entity inside it, and subtrees that touch make one
+    // range, so a moving crowd of roots is still a single sweep
+    uint32_t covered = 0;
+
+    for (uint32_t index : m_dirty_indices)
+    {
+        if (index < covered)
+        {
+            continue;
+        }
+
+        covered = m_pools.subtree_end[index];
+
+        if (!m_changed.empty() && m_changed.back().end == index)
+        {
+            m_changed.back().end = covered;
+        }
+        else
+        {
+            m_changed.push_back({index, covered});
+        }
+    }
+
+    for (const SceneRange &range : m_changed)
+    {
+        propagate(range.begin, range.end);
+    }
+
+    if (reordered)
+    {
+        m_changed.assign(1, {0, entity_count()});
+    }
+}
+
+const WorldMatrix &Scene::world_matrix(Entity entity) const noexcept
+{
+    static const WorldMatrix identity{1.0f, 0.0f, 0.0f, 0.0f,
+                                      0.0f, 1.0f, 0.0f, 0.0f,
+                                      0.0f, 0.0f, 1.0f, 0.0f};
+
+    return is_valid(entity) ? m_pools.world[m_dense[entity]] : identity;
+}
+
+std::array<float, 4> Scene::world_bounds(Entity entity) const noexcept
+{
+    if (!is_valid(entity))
+    {
+        return {};
+    }
+
+    return m_pools.world_bounds(m_dense[entity]);
+}
+
+bool Scene::is_alive(Entity entity) const noexcept
+{
+    return is_valid(entity);
+}
+
+uint32_t Scene::entity_count() const noexcept
+{
+    return static_cast<uint32_t>(m_pools.entity.size());
+}
+
+uint32_t Scene::dense_index(Entity entity) const noexcept
+{
+    return is_valid(entity) ? m_dense[entity] : ScenePools::NO_PARENT;
+}
+
+const ScenePools &Scene::pools() const noexcept
+{
+    return m_pools;
+}
+
+const std::vector<SceneRange> &Scene::changed() const noexcept
+{
+    return m_changed;
+}
+
+uint64_t Scene::layout_version() const noexcept
+{
+    return m_layout_version;
+}
+
+void Scene::mark_dirty(uint32_t index) noexcept
+{
+    if (!m_pools.dirty[index])
+    {
+        m_pools.dirty[index] = 1;
+        m_dirty.push_back(m_pools.entity[index]);
+    }
+}
+
+void Scene::reorder() noexcept
+{
+    uint32_t count = static_cast<uint32_t>(m_pools.entity.size());
+
+    // Children of every slot, in dense order so siblings keep theirs
+    m_child_offsets.assign(count + 1, 0);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (m_pools.alive[i] && m_pools.parent[i] != ScenePools::NO_PARENT)
+        {
+            ++m_child_offsets[m_pools.parent[i] + 1];
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_child_offsets[i + 1] += m_child_offsets[i];
+    }
+
+    m_children.resize(m_child_offsets[count]);
+    m_stack.assign(m_child_offsets.begin(), m_child_offsets.end() - 1);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (m_pools.alive[i] && m_pools.parent[i] != ScenePools::NO_PARENT)
+        {
+            m_children[m_stack[m_pools.parent[i]]++] = i;
+        }
+    }
+
+    // Depth first from every root, descendants of destroyed entities are never reached
+    m_order.clear();
+    m_stack.clear();
+
+    for (uint32_t root = 0; root < count; ++root)
+    {
+        if (!m_pools.alive[root] || m_pools.parent[root] != ScenePools::NO_PARENT)
+        {
+            continue;
+        }
+
+        m_stack.push_back(root);
+
+        while (!m_stack.empty())
+        {
+            uint32_t node = m_stack.back();
+            m_stack.pop_back();
+
+            if (!m_pools.alive[node])
+            {
+                continue;
+            }
+
+            m_order.push_back(node);
+
+            for (uint32_t child = m_child_offsets[node + 1]; child > m_child_offsets[node]; --child)
+            {
+                m_stack.push_back(m_children[child - 1]);
+            }
+        }
+    }
+
+    m_remap.assign(count, ScenePools::NO_PARENT);
+
+    for (uint32_t i = 0; i < m_order.size(); ++i)
+    {
+        m_remap[m_order[i]] = i;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (m_pools.alive[i] && m_remap[i] == ScenePools::NO_PARENT)
+        {
+            m_dense[m_pools.entity[i]] = INVALID_ENTITY;
+            m_free.push_back(m_pools.entity[i]);
+        }
+    }
+
+    // Gathered into the spare pools, which then trade places with the live ones, so a
+    // reorder allocates nothing once the spares have grown
+    for_each_pool([this](auto &pool, auto &reordered)
+    {
+        reordered.resize(m_order.size());
+
+        for (size_t i = 0; i < m_order.size(); ++i)
+        {
+            reordered[i] = pool[m_order[i]];
+        }
+
+        pool.swap(reordered);
+    }, m_pools, m_reordered);
+
+    uint32_t ordered_count = static_cast<uint32_t>(m_order.size());
+
+    for (uint32_t i = 0; i < ordered_count; ++i)
+    {
+        uint32_t &parent = m_pools.parent[i];
+        parent = parent == ScenePools::NO_PARENT ? parent : m_remap[parent];
+
+        m_pools.subtree_end[i] = i + 1;
+        m_dense[m_pools.entity[i]] = i;
+    }
+
+    // Parents come first, so walking backwards finishes every subtree before its parent
+    for (uint32_t i = ordered_count; i-- > 0;)
+    {
+        if (m_pools.parent[i] != ScenePools::NO_PARENT)
+        {
+            uint32_t &parent_end = m_pools.subtree_end[m_pools.parent[i]];
+            parent_end = std::max(parent_end, m_pools.subtree_end[i]);
+        }
+    }
+
+    m_reorder = false;
+    ++m_layout_version;
+}
+
+void Scene::propagate(uint32_t begin, uint32_t end) noexcept
+{
+    world_matrices(m_pools, begin, end);
+}
+
+bool Scene::is_valid(Entity entity) const noexcept
+{
+    return entity < m_dense.size() && m_dense[entity] != INVALID_ENTITY;
+}
+} // namespace systems
+} // namespace niqqa
\ No newline at end of file
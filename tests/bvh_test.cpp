@@ -0,0 +1,348 @@
+#include <math/mat4.hpp>
+#include <systems/bvh.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using niqqa::math::Aabb;
+using niqqa::math::Frustum;
+using niqqa::math::Ray;
+using niqqa::math::vec3;
+using niqqa::systems::Bvh;
+using niqqa::systems::BvhHit;
+
+// Enough items for the parallel query to split the tree instead of falling back
+static constexpr uint32_t ITEM_COUNT{20000};
+
+static bool check(bool condition, const char *name, uint64_t actual, uint64_t expected)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "%s: got %llu, expected %llu\n", name,
+                     static_cast<unsigned long long>(actual), static_cast<unsigned long long>(expected));
+    }
+
+    return condition;
+}
+
+// Every box the tree should hold, by item
+struct Reference
+{
+    std::vector<Aabb> bounds;
+    std::vector<uint32_t> values;
+    std::vector<uint8_t> alive;
+
+    void set(uint32_t item, const Aabb &box, uint32_t value)
+    {
+        if (item >= bounds.size())
+        {
+            bounds.resize(item + 1);
+            values.resize(item + 1, 0);
+            alive.resize(item + 1, 0);
+        }
+
+        bounds[item] = box;
+        values[item] = value;
+        alive[item] = 1;
+    }
+};
+
+// A tenth are points and a tenth flat along one axis, the rest ordinary boxes
+static Aabb random_box(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.05f, 4.0f);
+
+    vec3 center{position(random), position(random), position(random)};
+    vec3 extent{size(random), size(random), size(random)};
+
+    uint32_t kind = random() % 10;
+
+    if (kind == 0)
+    {
+        extent = {0.0f, 0.0f, 0.0f};
+    }
+    else if (kind == 1)
+    {
+        (random() % 2 == 0 ? extent.x : extent.z) = 0.0f;
+    }
+
+    return {center - extent, center + extent};
+}
+
+// Same plane test as the tree, in double. Boxes within a hair of a plane can go either way.
+static int classify(const Frustum &frustum, const Aabb &box)
+{
+    constexpr double EPSILON{1e-3};
+
+    int result = 1;
+
+    for (const niqqa::math::Plane &plane : frustum.planes)
+    {
+        double x = plane.normal.x >= 0.0f ? box.max.x : box.min.x;
+        double y = plane.normal.y >= 0.0f ? box.max.y : box.min.y;
+        double z = plane.normal.z >= 0.0f ? box.max.z : box.min.z;
+        double distance = plane.normal.x * x + plane.normal.y * y + plane.normal.z * z + plane.distance;
+
+        if (distance < -EPSILON)
+        {
+            return -1;
+        }
+
+        if (distance < EPSILON)
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// Sorted query results against the brute force verdict of every live box
+static uint32_t frustum_errors(const Reference &reference, const Frustum &frustum, std::vector<uint32_t> visible)
+{
+    std::sort(visible.begin(), visible.end());
+
+    uint32_t errors = 0;
+
+    for (uint32_t item = 0; item < reference.bounds.size(); ++item)
+    {
+        int expected = reference.alive[item] ? classify(frustum, reference.bounds[item]) : -1;
+        bool found = std::binary_search(visible.begin(), visible.end(), reference.values[item]);
+
+        errors += (expected == 1 && !found) || (expected == -1 && found) ? 1 : 0;
+    }
+
+    return errors;
+}
+
+// The slab test the tree runs, one box at a time. Negative for a miss.
+static float enter_distance(const Ray &ray, const Aabb &box)
+{
+    vec3 inverse{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+
+    float t1_x = (box.min.x - ray.origin.x) * inverse.x;
+    float t2_x = (box.max.x - ray.origin.x) * inverse.x;
+    float t1_y = (box.min.y - ray.origin.y) * inverse.y;
+    float t2_y = (box.max.y - ray.origin.y) * inverse.y;
+    float t1_z = (box.min.z - ray.origin.z) * inverse.z;
+    float t2_z = (box.max.z - ray.origin.z) * inverse.z;
+
+    float t_near = std::max(std::max(std::min(t1_x, t2_x), std::min(t1_y, t2_y)), std::max(std::min(t1_z, t2_z), 0.0f));
+    float t_far = std::min(std::min(std::max(t1_x, t2_x), std::max(t1_y, t2_y)), std::min(std::max(t1_z, t2_z), ray.max_distance));
+
+    return t_far >= t_near ? t_near : -1.0f;
+}
+
+static std::vector<Frustum> make_frustums(std::mt19937 &random)
+{
+    using namespace niqqa::math;
+
+    std::uniform_real_distribution<float> position(-80.0f, 80.0f);
+
+    std::vector<Frustum> frustums;
+
+    for (int i = 0; i < 12; ++i)
+    {
+        vec3 eye{position(random), position(random), position(random)};
+        vec3 target{position(random), position(random), position(random)};
+
+        frustums.push_back(extract_frustum(perspective(1.0f + 0.1f * i, 16.0f / 9.0f, 0.1f, 60.0f + 10.0f * i) *
+                                           look_at(eye, target, {0.0f, 1.0f, 0.0f})));
+    }
+
+    // Far enough out that the whole cube is inside, whole subtrees go in without a test
+    frustums.push_back(extract_frustum(perspective(1.2f, 1.0f, 1.0f, 2000.0f) *
+                                       look_at({0.0f, 0.0f, 600.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f})));
+
+    return frustums;
+}
+
+static bool test_queries(Bvh &bvh, niqqa::systems::JobSystem &jobs, const Reference &reference, std::mt19937 &random, const char *name)
+{
+    uint32_t serial_errors = 0;
+    uint32_t parallel_errors = 0;
+    uint32_t unstable_order = 0;
+
+    std::vector<uint32_t> serial;
+    std::vector<uint32_t> parallel;
+    std::vector<uint32_t> again;
+
+    for (const Frustum &frustum : make_frustums(random))
+    {
+        bvh.query(frustum, serial);
+        bvh.query(frustum, jobs, parallel);
+        bvh.query(frustum, jobs, again);
+
+        serial_errors += frustum_errors(reference, frustum, serial);
+        parallel_errors += frustum_errors(reference, frustum, parallel);
+        unstable_order += parallel == again ? 0 : 1;
+    }
+
+    std::uniform_real_distribution<float> position(-110.0f, 110.0f);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+
+    uint32_t ray_errors = 0;
+    uint32_t hits = 0;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        Ray ray;
+        ray.origin = {position(random), position(random), position(random)};
+        ray.direction = niqqa::math::normalize(vec3{axis(random), axis(random), axis(random)});
+        ray.max_distance = i % 4 == 0 ? 25.0f : FLT_MAX;
+
+        float nearest = -1.0f;
+
+        for (uint32_t item = 0; item < reference.bounds.size(); ++item)
+        {
+            float distance = reference.alive[item] ? enter_distance(ray, reference.bounds[item]) : -1.0f;
+
+            if (distance >= 0.0f && (nearest < 0.0f || distance < nearest))
+            {
+                nearest = distance;
+            }
+        }
+
+        BvhHit hit;
+        bool found = bvh.raycast(ray, hit);
+
+        // Ties may pick either box, the distance and the box it names have to agree
+        bool agrees = found == (nearest >= 0.0f);
+
+        if (found && agrees)
+        {
+            agrees = hit.item < reference.bounds.size() && reference.alive[hit.item] && hit.value == reference.values[hit.item] &&
+                     std::fabs(hit.distance - nearest) <= 1e-4f * std::max(1.0f, nearest) &&
+                     std::fabs(enter_distance(ray, reference.bounds[hit.item]) - hit.distance) <= 1e-4f * std::max(1.0f, nearest);
+        }
+
+        ray_errors += agrees ? 0 : 1;
+        hits += found ? 1 : 0;
+    }
+
+    bool passed = check(serial_errors == 0, "frustum query mismatches", serial_errors, 0) &&
+                  check(parallel_errors == 0, "parallel frustum query mismatches", parallel_errors, 0) &&
+                  check(unstable_order == 0, "parallel query order changed", unstable_order, 0) &&
+                  check(ray_errors == 0, "raycast mismatches", ray_errors, 0) &&
+                  check(hits > 0, "raycast hits", hits, 1);
+
+    if (!passed)
+    {
+        std::fprintf(stderr, "  in %s\n", name);
+    }
+
+    return passed;
+}
+
+int main()
+{
+    niqqa::systems::JobSystem jobs;
+    Bvh bvh;
+
+    if (!jobs.init(3) || !bvh.init(ITEM_COUNT))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 random{5};
+    Reference reference;
+    std::vector<uint32_t> items;
+
+    for (uint32_t i = 0; i < ITEM_COUNT; ++i)
+    {
+        Aabb box = random_box(random);
+        uint32_t item = bvh.insert(box, i);
+
+        reference.set(item, box, i);
+        items.push_back(item);
+    }
+
+    bvh.rebuild();
+
+    bool passed = test_queries(bvh, jobs, reference, random, "full build");
+
+    // Removed items leave empty slots behind, too few removes and inserts for a full rebuild
+    std::shuffle(items.begin(), items.end(), random);
+
+    for (uint32_t i = 0; i < ITEM_COUNT / 8; ++i)
+    {
+        bvh.remove(items.back());
+        reference.alive[items.back()] = 0;
+        items.pop_back();
+    }
+
+    for (uint32_t i = 0; i < ITEM_COUNT / 16; ++i)
+    {
+        Aabb box = random_box(random);
+        uint32_t value = ITEM_COUNT + i;
+        uint32_t item = bvh.insert(box, value);
+
+        reference.set(item, box, value);
+        items.push_back(item);
+    }
+
+    bvh.update();
+
+    passed = test_queries(bvh, jobs, reference, random, "removes and inserts") && passed;
+
+    // Long enough drifting for subtree and top rebuilds and compaction to come round
+    std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+
+    for (uint32_t frame = 0; frame < 400; ++frame)
+    {
+        for (uint32_t i = frame % 4; i < items.size(); i += 4)
+        {
+            uint32_t item = items[i];
+            vec3 offset{step(random), step(random), step(random)};
+            Aabb box{reference.bounds[item].min + offset, reference.bounds[item].max + offset};
+
+            bvh.move(item, box);
+            reference.bounds[item] = box;
+        }
+
+        // Values change without touching the tree
+        if (frame % 50 == 0)
+        {
+            uint32_t item = items[frame % items.size()];
+
+            reference.values[item] += 2 * ITEM_COUNT;
+            bvh.set_value(item, reference.values[item]);
+        }
+
+        // Now and then everything shifts at once, which only comes out right if every level
+        // up to the root was refit, wherever rebuilds left the nodes
+        if (frame % 100 == 99)
+        {
+            vec3 shift{12.0f, -7.0f, 5.0f};
+
+            for (uint32_t item : items)
+            {
+                Aabb box{reference.bounds[item].min + shift, reference.bounds[item].max + shift};
+
+                bvh.move(item, box);
+                reference.bounds[item] = box;
+            }
+        }
+
+        bvh.update();
+
+        if (frame % 100 == 99)
+        {
+            passed = test_queries(bvh, jobs, reference, random, "moves") && passed;
+        }
+    }
+
+    bvh.cleanup();
+    jobs.cleanup();
+
+    std::printf("bvh tests %s\n", passed ? "passed" : "failed");
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include <systems/job_system.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// More jobs in flight than a thread has slots, so the job rings wrap while earlier jobs still wait
+static constexpr uint32_t JOB_COUNT{3 * niqqa::systems::JobSystem::MAX_JOBS_PER_THREAD + 17};
+
+static bool check(bool condition, const char *name, uint64_t actual, uint64_t expected)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "%s: got %llu, expected %llu\n", name,
+                     static_cast<unsigned long long>(actual), static_cast<unsigned long long>(expected));
+    }
+
+    return condition;
+}
+
+static bool test_parallel_for(niqqa::systems::JobSystem &jobs)
+{
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint32_t> calls{0};
+
+    jobs.parallel_for(JOB_COUNT, 1, [&sum, &calls](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            sum.fetch_add(i, std::memory_order_relaxed);
+        }
+
+        calls.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    uint64_t expected = static_cast<uint64_t>(JOB_COUNT) * (JOB_COUNT - 1) / 2;
+
+    return check(sum.load() == expected, "parallel_for sum", sum.load(), expected) &&
+           check(calls.load() == JOB_COUNT, "parallel_for chunks", calls.load(), JOB_COUNT);
+}
+
+// No work returns at once, a zero chunk size is taken as 1
+static bool test_parallel_for_edges(niqqa::systems::JobSystem &jobs)
+{
+    std::atomic<uint32_t> empty_calls{0};
+
+    jobs.parallel_for(0, 16, [&empty_calls](uint32_t, uint32_t) {
+        empty_calls.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    std::atomic<uint32_t> calls{0};
+    std::atomic<uint32_t> covered{0};
+
+    jobs.parallel_for(100, 0, [&calls, &covered](uint32_t begin, uint32_t end) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        covered.fetch_add(end - begin, std::memory_order_relaxed);
+    });
+
+    return check(empty_calls.load() == 0, "parallel_for empty calls", empty_calls.load(), 0) &&
+           check(calls.load() == 100, "parallel_for zero chunk calls", calls.load(), 100) &&
+           check(covered.load() == 100, "parallel_for zero chunk covered", covered.load(), 100);
+}
+
+static bool test_flat(niqqa::systems::JobSystem &jobs)
+{
+    std::atomic<uint64_t> sum{0};
+    niqqa::systems::JobCounter counter;
+
+    for (uint32_t i = 0; i < JOB_COUNT; ++i)
+    {
+        jobs.run([&sum, i]() {
+            sum.fetch_add(i, std::memory_order_relaxed);
+        }, &counter);
+    }
+
+    jobs.wait(counter);
+
+    uint64_t expected = static_cast<uint64_t>(JOB_COUNT) * (JOB_COUNT - 1) / 2;
+
+    return check(sum.load() == expected, "flat sum", sum.load(), expected);
+}
+
+// The second batch is requeued while the first still runs, both batches overflow the rings
+static bool test_dependency(niqqa::systems::JobSystem &jobs)
+{
+    std::atomic<uint32_t> first_done{0};
+    std::atomic<uint32_t> early{0};
+    std::atomic<uint32_t> second_done{0};
+    niqqa::systems::JobCounter first;
+    niqqa::systems::JobCounter second;
+
+    for (uint32_t i = 0; i < JOB_COUNT; ++i)
+    {
+        jobs.run([&first_done]() {
+            first_done.fetch_add(1, std::memory_order_relaxed);
+        }, &first);
+    }
+
+    for (uint32_t i = 0; i < JOB_COUNT; ++i)
+    {
+        jobs.run([&first_done, &early, &second_done]() {
+            early.fetch_add(first_done.load(std::memory_order_relaxed) == JOB_COUNT ? 0 : 1, std::memory_order_relaxed);
+            second_done.fetch_add(1, std::memory_order_relaxed);
+        }, &second, &first);
+    }
+
+    jobs.wait(second);
+
+    return check(second_done.load() == JOB_COUNT, "dependency jobs run", second_done.load(), JOB_COUNT) &&
+           check(early.load() == 0, "dependency jobs run early", early.load(), 0);
+}
+
+// Jobs submitting more jobs than fit in the ring of whichever thread runs them
+static bool test_nested(niqqa::systems::JobSystem &jobs)
+{
+    constexpr uint32_t PARENT_COUNT{4};
+
+    std::atomic<uint32_t> children{0};
+    niqqa::systems::JobCounter counter;
+
+    for (uint32_t i = 0; i < PARENT_COUNT; ++i)
+    {
+        jobs.run([&jobs, &children, &counter]() {
+            for (uint32_t j = 0; j < JOB_COUNT; ++j)
+            {
+                jobs.run([&children]() {
+                    children.fetch_add(1, std::memory_order_relaxed);
+                }, &counter);
+            }
+        }, &counter);
+    }
+
+    jobs.wait(counter);
+
+    return check(children.load() == PARENT_COUNT * JOB_COUNT, "nested jobs run", children.load(), PARENT_COUNT * JOB_COUNT);
+}
+
+int main()
+{
+    bool passed = true;
+
+    for (uint32_t worker_count : {1u, 3u})
+    {
+        niqqa::systems::JobSystem jobs;
+
+        if (!jobs.init(worker_count))
+        {
+            return EXIT_FAILURE;
+        }
+
+        for (int i = 0; i < 5; ++i)
+        {
+            passed = test_parallel_for(jobs) && passed;
+            passed = test_parallel_for_edges(jobs) && passed;
+            passed = test_flat(jobs) && passed;
+            passed = test_dependency(jobs) && passed;
+            passed = test_nested(jobs) && passed;
+        }
+
+        jobs.cleanup();
+    }
+
+    std::printf("job system tests %s\n", passed ? "passed" : "failed");
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
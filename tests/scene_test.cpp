@@ -0,0 +1,525 @@
+#include <systems/scene.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+using niqqa::systems::Entity;
+using niqqa::systems::Scene;
+using niqqa::systems::SceneRange;
+using niqqa::systems::ScenePools;
+using niqqa::systems::Transform;
+
+// One entity in sixteen dirty is where update() stops sorting and sweeps the dirty flags
+static constexpr uint32_t DIRTY_SCAN_RATIO{16};
+
+static bool check(bool condition, const char *name, uint64_t actual, uint64_t expected)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "%s: got %llu, expected %llu\n", name,
+                     static_cast<unsigned long long>(actual), static_cast<unsigned long long>(expected));
+    }
+
+    return condition;
+}
+
+// What the scene should hold, kept by entity id and updated alongside it
+struct Mirror
+{
+    std::vector<Transform> local;
+    std::vector<Entity> parent;
+    std::vector<uint8_t> alive;
+
+    void create(Entity entity, const Transform &transform, Entity parent_entity)
+    {
+        if (entity >= local.size())
+        {
+            local.resize(entity + 1);
+            parent.resize(entity + 1, Scene::INVALID_ENTITY);
+            alive.resize(entity + 1, 0);
+        }
+
+        local[entity] = transform;
+        parent[entity] = parent_entity;
+        alive[entity] = 1;
+    }
+
+    bool is_descendant(Entity entity, Entity ancestor) const
+    {
+        for (Entity e = parent[entity]; e != Scene::INVALID_ENTITY; e = parent[e])
+        {
+            if (e == ancestor)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // The entity and everything below it
+    void destroy(Entity entity)
+    {
+        for (Entity e = 0; e < alive.size(); ++e)
+        {
+            if (alive[e] && e != entity && is_descendant(e, entity))
+            {
+                alive[e] = 0;
+            }
+        }
+
+        alive[entity] = 0;
+    }
+};
+
+using Matrix = std::array<double, 12>;
+
+static Matrix local_matrix(const Transform &t)
+{
+    double x = t.rotation[0];
+    double y = t.rotation[1];
+    double z = t.rotation[2];
+    double w = t.rotation[3];
+
+    return {(1.0 - 2.0 * (y * y + z * z)) * t.scale[0], 2.0 * (x * y - w * z) * t.scale[1], 2.0 * (x * z + w * y) * t.scale[2], t.position[0],
+            2.0 * (x * y + w * z) * t.scale[0], (1.0 - 2.0 * (x * x + z * z)) * t.scale[1], 2.0 * (y * z - w * x) * t.scale[2], t.position[1],
+            2.0 * (x * z - w * y) * t.scale[0], 2.0 * (y * z + w * x) * t.scale[1], (1.0 - 2.0 * (x * x + y * y)) * t.scale[2], t.position[2]};
+}
+
+// Parent times child, the recursion the scene flattens into one sweep
+static Matrix reference_world(const Mirror &mirror, Entity entity)
+{
+    Matrix local = local_matrix(mirror.local[entity]);
+
+    if (mirror.parent[entity] == Scene::INVALID_ENTITY)
+    {
+        return local;
+    }
+
+    Matrix parent = reference_world(mirror, mirror.parent[entity]);
+    Matrix world;
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            world[r * 4 + c] = parent[r * 4] * local[c] + parent[r * 4 + 1] * local[4 + c] + parent[r * 4 + 2] * local[8 + c] +
+                               (c == 3 ? parent[r * 4 + 3] : 0.0);
+        }
+    }
+
+    return world;
+}
+
+// Every entity against the reference, plus liveness and the hierarchy order update() relies on
+static bool check_scene(const Scene &scene, const Mirror &mirror, const char *name)
+{
+    uint32_t alive_count = 0;
+    uint32_t wrong_alive = 0;
+    uint32_t wrong_parent = 0;
+    uint32_t wrong_world = 0;
+
+    for (Entity entity = 0; entity < mirror.alive.size(); ++entity)
+    {
+        if (scene.is_alive(entity) != (mirror.alive[entity] != 0))
+        {
+            ++wrong_alive;
+            continue;
+        }
+
+        if (!mirror.alive[entity])
+        {
+            continue;
+        }
+
+        ++alive_count;
+
+        if (scene.parent(entity) != mirror.parent[entity])
+        {
+            ++wrong_parent;
+        }
+
+        Matrix expected = reference_world(mirror, entity);
+        const niqqa::systems::WorldMatrix &world = scene.world_matrix(entity);
+
+        for (uint32_t i = 0; i < 12; ++i)
+        {
+            if (std::fabs(world[i] - expected[i]) > 1e-4 * std::max(1.0, std::fabs(expected[i])))
+            {
+                ++wrong_world;
+                break;
+            }
+        }
+    }
+
+    const ScenePools &pools = scene.pools();
+    uint32_t count = scene.entity_count();
+    uint32_t wrong_order = 0;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t parent = pools.parent[i];
+
+        if (parent != ScenePools::NO_PARENT && (parent >= i || pools.subtree_end[parent] < pools.subtree_end[i]))
+        {
+            ++wrong_order;
+        }
+    }
+
+    bool passed = check(count == alive_count, "entity count", count, alive_count) &&
+                  check(wrong_alive == 0, "wrong liveness", wrong_alive, 0) &&
+                  check(wrong_parent == 0, "wrong parents", wrong_parent, 0) &&
+                  check(wrong_order == 0, "parents after children", wrong_order, 0) &&
+                  check(wrong_world == 0, "wrong world matrices", wrong_world, 0);
+
+    if (!passed)
+    {
+        std::fprintf(stderr, "  in %s\n", name);
+    }
+
+    return passed;
+}
+
+static Transform random_transform(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+
+    Transform t;
+    t.position = {position(random), position(random), position(random)};
+
+    std::array<float, 4> q{axis(random), axis(random), axis(random), axis(random)};
+    float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    t.rotation = {q[0] / length, q[1] / length, q[2] / length, q[3] / length};
+
+    t.scale = {scale(random), scale(random), scale(random)};
+
+    return t;
+}
+
+// Parents picked among recent entities, so depth stays moderate. Most appends are out of
+// hierarchy order, the first update() reorders.
+static void build(Scene &scene, Mirror &mirror, std::mt19937 &random, uint32_t count)
+{
+    std::vector<Entity> created;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Entity parent = Scene::INVALID_ENTITY;
+
+        if (!created.empty() && random() % 8 != 0)
+        {
+            uint32_t window = std::min<uint32_t>(static_cast<uint32_t>(created.size()), 32);
+            parent = created[created.size() - 1 - random() % window];
+        }
+
+        Transform t = random_transform(random);
+        Entity entity = scene.create(t, parent);
+
+        mirror.create(entity, t, parent);
+        created.push_back(entity);
+    }
+}
+
+static std::vector<Entity> alive_entities(const Mirror &mirror)
+{
+    std::vector<Entity> entities;
+
+    for (Entity entity = 0; entity < mirror.alive.size(); ++entity)
+    {
+        if (mirror.alive[entity])
+        {
+            entities.push_back(entity);
+        }
+    }
+
+    return entities;
+}
+
+// Moves dirty_count distinct entities and checks the result and what changed() reports
+static bool test_moves(Scene &scene, Mirror &mirror, std::mt19937 &random, uint32_t dirty_count, const char *name)
+{
+    std::vector<Entity> entities = alive_entities(mirror);
+    std::shuffle(entities.begin(), entities.end(), random);
+    entities.resize(std::min<size_t>(dirty_count, entities.size()));
+
+    uint64_t layout = scene.layout_version();
+
+    for (Entity entity : entities)
+    {
+        Transform t = random_transform(random);
+        scene.set_transform(entity, t);
+        mirror.local[entity] = t;
+    }
+
+    scene.update();
+
+    // Sorted, disjoint and merged where they touch, and every moved subtree inside one
+    const std::vector<SceneRange> &changed = scene.changed();
+    uint32_t bad_ranges = 0;
+    uint32_t uncovered = 0;
+
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+        if (changed[i].begin >= changed[i].end || (i > 0 && changed[i - 1].end >= changed[i].begin))
+        {
+            ++bad_ranges;
+        }
+    }
+
+    for (Entity entity : entities)
+    {
+        uint32_t index = scene.dense_index(entity);
+        bool covered = false;
+
+        for (const SceneRange &range : changed)
+        {
+            covered = covered || (range.begin <= index && scene.pools().subtree_end[index] <= range.end);
+        }
+
+        uncovered += covered ? 0 : 1;
+    }
+
+    bool passed = check(scene.layout_version() == layout, "layout version after moves", scene.layout_version(), layout) &&
+                  check(bad_ranges == 0, "unsorted or unmerged ranges", bad_ranges, 0) &&
+                  check(uncovered == 0, "moved subtrees outside changed()", uncovered, 0);
+
+    if (!passed)
+    {
+        std::fprintf(stderr, "  in %s\n", name);
+    }
+
+    return check_scene(scene, mirror, name) && passed;
+}
+
+// Sorted dirty list below the ratio, flag sweep at and above it
+static bool test_dirty_paths()
+{
+    constexpr uint32_t COUNT{2048};
+
+    bool passed = true;
+
+    for (uint32_t dirty_count : {1u, 7u, COUNT / DIRTY_SCAN_RATIO - 1, COUNT / DIRTY_SCAN_RATIO,
+                                 COUNT / DIRTY_SCAN_RATIO + 1, COUNT / 2, COUNT})
+    {
+        std::mt19937 random{dirty_count};
+        Scene scene;
+        Mirror mirror;
+
+        scene.init(COUNT);
+        build(scene, mirror, random, COUNT);
+        scene.update();
+
+        passed = check_scene(scene, mirror, "dirty paths build") && passed;
+
+        for (int round = 0; round < 3; ++round)
+        {
+            passed = test_moves(scene, mirror, random, dirty_count, "dirty paths") && passed;
+        }
+
+        scene.cleanup();
+    }
+
+    return passed;
+}
+
+// Neighbouring subtrees make one range, a gap between them keeps two
+static bool test_range_merge()
+{
+    Scene scene;
+    Mirror mirror;
+    std::mt19937 random{7};
+
+    scene.init();
+
+    std::array<Entity, 4> roots;
+
+    for (Entity &root : roots)
+    {
+        Transform t = random_transform(random);
+        root = scene.create(t);
+        mirror.create(root, t, Scene::INVALID_ENTITY);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            Transform child = random_transform(random);
+            mirror.create(scene.create(child, root), child, root);
+        }
+    }
+
+    scene.update();
+
+    auto move = [&scene, &mirror, &random](std::initializer_list<Entity> entities)
+    {
+        for (Entity entity : entities)
+        {
+            Transform t = random_transform(random);
+            scene.set_transform(entity, t);
+            mirror.local[entity] = t;
+        }
+
+        scene.update();
+
+        return scene.changed();
+    };
+
+    std::vector<SceneRange> adjacent = move({roots[1], roots[2]});
+    std::vector<SceneRange> apart = move({roots[0], roots[2]});
+    std::vector<SceneRange> nested = move({roots[3] + 1, roots[3]});
+
+    return check(adjacent.size() == 1 && adjacent[0].begin == 4 && adjacent[0].end == 12, "adjacent subtrees ranges", adjacent.size(), 1) &&
+           check(apart.size() == 2, "separate subtrees ranges", apart.size(), 2) &&
+           check(nested.size() == 1 && nested[0].begin == 12 && nested[0].end == 16, "child inside moved parent ranges", nested.size(), 1) &&
+           check_scene(scene, mirror, "range merge");
+}
+
+// Reparenting moves whole subtrees, rejects cycles and lays the scene out again
+static bool test_set_parent()
+{
+    constexpr uint32_t COUNT{1500};
+
+    Scene scene;
+    Mirror mirror;
+    std::mt19937 random{11};
+
+    scene.init(COUNT);
+    build(scene, mirror, random, COUNT);
+    scene.update();
+
+    bool passed = true;
+    uint32_t wrong_cycles = 0;
+
+    for (int round = 0; round < 5; ++round)
+    {
+        std::vector<Entity> entities = alive_entities(mirror);
+        uint64_t layout = scene.layout_version();
+
+        for (int i = 0; i < 40; ++i)
+        {
+            Entity entity = entities[random() % entities.size()];
+            Entity parent = random() % 6 == 0 ? Scene::INVALID_ENTITY : entities[random() % entities.size()];
+
+            bool cycle = parent == entity || (parent != Scene::INVALID_ENTITY && mirror.is_descendant(parent, entity));
+
+            if (scene.set_parent(entity, parent) == cycle)
+            {
+                ++wrong_cycles;
+            }
+
+            if (!cycle)
+            {
+                mirror.parent[entity] = parent;
+            }
+        }
+
+        scene.update();
+
+        const std::vector<SceneRange> &changed = scene.changed();
+
+        passed = check(scene.layout_version() == layout + 1, "layout version after reparenting", scene.layout_version(), layout + 1) &&
+                 check(changed.size() == 1 && changed[0].begin == 0 && changed[0].end == scene.entity_count(),
+                       "changed after reparenting", changed.size(), 1) &&
+                 check_scene(scene, mirror, "set_parent") && passed;
+
+        // The sorted and swept dirty paths on the new layout
+        passed = test_moves(scene, mirror, random, 5, "moves after reorder") && passed;
+        passed = test_moves(scene, mirror, random, COUNT / 4, "moves after reorder") && passed;
+    }
+
+    scene.cleanup();
+
+    return check(wrong_cycles == 0, "set_parent cycle results", wrong_cycles, 0) && passed;
+}
+
+// Destroyed entities take their descendants along, ids come back through create()
+static bool test_destroy()
+{
+    constexpr uint32_t COUNT{1500};
+
+    Scene scene;
+    Mirror mirror;
+    std::mt19937 random{13};
+
+    scene.init(COUNT);
+    build(scene, mirror, random, COUNT);
+    scene.update();
+
+    bool passed = true;
+
+    for (int round = 0; round < 5; ++round)
+    {
+        std::vector<Entity> entities = alive_entities(mirror);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            Entity entity = entities[random() % entities.size()];
+
+            if (mirror.alive[entity])
+            {
+                scene.destroy(entity);
+                mirror.destroy(entity);
+            }
+        }
+
+        // A move queued for an entity that then dies, and one for a survivor
+        entities = alive_entities(mirror);
+        Entity doomed = entities[random() % entities.size()];
+        Entity survivor = entities[random() % entities.size()];
+
+        Transform t = random_transform(random);
+        scene.set_transform(doomed, t);
+        scene.set_transform(survivor, t);
+        mirror.local[doomed] = t;
+        mirror.local[survivor] = t;
+
+        if (doomed != survivor && !mirror.is_descendant(survivor, doomed))
+        {
+            scene.destroy(doomed);
+            mirror.destroy(doomed);
+        }
+
+        scene.update();
+        passed = check_scene(scene, mirror, "destroy") && passed;
+
+        // Reused ids under surviving parents
+        entities = alive_entities(mirror);
+
+        for (int i = 0; i < 12; ++i)
+        {
+            Entity parent = entities[random() % entities.size()];
+            Transform local = random_transform(random);
+
+            mirror.create(scene.create(local, parent), local, parent);
+        }
+
+        scene.update();
+        passed = check_scene(scene, mirror, "create after destroy") && passed;
+        passed = test_moves(scene, mirror, random, 20, "moves after destroy") && passed;
+    }
+
+    scene.cleanup();
+
+    return passed;
+}
+
+int main()
+{
+    bool passed = true;
+
+    passed = test_dirty_paths() && passed;
+    passed = test_range_merge() && passed;
+    passed = test_set_parent() && passed;
+    passed = test_destroy() && passed;
+
+    std::printf("scene tests %s\n", passed ? "passed" : "failed");
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file